@@ -0,0 +1,1264 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <TFile.h>
+#include <TGenPhaseSpace.h>
+#include <TLorentzVector.h>
+#include <TRandom.h>
+#include <TTree.h>
+#include <TVector3.h>
+#include <ROOT/RVec.hxx>
+
+#include "K3PiStudiesUtils.h"
+#include "K3PiBinIndex.h"
+#include "K3PiEventFile.h"
+#include "K3PiFastMath.h"
+#include "K3PiOutputPrecision.h"
+#include "K3PiParallelDriver.h"
+#include "K3PiRDFPipeline.h"
+#include "K3PiRegionClassifier.h"
+#include "K3PiScratchArena.h"
+#include "K3PiToyGenerator.h"
+
+/**
+ * Microbenchmarks for the K3PiStudiesUtils hot paths.
+ *
+ * Inputs are D*+ -> D0 (-> K- pi+ pi+ pi-) pi+ decays from TGenPhaseSpace, boosted to a typical LHCb lab momentum,
+ * plus the AmpGen test point from python/src/ConvertPhsp.py.
+ * Every benchmark cycles through the same fixed, seeded sample, so numbers can be compared between builds.
+ */
+
+using namespace K3PiStudies;
+
+namespace
+{
+	constexpr std::size_t _NUM_EVENTS = 4096;
+	constexpr double _D0_MASS_MEV = 1864.84;
+	constexpr double _DSTAR_MASS_MEV = 2010.26;
+
+	struct BenchEvents
+	{
+		// D0 rest frame, in the order calc_phsp takes them: K-, OS pi 1, SS pi, OS pi 2
+		std::vector<TLorentzVector> _d0;
+		std::vector<std::array<TLorentzVector, 4>> _rest;
+
+		// lab frame
+		std::vector<std::array<TLorentzVector, 4>> _lab;
+		std::vector<TLorentzVector> _d0Lab;
+		std::vector<TLorentzVector> _softPiLab;
+		std::vector<bool> _pi1GoesWithK;
+
+		// daughter IDs in ntuple order (D0_P0...D0_P3), shuffled per event
+		std::vector<std::array<int, 4>> _ids;
+
+		// region/time bin inputs, signal peak on top of a flat background
+		std::vector<double> _d0MassMeV;
+		std::vector<double> _deltaMMeV;
+		std::vector<double> _decayTimePS;
+
+		// SoA copies of _rest for the batch kernel
+		std::array<std::vector<double>, 4> _px, _py, _pz, _pE;
+
+		// SoA pt, eta, phi of _lab for the PtEtaPhi batch kernel
+		std::array<std::vector<double>, 4> _pt, _eta, _phi;
+	};
+
+	// _NUM_EVENTS decays with D* lab momenta from dStarMomentum
+	BenchEvents makeEvents(const std::function<TVector3()> &dStarMomentum)
+	{
+		BenchEvents ev;
+		gRandom->SetSeed(20230901);
+
+		const double kpipipiMasses[4] = {K3PiStudiesUtils::_KAON_MASS, K3PiStudiesUtils::_PION_MASS, K3PiStudiesUtils::_PION_MASS, K3PiStudiesUtils::_PION_MASS};
+		const double d0PiMasses[2] = {_D0_MASS_MEV, K3PiStudiesUtils::_PION_MASS};
+		TLorentzVector d0AtRest(0.0, 0.0, 0.0, _D0_MASS_MEV);
+		TLorentzVector dStarAtRest(0.0, 0.0, 0.0, _DSTAR_MASS_MEV);
+		TGenPhaseSpace d0Decay, dStarDecay;
+		d0Decay.SetDecay(d0AtRest, 4, kpipipiMasses);
+		dStarDecay.SetDecay(dStarAtRest, 2, d0PiMasses);
+
+		while (ev._rest.size() < _NUM_EVENTS)
+		{
+			if (gRandom->Rndm() * d0Decay.GetWtMax() > d0Decay.Generate())
+			{
+				continue;
+			}
+			dStarDecay.Generate();
+
+			// K-, pi+ (OS 1), pi+ (OS 2), pi- (SS)
+			const std::array<TLorentzVector, 4> rest = {*d0Decay.GetDecay(0), *d0Decay.GetDecay(1), *d0Decay.GetDecay(3), *d0Decay.GetDecay(2)};
+
+			TLorentzVector dStarLab;
+			dStarLab.SetVectM(dStarMomentum(), _DSTAR_MASS_MEV);
+			TLorentzVector d0Lab = *dStarDecay.GetDecay(0);
+			TLorentzVector softPiLab = *dStarDecay.GetDecay(1);
+			d0Lab.Boost(dStarLab.BoostVector());
+			softPiLab.Boost(dStarLab.BoostVector());
+
+			std::array<TLorentzVector, 4> lab = rest;
+			for (TLorentzVector &p : lab)
+			{
+				p.Boost(d0Lab.BoostVector());
+			}
+
+			ev._d0.push_back(d0AtRest);
+			ev._rest.push_back(rest);
+			ev._lab.push_back(lab);
+			ev._d0Lab.push_back(d0Lab);
+			ev._softPiLab.push_back(softPiLab);
+			ev._pi1GoesWithK.push_back(gRandom->Rndm() < 0.5);
+
+			// D0 or D0bar, daughters in random order
+			const int sign = (gRandom->Rndm() < 0.5) ? 1 : -1;
+			std::array<int, 4> ids = {-sign * int(K3PiStudiesUtils::_KAON_ID), sign * int(K3PiStudiesUtils::_PION_ID), sign * int(K3PiStudiesUtils::_PION_ID), -sign * int(K3PiStudiesUtils::_PION_ID)};
+			for (int i = 3; i > 0; i--)
+			{
+				std::swap(ids[i], ids[int(gRandom->Rndm() * (i + 1)) % (i + 1)]);
+			}
+			ev._ids.push_back(ids);
+
+			const bool isSignal = gRandom->Rndm() < 0.6;
+			ev._d0MassMeV.push_back(isSignal ? gRandom->Gaus(_D0_MASS_MEV, 8.0) : gRandom->Uniform(K3PiStudiesUtils::_ALL_REGS_D0_MASS_AXIS_MIN_MEV, K3PiStudiesUtils::_ALL_REGS_D0_MASS_AXIS_MAX_MEV));
+			ev._deltaMMeV.push_back(isSignal ? gRandom->Gaus(K3PiStudiesUtils::_DELTAM_PDG_MEV, 0.3) : gRandom->Uniform(K3PiStudiesUtils::_ALL_REGS_DELTAM_AXIS_MIN_MEV, K3PiStudiesUtils::_ALL_REGS_DELTAM_AXIS_MAX_MEV));
+			ev._decayTimePS.push_back(gRandom->Exp(K3PiStudiesUtils::_D0_LIFETIME_PS));
+
+			for (int r = 0; r < 4; r++)
+			{
+				ev._px[r].push_back(rest[r].Px());
+				ev._py[r].push_back(rest[r].Py());
+				ev._pz[r].push_back(rest[r].Pz());
+				ev._pE[r].push_back(rest[r].E());
+				ev._pt[r].push_back(K3PiStudiesUtils::getPT(lab[r].Px(), lab[r].Py(), lab[r].Pz(), lab[r].E()));
+				ev._eta[r].push_back(K3PiStudiesUtils::getEta(lab[r].Px(), lab[r].Py(), lab[r].Pz(), lab[r].E()));
+				ev._phi[r].push_back(K3PiStudiesUtils::getPhi(lab[r].Px(), lab[r].Py(), lab[r].Pz(), lab[r].E()));
+			}
+		}
+
+		return ev;
+	}
+
+	const BenchEvents &benchEvents()
+	{
+		// D* with pT ~ 5 GeV, pz ~ 60 GeV
+		static const BenchEvents events = makeEvents(
+			[]()
+			{
+				const double px = gRandom->Gaus(0.0, 4000.0);
+				const double py = gRandom->Gaus(0.0, 4000.0);
+				return TVector3(px, py, gRandom->Uniform(20000.0, 100000.0));
+			});
+		return events;
+	}
+
+	// for the validation entries: D* momenta of 5 to 150 GeV, the range the K3PiFastMath bounds are given for, at 0.01 to 0.3 rad to the beam
+	const BenchEvents &validationEvents()
+	{
+		static const BenchEvents events = makeEvents(
+			[]()
+			{
+				TVector3 p;
+				const double mag = gRandom->Uniform(5000.0, 150000.0);
+				const double theta = gRandom->Uniform(0.01, 0.3);
+				p.SetMagThetaPhi(mag, theta, gRandom->Uniform(0.0, K3PiStudiesUtils::_TWO_PI));
+				return p;
+			});
+		return events;
+	}
+
+	// AmpGen test point from python/src/ConvertPhsp.py, px, py, pz, E [GeV]
+	TLorentzVector ampGenToTLorentzVector(double px, double py, double pz, double pE)
+	{
+		return K3PiStudiesUtils::toTLorentzVector(pE * K3PiStudiesUtils::_GEV_TO_MEV, px * K3PiStudiesUtils::_GEV_TO_MEV, py * K3PiStudiesUtils::_GEV_TO_MEV, pz * K3PiStudiesUtils::_GEV_TO_MEV);
+	}
+
+	// validation entries (BM_validate_*) run once and report the largest deviation of each quantity as a counter,
+	// failing the entry if one is over the bound the code documents
+	void checkMaxDeviation(benchmark::State &state, const std::string &name, double maxDeviation, double bound)
+	{
+		state.counters[name] = maxDeviation;
+		if (!(maxDeviation <= bound))
+		{
+			state.SkipWithError((name + " is over its documented bound").c_str());
+		}
+	}
+
+	// whether the pi pi pair of cos1 or the K pi pair of cos2 of event i is within 1 MeV of its threshold, as defined by pi1GoesWithK
+	bool isNearThreshold(const BenchEvents &ev, std::size_t i)
+	{
+		const bool pi1GoesWithK = ev._pi1GoesWithK[i];
+		const std::array<TLorentzVector, 4> &rest = ev._rest[i];
+		const double m12 = (rest[pi1GoesWithK ? K3Pi_OSPion2 : K3Pi_OSPion1] + rest[K3Pi_SSPion]).M();
+		const double m34 = (rest[K3Pi_Kaon] + rest[pi1GoesWithK ? K3Pi_OSPion1 : K3Pi_OSPion2]).M();
+		return m12 < 2.0 * K3PiStudiesUtils::_PION_MASS + 1.0 || m34 < K3PiStudiesUtils::_KAON_MASS + K3PiStudiesUtils::_PION_MASS + 1.0;
+	}
+
+	// |a - b| for angles of a 2 pi range, so values just either side of its ends are close
+	double angleDiff(double a, double b)
+	{
+		const double diff = std::abs(a - b);
+		return std::min(diff, K3PiStudiesUtils::_TWO_PI - diff);
+	}
+
+	// ntuple order D0_P0...D0_P3 of the validation inputs = K-, pi+ (OS 1), pi+ (OS 2), pi- (SS); _lab is in K3Pi_Roles order
+	const int _VALIDATE_ROLE_OF_DAUGHTER[4] = {K3Pi_Kaon, K3Pi_OSPion1, K3Pi_OSPion2, K3Pi_SSPion};
+	const int _VALIDATE_IDS[4] = {-int(K3PiStudiesUtils::_KAON_ID), int(K3PiStudiesUtils::_PION_ID), int(K3PiStudiesUtils::_PION_ID), -int(K3PiStudiesUtils::_PION_ID)};
+
+	// folds the deviation of phsp (m12, m34, cos12, cos34, phi) from calc_phsp on bench event e in the D0 rest frame into maxDiff
+	void updatePhspDeviation(std::array<double, 5> &maxDiff, std::size_t e, const std::array<double, 5> &phsp)
+	{
+		const BenchEvents &ev = benchEvents();
+		const std::array<TLorentzVector, 4> &p = ev._rest[e];
+		const std::vector<double> expected = K3PiStudiesUtils::calc_phsp(ev._d0[e], p[0], p[1], p[2], p[3]);
+		for (int c = 0; c < 5; c++)
+		{
+			maxDiff[c] = std::max(maxDiff[c], c == 4 ? angleDiff(phsp[c], expected[c]) : std::abs(phsp[c] - expected[c]));
+		}
+	}
+
+	void checkPhspDeviation(benchmark::State &state, const std::array<double, 5> &maxDiff)
+	{
+		// the lab -> D0 CM boost undoes the bench's D0 CM -> lab one up to rounding, amplified by the boost (gamma up to ~50)
+		checkMaxDeviation(state, "m12", maxDiff[0], 1e-6);
+		checkMaxDeviation(state, "m34", maxDiff[1], 1e-6);
+		checkMaxDeviation(state, "cos12", maxDiff[2], 1e-8);
+		checkMaxDeviation(state, "cos34", maxDiff[3], 1e-8);
+		checkMaxDeviation(state, "phi", maxDiff[4], 1e-8);
+	}
+
+	// ALL/SIGNAL regions x decay time bins, as in our region/time bin studies
+	const std::vector<std::string> _REGIONS = {K3PiStudiesUtils::_ALL_REGION_FLAG, K3PiStudiesUtils::_SIG_REGION_FLAG};
+	const std::vector<double> _UPPER_TIME_BIN_EDGES_PS = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.8, 1.0, 1.5, 2.0};
+} // end anonymous namespace
+
+static void BM_calc_phsp_AmpGenTestPoint(benchmark::State &state)
+{
+	const TLorentzVector d0 = K3PiStudiesUtils::toTLorentzVector(_D0_MASS_MEV, 0.0, 0.0, 0.0);
+	const TLorentzVector k = ampGenToTLorentzVector(-0.22605460233259722, 0.37058687639201848, -0.046885439376411875, 0.65905276036464722);
+	const TLorentzVector osPi1 = ampGenToTLorentzVector(0.075397408921232992, 0.24469544143911467, 0.20952672690121868, 0.35908482669738223);
+	const TLorentzVector osPi2 = ampGenToTLorentzVector(0.07358860140319394, -0.24208436188963289, -0.30165403210059527, 0.41772611931236503);
+	const TLorentzVector ssPi = ampGenToTLorentzVector(0.077068592008170317, -0.37319795594150029, 0.13901274457578858, 0.42897629362560541);
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(K3PiStudiesUtils::calc_phsp(d0, k, osPi1, ssPi, osPi2));
+	}
+}
+BENCHMARK(BM_calc_phsp_AmpGenTestPoint);
+
+static void BM_calc_phsp(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		const std::array<TLorentzVector, 4> &p = ev._rest[i];
+		benchmark::DoNotOptimize(K3PiStudiesUtils::calc_phsp(ev._d0[i], p[0], p[1], p[2], p[3]));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_calc_phsp);
+
+static void BM_calc_phsp_point(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		const std::array<TLorentzVector, 4> &p = ev._rest[i];
+		benchmark::DoNotOptimize(K3PiStudiesUtils::calc_phsp_point(ev._d0[i], p[0], p[1], p[2], p[3]));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_calc_phsp_point);
+
+static void BM_calc_phsp_batch(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	const std::size_t n = state.range(0);
+	std::vector<double> m12(n), m34(n), cos12(n), cos34(n), phi(n);
+	P4Columns cols[4];
+	for (int r = 0; r < 4; r++)
+	{
+		cols[r] = {ev._px[r].data(), ev._py[r].data(), ev._pz[r].data(), ev._pE[r].data()};
+	}
+	const Phsp4BodyColumns out = {m12.data(), m34.data(), cos12.data(), cos34.data(), phi.data()};
+
+	for (auto _ : state)
+	{
+		K3PiStudiesUtils::calc_phsp_batch(n, cols[0], cols[1], cols[2], cols[3], out);
+		benchmark::DoNotOptimize(phi.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+	state.SetLabel(K3PiStudiesUtils::batchKernelISA());
+}
+BENCHMARK(BM_calc_phsp_batch)->Arg(64)->Arg(_NUM_EVENTS);
+
+// defineK3PiColumns on the boosted (lab frame) daughters vs calc_phsp on the same decays in the D0 rest frame
+static void BM_validate_defineK3PiColumns(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+
+	for (auto _ : state)
+	{
+		ROOT::RDF::RNode df = ROOT::RDataFrame(_NUM_EVENTS);
+		for (int d = 0; d < 4; d++)
+		{
+			const std::string name = "D0_P" + std::to_string(d) + "_";
+			const int role = _VALIDATE_ROLE_OF_DAUGHTER[d];
+			const int id = _VALIDATE_IDS[d];
+			df = df.Define(name + "ID", [id]() { return id; });
+			df = df.Define(name + "PX", [&ev, role](ULong64_t e) { return ev._lab[e][role].Px(); }, {"rdfentry_"});
+			df = df.Define(name + "PY", [&ev, role](ULong64_t e) { return ev._lab[e][role].Py(); }, {"rdfentry_"});
+			df = df.Define(name + "PZ", [&ev, role](ULong64_t e) { return ev._lab[e][role].Pz(); }, {"rdfentry_"});
+			df = df.Define(name + "PE", [&ev, role](ULong64_t e) { return ev._lab[e][role].E(); }, {"rdfentry_"});
+		}
+		ROOT::RDF::RNode withK3Pi = K3PiRDFPipeline::defineK3PiColumns(df, K3PiColumnConfig());
+
+		const char *names[5] = {"m12", "m34", "cos12", "cos34", "phi"};
+		std::vector<ROOT::RDF::RResultPtr<std::vector<double>>> columns;
+		for (const char *name : names)
+		{
+			columns.push_back(withK3Pi.Take<double>(std::string("K3Pi_") + name));
+		}
+		ROOT::RDF::RResultPtr<std::vector<ULong64_t>> entries = withK3Pi.Take<ULong64_t>("rdfentry_");
+
+		std::array<double, 5> maxDiff = {0.0, 0.0, 0.0, 0.0, 0.0};
+		for (std::size_t i = 0; i < entries->size(); i++)
+		{
+			updatePhspDeviation(maxDiff, (*entries)[i], {(*columns[0])[i], (*columns[1])[i], (*columns[2])[i], (*columns[3])[i], (*columns[4])[i]});
+		}
+		checkPhspDeviation(state, maxDiff);
+	}
+}
+BENCHMARK(BM_validate_defineK3PiColumns)->Iterations(1);
+
+// K3PiParallelDriver chunks of a TTree of the boosted (lab frame) daughters vs calc_phsp on the same decays in the D0 rest frame
+static void BM_validate_parallelDriver(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	const std::string path = "K3PiStudiesUtilsBench_validate.root";
+	{
+		std::unique_ptr<TFile> file(TFile::Open(path.c_str(), "RECREATE"));
+		TTree *tree = new TTree("DecayTree", "DecayTree");
+		// small clusters, so the file is split into many tasks
+		tree->SetAutoFlush(256);
+		int id[4];
+		double px[4], py[4], pz[4], pE[4];
+		for (int d = 0; d < 4; d++)
+		{
+			const std::string name = "D0_P" + std::to_string(d) + "_";
+			tree->Branch((name + "ID").c_str(), &id[d], (name + "ID/I").c_str());
+			tree->Branch((name + "PX").c_str(), &px[d], (name + "PX/D").c_str());
+			tree->Branch((name + "PY").c_str(), &py[d], (name + "PY/D").c_str());
+			tree->Branch((name + "PZ").c_str(), &pz[d], (name + "PZ/D").c_str());
+			tree->Branch((name + "PE").c_str(), &pE[d], (name + "PE/D").c_str());
+		}
+		for (std::size_t e = 0; e < _NUM_EVENTS; e++)
+		{
+			for (int d = 0; d < 4; d++)
+			{
+				const TLorentzVector &p = ev._lab[e][_VALIDATE_ROLE_OF_DAUGHTER[d]];
+				id[d] = _VALIDATE_IDS[d];
+				px[d] = p.Px();
+				py[d] = p.Py();
+				pz[d] = p.Pz();
+				pE[d] = p.E();
+			}
+			tree->Fill();
+		}
+		tree->Write();
+		file->Close();
+	}
+
+	K3PiParallelDriverConfig config;
+	config._chunkConfig._treeName = "DecayTree";
+	config._numThreads = 4;
+	config._taskEntries = 1000;
+
+	struct WorkerState
+	{
+		std::array<double, 5> _maxDiff = {0.0, 0.0, 0.0, 0.0, 0.0};
+		std::vector<int> _timesSeen = std::vector<int>(_NUM_EVENTS, 0);
+	};
+
+	for (auto _ : state)
+	{
+		const K3PiParallelDriver driver({path}, config);
+		auto process = [](WorkerState &worker, const K3PiChunk &chunk)
+		{
+			for (std::size_t i = 0; i < chunk._size; i++)
+			{
+				const std::size_t e = chunk._firstEntry + i;
+				worker._timesSeen[e]++;
+				updatePhspDeviation(worker._maxDiff, e, {chunk._m12_MeV[i], chunk._m34_MeV[i], chunk._cos12[i], chunk._cos34[i], chunk._phi_rad[i]});
+			}
+		};
+		auto merge = [](WorkerState &into, WorkerState &from)
+		{
+			for (int c = 0; c < 5; c++)
+			{
+				into._maxDiff[c] = std::max(into._maxDiff[c], from._maxDiff[c]);
+			}
+			for (std::size_t e = 0; e < _NUM_EVENTS; e++)
+			{
+				into._timesSeen[e] += from._timesSeen[e];
+			}
+		};
+		const WorkerState merged = driver.runAndMerge([]() { return WorkerState(); }, process, merge);
+
+		checkPhspDeviation(state, merged._maxDiff);
+		if (std::any_of(merged._timesSeen.begin(), merged._timesSeen.end(), [](int n) { return n != 1; }))
+		{
+			state.SkipWithError("not every entry was processed exactly once");
+		}
+	}
+	std::remove(path.c_str());
+}
+BENCHMARK(BM_validate_parallelDriver)->Iterations(1);
+
+// calc_phsp_batch straight from a mapped K3PiEventFile (0 = float, 1 = double precision file)
+static void BM_calc_phsp_eventFile(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::vector<const double *> p4Columns;
+	for (int r = 0; r < 4; r++)
+	{
+		p4Columns.insert(p4Columns.end(), {ev._px[r].data(), ev._py[r].data(), ev._pz[r].data(), ev._pE[r].data()});
+	}
+	K3PiEventFileConfig config;
+	config._precision = state.range(0) ? K3PiEventPrecision::Double : K3PiEventPrecision::Float;
+	const std::string path = "K3PiStudiesUtilsBench_events.k3pievts";
+	K3PiEventFile::write(path, _NUM_EVENTS, p4Columns, {}, {}, config);
+	const K3PiEventFile file(path);
+	std::remove(path.c_str());
+
+	std::vector<double> m12(_NUM_EVENTS), m34(_NUM_EVENTS), cos12(_NUM_EVENTS), cos34(_NUM_EVENTS), phi(_NUM_EVENTS);
+	const Phsp4BodyColumns out = {m12.data(), m34.data(), cos12.data(), cos34.data(), phi.data()};
+
+	for (auto _ : state)
+	{
+		file.calc_phsp(out);
+		benchmark::DoNotOptimize(phi.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * _NUM_EVENTS);
+}
+BENCHMARK(BM_calc_phsp_eventFile)->ArgName("double")->Arg(0)->Arg(1);
+
+static void BM_calc_phsp_PtEtaPhi(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	const bool verifyAngles = state.range(0);
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(K3PiStudiesUtils::calc_phsp(
+			ev._pt[0][i], ev._eta[0][i], ev._phi[0][i],
+			ev._pt[2][i], ev._eta[2][i], ev._phi[2][i],
+			ev._pt[1][i], ev._eta[1][i], ev._phi[1][i],
+			ev._pt[3][i], ev._eta[3][i], ev._phi[3][i],
+			ev._pi1GoesWithK[i], verifyAngles, false));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_calc_phsp_PtEtaPhi)->ArgName("verifyAngles")->Arg(0)->Arg(1);
+
+static void BM_calc_phsp_point_PtEtaPhi_VerifyOff(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(K3PiStudiesUtils::calc_phsp_point<Pairing::Pi2WithK, Verify::Off>(
+			ev._pt[0][i], ev._eta[0][i], ev._phi[0][i],
+			ev._pt[2][i], ev._eta[2][i], ev._phi[2][i],
+			ev._pt[1][i], ev._eta[1][i], ev._phi[1][i],
+			ev._pt[3][i], ev._eta[3][i], ev._phi[3][i]));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_calc_phsp_point_PtEtaPhi_VerifyOff);
+
+static void BM_calc_phsp_point_fused(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(K3PiStudiesUtils::calc_phsp_point_fused(
+			ev._pt[0][i], ev._eta[0][i], ev._phi[0][i],
+			ev._pt[2][i], ev._eta[2][i], ev._phi[2][i],
+			ev._pt[1][i], ev._eta[1][i], ev._phi[1][i],
+			ev._pt[3][i], ev._eta[3][i], ev._phi[3][i],
+			ev._pi1GoesWithK[i]));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_calc_phsp_point_fused);
+
+// calc_phsp_point_fused vs the PtEtaPhi calc_phsp_point, on validationEvents and on decays within 1 MeV of the pi pi or K pi threshold
+static void BM_validate_calc_phsp_point_fused(benchmark::State &state)
+{
+	const BenchEvents &ev = validationEvents();
+	const double pionMass = K3PiStudiesUtils::_PION_MASS;
+	const double kaonMass = K3PiStudiesUtils::_KAON_MASS;
+
+	// largest |fused - exact| of m12, m34, cos1, cos2, phi, m13; cos1 and cos2 separately for nearThreshold decays
+	std::array<double, 6> maxDiff = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+	std::array<double, 2> maxCosDiffNearThreshold = {0.0, 0.0};
+	auto compare = [&](const std::array<TLorentzVector, 4> &lab, bool pi1GoesWithK, bool nearThreshold)
+	{
+		double pt[4], eta[4], phi[4];
+		for (int r = 0; r < 4; r++)
+		{
+			pt[r] = K3PiStudiesUtils::getPT(lab[r].Px(), lab[r].Py(), lab[r].Pz(), lab[r].E());
+			eta[r] = K3PiStudiesUtils::getEta(lab[r].Px(), lab[r].Py(), lab[r].Pz(), lab[r].E());
+			phi[r] = K3PiStudiesUtils::getPhi(lab[r].Px(), lab[r].Py(), lab[r].Pz(), lab[r].E());
+		}
+		const Phsp4BodyPtEtaPhiPoint fused = K3PiStudiesUtils::calc_phsp_point_fused(
+			pt[0], eta[0], phi[0], pt[2], eta[2], phi[2], pt[1], eta[1], phi[1], pt[3], eta[3], phi[3], pi1GoesWithK);
+		const Phsp4BodyPtEtaPhiPoint exact = K3PiStudiesUtils::calc_phsp_point(
+			pt[0], eta[0], phi[0], pt[2], eta[2], phi[2], pt[1], eta[1], phi[1], pt[3], eta[3], phi[3], pi1GoesWithK, false, false);
+
+		const double diff[6] = {std::abs(fused._m12_MeV - exact._m12_MeV), std::abs(fused._m34_MeV - exact._m34_MeV),
+								std::abs(fused._cos1 - exact._cos1), std::abs(fused._cos2 - exact._cos2),
+								std::abs(fused._phi_rad - exact._phi_rad), std::abs(fused._m13_MeV - exact._m13_MeV)};
+		for (int c = 0; c < 6; c++)
+		{
+			const bool isCos = c == 2 || c == 3;
+			double &maxC = nearThreshold && isCos ? maxCosDiffNearThreshold[c - 2] : maxDiff[c];
+			maxC = std::max(maxC, c == 4 ? angleDiff(fused._phi_rad, exact._phi_rad) : diff[c]);
+		}
+	};
+
+	for (auto _ : state)
+	{
+		for (std::size_t i = 0; i < _NUM_EVENTS; i++)
+		{
+			compare(ev._lab[i], ev._pi1GoesWithK[i], isNearThreshold(ev, i));
+		}
+
+		// D0 -> (pi pi) (K pi), with every other decay 1 keV to 1 MeV above the pi pi threshold, the others above the K pi one
+		TRandom &rng = *gRandom;
+		rng.SetSeed(20231104);
+		TLorentzVector d0AtRest(0.0, 0.0, 0.0, _D0_MASS_MEV);
+		const double pipiMasses[2] = {pionMass, pionMass};
+		const double kpiMasses[2] = {kaonMass, pionMass};
+		for (std::size_t i = 0; i < _NUM_EVENTS; i++)
+		{
+			const double aboveThreshold = std::pow(10.0, rng.Uniform(-3.0, 0.0));
+			double resMasses[2];
+			if (i % 2 == 0)
+			{
+				resMasses[0] = 2.0 * pionMass + aboveThreshold;
+				resMasses[1] = rng.Uniform(kaonMass + pionMass + 1.0, _D0_MASS_MEV - resMasses[0] - 1.0);
+			}
+			else
+			{
+				resMasses[1] = kaonMass + pionMass + aboveThreshold;
+				resMasses[0] = rng.Uniform(2.0 * pionMass + 1.0, _D0_MASS_MEV - resMasses[1] - 1.0);
+			}
+
+			TGenPhaseSpace toResonances, pipiDecay, kpiDecay;
+			toResonances.SetDecay(d0AtRest, 2, resMasses);
+			toResonances.Generate();
+			pipiDecay.SetDecay(*toResonances.GetDecay(0), 2, pipiMasses);
+			pipiDecay.Generate();
+			kpiDecay.SetDecay(*toResonances.GetDecay(1), 2, kpiMasses);
+			kpiDecay.Generate();
+
+			// pi1GoesWithK: OS pi 1 is the kaon's partner, OS pi 2 the SS pion's
+			std::array<TLorentzVector, 4> lab;
+			lab[K3Pi_Kaon] = *kpiDecay.GetDecay(0);
+			lab[K3Pi_OSPion1] = *kpiDecay.GetDecay(1);
+			lab[K3Pi_SSPion] = *pipiDecay.GetDecay(1);
+			lab[K3Pi_OSPion2] = *pipiDecay.GetDecay(0);
+			TLorentzVector d0Lab;
+			d0Lab.SetVectM(ev._d0Lab[i].Vect(), _D0_MASS_MEV);
+			for (TLorentzVector &p : lab)
+			{
+				p.Boost(d0Lab.BoostVector());
+			}
+			compare(lab, true, true);
+		}
+
+		checkMaxDeviation(state, "m12", maxDiff[0], 1e-9);
+		checkMaxDeviation(state, "m34", maxDiff[1], 1e-9);
+		checkMaxDeviation(state, "cos1", maxDiff[2], 1e-9);
+		checkMaxDeviation(state, "cos2", maxDiff[3], 1e-9);
+		checkMaxDeviation(state, "phi", maxDiff[4], 1e-9);
+		checkMaxDeviation(state, "m13", maxDiff[5], 1e-9);
+		// the numerator of helicityCosFromInvariants cancels there
+		checkMaxDeviation(state, "cos1_threshold", maxCosDiffNearThreshold[0], 5e-6);
+		checkMaxDeviation(state, "cos2_threshold", maxCosDiffNearThreshold[1], 5e-6);
+	}
+}
+BENCHMARK(BM_validate_calc_phsp_point_fused)->Iterations(1);
+
+static void BM_calc_phsp_point_PtEtaPhi_FastMath(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(K3PiFastMath::calc_phsp_point(
+			ev._pt[0][i], ev._eta[0][i], ev._phi[0][i],
+			ev._pt[2][i], ev._eta[2][i], ev._phi[2][i],
+			ev._pt[1][i], ev._eta[1][i], ev._phi[1][i],
+			ev._pt[3][i], ev._eta[3][i], ev._phi[3][i],
+			ev._pi1GoesWithK[i]));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_calc_phsp_point_PtEtaPhi_FastMath);
+
+// every K3PiFastMath function vs its exact version on validationEvents, against the bounds in K3PiFastMath.h
+static void BM_validate_K3PiFastMath(benchmark::State &state)
+{
+	const BenchEvents &ev = validationEvents();
+
+	for (auto _ : state)
+	{
+		// atan2 around the unit circle and acos over [-1, 1], both compared with the double functions of the same float input
+		double atan2Diff = 0.0, acosDiff = 0.0;
+		constexpr int numSteps = 1 << 20;
+		for (int i = 0; i <= numSteps; i++)
+		{
+			const double angle = -K3PiStudiesUtils::_PI + K3PiStudiesUtils::_TWO_PI * i / numSteps;
+			const float y = std::sin(angle), x = std::cos(angle);
+			atan2Diff = std::max(atan2Diff, angleDiff(K3PiFastMath::atan2(y, x), std::atan2(double(y), double(x))));
+			const float c = -1.0 + 2.0 * i / numSteps;
+			acosDiff = std::max(acosDiff, std::abs(K3PiFastMath::acos(c) - std::acos(double(c))));
+		}
+
+		double kutschkeDiff = 0.0, helicityDiff = 0.0;
+		std::array<double, 5> d0CMDiff = {0.0, 0.0, 0.0, 0.0, 0.0};
+		// m12, m34, cos1, cos2, phi, m13; cos1 and cos2 of decays near threshold separately, as for calc_phsp_point_fused
+		std::array<double, 6> ptEtaPhiDiff = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+		std::array<double, 2> ptEtaPhiCosDiffNearThreshold = {0.0, 0.0};
+		for (std::size_t i = 0; i < _NUM_EVENTS; i++)
+		{
+			const std::array<TLorentzVector, 4> &p = ev._rest[i];
+			kutschkeDiff = std::max(kutschkeDiff, angleDiff(K3PiFastMath::angleBetweenDecayPlanesKutschke(p[0].Vect(), p[1].Vect(), p[2].Vect(), p[3].Vect()),
+															K3PiStudiesUtils::angleBetweenDecayPlanesKutschke(p[0].Vect(), p[1].Vect(), p[2].Vect(), p[3].Vect())));
+
+			std::vector<ROOT::Math::PxPyPzEVector> genP;
+			for (const TLorentzVector &pr : p)
+			{
+				genP.emplace_back(pr.Px(), pr.Py(), pr.Pz(), pr.E());
+			}
+			const Phsp4BodyPoint fastD0CM = K3PiFastMath::calc_phsp_point(genP[0], genP[1], genP[2], genP[3]);
+			const Phsp4BodyPoint exactD0CM = K3PiStudiesUtils::calc_phsp_point(genP[0], genP[1], genP[2], genP[3]);
+			const double d0CM[5] = {std::abs(fastD0CM._m12_MeV - exactD0CM._m12_MeV), std::abs(fastD0CM._m34_MeV - exactD0CM._m34_MeV),
+									std::abs(fastD0CM._cos12 - exactD0CM._cos12), std::abs(fastD0CM._cos34 - exactD0CM._cos34),
+									angleDiff(fastD0CM._phi_rad, exactD0CM._phi_rad)};
+			for (int c = 0; c < 5; c++)
+			{
+				d0CMDiff[c] = std::max(d0CMDiff[c], d0CM[c]);
+			}
+
+			const Phsp4BodyPtEtaPhiPoint fast = K3PiFastMath::calc_phsp_point(
+				ev._pt[0][i], ev._eta[0][i], ev._phi[0][i],
+				ev._pt[2][i], ev._eta[2][i], ev._phi[2][i],
+				ev._pt[1][i], ev._eta[1][i], ev._phi[1][i],
+				ev._pt[3][i], ev._eta[3][i], ev._phi[3][i],
+				ev._pi1GoesWithK[i]);
+			const Phsp4BodyPtEtaPhiPoint exact = K3PiStudiesUtils::calc_phsp_point(
+				ev._pt[0][i], ev._eta[0][i], ev._phi[0][i],
+				ev._pt[2][i], ev._eta[2][i], ev._phi[2][i],
+				ev._pt[1][i], ev._eta[1][i], ev._phi[1][i],
+				ev._pt[3][i], ev._eta[3][i], ev._phi[3][i],
+				ev._pi1GoesWithK[i], false, false);
+			const bool nearThreshold = isNearThreshold(ev, i);
+			const double ptEtaPhi[6] = {std::abs(fast._m12_MeV - exact._m12_MeV), std::abs(fast._m34_MeV - exact._m34_MeV),
+										std::abs(fast._cos1 - exact._cos1), std::abs(fast._cos2 - exact._cos2),
+										angleDiff(fast._phi_rad, exact._phi_rad), std::abs(fast._m13_MeV - exact._m13_MeV)};
+			for (int c = 0; c < 6; c++)
+			{
+				double &maxC = nearThreshold && (c == 2 || c == 3) ? ptEtaPhiCosDiffNearThreshold[c - 2] : ptEtaPhiDiff[c];
+				maxC = std::max(maxC, ptEtaPhi[c]);
+			}
+
+			const TLorentzVector &d0 = ev._d0Lab[i];
+			const TLorentzVector &pis = ev._softPiLab[i];
+			helicityDiff = std::max(helicityDiff, double(std::abs(
+													  K3PiFastMath::helicity_angle_func(d0.Px(), d0.Py(), d0.Pz(), _D0_MASS_MEV, pis.Px(), pis.Py(), pis.Pz(), K3PiStudiesUtils::_PION_MASS) -
+													  K3PiStudiesUtils::helicity_angle_func(d0.Px(), d0.Py(), d0.Pz(), _D0_MASS_MEV, pis.Px(), pis.Py(), pis.Pz(), K3PiStudiesUtils::_PION_MASS))));
+		}
+
+		checkMaxDeviation(state, "atan2", atan2Diff, 4e-7);
+		checkMaxDeviation(state, "acos", acosDiff, 5e-7);
+		checkMaxDeviation(state, "kutschke", kutschkeDiff, 4e-7);
+		checkMaxDeviation(state, "D0CM_m12", d0CMDiff[0], 1e-9);
+		checkMaxDeviation(state, "D0CM_m34", d0CMDiff[1], 1e-9);
+		checkMaxDeviation(state, "D0CM_cos12", d0CMDiff[2], 1e-9);
+		checkMaxDeviation(state, "D0CM_cos34", d0CMDiff[3], 1e-9);
+		checkMaxDeviation(state, "D0CM_phi", d0CMDiff[4], 6e-7);
+		checkMaxDeviation(state, "PtEtaPhi_m12", ptEtaPhiDiff[0], 1e-9);
+		checkMaxDeviation(state, "PtEtaPhi_m34", ptEtaPhiDiff[1], 1e-9);
+		checkMaxDeviation(state, "PtEtaPhi_cos1", ptEtaPhiDiff[2], 1e-9);
+		checkMaxDeviation(state, "PtEtaPhi_cos2", ptEtaPhiDiff[3], 1e-9);
+		checkMaxDeviation(state, "PtEtaPhi_phi", ptEtaPhiDiff[4], 4e-7);
+		checkMaxDeviation(state, "PtEtaPhi_m13", ptEtaPhiDiff[5], 1e-9);
+		checkMaxDeviation(state, "PtEtaPhi_cos1_threshold", ptEtaPhiCosDiffNearThreshold[0], 5e-6);
+		checkMaxDeviation(state, "PtEtaPhi_cos2_threshold", ptEtaPhiCosDiffNearThreshold[1], 5e-6);
+		checkMaxDeviation(state, "helicity_angle_func", helicityDiff, 5e-7);
+	}
+}
+BENCHMARK(BM_validate_K3PiFastMath)->Iterations(1);
+
+// K3PiPrecision rounding of random values and of the validation events' phase space columns, at every mantissa width,
+// against the bounds in K3PiOutputPrecision.h; each counter is the largest error as a fraction of its bound
+static void BM_validate_K3PiPrecision(benchmark::State &state)
+{
+	const BenchEvents &ev = validationEvents();
+
+	for (auto _ : state)
+	{
+		gRandom->SetSeed(20231014);
+		constexpr int numRandom = 1 << 16;
+
+		double relativeErr = 0.0, cosErr = 0.0, phiErr = 0.0, lowBitsSet = 0.0;
+		for (int m = 0; m <= K3PiPrecision::_FLOAT_MANTISSA_BITS; m++)
+		{
+			const K3PiOutputPrecision precision = m == K3PiPrecision::_FLOAT_MANTISSA_BITS ? K3PiOutputPrecision::Float : K3PiOutputPrecision::RoundedFloat;
+			const double relBound = K3PiPrecision::maxRelativeError(precision, m);
+			const double cosBound = K3PiPrecision::maxAbsError(precision, m, 1.0);
+			const double phiBound = K3PiPrecision::maxAbsError(precision, m, K3PiStudiesUtils::_TWO_PI);
+
+			// the stored float must not have any of the dropped mantissa bits set, or it would not compress
+			const std::uint32_t droppedBits = (std::uint32_t(1) << (K3PiPrecision::_FLOAT_MANTISSA_BITS - m)) - 1;
+			const auto checkLowBits = [&](double x, double stored)
+			{
+				const float f = float(stored);
+				std::uint32_t bits;
+				std::memcpy(&bits, &f, sizeof(bits));
+				// float subnormals have fewer mantissa bits, they are only bounded absolutely
+				if (std::abs(x) >= 1e-37 && (bits & droppedBits) != 0)
+				{
+					lowBitsSet++;
+				}
+			};
+
+			for (int i = 0; i < numRandom; i++)
+			{
+				// magnitudes over most of the normal float range, where the relative bound holds
+				const double x = (gRandom->Rndm() < 0.5 ? -1.0 : 1.0) * std::ldexp(1.0 + gRandom->Rndm(), int(gRandom->Uniform(-120.0, 120.0)));
+				const double xStored = K3PiPrecision::store(x, precision, m);
+				relativeErr = std::max(relativeErr, std::abs(xStored - x) / std::abs(x) / relBound);
+				checkLowBits(x, xStored);
+
+				// cosines, including ones close enough to 0 to be float subnormals
+				const double c = gRandom->Rndm() < 0.1 ? std::ldexp(gRandom->Uniform(-1.0, 1.0), -int(gRandom->Uniform(0.0, 160.0))) : gRandom->Uniform(-1.0, 1.0);
+				cosErr = std::max(cosErr, std::abs(K3PiPrecision::store(c, precision, m) - c) / cosBound);
+
+				const double a = gRandom->Uniform(0.0, K3PiStudiesUtils::_TWO_PI);
+				phiErr = std::max(phiErr, std::abs(K3PiPrecision::store(a, precision, m) - a) / phiBound);
+			}
+
+			for (std::size_t e = 0; e < _NUM_EVENTS; e++)
+			{
+				const std::array<TLorentzVector, 4> &p = ev._rest[e];
+				const std::vector<double> phsp = K3PiStudiesUtils::calc_phsp(ev._d0[e], p[0], p[1], p[2], p[3]);
+				for (int c = 0; c < 2; c++)
+				{
+					const double stored = K3PiPrecision::store(phsp[c], precision, m);
+					relativeErr = std::max(relativeErr, std::abs(stored - phsp[c]) / phsp[c] / relBound);
+					checkLowBits(phsp[c], stored);
+				}
+				for (int c = 2; c < 4; c++)
+				{
+					cosErr = std::max(cosErr, std::abs(K3PiPrecision::store(phsp[c], precision, m) - phsp[c]) / cosBound);
+				}
+				phiErr = std::max(phiErr, std::abs(K3PiPrecision::store(phsp[4], precision, m) - phsp[4]) / phiBound);
+			}
+		}
+
+		// NaN (a failed candidate) must stay NaN
+		const bool keepsNaN = std::isnan(K3PiPrecision::store(std::numeric_limits<double>::quiet_NaN(), K3PiOutputPrecision::RoundedFloat, 12));
+
+		checkMaxDeviation(state, "relative", relativeErr, 1.0);
+		checkMaxDeviation(state, "cos", cosErr, 1.0);
+		checkMaxDeviation(state, "phi", phiErr, 1.0);
+		checkMaxDeviation(state, "lowBitsSet", lowBitsSet, 0.0);
+		checkMaxDeviation(state, "NaN", keepsNaN ? 0.0 : 1.0, 0.0);
+	}
+}
+BENCHMARK(BM_validate_K3PiPrecision)->Iterations(1);
+
+static void BM_calc_phsp_batch_PtEtaPhi(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	const std::size_t n = state.range(0);
+	std::vector<double> m12(n), m34(n), cos1(n), cos2(n), phi(n), m13(n);
+	std::unique_ptr<bool[]> pi1GoesWithK(new bool[n]);
+	std::copy(ev._pi1GoesWithK.begin(), ev._pi1GoesWithK.begin() + n, pi1GoesWithK.get());
+	PtEtaPhiColumns cols[4];
+	for (int r = 0; r < 4; r++)
+	{
+		cols[r] = {ev._pt[r].data(), ev._eta[r].data(), ev._phi[r].data()};
+	}
+	const Phsp4BodyPtEtaPhiColumns out = {m12.data(), m34.data(), cos1.data(), cos2.data(), phi.data(), m13.data()};
+
+	for (auto _ : state)
+	{
+		K3PiStudiesUtils::calc_phsp_batch(n, cols[0], cols[2], cols[1], cols[3], pi1GoesWithK.get(), out);
+		benchmark::DoNotOptimize(phi.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+	state.SetLabel(K3PiStudiesUtils::batchKernelISA());
+}
+BENCHMARK(BM_calc_phsp_batch_PtEtaPhi)->Arg(64)->Arg(_NUM_EVENTS);
+
+static void BM_angleBetweenDecayPlanesKutschke(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		const std::array<TLorentzVector, 4> &p = ev._rest[i];
+		benchmark::DoNotOptimize(K3PiStudiesUtils::angleBetweenDecayPlanesKutschke(p[0].Vect(), p[1].Vect(), p[2].Vect(), p[3].Vect()));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_angleBetweenDecayPlanesKutschke);
+
+// Math is K3PiKinematics or K3PiFastMath, which have the same GenVector overload of this one function
+template <typename Math>
+static void BM_angleBetweenDecayPlanesKutschke_GenVector(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::vector<std::array<ROOT::Math::XYZVector, 4>> rest;
+	for (const std::array<TLorentzVector, 4> &p : ev._rest)
+	{
+		rest.push_back({ROOT::Math::XYZVector(p[0].X(), p[0].Y(), p[0].Z()), ROOT::Math::XYZVector(p[1].X(), p[1].Y(), p[1].Z()),
+						ROOT::Math::XYZVector(p[2].X(), p[2].Y(), p[2].Z()), ROOT::Math::XYZVector(p[3].X(), p[3].Y(), p[3].Z())});
+	}
+
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		const std::array<ROOT::Math::XYZVector, 4> &p = rest[i];
+		benchmark::DoNotOptimize(Math::angleBetweenDecayPlanesKutschke(p[0], p[1], p[2], p[3]));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_angleBetweenDecayPlanesKutschke_GenVector, K3PiKinematics);
+BENCHMARK_TEMPLATE(BM_angleBetweenDecayPlanesKutschke_GenVector, K3PiFastMath);
+
+static void BM_helicity_angle_func(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		const TLorentzVector &d0 = ev._d0Lab[i];
+		const TLorentzVector &pis = ev._softPiLab[i];
+		benchmark::DoNotOptimize(K3PiStudiesUtils::helicity_angle_func(
+			d0.Px(), d0.Py(), d0.Pz(), _D0_MASS_MEV,
+			pis.Px(), pis.Py(), pis.Pz(), K3PiStudiesUtils::_PION_MASS));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_helicity_angle_func);
+
+static void BM_helicity_angle_func_RVec(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::vector<ROOT::RVec<float>> pisPx, pisPy, pisPz;
+	for (const TLorentzVector &pis : ev._softPiLab)
+	{
+		pisPx.push_back({float(pis.Px())});
+		pisPy.push_back({float(pis.Py())});
+		pisPz.push_back({float(pis.Pz())});
+	}
+
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		const TLorentzVector &d0 = ev._d0Lab[i];
+		benchmark::DoNotOptimize(K3PiStudiesUtils::helicity_angle_func(
+			d0.Px(), d0.Py(), d0.Pz(), _D0_MASS_MEV,
+			pisPx[i], pisPy[i], pisPz[i], K3PiStudiesUtils::_PION_MASS));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_helicity_angle_func_RVec);
+
+static void BM_helicity_angle_func_allCandidates(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	const std::size_t n = state.range(0);
+	ROOT::RVec<float> d0Px(n), d0Py(n), d0Pz(n), d0M(n, _D0_MASS_MEV), pisPx(n), pisPy(n), pisPz(n);
+	for (std::size_t i = 0; i < n; i++)
+	{
+		d0Px[i] = ev._d0Lab[i].Px();
+		d0Py[i] = ev._d0Lab[i].Py();
+		d0Pz[i] = ev._d0Lab[i].Pz();
+		pisPx[i] = ev._softPiLab[i].Px();
+		pisPy[i] = ev._softPiLab[i].Py();
+		pisPz[i] = ev._softPiLab[i].Pz();
+	}
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(K3PiStudiesUtils::helicity_angle_func(d0Px, d0Py, d0Pz, d0M, pisPx, pisPy, pisPz, K3PiStudiesUtils::_PION_MASS));
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_helicity_angle_func_allCandidates)->Arg(8)->Arg(_NUM_EVENTS);
+
+static void BM_helicity_angle_func_allCandidates_FastMath(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	const std::size_t n = state.range(0);
+	ROOT::RVec<float> d0Px(n), d0Py(n), d0Pz(n), d0M(n, _D0_MASS_MEV), pisPx(n), pisPy(n), pisPz(n);
+	for (std::size_t i = 0; i < n; i++)
+	{
+		d0Px[i] = ev._d0Lab[i].Px();
+		d0Py[i] = ev._d0Lab[i].Py();
+		d0Pz[i] = ev._d0Lab[i].Pz();
+		pisPx[i] = ev._softPiLab[i].Px();
+		pisPy[i] = ev._softPiLab[i].Py();
+		pisPz[i] = ev._softPiLab[i].Pz();
+	}
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(K3PiFastMath::helicity_angle_func(d0Px, d0Py, d0Pz, d0M, pisPx, pisPy, pisPz, K3PiStudiesUtils::_PION_MASS));
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_helicity_angle_func_allCandidates_FastMath)->Arg(8)->Arg(_NUM_EVENTS);
+
+static void BM_compute_delta_angle(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		const TLorentzVector &extra = ev._softPiLab[i];
+		const TLorentzVector &d = ev._lab[i][1];
+		benchmark::DoNotOptimize(K3PiStudiesUtils::compute_delta_angle(extra.Px(), extra.Py(), extra.Pz(), d.Px(), d.Py(), d.Pz()));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_compute_delta_angle);
+
+static void BM_compute_delta_angle_allExtraTracks(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	const std::size_t n = state.range(0);
+	ROOT::RVec<double> extraPx(n), extraPy(n), extraPz(n);
+	for (std::size_t i = 0; i < n; i++)
+	{
+		extraPx[i] = ev._softPiLab[i].Px();
+		extraPy[i] = ev._softPiLab[i].Py();
+		extraPz[i] = ev._softPiLab[i].Pz();
+	}
+	const TLorentzVector &d = ev._lab[0][1];
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(K3PiStudiesUtils::compute_delta_angle(extraPx, extraPy, extraPz, d.Px(), d.Py(), d.Pz()));
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_compute_delta_angle_allExtraTracks)->Arg(8)->Arg(_NUM_EVENTS);
+
+static void BM_compute_delta_angle_withMasses(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		const TLorentzVector &extra = ev._softPiLab[i];
+		const TLorentzVector &d = ev._lab[i][0];
+		benchmark::DoNotOptimize(K3PiStudiesUtils::compute_delta_angle(
+			extra.Px(), extra.Py(), extra.Pz(), K3PiStudiesUtils::_PION_MASS,
+			d.Px(), d.Py(), d.Pz(), K3PiStudiesUtils::_KAON_MASS));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_compute_delta_angle_withMasses);
+
+// findKaon -> isKaonNeg -> findSSPion -> findOSPions, as the analysis scripts chain them
+static void BM_daughterFinders(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		const std::array<int, 4> &id = ev._ids[i];
+		const int kaonInd = K3PiStudiesUtils::findKaon(id[0], id[1], id[2], id[3]);
+		const bool kaonIsNeg = K3PiStudiesUtils::isKaonNeg(kaonInd, id[0], id[1], id[2], id[3]);
+		benchmark::DoNotOptimize(K3PiStudiesUtils::findSSPion(kaonIsNeg, id[0], id[1], id[2], id[3]));
+		benchmark::DoNotOptimize(K3PiStudiesUtils::findOSPions(kaonIsNeg, id[0], id[1], id[2], id[3]));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_daughterFinders);
+
+static void BM_findDecayPermutation(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		const std::array<int, 4> &id = ev._ids[i];
+		benchmark::DoNotOptimize(K3PiStudiesUtils::findDecayPermutation(id[0], id[1], id[2], id[3]));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_findDecayPermutation);
+
+// the bench IDs with every 4th candidate made a ghost (a muon in place of daughter 3), to compare the reject paths
+static std::vector<std::array<int, 4>> idsWithGhosts()
+{
+	std::vector<std::array<int, 4>> ids = benchEvents()._ids;
+	for (std::size_t i = 0; i < ids.size(); i += 4)
+	{
+		ids[i][3] = 13;
+	}
+	return ids;
+}
+
+static void BM_daughterFinders_withGhosts(benchmark::State &state)
+{
+	const std::vector<std::array<int, 4>> ids = idsWithGhosts();
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		const std::array<int, 4> &id = ids[i];
+		try
+		{
+			const int kaonInd = K3PiStudiesUtils::findKaon(id[0], id[1], id[2], id[3]);
+			const bool kaonIsNeg = K3PiStudiesUtils::isKaonNeg(kaonInd, id[0], id[1], id[2], id[3]);
+			benchmark::DoNotOptimize(K3PiStudiesUtils::findSSPion(kaonIsNeg, id[0], id[1], id[2], id[3]));
+			benchmark::DoNotOptimize(K3PiStudiesUtils::findOSPionPair(kaonIsNeg, id[0], id[1], id[2], id[3]));
+		}
+		catch (const InvalidDecayError &)
+		{
+		}
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_daughterFinders_withGhosts);
+
+static void BM_findDecayPermutations_withGhosts(benchmark::State &state)
+{
+	const std::vector<std::array<int, 4>> ids = idsWithGhosts();
+	std::vector<int> idColumns[4];
+	for (int d = 0; d < 4; d++)
+	{
+		for (const std::array<int, 4> &id : ids)
+		{
+			idColumns[d].push_back(id[d]);
+		}
+	}
+
+	std::vector<DecayPermutation> perms(_NUM_EVENTS);
+	DecayRejectCounters counters;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(K3PiStudiesUtils::findDecayPermutations(
+			_NUM_EVENTS, idColumns[0].data(), idColumns[1].data(), idColumns[2].data(), idColumns[3].data(), perms.data(), counters));
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * _NUM_EVENTS);
+}
+BENCHMARK(BM_findDecayPermutations_withGhosts);
+
+// isInD0MassRegion/isInDeltaMRegion + isWithinDecayTimeBin for every region and time bin, as the per-configuration loops do
+static void BM_regionChecks(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	const std::vector<std::pair<double, double>> timeBins = K3PiStudiesUtils::makeTimeBins(_UPPER_TIME_BIN_EDGES_PS);
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		int numPassing = 0;
+		for (const std::string &region : _REGIONS)
+		{
+			for (const std::pair<double, double> &timeBin : timeBins)
+			{
+				numPassing += K3PiStudiesUtils::isInD0MassRegion(region, ev._d0MassMeV[i]) &&
+							  K3PiStudiesUtils::isInDeltaMRegion(region, ev._deltaMMeV[i]) &&
+							  K3PiStudiesUtils::isWithinDecayTimeBin(ev._decayTimePS[i], timeBin);
+			}
+		}
+		benchmark::DoNotOptimize(numPassing);
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_regionChecks);
+
+static void BM_regionClassifier(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	const K3PiRegionClassifier classifier(_REGIONS, _UPPER_TIME_BIN_EDGES_PS);
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(classifier.timeBin(ev._decayTimePS[i]));
+		benchmark::DoNotOptimize(classifier.regionMask(ev._d0MassMeV[i], ev._deltaMMeV[i]));
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_regionClassifier);
+
+static void BM_regionClassifier_batch(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	const K3PiRegionClassifier classifier(_REGIONS, _UPPER_TIME_BIN_EDGES_PS);
+	std::vector<int> timeBins(_NUM_EVENTS);
+	std::vector<std::uint32_t> regionMasks(_NUM_EVENTS);
+	for (auto _ : state)
+	{
+		classifier.classify(_NUM_EVENTS, ev._d0MassMeV.data(), ev._deltaMMeV.data(), ev._decayTimePS.data(), timeBins.data(), regionMasks.data());
+		benchmark::DoNotOptimize(regionMasks.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * _NUM_EVENTS);
+}
+BENCHMARK(BM_regionClassifier_batch);
+
+// calc_phsp vs calc_phsp_point of the same event, as the validation loops compare them
+static void BM_compare5(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	std::vector<Phsp4Body> phsps;
+	std::vector<Phsp4Body> points;
+	for (std::size_t i = 0; i < _NUM_EVENTS; i++)
+	{
+		const std::array<TLorentzVector, 4> &p = ev._rest[i];
+		const std::vector<double> v = K3PiStudiesUtils::calc_phsp(ev._d0[i], p[0], p[1], p[2], p[3]);
+		const Phsp4BodyPoint pt = K3PiStudiesUtils::calc_phsp_point(ev._d0[i], p[0], p[1], p[2], p[3]);
+		phsps.emplace_back(v[0], v[1], v[2], v[3], v[4], 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+		points.emplace_back(pt._m12_MeV, pt._m34_MeV, pt._cos12, pt._cos34, pt._phi_rad, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+	}
+
+	const std::function<bool(double, double)> isEqualFunc = K3PiStudiesUtils::combinedToleranceCompare;
+	std::size_t i = 0;
+	for (auto _ : state)
+	{
+		if (state.range(0) == 0)
+		{
+			benchmark::DoNotOptimize(phsps[i].compare5(points[i], isEqualFunc, int(i), false));
+		}
+		else
+		{
+			benchmark::DoNotOptimize(phsps[i].compare5(points[i], K3PiStudiesUtils::combinedToleranceCompare, int(i), false));
+		}
+		i = (i + 1) % _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_compare5)->ArgName("template")->Arg(0)->Arg(1);
+
+// flat phase space toys straight into columns, with and without the 4-vectors
+static void BM_toyGenerator(benchmark::State &state)
+{
+	const K3PiToyGenerator generator(K3PiToyGeneratorConfig{});
+	std::vector<std::vector<double>> cols(5 + 16, std::vector<double>(_NUM_EVENTS));
+	const Phsp4BodyColumns phsp = {cols[0].data(), cols[1].data(), cols[2].data(), cols[3].data(), cols[4].data()};
+	std::array<P4OutColumns, 4> p4;
+	for (int r = 0; r < 4; r++)
+	{
+		p4[r] = {cols[5 + 4 * r].data(), cols[6 + 4 * r].data(), cols[7 + 4 * r].data(), cols[8 + 4 * r].data()};
+	}
+
+	std::uint64_t firstEvent = 0;
+	for (auto _ : state)
+	{
+		generator.generate(firstEvent, _NUM_EVENTS, phsp, state.range(0) ? &p4 : nullptr);
+		benchmark::DoNotOptimize(cols[0].data());
+		benchmark::ClobberMemory();
+		firstEvent += _NUM_EVENTS;
+	}
+	state.SetItemsProcessed(state.iterations() * _NUM_EVENTS);
+}
+BENCHMARK(BM_toyGenerator)->ArgName("p4")->Arg(0)->Arg(1);
+
+// one rebinning of a precomputed K3PiBinIndex (D0 mass in groups of range(0) fine bins x decay time), RS candidates only
+static void BM_binIndex_rebin(benchmark::State &state)
+{
+	const BenchEvents &ev = benchEvents();
+	const K3PiBinAxis massAxis = K3PiBinAxis::uniform("mD0", 240, K3PiStudiesUtils::_ALL_REGS_D0_MASS_AXIS_MIN_MEV, K3PiStudiesUtils::_ALL_REGS_D0_MASS_AXIS_MAX_MEV);
+	const K3PiBinAxis timeAxis = K3PiBinAxis::fromUpperEdges("t", _UPPER_TIME_BIN_EDGES_PS);
+	K3PiBinIndex index({massAxis, timeAxis});
+	std::vector<std::uint8_t> flags(_NUM_EVENTS);
+	for (std::size_t i = 0; i < _NUM_EVENTS; i++)
+	{
+		flags[i] = K3PiBinIndex::makeFlags(true, i % 2 == 0, 0);
+	}
+	const double *columns[2] = {ev._d0MassMeV.data(), ev._decayTimePS.data()};
+	index.fill(_NUM_EVENTS, columns, flags.data());
+
+	const std::vector<K3PiBinMap> maps = {K3PiBinMap::merge(massAxis, state.range(0)), K3PiBinMap::identity(timeAxis)};
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(index.histogram(maps, K3PiBinFlag_IsRS, K3PiBinFlag_IsRS));
+	}
+	state.SetItemsProcessed(state.iterations() * _NUM_EVENTS);
+}
+BENCHMARK(BM_binIndex_rebin)->Arg(1)->Arg(8);
+
+// per candidate helpers returning heap vectors vs the same ones on the per-thread scratch arena
+static void BM_findOSPions_heap(benchmark::State &state)
+{
+	int d0P2ID = 211;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(d0P2ID);
+		const std::vector<int> osPions = K3PiStudiesUtils::findOSPions(true, -321, 211, d0P2ID, -211);
+		benchmark::DoNotOptimize(osPions.data());
+	}
+}
+BENCHMARK(BM_findOSPions_heap);
+
+static void BM_findOSPions_scratch(benchmark::State &state)
+{
+	int d0P2ID = 211;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(d0P2ID);
+		K3PiScratchScope scope;
+		const std::pmr::vector<int> osPions = K3PiStudiesUtils::findOSPions(true, -321, 211, d0P2ID, -211, scope.resource());
+		benchmark::DoNotOptimize(osPions.data());
+	}
+}
+BENCHMARK(BM_findOSPions_scratch);
+
+BENCHMARK_MAIN();
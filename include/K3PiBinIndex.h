@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace K3PiStudies
+{
+
+	// fine binning of one variable: bin b is [_edges[b], _edges[b + 1]); at most 65535 bins
+	struct K3PiBinAxis
+	{
+		std::string _name;
+		std::vector<double> _edges;
+
+		static K3PiBinAxis uniform(const std::string &name, std::size_t numBins, double low, double high);
+
+		// the bins of K3PiStudiesUtils::makeTimeBins(upperBinEdges): (-inf, e0), [e0, e1), ..., [e_last, inf)
+		static K3PiBinAxis fromUpperEdges(const std::string &name, const std::vector<double> &upperBinEdges);
+
+		std::size_t numBins() const;
+	};
+
+	// coarse binning of an axis as a lookup table from fine bin to coarse bin (-1 = dropped)
+	struct K3PiBinMap
+	{
+		std::vector<std::int32_t> _fineToCoarse;
+		std::size_t _numCoarse;
+
+		static K3PiBinMap identity(const K3PiBinAxis &axis);
+
+		// coarseEdges must be fine edges; fine bins outside them are dropped. Throws std::invalid_argument otherwise
+		static K3PiBinMap fromEdges(const K3PiBinAxis &axis, const std::vector<double> &coarseEdges);
+
+		// consecutive groups of groupSize fine bins (the last one may be smaller)
+		static K3PiBinMap merge(const K3PiBinAxis &axis, std::size_t groupSize);
+
+		// only the fine bins [firstBin, endBin), e.g. an m12 slice, into a single coarse bin
+		static K3PiBinMap slice(const K3PiBinAxis &axis, std::size_t firstBin, std::size_t endBin);
+	};
+
+	// per event flag bits, see K3PiBinIndex::makeFlags
+	enum K3PiBinFlags : std::uint8_t
+	{
+		K3PiBinFlag_IsD0 = 1 << 0,
+		K3PiBinFlag_IsRS = 1 << 1,
+		K3PiBinFlag_QuadrantShift = 2, // bits 2-4: K3PiStudiesUtils::determineQuadrant (0-4)
+		K3PiBinFlag_QuadrantMask = 7 << K3PiBinFlag_QuadrantShift
+	};
+
+	/**
+	 * Fine bin coordinates of every event, computed once, so coarser or shifted binnings, m12/m34 slices, decay time rebinnings,
+	 * quadrants and RS/WS or D0/D0bar partitions can be derived later by integer lookups instead of event loops over the
+	 * kinematics. Per event it keeps one uint8 (axes up to 255 bins) or uint16 per axis plus one byte of K3PiBinFlags.
+	 *
+	 * Values outside an axis (and NaN) get no fine bin, and are dropped by every K3PiBinMap.
+	 */
+	class K3PiBinIndex final
+	{
+	public:
+		// throws std::invalid_argument for an axis without bins, with too many, or with edges that are not increasing
+		explicit K3PiBinIndex(const std::vector<K3PiBinAxis> &axes);
+
+		static std::uint8_t makeFlags(bool isD0, bool isRS, unsigned int quadrant);
+
+		/**
+		 * Appends nEvents events.
+		 *
+		 * @param columns one column of nEvents values per axis, in axis order
+		 * @param flags nEvents K3PiBinFlags, or null for all 0
+		 */
+		void fill(std::size_t nEvents, const double *const *columns, const std::uint8_t *flags = nullptr);
+
+		// same for float columns, e.g. the K3PiPhspSidecar ones
+		void fill(std::size_t nEvents, const float *const *columns, const std::uint8_t *flags = nullptr);
+
+		std::size_t numEvents() const;
+
+		const std::vector<K3PiBinAxis> &axes() const;
+
+		// -1 if the value was outside the axis
+		int fineBin(std::size_t axisInd, std::size_t event) const;
+
+		std::uint8_t flags(std::size_t event) const;
+
+		/**
+		 * Events per bin of the coarse binning given by one map per axis, as a dense array with the first axis varying slowest,
+		 * only over events with (flags & flagMask) == flagValue.
+		 *
+		 * @param weights null, or one weight per event
+		 */
+		std::vector<double> histogram(
+			const std::vector<K3PiBinMap> &maps,
+			std::uint8_t flagMask = 0,
+			std::uint8_t flagValue = 0,
+			const double *weights = nullptr) const;
+
+		// the dense coarse bin of every event as used by histogram, -1 if it is dropped; out has numEvents() entries
+		void denseIndices(
+			const std::vector<K3PiBinMap> &maps,
+			std::uint8_t flagMask,
+			std::uint8_t flagValue,
+			std::int32_t *out) const;
+
+	private:
+		struct AxisBins
+		{
+			std::vector<std::uint8_t> _bins8; // used if the axis has at most 255 bins; numBins() means outside the axis
+			std::vector<std::uint16_t> _bins16;
+			bool _isUniform;
+			double _invBinWidth;
+		};
+
+		template <typename T>
+		void fillColumns(std::size_t nEvents, const T *const *columns, const std::uint8_t *flags);
+
+		void checkMaps(const std::vector<K3PiBinMap> &maps) const;
+
+		std::vector<K3PiBinAxis> _axes;
+		std::vector<AxisBins> _bins;
+		std::vector<std::uint8_t> _flags;
+	}; // end K3PiBinIndex class
+
+} // end namespace K3PiStudies
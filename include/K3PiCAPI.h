@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Plain C entry points into the batch kernels, for callers that only have raw buffers and no C++ ABI,
+ * e.g. python/src/py_k3pi_utilities/batch.py through ctypes (which releases the GIL around every call).
+ * The columns are used in place; nothing is copied or allocated.
+ *
+ * Functions return 0 on success, non-zero on failure with the reason from k3pi_last_error().
+ * The header is plain C, so C callers can include it too.
+ */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+	/**
+	 * K3PiStudiesUtils::calc_phsp_batch on 16 momentum columns in the D0 CM frame, role-major in K3Pi_Roles order:
+	 * K_PX, K_PY, K_PZ, K_PE, OSPi1_PX, ..., SSPi_PX, ..., OSPi2_PE.
+	 *
+	 * @param p4Columns 16 pointers to nEvents doubles each
+	 * @param phspColumns 5 pointers to nEvents doubles each, filled with m12, m34, cos12, cos34, phi (0 to 2 pi)
+	 * @param toMeV factor converting the momentum units to MeV (1 for MeV, 1000 for GeV), applied to m12 and m34
+	 */
+	int k3pi_calc_phsp_batch(
+		size_t nEvents,
+		const double *const *p4Columns,
+		double *const *phspColumns,
+		double toMeV);
+
+	/**
+	 * K3PiToyGenerator::generate: flat phase space events [firstEvent, firstEvent + nEvents) of the given seed, the same
+	 * for any numThreads (0 = all cores).
+	 *
+	 * @param phspColumns 5 pointers to nEvents doubles each, filled with m12, m34, cos12, cos34, phi (0 to 2 pi)
+	 * @param p4Columns null, or 16 pointers to nEvents doubles each (role-major as above), filled with the D0 CM momenta in MeV
+	 */
+	int k3pi_generate_toy_phsp(
+		uint64_t seed,
+		double d0MassMeV,
+		uint64_t firstEvent,
+		size_t nEvents,
+		double *const *phspColumns,
+		double *const *p4Columns,
+		unsigned int numThreads);
+
+	// message of the last failure on the calling thread, "" if none
+	const char *k3pi_last_error(void);
+
+	// K3PiStudiesUtils::batchKernelISA(), e.g. to log which kernel the Python jobs ran
+	const char *k3pi_batch_kernel_isa(void);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "K3PiStudiesUtils.h"
+#include "K3PiRDFPipeline.h"
+#include "K3PiRegionClassifier.h"
+
+namespace K3PiStudies
+{
+
+	// settings for K3PiChunkedDriver
+	struct K3PiChunkedDriverConfig
+	{
+		std::string _treeName;
+
+		// which daughter branches to read and their type; if _dstPiIDColumn is set the chunks also have isRS. _outPrefix is not used
+		K3PiColumnConfig _columnConfig;
+
+		// upper bound on the buffers of the two chunks in flight (one being read, one being processed); sets the chunk size
+		std::size_t _maxMemoryBytes = std::size_t(256) * 1024 * 1024;
+
+		// names of extra (double) branches read along with the daughters, given to the callback in this order in K3PiChunk::_extra
+		std::vector<std::string> _extraColumns;
+
+		// if _decayTimeColumn is set, every candidate is also classified (K3PiRegionClassifier) using these (double) branches
+		std::vector<std::string> _regionFlags = {K3PiStudiesUtils::_ALL_REGION_FLAG, K3PiStudiesUtils::_SIG_REGION_FLAG};
+		std::vector<double> _upperTimeBinEdges;
+		std::string _d0MassMeVColumn = "";
+		std::string _deltaMMeVColumn = "";
+		std::string _decayTimeColumn = "";
+	};
+
+	// entries [_firstEntry, _endEntry) of input file _fileInd; _endEntry past the end of the file means up to the end
+	struct K3PiEntryRange
+	{
+		std::size_t _fileInd;
+		std::uint64_t _firstEntry;
+		std::uint64_t _endEntry;
+	};
+
+	/**
+	 * View of one chunk of consecutive entries of one input file, given to the K3PiChunkedDriver callback.
+	 * Every column has _size entries; the buffers are reused for later chunks, so don't keep pointers past the callback.
+	 * K3PiScratchArena::threadLocal() is reset after every callback, so the callback can use it for per-candidate scratch.
+	 */
+	struct K3PiChunk
+	{
+		std::size_t _fileInd;
+		std::uint64_t _firstEntry; // entry number in the file of element 0
+
+		std::size_t _size;
+
+		// false if the daughter IDs are not K + 3 pi with the right charges; the momenta and phase space are then NaN
+		const bool *_isValid;
+		const bool *_kaonIsNeg;
+
+		// nullptr unless _columnConfig._dstPiIDColumn is set
+		const bool *_isRS;
+
+		// 4-momenta as read (lab frame), indexed by K3Pi_Roles
+		P4Columns _p4[4];
+
+		// the same boosted into the D0 rest frame
+		P4Columns _p4D0CM[4];
+
+		// calc_phsp_batch output, computed from _p4D0CM
+		const double *_m12_MeV;
+		const double *_m34_MeV;
+		const double *_cos12;
+		const double *_cos34;
+		const double *_phi_rad;
+
+		// K3PiRegionClassifier::classify output, nullptr unless _decayTimeColumn is set
+		const int *_timeBins;
+		const std::uint32_t *_regionMasks;
+
+		// one column per K3PiChunkedDriverConfig::_extraColumns
+		std::vector<const double *> _extra;
+	};
+
+	/**
+	 * Streams a list of input files (e.g. from K3PiStudiesUtils::buildListFromCommaSepStr) through a callback in bounded-size chunks,
+	 * for samples whose phase space columns don't fit in memory all at once. The next chunk is read from disk on a second thread
+	 * while the current one is processed and handed to the callback, so I/O and compute overlap.
+	 *
+	 * The callback runs on the calling thread and typically pushes into accumulators (K3PiStreamingStats.h) or fills histograms.
+	 * Calls ROOT::EnableThreadSafety, since the reading thread uses ROOT I/O while the callback may use ROOT too.
+	 */
+	class K3PiChunkedDriver final
+	{
+	public:
+		using ChunkFunc = std::function<void(const K3PiChunk &)>;
+
+		// sets the next entry range to process and returns true, or returns false when there are no more; called on the reading thread
+		using RangeSource = std::function<bool(K3PiEntryRange &)>;
+
+		K3PiChunkedDriver(const std::vector<std::string> &inputFiles, const K3PiChunkedDriverConfig &config);
+
+		// entries per chunk, from _maxMemoryBytes
+		std::size_t chunkEntries() const;
+
+		// bytes of buffer per entry of a chunk
+		std::size_t bytesPerEntry() const;
+
+		/**
+		 * Processes every entry of every input file once, in order.
+		 *
+		 * @return number of entries processed
+		 */
+		std::uint64_t run(const ChunkFunc &func) const;
+
+		/**
+		 * Processes only the entry ranges given by nextRange, in that order; chunks never span two ranges.
+		 * Does not modify the driver, so e.g. K3PiParallelDriver runs one per thread on the same driver.
+		 *
+		 * @return number of entries processed
+		 */
+		std::uint64_t run(const ChunkFunc &func, const RangeSource &nextRange) const;
+
+	private:
+		std::vector<std::string> _inputFiles;
+		K3PiChunkedDriverConfig _config;
+
+		// branches read as double: the _extraColumns followed by any classifier columns not among them
+		std::vector<std::string> _doubleColumns;
+		int _d0MassInd = -1;
+		int _deltaMInd = -1;
+		int _decayTimeInd = -1;
+		std::unique_ptr<K3PiRegionClassifier> _classifier;
+
+		std::size_t _bytesPerEntry;
+		std::size_t _chunkEntries;
+	}; // end K3PiChunkedDriver class
+
+} // end namespace K3PiStudies
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <TH1.h>
+#include <TString.h>
+
+class TCanvas;
+class TFile;
+class TLegend;
+class TPaveText;
+
+namespace K3PiStudies
+{
+
+	enum class K3PiReportOutput
+	{
+		MultiPagePDF, // one page per comparison in _path
+		ROOTFile,	  // one TCanvas per comparison in _path, nothing is rendered until it is opened
+		MetricsOnly	  // no drawing at all, only the K3PiComparisonMetrics
+	};
+
+	// settings for K3PiComparisonReport
+	struct K3PiComparisonReportConfig
+	{
+		K3PiReportOutput _output = K3PiReportOutput::MultiPagePDF;
+		std::string _path; // not used for MetricsOnly
+
+		// same meaning as the makeNormalizedComparisonPlot arguments
+		bool _addNumEntries = true;
+		TString _unit = "";
+		bool _updateYLabel = false;
+
+		int _canvasWidth = 700;
+		int _canvasHeight = 500;
+	};
+
+	/**
+	 * Shape comparison of two histograms, computed straight from the bin arrays (under/overflow bins are left out),
+	 * treating both as unweighted counts like TH1::Chi2Test("UU") and TH1::KolmogorovTest.
+	 */
+	struct K3PiComparisonMetrics
+	{
+		std::string _name;
+
+		// bin content sums over the in-range bins; the other metrics are NaN if either is <= 0
+		double _n1;
+		double _n2;
+
+		// chi2 of the two normalized shapes being equal, over the bins with any entries; ndf = (that number of bins) - 1
+		double _chi2;
+		int _ndf;
+		double _chi2Prob;
+
+		// largest difference of the two normalized cumulative distributions, and its Kolmogorov probability
+		double _ksDistance;
+		double _ksProb;
+
+		// largest and summed |h1 / n1 - h2 / n2| over the bins
+		double _maxAbsNormDiff;
+		double _sumAbsNormDiff;
+	};
+
+	/**
+	 * Batch version of K3PiStudiesUtils::makeNormalizedComparisonPlot for validation reports with many plots: one off-screen
+	 * (batch mode) canvas, legend and text box are reused for every comparison and everything goes into one output file,
+	 * instead of a TCanvas and SaveAs per plot. Unlike makeNormalizedComparisonPlot, the input histograms are not modified.
+	 *
+	 * Not thread safe (ROOT graphics); use one report per thread, or fill on worker threads and draw on one.
+	 */
+	class K3PiComparisonReport final
+	{
+	public:
+		explicit K3PiComparisonReport(const K3PiComparisonReportConfig &config);
+		~K3PiComparisonReport();
+
+		K3PiComparisonReport(const K3PiComparisonReport &copyMe) = delete;
+		K3PiComparisonReport &operator=(const K3PiComparisonReport &copyMe) = delete;
+
+		// h1 and h2 are numBins bin contents each
+		static K3PiComparisonMetrics computeMetrics(const std::string &name, std::size_t numBins, const double *h1, const double *h2);
+
+		// throws std::invalid_argument if the numbers of bins differ
+		static K3PiComparisonMetrics computeMetrics(const std::string &name, const TH1 &h1, const TH1 &h2);
+
+		/**
+		 * Adds one comparison page (or canvas) called name, drawn like makeNormalizedComparisonPlot.
+		 * A pair where either histogram has a bin content sum <= 0 over its in-range bins (so also one with only
+		 * under/overflow entries) is skipped with a warning; exactly those pairs have NaN metrics.
+		 *
+		 * @return the metrics of the pair, also kept in metrics()
+		 */
+		const K3PiComparisonMetrics &add(
+			const std::string &name,
+			const TH1 &h1,
+			const TH1 &h2,
+			const TString &legLine1,
+			const TString &legLine2);
+
+		const std::vector<K3PiComparisonMetrics> &metrics() const;
+
+		// one row per comparison, with a header line
+		void writeMetricsCSV(const std::string &path) const;
+
+		// finishes the output file; called by the destructor if not done before, no more comparisons can be added after
+		void close();
+
+	private:
+		void draw(const std::string &name, const TH1 &h1, const TH1 &h2, const TString &legLine1, const TString &legLine2);
+
+		K3PiComparisonReportConfig _config;
+		std::vector<K3PiComparisonMetrics> _metrics;
+		bool _isOpen = true;
+		bool _wasBatch = false;
+
+		std::unique_ptr<TCanvas> _canvas;
+		std::unique_ptr<TLegend> _legend;
+		std::unique_ptr<TPaveText> _numEntriesText;
+		std::unique_ptr<TFile> _file;
+	}; // end K3PiComparisonReport class
+
+} // end namespace K3PiStudies
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace K3PiStudies
+{
+
+	// roles of the 4 D0 daughters; same order calc_phsp(const TLorentzVector &...) takes them in
+	enum K3Pi_Roles
+	{
+		K3Pi_Kaon,
+		K3Pi_OSPion1, // opposite sign pion with the lower daughter index
+		K3Pi_SSPion,
+		K3Pi_OSPion2 // opposite sign pion with the higher daughter index
+	};
+
+	// why a candidate was rejected; the checks run in this order and the first failing one is reported
+	enum class DecayStatus : std::uint8_t
+	{
+		Ok,
+		UnknownID,		 // a daughter ID is neither a K nor a pi
+		WrongNumKaons,	 // not exactly one kaon
+		WrongNumSSPions, // not exactly one pion with the same charge as the kaon
+		WrongNumOSPions, // not exactly two pions with the opposite charge
+		BadIndex,		 // daughter index outside 0...3
+		NumStatuses
+	};
+
+	constexpr const char *toString(DecayStatus status)
+	{
+		constexpr const char *names[] = {"Ok", "UnknownID", "WrongNumKaons", "WrongNumSSPions", "WrongNumOSPions", "BadIndex"};
+		return status < DecayStatus::NumStatuses ? names[static_cast<int>(status)] : "Invalid";
+	}
+
+	/**
+	 * std::optional-like result of the noexcept try* lookups in K3PiStudiesUtils: _value is only meaningful if ok().
+	 * Holds the reject reason instead of an empty state, so it can be passed on to DecayRejectCounters.
+	 */
+	template <typename T>
+	struct DecayLookup
+	{
+		T _value;
+		DecayStatus _status;
+
+		constexpr bool ok() const
+		{
+			return _status == DecayStatus::Ok;
+		}
+
+		constexpr explicit operator bool() const
+		{
+			return ok();
+		}
+
+		constexpr T value_or(T fallback) const
+		{
+			return ok() ? _value : fallback;
+		}
+	};
+
+	// number of candidates seen per DecayStatus, e.g. filled per thread and merged at the end of the job
+	class DecayRejectCounters final
+	{
+	public:
+		void push(DecayStatus status, std::uint64_t num = 1)
+		{
+			_counts[static_cast<int>(status)] += num;
+		}
+
+		void merge(const DecayRejectCounters &other)
+		{
+			for (std::size_t i = 0; i < _counts.size(); i++)
+			{
+				_counts[i] += other._counts[i];
+			}
+		}
+
+		std::uint64_t count(DecayStatus status) const
+		{
+			return _counts[static_cast<int>(status)];
+		}
+
+		std::uint64_t numTotal() const
+		{
+			std::uint64_t total = 0;
+			for (const std::uint64_t c : _counts)
+			{
+				total += c;
+			}
+			return total;
+		}
+
+		std::uint64_t numRejected() const
+		{
+			return numTotal() - count(DecayStatus::Ok);
+		}
+
+	private:
+		std::array<std::uint64_t, static_cast<int>(DecayStatus::NumStatuses)> _counts = {};
+	}; // end DecayRejectCounters class
+
+	namespace detail
+	{
+		/**
+		 * Each daughter ID is reduced to a 2 bit code, bit 0 = negative ID, bit 1 = pion (i.e. K+ = 0, K- = 1, pi+ = 2, pi- = 3),
+		 * and the 4 codes of a candidate make an 8 bit key into _PERMUTATION_TABLE.
+		 *
+		 * Table entry layout:
+		 * bits 0-7 = daughter index of role r in bits 2r, 2r+1
+		 * bit 8    = the IDs are K3Pi with the right charges
+		 * bit 9    = the kaon is negative
+		 * bits 10-12 = DecayStatus (the role indices and bits 8, 9 are 0 unless it is Ok)
+		 */
+		constexpr std::uint16_t _PERMUTATION_VALID_BIT = 1 << 8;
+		constexpr std::uint16_t _PERMUTATION_KAON_NEG_BIT = 1 << 9;
+		constexpr int _PERMUTATION_STATUS_SHIFT = 10;
+
+		constexpr std::uint16_t makeRejectedEntry(DecayStatus status)
+		{
+			return static_cast<std::uint16_t>(static_cast<unsigned int>(status) << _PERMUTATION_STATUS_SHIFT);
+		}
+
+		constexpr std::uint16_t makePermutationEntry(unsigned int key)
+		{
+			int kaonInd = -1;
+			int numKaons = 0;
+			bool kaonIsNeg = false;
+			for (int i = 0; i < 4; i++)
+			{
+				const unsigned int code = (key >> (2 * i)) & 3;
+				if (!(code & 2))
+				{
+					kaonInd = i;
+					kaonIsNeg = code & 1;
+					numKaons++;
+				}
+			}
+
+			if (numKaons != 1)
+			{
+				return makeRejectedEntry(DecayStatus::WrongNumKaons);
+			}
+
+			int ssPionInd = -1;
+			int numSSPions = 0;
+			int osPionInds[2] = {-1, -1};
+			int numOSPions = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				const unsigned int code = (key >> (2 * i)) & 3;
+				if (i == kaonInd)
+				{
+					continue;
+				}
+
+				if (bool(code & 1) == kaonIsNeg)
+				{
+					ssPionInd = i;
+					numSSPions++;
+				}
+				else
+				{
+					if (numOSPions < 2)
+					{
+						osPionInds[numOSPions] = i;
+					}
+					numOSPions++;
+				}
+			}
+
+			// with 3 pions, numSSPions != 1 implies numOSPions != 2, so only the first is ever reported
+			if (numSSPions != 1)
+			{
+				return makeRejectedEntry(DecayStatus::WrongNumSSPions);
+			}
+			if (numOSPions != 2)
+			{
+				return makeRejectedEntry(DecayStatus::WrongNumOSPions);
+			}
+
+			return (kaonInd << (2 * K3Pi_Kaon)) |
+				   (osPionInds[0] << (2 * K3Pi_OSPion1)) |
+				   (ssPionInd << (2 * K3Pi_SSPion)) |
+				   (osPionInds[1] << (2 * K3Pi_OSPion2)) |
+				   _PERMUTATION_VALID_BIT |
+				   (kaonIsNeg ? _PERMUTATION_KAON_NEG_BIT : 0);
+		}
+
+		constexpr std::array<std::uint16_t, 256> makePermutationTable()
+		{
+			std::array<std::uint16_t, 256> table = {};
+			for (unsigned int key = 0; key < 256; key++)
+			{
+				table[key] = makePermutationEntry(key);
+			}
+			return table;
+		}
+
+		inline constexpr std::array<std::uint16_t, 256> _PERMUTATION_TABLE = makePermutationTable();
+	} // end namespace detail
+
+	/**
+	 * Assignment of the 4 D0 daughters to the K3Pi_Roles, found once per candidate from the PDG IDs with a single table lookup.
+	 * Gives the same answers as findKaon, isKaonNeg, findSSPion and findOSPionPair, but without branches, allocations or exceptions,
+	 * so it can be used directly in event loops (check isValid() instead of catching InvalidDecayError).
+	 */
+	class DecayPermutation final
+	{
+	public:
+		constexpr DecayPermutation() : _packed(0)
+		{
+		}
+
+		static constexpr DecayPermutation fromIDs(int D0_P0_ID, int D0_P1_ID, int D0_P2_ID, int D0_P3_ID)
+		{
+			bool allKnown = true;
+			const unsigned int key = code(D0_P0_ID, allKnown) |
+									 (code(D0_P1_ID, allKnown) << 2) |
+									 (code(D0_P2_ID, allKnown) << 4) |
+									 (code(D0_P3_ID, allKnown) << 6);
+
+			return DecayPermutation(allKnown ? detail::_PERMUTATION_TABLE[key] : detail::makeRejectedEntry(DecayStatus::UnknownID));
+		}
+
+		// false if the IDs are not one kaon, one same sign pion and two opposite sign pions; index() is then 0 for every role
+		constexpr bool isValid() const
+		{
+			return _packed & detail::_PERMUTATION_VALID_BIT;
+		}
+
+		// Ok if isValid(), otherwise why not
+		constexpr DecayStatus status() const
+		{
+			return static_cast<DecayStatus>(_packed >> detail::_PERMUTATION_STATUS_SHIFT);
+		}
+
+		constexpr bool kaonIsNeg() const
+		{
+			return _packed & detail::_PERMUTATION_KAON_NEG_BIT;
+		}
+
+		// daughter index (0 = D0_P0 / *_Kplus, ..., 3 = D0_P3 / *_piplus) that plays the given role
+		constexpr int index(K3Pi_Roles role) const
+		{
+			return (_packed >> (2 * role)) & 3;
+		}
+
+		// the 4 role indices packed 2 bits each, role r in bits 2r, 2r+1
+		constexpr std::uint8_t indexMap() const
+		{
+			return _packed & 0xFF;
+		}
+
+		// picks the daughter playing the given role out of the per-daughter values p0...p3
+		template <typename T>
+		constexpr T select(K3Pi_Roles role, T p0, T p1, T p2, T p3) const
+		{
+			const T vals[4] = {p0, p1, p2, p3};
+			return vals[index(role)];
+		}
+
+	private:
+		constexpr explicit DecayPermutation(std::uint16_t packed) : _packed(packed)
+		{
+		}
+
+		static constexpr unsigned int code(int id, bool &allKnown)
+		{
+			const int absID = id < 0 ? -id : id;
+			const bool isPion = absID == 211;
+			allKnown &= isPion || absID == 321;
+			return (unsigned(isPion) << 1) | unsigned(id < 0);
+		}
+
+		std::uint16_t _packed;
+	}; // end DecayPermutation class
+
+} // end namespace K3PiStudies
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <ROOT/RDataFrame.hxx>
+
+#include "K3PiStudiesUtils.h"
+#include "K3PiDecayPermutation.h"
+#include "K3PiRDFPipeline.h"
+
+namespace K3PiStudies
+{
+
+	enum K3PiEvent_Components
+	{
+		K3PiEvent_PX,
+		K3PiEvent_PY,
+		K3PiEvent_PZ,
+		K3PiEvent_PE,
+		K3PiEvent_NumComponents
+	};
+
+	enum class K3PiEventUnits : std::uint8_t
+	{
+		MeV,
+		GeV // e.g. AmpGen output; K3PiStudiesUtils::_GEV_TO_MEV converts
+	};
+
+	enum class K3PiEventPrecision : std::uint8_t
+	{
+		Float,
+		Double
+	};
+
+	// settings for writing a K3PiEventFile
+	struct K3PiEventFileConfig
+	{
+		// units of the momentum columns being written (they are stored as they are, not converted)
+		K3PiEventUnits _units = K3PiEventUnits::MeV;
+
+		K3PiEventPrecision _precision = K3PiEventPrecision::Double;
+
+		// flavour and RS/WS of the whole sample, used if the per event columns below are not set (e.g. for AmpGen samples)
+		bool _isD0 = true;
+		bool _isRS = true;
+
+		// if both are set, names of (bool) columns with the flags of each event, e.g. K3Pi_isD0 / K3Pi_isRS from defineK3PiColumns
+		std::string _isD0Column = "";
+		std::string _isRSColumn = "";
+	};
+
+	/**
+	 * Read-only memory map of a binary 4-body event file, so repeated studies on a sample skip the TTree decompression.
+	 *
+	 * Layout: a 128 byte header (units, precision, sample flags, number of events), then one float or double array per
+	 * (K3Pi_Roles, K3PiEvent_Components), role-major, each starting on a 64 byte boundary, then (if the flags vary per event)
+	 * one byte per event with bit 0 = isD0 and bit 1 = isRS.
+	 * Momenta are in the D0 rest frame: calc_phsp passes them to calc_phsp_batch as they are, so whatever is written must be boosted already.
+	 */
+	class K3PiEventFile final
+	{
+	public:
+		// maps the file; throws std::runtime_error if it can't be opened or is not an event file of the current format
+		explicit K3PiEventFile(const std::string &path);
+		K3PiEventFile(K3PiEventFile &&moveMe) noexcept;
+		K3PiEventFile(const K3PiEventFile &copyMe) = delete;
+		K3PiEventFile &operator=(K3PiEventFile &&moveMe) noexcept;
+		K3PiEventFile &operator=(const K3PiEventFile &copyMe) = delete;
+		~K3PiEventFile();
+
+		/**
+		 * Runs df and writes its momentum columns to path (via a temporary file and a rename).
+		 *
+		 * @param p4Columns the 16 (double) D0 rest frame momentum column names, role-major in K3Pi_Roles order: K_PX, K_PY, K_PZ, K_PE, OSPi1_PX, ...
+		 */
+		static void write(ROOT::RDF::RNode df, const std::vector<std::string> &p4Columns, const std::string &path, const K3PiEventFileConfig &config);
+
+		/**
+		 * Writes columns that are already in memory; config._isD0Column / _isRSColumn are not used.
+		 *
+		 * @param p4Columns 16 pointers to numEvents values each, same order as above
+		 * @param isD0 per event flags, or empty to store only the sample flags of config (then isRS must be empty too)
+		 */
+		static void write(
+			const std::string &path,
+			std::uint64_t numEvents,
+			const std::vector<const double *> &p4Columns,
+			const std::vector<bool> &isD0,
+			const std::vector<bool> &isRS,
+			const K3PiEventFileConfig &config);
+
+		/**
+		 * Converts reconstructed ntuples: K3PiRDFPipeline::defineK3PiColumns picks the daughters and boosts them into the D0 rest frame
+		 * (the <role>_PX_D0CM, ... columns are stored), candidates failing the daughter identification are dropped.
+		 * If columnConfig._dstPiIDColumn is set the per event isD0 / isRS flags are stored too.
+		 */
+		static void convertTree(
+			const std::vector<std::string> &inputFiles,
+			const std::string &treeName,
+			const K3PiColumnConfig &columnConfig,
+			const std::string &path,
+			K3PiEventFileConfig config);
+
+		std::uint64_t numEvents() const;
+
+		K3PiEventUnits units() const;
+
+		K3PiEventPrecision precision() const;
+
+		// false if the whole sample has the flavour / RS-WS flags in the header
+		bool hasPerEventFlags() const;
+
+		bool isD0(std::uint64_t event) const;
+
+		bool isRS(std::uint64_t event) const;
+
+		// throws std::logic_error if the file is not stored in double precision
+		const double *column(K3Pi_Roles role, K3PiEvent_Components comp) const;
+
+		// throws std::logic_error if the file is not stored in float precision
+		const float *floatColumn(K3Pi_Roles role, K3PiEvent_Components comp) const;
+
+		// zero-copy view for K3PiStudiesUtils::calc_phsp_batch; double precision files only
+		P4Columns p4Columns(K3Pi_Roles role) const;
+
+		/**
+		 * calc_phsp_batch over every event, with masses in MeV whatever the stored units.
+		 * Double precision files are passed straight from the map, float ones are converted block by block.
+		 */
+		void calc_phsp(const Phsp4BodyColumns &phsp) const;
+
+	private:
+		const void *array(K3Pi_Roles role, K3PiEvent_Components comp) const;
+
+		void unmap();
+
+		void *_map = nullptr;
+		std::size_t _mapSize = 0;
+		std::uint64_t _numEvents = 0;
+		std::uint64_t _arrayStride = 0;
+		K3PiEventUnits _units = K3PiEventUnits::MeV;
+		K3PiEventPrecision _precision = K3PiEventPrecision::Double;
+		bool _isD0 = true;
+		bool _isRS = true;
+		const std::uint8_t *_flags = nullptr;
+	}; // end K3PiEventFile class
+
+} // end namespace K3PiStudies
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <TVector3.h>
+#include <Math/Vector3D.h>
+#include <Math/Vector4D.h>
+#include <ROOT/RVec.hxx>
+
+#include "K3PiKinematics.h"
+
+namespace K3PiStudies
+{
+
+	/**
+	 * Opt-in fast versions of the angle functions in K3PiKinematics, for selection and plotting jobs that only need float precision.
+	 *
+	 * atan2 and acos are float polynomial approximations (no library calls, so loops over them vectorize) and the results are floats.
+	 * The kinematics feeding them stay in double: in float, the invariant masses and breakup momenta near threshold and the lab frame
+	 * products of boosted candidates lose far more than float precision (up to 5e-2 in the cosines in tests).
+	 * Maximum absolute differences to the exact (K3PiKinematics) versions are given per function, for
+	 * D*+ -> D0 (-> K- pi+ pi+ pi-) pi+ phase space decays with D* momenta of 5 to 150 GeV; BM_validate_K3PiFastMath in the
+	 * benchmarks measures them on such a sample and fails if one is exceeded.
+	 *
+	 * A separate API, not a drop-in for K3PiKinematics: the angles come back as float, and the PtEtaPhi calc_phsp_point has
+	 * no verifyAngles / printDiff parameters. Code switching between the two has to be written against each.
+	 */
+	class K3PiFastMath final
+	{
+	public:
+		/** Abramowitz & Stegun 4.4.49 after reduction to |y/x| <= 1, max abs error 4e-7 rad; 0 for (0, 0) */
+		static float atan2(float y, float x);
+
+		/** Abramowitz & Stegun 4.4.46, max abs error 5e-7 rad (vs acos of the same float input); the input is clamped to [-1, 1] */
+		static float acos(float x);
+
+		/** the hardware single precision square root (correctly rounded, no polynomial needed) */
+		static float sqrt(float x);
+
+		static float changeAngleRange_0_to_2pi(float angle_neg_pi_to_pi);
+
+		static float changeAngleRange_neg_pi_to_pi(float angle_0_to_2pi);
+
+		/** max abs difference to K3PiKinematics::angleBetweenDecayPlanesKutschke: 4e-7 rad */
+		static float angleBetweenDecayPlanesKutschke(
+			const TVector3 &d4_motherRestFrame,
+			const TVector3 &d5_motherRestFrame,
+			const TVector3 &d6_motherRestFrame,
+			const TVector3 &d7_motherRestFrame);
+
+		static float angleBetweenDecayPlanesKutschke(
+			const ROOT::Math::XYZVector &d4_motherRestFrame,
+			const ROOT::Math::XYZVector &d5_motherRestFrame,
+			const ROOT::Math::XYZVector &d6_motherRestFrame,
+			const ROOT::Math::XYZVector &d7_motherRestFrame);
+
+		/** max abs difference to K3PiKinematics::calc_phsp_point (D0 CM inputs): masses 1e-9 MeV; cos12, cos34 1e-9; phi 6e-7 rad */
+		static Phsp4BodyPoint calc_phsp_point(
+			const ROOT::Math::PxPyPzEVector &pA_IN_D0CM,  // K-
+			const ROOT::Math::PxPyPzEVector &pB_IN_D0CM,  // OS pi 1
+			const ROOT::Math::PxPyPzEVector &pC_IN_D0CM,  // SS pi
+			const ROOT::Math::PxPyPzEVector &pD_IN_D0CM); // OS pi 2
+
+		/**
+		 * PtEtaPhi calc_phsp_point without verification (_phi_diff is 0); max abs difference: masses 1e-9 MeV; phi 4e-7 rad;
+		 * cos1, cos2 1e-9, but 5e-6 within 1 MeV of their pi pi / K pi threshold (as calc_phsp_point_fused)
+		 */
+		static Phsp4BodyPtEtaPhiPoint calc_phsp_point(
+			double K_D0Fit_PT,
+			double K_D0Fit_ETA,
+			double K_D0Fit_PHI,
+			double Pi_SS_D0Fit_PT,
+			double Pi_SS_D0Fit_ETA,
+			double Pi_SS_D0Fit_PHI,
+			double Pi_OS1_D0Fit_PT,
+			double Pi_OS1_D0Fit_ETA,
+			double Pi_OS1_D0Fit_PHI,
+			double Pi_OS2_D0Fit_PT,
+			double Pi_OS2_D0Fit_ETA,
+			double Pi_OS2_D0Fit_PHI,
+			bool pi1GoesWithK);
+
+		/** max abs difference to K3PiKinematics::helicity_angle_func: 5e-7 rad */
+		static float helicity_angle_func(
+			float d0_px,
+			float d0_py,
+			float d0_pz,
+			float d0_m,
+			float pis_px,
+			float pis_py,
+			float pis_pz,
+			float pis_m);
+
+		static ROOT::RVec<float> helicity_angle_func(
+			const ROOT::RVec<float> &d0_px,
+			const ROOT::RVec<float> &d0_py,
+			const ROOT::RVec<float> &d0_pz,
+			const ROOT::RVec<float> &d0_m,
+			const ROOT::RVec<float> &pis_px,
+			const ROOT::RVec<float> &pis_py,
+			const ROOT::RVec<float> &pis_pz,
+			float pis_m);
+
+	}; // end K3PiFastMath class
+
+} // end namespace K3PiStudies
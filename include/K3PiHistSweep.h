@@ -0,0 +1,121 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <TH1D.h>
+#include <ROOT/RDataFrame.hxx>
+
+#include "K3PiStudiesUtils.h"
+#include "K3PiRegionClassifier.h"
+
+namespace K3PiStudies
+{
+
+	// settings for K3PiHistSweep::book; one histogram of _valueColumn is filled per (RS/WS flag) x (region) x (decay time bin)
+	struct K3PiHistSweepConfig
+	{
+		// any of K3PiStudiesUtils::_RS_FLAG, _WS_FLAG, _BOTH_FLAG
+		std::vector<std::string> _rsWsFlags = {K3PiStudiesUtils::_RS_FLAG, K3PiStudiesUtils::_WS_FLAG, K3PiStudiesUtils::_BOTH_FLAG};
+
+		// any of K3PiStudiesUtils::_ALL_REGION_FLAG, _SIG_REGION_FLAG; a candidate is in a region if both its m(D0) and delta m are
+		std::vector<std::string> _regionFlags = {K3PiStudiesUtils::_ALL_REGION_FLAG, K3PiStudiesUtils::_SIG_REGION_FLAG};
+
+		// passed to K3PiStudiesUtils::makeTimeBins, so there is one more time bin than edges (first and last bin are open ended)
+		std::vector<double> _upperTimeBinEdges;
+
+		// names of the (double) columns to read, and the (bool) RS column, e.g. the one K3PiRDFPipeline::defineK3PiColumns makes
+		std::string _valueColumn;
+		std::string _d0MassMeVColumn;
+		std::string _deltaMMeVColumn;
+		std::string _decayTimeColumn;
+		std::string _isRSColumn;
+
+		// histogram names are <_histNamePrefix>_<RS/WS flag>_<region>_t<time bin>
+		std::string _histNamePrefix = "h";
+		std::string _histTitle = "";
+		int _nBins = 100;
+		double _xMin = 0.0;
+		double _xMax = 1.0;
+	};
+
+	// filled histograms for every (flag, region, time bin) combination of a K3PiHistSweepConfig
+	class K3PiHistGrid final
+	{
+	public:
+		K3PiHistGrid(const K3PiHistSweepConfig &config, const std::string &nameSuffix);
+
+		TH1D &get(std::size_t flagInd, std::size_t regionInd, std::size_t timeBin);
+
+		const TH1D &get(std::size_t flagInd, std::size_t regionInd, std::size_t timeBin) const;
+
+		// TH1::Add every histogram of other (which must come from the same config) to the one at the same position here
+		void add(const K3PiHistGrid &other);
+
+		const std::vector<std::string> &rsWsFlags() const;
+
+		const std::vector<std::string> &regionFlags() const;
+
+		const std::vector<std::pair<double, double>> &timeBins() const;
+
+		std::size_t size() const;
+
+	private:
+		std::size_t flatIndex(std::size_t flagInd, std::size_t regionInd, std::size_t timeBin) const;
+
+		std::vector<std::string> _rsWsFlags;
+		std::vector<std::string> _regionFlags;
+		std::vector<std::pair<double, double>> _timeBins;
+
+		// flag-major, then region, then time bin
+		std::vector<std::unique_ptr<TH1D>> _hists;
+	}; // end K3PiHistGrid class
+
+	/**
+	 * RDF action filling a whole K3PiHistGrid in one event loop.
+	 * Each processing slot fills its own copy of the grid; the copies are merged into the result in Finalize,
+	 * so it scales with ROOT::EnableImplicitMT without any locking.
+	 */
+	class K3PiHistSweepHelper final : public ROOT::Detail::RDF::RActionImpl<K3PiHistSweepHelper>
+	{
+	public:
+		using Result_t = K3PiHistGrid;
+
+		K3PiHistSweepHelper(const K3PiHistSweepConfig &config, unsigned int nSlots);
+		K3PiHistSweepHelper(K3PiHistSweepHelper &&moveMe) = default;
+		K3PiHistSweepHelper(const K3PiHistSweepHelper &copyMe) = delete;
+
+		std::shared_ptr<Result_t> GetResultPtr() const;
+
+		void Initialize();
+
+		void InitTask(TTreeReader *reader, unsigned int slot);
+
+		void Exec(unsigned int slot, double value, double d0MassMeV, double deltaMMeV, double decayTime, bool isRS);
+
+		void Finalize();
+
+		std::string GetActionName() const;
+
+	private:
+		// slot 0 fills the result directly
+		std::shared_ptr<K3PiHistGrid> _result;
+		std::vector<std::unique_ptr<K3PiHistGrid>> _slotGrids;
+
+		K3PiRegionClassifier _classifier;
+
+		std::vector<bool> _flagTakesRS;
+		std::vector<bool> _flagTakesWS;
+	}; // end K3PiHistSweepHelper class
+
+	class K3PiHistSweep final
+	{
+	public:
+		// lazily books the sweep on df; the histograms are filled the first time the result (or any other action on df) is accessed
+		static ROOT::RDF::RResultPtr<K3PiHistGrid> book(ROOT::RDF::RNode df, const K3PiHistSweepConfig &config);
+
+	}; // end K3PiHistSweep class
+
+} // end namespace K3PiStudies
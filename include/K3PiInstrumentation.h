@@ -0,0 +1,134 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+
+#ifdef K3PI_INSTRUMENTATION
+#include <atomic>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+/**
+ * Optional hot-path instrumentation: per-thread call counts and TSC timers around the public K3PiStudiesUtils functions,
+ * plus counts of how often the exceptions are constructed (i.e. thrown).
+ * Compiled out by default; configure with -DK3PISTUDIESUTILS_INSTRUMENTATION=ON to define K3PI_INSTRUMENTATION,
+ * then call K3PiInstrumentation::printTable or toJSON at the end of the job.
+ *
+ * K3PI_PROFILE_FUNCTION() / K3PI_PROFILE_SCOPE(name) time the rest of the enclosing scope (inclusive of nested probes),
+ * K3PI_COUNT(name) only counts. All three expand to nothing when instrumentation is off.
+ * The probes sit only in out-of-line public functions: not in header inline helpers (one probe per inline copy), per-event
+ * RDF actions, or the noexcept try* lookups (registering a probe allocates, and their throwing wrappers are timed already).
+ */
+
+namespace K3PiStudies
+{
+
+	class K3PiInstrumentation final
+	{
+	public:
+		// true if the library was built with K3PI_INSTRUMENTATION
+		static bool isEnabled();
+
+		// one row per probe (name, calls, total ms, ns per call), slowest total first; call once the worker threads are done
+		static void printTable(std::ostream &out);
+
+		// {"enabled": ..., "ticksPerNs": ..., "probes": [{"name": ..., "calls": ..., "totalNs": ..., "nsPerCall": ...}, ...]}
+		static std::string toJSON();
+
+		// zero every counter, e.g. to leave out a warm up
+		static void reset();
+
+		// used by the macros; the same name always gives the same probe, so e.g. the counts of an inline function add up
+		static int registerProbe(const char *name);
+	}; // end K3PiInstrumentation class
+
+#ifdef K3PI_INSTRUMENTATION
+	namespace detail
+	{
+		constexpr int _MAX_PROBES = 512;
+
+		// only the owning thread writes, so plain relaxed load + store is enough (no locked read-modify-write on the hot path)
+		struct ProbeCounters
+		{
+			std::atomic<std::uint64_t> _calls{0};
+			std::atomic<std::uint64_t> _ticks{0};
+
+			void add(std::uint64_t ticks)
+			{
+				_calls.store(_calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				_ticks.store(_ticks.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+			}
+		};
+
+		struct ThreadCounters
+		{
+			ProbeCounters _probes[_MAX_PROBES];
+		};
+
+		// counters of the calling thread, registered with the global list on first use so they outlive the thread
+		ThreadCounters &threadCounters();
+
+		inline std::uint64_t readTicks()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+#else
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+		}
+
+		class ScopedProbeTimer final
+		{
+		public:
+			explicit ScopedProbeTimer(int probe) : _probe(probe), _start(readTicks())
+			{
+			}
+
+			~ScopedProbeTimer()
+			{
+				threadCounters()._probes[_probe].add(readTicks() - _start);
+			}
+
+			ScopedProbeTimer(const ScopedProbeTimer &) = delete;
+			ScopedProbeTimer &operator=(const ScopedProbeTimer &) = delete;
+
+		private:
+			const int _probe;
+			const std::uint64_t _start;
+		};
+	} // end namespace detail
+
+#define K3PI_PROFILE_SCOPE(name)                                                                      \
+	static const int _k3piProbeId = ::K3PiStudies::K3PiInstrumentation::registerProbe(name); \
+	const ::K3PiStudies::detail::ScopedProbeTimer _k3piProbeTimer(_k3piProbeId)
+
+#ifdef _MSC_VER
+#define K3PI_PROFILE_FUNCTION() K3PI_PROFILE_SCOPE(__FUNCSIG__)
+#else
+#define K3PI_PROFILE_FUNCTION() K3PI_PROFILE_SCOPE(__PRETTY_FUNCTION__)
+#endif
+
+#define K3PI_COUNT(name)                                                                                   \
+	do                                                                                                     \
+	{                                                                                                      \
+		static const int _k3piCountId = ::K3PiStudies::K3PiInstrumentation::registerProbe(name); \
+		::K3PiStudies::detail::threadCounters()._probes[_k3piCountId].add(0);                              \
+	} while (false)
+
+#else
+
+#define K3PI_PROFILE_SCOPE(name)
+#define K3PI_PROFILE_FUNCTION()
+#define K3PI_COUNT(name) \
+	do                   \
+	{                    \
+	} while (false)
+
+#endif
+
+} // end namespace K3PiStudies
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <TMath.h>
+#include <TLorentzVector.h>
+#include <TVector3.h>
+#include <Math/Vector3D.h>
+#include <Math/Vector4D.h>
+#include <ROOT/RVec.hxx>
+
+#include "K3PiKinematicsTypes.h"
+
+namespace K3PiStudies
+{
+
+	/**
+	 * The phase space and angle calculations of K3PiStudiesUtils, for code that wants the kinematics without the histogram and
+	 * plotting headers (it still includes TLorentzVector, TVector3, GenVector and RVec for its overloads). K3PiStudiesUtils
+	 * derives from it, so K3PiStudiesUtils::calc_phsp and the like still work.
+	 */
+	class K3PiKinematics
+	{
+	public:
+		static const unsigned int _KAON_ID = 321;
+		static const unsigned int _PION_ID = 211;
+		static constexpr double _PI = TMath::Pi();
+		static constexpr double _TWO_PI = 2.0 * TMath::Pi();
+		static constexpr double _GEV_TO_MEV = 1000.0;
+		static constexpr double _KAON_MASS = 493.677;
+		static constexpr double _PION_MASS = 139.57061;
+		static constexpr double _COMPARE_EPS = std::numeric_limits<double>::epsilon();
+
+		static TLorentzVector toTLorentzVector(
+			double pE,
+			double px,
+			double py,
+			double pz);
+
+		static std::vector<double> calc_phsp(
+			const TLorentzVector &pD0_IN_D0CM,
+			const TLorentzVector &pA_IN_D0CM,  // K-
+			const TLorentzVector &pB_IN_D0CM,  // OS pi 1
+			const TLorentzVector &pC_IN_D0CM,  // SS pi
+			const TLorentzVector &pD_IN_D0CM); // OS pi 2
+
+		static Phsp4BodyPoint calc_phsp_point(
+			const TLorentzVector &pD0_IN_D0CM,
+			const TLorentzVector &pA_IN_D0CM,  // K-
+			const TLorentzVector &pB_IN_D0CM,  // OS pi 1
+			const TLorentzVector &pC_IN_D0CM,  // SS pi
+			const TLorentzVector &pD_IN_D0CM); // OS pi 2
+
+		static Phsp4BodyPoint calc_phsp_point(
+			const ROOT::Math::PxPyPzEVector &pA_IN_D0CM,  // K-
+			const ROOT::Math::PxPyPzEVector &pB_IN_D0CM,  // OS pi 1
+			const ROOT::Math::PxPyPzEVector &pC_IN_D0CM,  // SS pi
+			const ROOT::Math::PxPyPzEVector &pD_IN_D0CM); // OS pi 2
+
+		static Phsp4BodyPairedPoint calc_phsp_point_pairLowerMKPi(
+			const ROOT::Math::PxPyPzEVector &kminus_IN_D0CM,
+			const ROOT::Math::PxPyPzEVector &osPi1_IN_D0CM,
+			const ROOT::Math::PxPyPzEVector &ssPi_IN_D0CM,
+			const ROOT::Math::PxPyPzEVector &osPi2_IN_D0CM);
+
+		static Phsp4BodyPairings calc_phsp_point_bothPairings(
+			const ROOT::Math::PxPyPzEVector &kminus_IN_D0CM,
+			const ROOT::Math::PxPyPzEVector &osPi1_IN_D0CM,
+			const ROOT::Math::PxPyPzEVector &ssPi_IN_D0CM,
+			const ROOT::Math::PxPyPzEVector &osPi2_IN_D0CM);
+
+		static void calc_phsp_batch(
+			std::size_t nEvents,
+			const P4Columns &pA_IN_D0CM, // K-
+			const P4Columns &pB_IN_D0CM, // OS pi 1
+			const P4Columns &pC_IN_D0CM, // SS pi
+			const P4Columns &pD_IN_D0CM, // OS pi 2
+			const Phsp4BodyColumns &phsp);
+
+		static double angleBetweenDecayPlanesKutschke(
+			const TVector3 &d4_motherRestFrame,
+			const TVector3 &d5_motherRestFrame,
+			const TVector3 &d6_motherRestFrame,
+			const TVector3 &d7_motherRestFrame);
+
+		static double angleBetweenDecayPlanesKutschke(
+			const ROOT::Math::XYZVector &d4_motherRestFrame,
+			const ROOT::Math::XYZVector &d5_motherRestFrame,
+			const ROOT::Math::XYZVector &d6_motherRestFrame,
+			const ROOT::Math::XYZVector &d7_motherRestFrame);
+
+		static double verifyAngle(
+			const TVector3 &v1,
+			const TVector3 &v2,
+			double v1v2Angle,
+			bool v1v2AngleIsNegPiToPi,
+			const std::string &angleName,
+			bool printDiff);
+
+		static float helicity_angle_func(
+			float d0_px,
+			float d0_py,
+			float d0_pz,
+			float d0_m,
+			float pis_px,
+			float pis_py,
+			float pis_pz,
+			float pis_m);
+
+		static float helicity_angle_func(
+			float d0_px,
+			float d0_py,
+			float d0_pz,
+			float d0_m,
+			const ROOT::RVec<float> &pis_px,
+			const ROOT::RVec<float> &pis_py,
+			const ROOT::RVec<float> &pis_pz,
+			float pis_m);
+
+		static double compute_delta_angle(
+			double extra_px,
+			double extra_py,
+			double extra_pz,
+			double extra_m,
+			double d_px,
+			double d_py,
+			double d_pz,
+			double d_m);
+
+		static double compute_delta_angle(
+			double extra_px,
+			double extra_py,
+			double extra_pz,
+			double d_px,
+			double d_py,
+			double d_pz);
+
+		static ROOT::RVec<float> helicity_angle_func(
+			const ROOT::RVec<float> &d0_px,
+			const ROOT::RVec<float> &d0_py,
+			const ROOT::RVec<float> &d0_pz,
+			const ROOT::RVec<float> &d0_m,
+			const ROOT::RVec<float> &pis_px,
+			const ROOT::RVec<float> &pis_py,
+			const ROOT::RVec<float> &pis_pz,
+			float pis_m);
+
+		static ROOT::RVec<double> compute_delta_angle(
+			const ROOT::RVec<double> &extra_px,
+			const ROOT::RVec<double> &extra_py,
+			const ROOT::RVec<double> &extra_pz,
+			double d_px,
+			double d_py,
+			double d_pz);
+
+		static ROOT::RVec<double> compute_delta_angle(
+			const ROOT::RVec<double> &extra_px,
+			const ROOT::RVec<double> &extra_py,
+			const ROOT::RVec<double> &extra_pz,
+			const ROOT::RVec<double> &d_px,
+			const ROOT::RVec<double> &d_py,
+			const ROOT::RVec<double> &d_pz);
+
+		static double getPhi(
+			double px,
+			double py,
+			double pz,
+			double pE);
+
+		static double getEta(
+			double px,
+			double py,
+			double pz,
+			double pE);
+
+		static double getPT(
+			double px,
+			double py,
+			double pz,
+			double pE);
+
+		static bool isKPi1LowerMassPair(
+			const TLorentzVector &kminus_4vec,
+			const TLorentzVector &piplus1_4vec,
+			const TLorentzVector &piplus2_4vec);
+
+		static bool isKPi1LowerMassPair(
+			const ROOT::Math::PxPyPzEVector &kminus_4vec,
+			const ROOT::Math::PxPyPzEVector &piplus1_4vec,
+			const ROOT::Math::PxPyPzEVector &piplus2_4vec);
+
+		static std::vector<double> calc_phsp(
+			double K_D0Fit_PT,
+			double K_D0Fit_ETA,
+			double K_D0Fit_PHI,
+			double Pi_SS_D0Fit_PT,
+			double Pi_SS_D0Fit_ETA,
+			double Pi_SS_D0Fit_PHI,
+			double Pi_OS1_D0Fit_PT,
+			double Pi_OS1_D0Fit_ETA,
+			double Pi_OS1_D0Fit_PHI,
+			double Pi_OS2_D0Fit_PT,
+			double Pi_OS2_D0Fit_ETA,
+			double Pi_OS2_D0Fit_PHI,
+			bool pi1GoesWithK,
+			bool verifyAngles,
+			bool printDiff);
+
+		static Phsp4BodyPtEtaPhiPoint calc_phsp_point(
+			double K_D0Fit_PT,
+			double K_D0Fit_ETA,
+			double K_D0Fit_PHI,
+			double Pi_SS_D0Fit_PT,
+			double Pi_SS_D0Fit_ETA,
+			double Pi_SS_D0Fit_PHI,
+			double Pi_OS1_D0Fit_PT,
+			double Pi_OS1_D0Fit_ETA,
+			double Pi_OS1_D0Fit_PHI,
+			double Pi_OS2_D0Fit_PT,
+			double Pi_OS2_D0Fit_ETA,
+			double Pi_OS2_D0Fit_PHI,
+			bool pi1GoesWithK,
+			bool verifyAngles,
+			bool printDiff);
+
+		// PtEtaPhi calc_phsp_point with pi1GoesWithK and verifyAngles fixed at compile time; all four combinations are instantiated in the library
+		template <Pairing pairing, Verify verify>
+		static Phsp4BodyPtEtaPhiPoint calc_phsp_point(
+			double K_D0Fit_PT,
+			double K_D0Fit_ETA,
+			double K_D0Fit_PHI,
+			double Pi_SS_D0Fit_PT,
+			double Pi_SS_D0Fit_ETA,
+			double Pi_SS_D0Fit_PHI,
+			double Pi_OS1_D0Fit_PT,
+			double Pi_OS1_D0Fit_ETA,
+			double Pi_OS1_D0Fit_PHI,
+			double Pi_OS2_D0Fit_PT,
+			double Pi_OS2_D0Fit_ETA,
+			double Pi_OS2_D0Fit_PHI);
+
+		static Phsp4BodyPtEtaPhiPoint calc_phsp_point_fused(
+			double K_D0Fit_PT,
+			double K_D0Fit_ETA,
+			double K_D0Fit_PHI,
+			double Pi_SS_D0Fit_PT,
+			double Pi_SS_D0Fit_ETA,
+			double Pi_SS_D0Fit_PHI,
+			double Pi_OS1_D0Fit_PT,
+			double Pi_OS1_D0Fit_ETA,
+			double Pi_OS1_D0Fit_PHI,
+			double Pi_OS2_D0Fit_PT,
+			double Pi_OS2_D0Fit_ETA,
+			double Pi_OS2_D0Fit_PHI,
+			bool pi1GoesWithK);
+
+		static void calc_phsp_batch(
+			std::size_t nEvents,
+			const PtEtaPhiColumns &K_D0Fit,
+			const PtEtaPhiColumns &Pi_SS_D0Fit,
+			const PtEtaPhiColumns &Pi_OS1_D0Fit,
+			const PtEtaPhiColumns &Pi_OS2_D0Fit,
+			const bool *pi1GoesWithK,
+			const Phsp4BodyPtEtaPhiColumns &phsp);
+
+		static std::string batchKernelISA();
+
+		static bool areDoublesEqual(
+			std::function<bool(double, double)> isEqualFunc,
+			double d1,
+			double d2,
+			const std::string &varName,
+			bool printDiff);
+
+		// same as above for any callable, which can then be inlined
+		template <typename IsEqualFunc>
+		static bool areDoublesEqual(
+			const IsEqualFunc &isEqualFunc,
+			double d1,
+			double d2,
+			const std::string &varName,
+			bool printDiff)
+		{
+			if (isEqualFunc(d1, d2))
+			{
+				return true;
+			}
+
+			if (printDiff)
+			{
+				printDoublesDiff(varName, d1, d2);
+			}
+			return false;
+		}
+
+		static void printDoublesDiff(const std::string &varName, double d1, double d2);
+
+		static double changeAngleRange_neg_pi_to_pi(double angle_0_to_2pi);
+
+		static double radToDeg(double angleRad);
+
+		static double changeAngleRange_0_to_2pi(double angle_neg_pi_to_pi);
+
+		// defined inline, so comparisons taking a template callable (compare5, areDoublesEqual) can inline them too
+
+		/**
+		 * @see https://stackoverflow.com/a/15012792
+		 */
+		static bool combinedToleranceCompare(double x, double y)
+		{
+			const double maxXYOne = std::max({1.0, std::fabs(x), std::fabs(y)});
+			return std::fabs(x - y) <= _COMPARE_EPS * maxXYOne;
+		}
+
+		static bool isExactlyEqual(double d1, double d2)
+		{
+			return d1 == d2;
+		}
+
+	protected:
+		// only a base of K3PiStudiesUtils, everything here is static
+		K3PiKinematics() = default;
+		K3PiKinematics(const K3PiKinematics &copyMe) = default;
+		K3PiKinematics(K3PiKinematics &&moveMe) = default;
+		~K3PiKinematics() = default;
+		K3PiKinematics &operator=(const K3PiKinematics &copyMe) = default;
+		K3PiKinematics &operator=(K3PiKinematics &&moveMe) = default;
+	}; // end K3PiKinematics class
+
+} // end namespace K3PiStudies
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <exception>
+#include <string>
+
+// the plain types of the kinematics API (exceptions, particle names, phase space points and columns), without any ROOT headers,
+// for code and dictionaries that need them but not the plotting utilities of K3PiStudiesUtils.h
+
+namespace K3PiStudies
+{
+
+	struct InvalidDecayError : std::exception
+	{
+		const std::string _msg;
+
+		// defined in the library, where it counts throws (exceptions on the per-event path are expensive)
+		InvalidDecayError(const std::string &msg);
+
+		const char *what() const noexcept override
+		{
+			return _msg.c_str();
+		}
+	}; // end InvalidDecayError
+
+	struct ComputationError : std::exception
+	{
+		const std::string _msg;
+
+		// defined in the library, where it counts throws (exceptions on the per-event path are expensive)
+		ComputationError(const std::string &msg);
+
+		const char *what() const noexcept override
+		{
+			return _msg.c_str();
+		}
+	}; // end ComputationError
+
+	// names for the particles used in the "*D0Fit*" vars in the ntuple
+	enum D0Fit_PNames
+	{
+		D0Fit_D0_Kplus,
+		D0Fit_D0_piplus_0,
+		D0Fit_D0_piplus_1,
+		D0Fit_D0_piplus
+	};
+
+	// names for the particles used in the "*ReFit*" vars in the ntuple
+	enum ReFit_PNames
+	{
+		ReFit_D0_Kplus,
+		ReFit_D0_piplus_0,
+		ReFit_D0_piplus_1,
+		ReFit_D0_piplus
+	};
+
+	// which OS pion the PtEtaPhi calc_phsp_point pairs with the kaon (the pi1GoesWithK flag, as a compile time choice)
+	enum class Pairing
+	{
+		Pi2WithK,
+		Pi1WithK
+	};
+
+	// whether the PtEtaPhi calc_phsp_point cross-checks phi with verifyAngle (the verifyAngles flag, as a compile time choice)
+	enum class Verify
+	{
+		Off,
+		On
+	};
+
+	// fixed-size, trivially copyable result of calc_phsp_point(const TLorentzVector &...); same entries as the vector calc_phsp returns
+	struct Phsp4BodyPoint
+	{
+		double _m12_MeV;
+		double _m34_MeV;
+		double _cos12;
+		double _cos34;
+		double _phi_rad;
+	};
+
+	// result of calc_phsp_point_pairLowerMKPi: the phase space point for the OS pion that makes the lower mass pair with the kaon
+	struct Phsp4BodyPairedPoint
+	{
+		// pB is the chosen OS pion, so _phsp._m12_MeV is the chosen m(K pi)
+		Phsp4BodyPoint _phsp;
+
+		// m(K pi) for the other OS pion
+		double _mKPiOther_MeV;
+
+		// same as isKPi1LowerMassPair
+		bool _kPi1IsLowerMassPair;
+	};
+
+	// result of calc_phsp_point_bothPairings: the phase space point for each way of pairing the OS pions with the kaon
+	struct Phsp4BodyPairings
+	{
+		// pB = OS pi 1, pD = OS pi 2; _m12_MeV = m(K pi1)
+		Phsp4BodyPoint _pi1WithK;
+
+		// pB = OS pi 2, pD = OS pi 1; _m12_MeV = m(K pi2)
+		Phsp4BodyPoint _pi2WithK;
+
+		// same as isKPi1LowerMassPair
+		bool _kPi1IsLowerMassPair;
+
+		const Phsp4BodyPoint &lowerMassPairing() const
+		{
+			return _kPi1IsLowerMassPair ? _pi1WithK : _pi2WithK;
+		}
+	};
+
+	// fixed-size, trivially copyable result of the PtEtaPhi calc_phsp_point; same entries as the vector calc_phsp returns
+	struct Phsp4BodyPtEtaPhiPoint
+	{
+		double _m12_MeV;
+		double _m34_MeV;
+		double _cos1;
+		double _cos2;
+		double _phi_rad;
+		double _m13_MeV;
+		double _phi_diff;
+	};
+
+	// read-only view of the px, py, pz, E columns of one particle, each nEvents long
+	struct P4Columns
+	{
+		const double *_px;
+		const double *_py;
+		const double *_pz;
+		const double *_pE;
+	};
+
+	// caller-owned output columns for calc_phsp_batch, each nEvents long
+	struct Phsp4BodyColumns
+	{
+		double *_m12_MeV;
+		double *_m34_MeV;
+		double *_cos12;
+		double *_cos34;
+		double *_phi_rad;
+	};
+
+	// read-only view of the pt, eta, phi columns of one particle, each nEvents long
+	struct PtEtaPhiColumns
+	{
+		const double *_pt;
+		const double *_eta;
+		const double *_phi;
+	};
+
+	// caller-owned output columns for the PtEtaPhi calc_phsp_batch, each nEvents long
+	struct Phsp4BodyPtEtaPhiColumns
+	{
+		double *_m12_MeV;
+		double *_m34_MeV;
+		double *_cos1;
+		double *_cos2;
+		double *_phi_rad;
+		double *_m13_MeV;
+	};
+
+} // end namespace K3PiStudies
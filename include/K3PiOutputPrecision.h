@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace K3PiStudies
+{
+
+	// storage type of derived columns that are written out, e.g. by a Snapshot of K3PiRDFPipeline::defineK3PiColumns
+	enum class K3PiOutputPrecision
+	{
+		// computed value; the default, same as before
+		Double,
+
+		// float32, rounded to nearest: relative error at most 2^-24 (6.0e-8) in the normal float range
+		Float,
+
+		// float32 with the mantissa rounded to nearest at fewer bits, so the low bits are 0 and compress away
+		RoundedFloat
+	};
+
+	/**
+	 * Rounding of derived columns to the precision they are stored with, and the error bounds that come with it.
+	 *
+	 * With m mantissa bits kept (23 = plain float), a value x is rounded once, straight from the double, so
+	 * |stored - x| <= 2^-(m + 1) |x| for x in the normal float range (2^-126 <= |x| <= FLT_MAX). Below it the float
+	 * spacing is fixed and the relative error grows, above it x overflows to infinity. For the bounded columns that is an
+	 * absolute bound of
+	 *   cos12, cos34 in [-1, 1]:  2^-(m + 1)        (m = 23: 6.0e-8, m = 16: 7.6e-6, m = 12: 1.2e-4)
+	 *   phi in [0, 2 pi):          2 pi 2^-(m + 1)   (m = 23: 3.7e-7, m = 16: 4.8e-5, m = 12: 7.7e-4 rad)
+	 *   helicity angles in [0, pi]: pi 2^-(m + 1)
+	 * which holds down to 0, since float subnormals are far below these (|error| <= 2^-150 there).
+	 * NaN (failed candidates) and infinities are kept. BM_validate_K3PiPrecision in the benchmarks checks these bounds on random
+	 * values and on phase space points for every m.
+	 */
+	struct K3PiPrecision final
+	{
+		static constexpr int _FLOAT_MANTISSA_BITS = 23;
+
+		// x rounded to nearest (ties to even) at mantissaBits bits (clamped to 0-23) and converted to float exactly
+		static float roundToFloat(double x, int mantissaBits = _FLOAT_MANTISSA_BITS)
+		{
+			if (mantissaBits >= _FLOAT_MANTISSA_BITS || !std::isfinite(x))
+			{
+				return static_cast<float>(x);
+			}
+
+			// round in the 52 bit double mantissa, so there is only one rounding; carries into the exponent are correct
+			const int dropBits = 52 - (mantissaBits < 0 ? 0 : mantissaBits);
+			std::uint64_t bits;
+			std::memcpy(&bits, &x, sizeof(bits));
+			const std::uint64_t lsb = (bits >> dropBits) & 1;
+			bits += (std::uint64_t(1) << (dropBits - 1)) - 1 + lsb;
+			bits &= ~((std::uint64_t(1) << dropBits) - 1);
+			double rounded;
+			std::memcpy(&rounded, &bits, sizeof(rounded));
+			return static_cast<float>(rounded);
+		}
+
+		// the stored value of x at precision (mantissaBits only matters for RoundedFloat)
+		static double store(double x, K3PiOutputPrecision precision, int mantissaBits)
+		{
+			switch (precision)
+			{
+			case K3PiOutputPrecision::Float:
+				return roundToFloat(x);
+			case K3PiOutputPrecision::RoundedFloat:
+				return roundToFloat(x, mantissaBits);
+			default:
+				return x;
+			}
+		}
+
+		// upper bound of |stored - x| / |x|, only for x in the normal float range (not for float-subnormal or overflowing x)
+		static double maxRelativeError(K3PiOutputPrecision precision, int mantissaBits = _FLOAT_MANTISSA_BITS)
+		{
+			if (precision == K3PiOutputPrecision::Double)
+			{
+				return 0.0;
+			}
+			const int m = precision == K3PiOutputPrecision::Float || mantissaBits > _FLOAT_MANTISSA_BITS ? _FLOAT_MANTISSA_BITS
+																										  : (mantissaBits < 0 ? 0 : mantissaBits);
+			return std::ldexp(1.0, -(m + 1));
+		}
+
+		// upper bound of |stored - x| for |x| <= maxAbsValue <= FLT_MAX, e.g. 1 for cosines and 2 pi for phi; also holds for
+		// float-subnormal x, whose error is at most 2^-150
+		static double maxAbsError(K3PiOutputPrecision precision, int mantissaBits, double maxAbsValue)
+		{
+			return maxAbsValue * maxRelativeError(precision, mantissaBits);
+		}
+	}; // end K3PiPrecision struct
+
+} // end namespace K3PiStudies
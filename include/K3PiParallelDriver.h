@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "K3PiChunkedDriver.h"
+
+namespace K3PiStudies
+{
+
+	// settings for K3PiParallelDriver
+	struct K3PiParallelDriverConfig
+	{
+		// what each worker reads and computes; _maxMemoryBytes is per worker
+		K3PiChunkedDriverConfig _chunkConfig;
+
+		// 0 = std::thread::hardware_concurrency()
+		unsigned int _numThreads = 0;
+
+		// tasks are runs of whole TTree clusters of about this many entries, so the slowest task at the end of the run stays short
+		std::uint64_t _taskEntries = 200000;
+	};
+
+	/**
+	 * K3PiChunkedDriver over many input files on a pool of worker threads, for input lists whose file sizes differ a lot.
+	 * The files are split into (file, entry range) tasks at TTree cluster boundaries; every worker takes the next task off a shared
+	 * queue as soon as it is done with its last, so no worker idles while there is work left (unlike a static split of the files).
+	 * Each worker keeps its file open for consecutive tasks of the same file and overlaps its reading with its computation, like K3PiChunkedDriver.
+	 *
+	 * The callback gets the index of the calling worker, so per-worker outputs (histograms, K3PiStreamingStats accumulators, ...)
+	 * can be filled without locks; runAndMerge does the bookkeeping and merges them at the end. Which worker sees which task
+	 * is not deterministic, so floating point sums can differ in the last bits between runs.
+	 */
+	class K3PiParallelDriver final
+	{
+	public:
+		using WorkerChunkFunc = std::function<void(unsigned int worker, const K3PiChunk &)>;
+
+		K3PiParallelDriver(const std::vector<std::string> &inputFiles, const K3PiParallelDriverConfig &config);
+
+		unsigned int numThreads() const;
+
+		// in the order they are handed out: file by file, in increasing entry order
+		const std::vector<K3PiEntryRange> &tasks() const;
+
+		std::uint64_t numEntries() const;
+
+		/**
+		 * Processes every entry of every input file once, func being called concurrently from numThreads() workers.
+		 * If func or the reading throws, the remaining tasks are dropped and the first exception is rethrown once the workers have stopped.
+		 *
+		 * @return number of entries processed
+		 */
+		std::uint64_t run(const WorkerChunkFunc &func) const;
+
+		/**
+		 * run with one State per worker, State being whatever makeState() returns (deduced, so lambdas work as they are):
+		 * process(State &, const K3PiChunk &) fills the state of the calling worker, then merge(State &into, State &from)
+		 * folds the states of workers 1... into that of worker 0, which is returned.
+		 * Histograms in State should not be attached to a TDirectory (TH1::AddDirectory(false) or SetDirectory(nullptr)).
+		 */
+		template <typename MakeState, typename Process, typename Merge>
+		std::invoke_result_t<const MakeState &> runAndMerge(const MakeState &makeState, Process process, Merge merge) const
+		{
+			using State = std::invoke_result_t<const MakeState &>;
+			std::vector<State> states;
+			states.reserve(_numThreads);
+			for (unsigned int w = 0; w < _numThreads; w++)
+			{
+				states.push_back(makeState());
+			}
+
+			auto processChunk = [&states, &process](unsigned int worker, const K3PiChunk &chunk)
+			{
+				process(states[worker], chunk);
+			};
+			run(processChunk);
+
+			for (unsigned int w = 1; w < _numThreads; w++)
+			{
+				merge(states[0], states[w]);
+			}
+			return std::move(states[0]);
+		}
+
+	private:
+		K3PiChunkedDriver _driver;
+		unsigned int _numThreads;
+		std::vector<K3PiEntryRange> _tasks;
+		std::uint64_t _numEntries = 0;
+	}; // end K3PiParallelDriver class
+
+} // end namespace K3PiStudies
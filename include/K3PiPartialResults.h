@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <TH1.h>
+
+#include "K3PiHistSweep.h"
+#include "K3PiStreamingStats.h"
+
+namespace K3PiStudies
+{
+
+	/**
+	 * Mergeable, serializable output of one part of a study (some entry ranges of some files), for map/reduce over a batch farm
+	 * (python/src/K3PiFarm.py): histograms (e.g. the K3PiHistGrid of a K3PiHistSweep), InvVarWeightedAvgAccumulators and
+	 * AsymmetryAccumulators by name, plus the labels of the tasks that went in, so a task that ran twice is caught when merging
+	 * instead of being counted twice.
+	 *
+	 * write / read use a plain ROOT file: the histograms in directory "hists", the accumulator states (as TVectorD) in
+	 * "weightedAvgs" and "asymmetries", and the task labels as a TObjString "tasks", one per line.
+	 */
+	class K3PiPartialResults final
+	{
+	public:
+		K3PiPartialResults() = default;
+		K3PiPartialResults(K3PiPartialResults &&moveMe) = default;
+		K3PiPartialResults &operator=(K3PiPartialResults &&moveMe) = default;
+		K3PiPartialResults(const K3PiPartialResults &copyMe) = delete;
+		K3PiPartialResults &operator=(const K3PiPartialResults &copyMe) = delete;
+
+		// "<inputFile>:<firstEntry>-<endEntry>", the label K3PiFarm.py uses for a K3PiEntryRange
+		static std::string taskLabel(const std::string &inputFile, std::uint64_t firstEntry, std::uint64_t endEntry);
+
+		// records that taskLabel has been processed into these results; throws std::invalid_argument if it already was
+		void addTask(const std::string &taskLabel);
+
+		// in the order they were added / merged
+		const std::vector<std::string> &tasks() const;
+
+		// adds a copy of h, or TH1::Adds it to the histogram with the same name
+		void addHist(const TH1 &h);
+
+		// addHist for every histogram of the grid, under their own names (<prefix>_<flag>_<region>_t<time bin>)
+		void addGrid(const K3PiHistGrid &grid);
+
+		bool hasHist(const std::string &name) const;
+
+		// throws std::out_of_range if there is none with that name
+		const TH1 &hist(const std::string &name) const;
+
+		std::vector<std::string> histNames() const;
+
+		// created empty on first use
+		InvVarWeightedAvgAccumulator &weightedAvg(const std::string &name);
+
+		AsymmetryAccumulator &asymmetry(const std::string &name);
+
+		const std::map<std::string, InvVarWeightedAvgAccumulator> &weightedAvgs() const;
+
+		const std::map<std::string, AsymmetryAccumulator> &asymmetries() const;
+
+		// adds everything in other; throws std::invalid_argument (leaving this unchanged) if both contain the same task
+		// or a histogram of the same name with a different binning
+		void merge(const K3PiPartialResults &other);
+
+		// the file appears under path only once it is complete
+		void write(const std::string &path) const;
+
+		static K3PiPartialResults read(const std::string &path);
+
+		// reads and merges the files one at a time
+		static K3PiPartialResults mergeFiles(const std::vector<std::string> &paths);
+
+	private:
+		std::vector<std::string> _tasks;
+		std::set<std::string> _taskSet;
+
+		std::map<std::string, std::unique_ptr<TH1>> _hists;
+		std::map<std::string, InvVarWeightedAvgAccumulator> _weightedAvgs;
+		std::map<std::string, AsymmetryAccumulator> _asymmetries;
+	}; // end K3PiPartialResults class
+
+} // end namespace K3PiStudies
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ROOT/RDataFrame.hxx>
+
+#include "K3PiRDFPipeline.h"
+
+namespace K3PiStudies
+{
+
+	// the cached phase space columns, in the order they are stored in a sidecar
+	enum K3PiPhsp_Columns
+	{
+		K3PiPhsp_m12,
+		K3PiPhsp_m34,
+		K3PiPhsp_cos12,
+		K3PiPhsp_cos34,
+		K3PiPhsp_phi,
+		K3PiPhsp_NumColumns
+	};
+
+	// identifies the input a sidecar was computed from; a sidecar whose key does not match its input file is rebuilt
+	struct K3PiPhspCacheKey
+	{
+		// TFile UUID, file size and modification date together stand in for a content checksum, which would mean reading the whole ntuple
+		std::string _fileUUID;
+		std::uint64_t _fileSize;
+		std::uint32_t _fileModDate;
+		std::uint64_t _numEntries;
+
+		// FNV-1a of the tree name and the K3PiColumnConfig fields that change the computed values
+		std::uint64_t _configHash;
+
+		bool operator==(const K3PiPhspCacheKey &other) const;
+	};
+
+	/**
+	 * Read-only memory map of one sidecar file: a fixed size header followed by K3PiPhsp_NumColumns float32 columns
+	 * of numEntries() values each, indexed by the entry number of the tree in the input file.
+	 * Candidates that fail the daughter identification are stored as NaN, like defineK3PiColumns gives them.
+	 */
+	class K3PiPhspSidecar final
+	{
+	public:
+		// maps the file; throws std::runtime_error if it can't be opened or is not a sidecar of the current format
+		explicit K3PiPhspSidecar(const std::string &path);
+		K3PiPhspSidecar(K3PiPhspSidecar &&moveMe) noexcept;
+		K3PiPhspSidecar(const K3PiPhspSidecar &copyMe) = delete;
+		K3PiPhspSidecar &operator=(K3PiPhspSidecar &&moveMe) noexcept;
+		K3PiPhspSidecar &operator=(const K3PiPhspSidecar &copyMe) = delete;
+		~K3PiPhspSidecar();
+
+		// writes the columns to path (via a temporary file and a rename, so concurrent jobs never see a partial sidecar)
+		static void write(const std::string &path, const K3PiPhspCacheKey &key, const std::vector<float> &columnMajorValues);
+
+		const K3PiPhspCacheKey &key() const;
+
+		std::uint64_t numEntries() const;
+
+		const float *column(K3PiPhsp_Columns col) const;
+
+	private:
+		void unmap();
+
+		void *_map = nullptr;
+		std::size_t _mapSize = 0;
+		K3PiPhspCacheKey _key;
+		const float *_values = nullptr;
+	}; // end K3PiPhspSidecar class
+
+	// settings for K3PiPhspCache
+	struct K3PiPhspCacheConfig
+	{
+		std::string _treeName;
+
+		// sidecars are written here, one per input file; the directory must exist
+		std::string _cacheDir = ".";
+
+		// which daughter branches are read (by K3PiChunkedDriver) when a sidecar has to be built; _outPrefix and _dstPiIDColumn are not used
+		K3PiColumnConfig _columnConfig;
+	};
+
+	/**
+	 * Phase space (m12, m34, cos12, cos34, phi) of every entry of a list of input files, computed once and kept in sidecar files.
+	 * The first run over an input file computes the columns and writes its sidecar, later runs only map it.
+	 * The values are stored as float, so they differ from the double precision columns by float rounding (relative 6e-8), or by the
+	 * K3PiPrecision bound if _columnConfig._phspPrecision is RoundedFloat.
+	 */
+	class K3PiPhspCache final
+	{
+	public:
+		/**
+		 * Maps the sidecar of each input file, building the ones that are missing or no longer match their input.
+		 *
+		 * @param inputFiles e.g. the output of K3PiStudiesUtils::buildListFromCommaSepStr
+		 */
+		K3PiPhspCache(const std::vector<std::string> &inputFiles, const K3PiPhspCacheConfig &config);
+
+		// <cacheDir>/<input file name>.<hash of the full input path>.k3piphsp
+		static std::string sidecarPath(const std::string &inputFile, const K3PiPhspCacheConfig &config);
+
+		// key of inputFile as it is now; throws std::runtime_error if the file or the tree can't be opened
+		static K3PiPhspCacheKey makeKey(const std::string &inputFile, const K3PiPhspCacheConfig &config);
+
+		std::size_t numFiles() const;
+
+		// sum over all files; the global entry number of (file f, entry e) is fileOffset(f) + e, the same as in a TChain of the files
+		std::uint64_t numEntries() const;
+
+		std::uint64_t fileOffset(std::size_t fileInd) const;
+
+		const K3PiPhspSidecar &sidecar(std::size_t fileInd) const;
+
+		/**
+		 * Data frame with one entry per input entry (in TChain order) defining only the cached columns:
+		 * <prefix>{m12, m34, cos12, cos34, phi} (float), <prefix>fileInd (unsigned int) and <prefix>entry (entry number in its file).
+		 * It keeps the sidecars mapped for as long as it is used.
+		 */
+		ROOT::RDF::RNode dataFrame(const std::string &prefix = "K3Pi_") const;
+
+	private:
+		std::shared_ptr<std::vector<K3PiPhspSidecar>> _sidecars;
+		std::vector<std::uint64_t> _fileOffsets;
+	}; // end K3PiPhspCache class
+
+} // end namespace K3PiStudies
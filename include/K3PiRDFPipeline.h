@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <ROOT/RDataFrame.hxx>
+
+#include "K3PiOutputPrecision.h"
+#include "K3PiStudiesUtils.h"
+
+namespace K3PiStudies
+{
+
+	// settings for K3PiRDFPipeline::defineK3PiColumns
+	struct K3PiColumnConfig
+	{
+		// which daughter branches to read: K3PiStudiesUtils::_P_FLAG (D0_P0_* ...), _D0_FIT_FLAG (Dst_D0Fit_D0_*) or _REFIT_FLAG (Dst_ReFit_D0_*)
+		std::string _fitFlag = K3PiStudiesUtils::_P_FLAG;
+
+		// prepended to the name of every column that gets defined
+		std::string _outPrefix = "K3Pi_";
+
+		// true if the daughter PX/PY/PZ/PE branches are stored as float instead of double
+		bool _floatMomenta = false;
+
+		// if not empty, name of the D* soft pion ID branch; used to also define isD0 and isRS
+		std::string _dstPiIDColumn = "";
+
+		// type of the m12, m34, cos12, cos34 and phi columns: double, or float (half the size in a Snapshot); see K3PiPrecision for the
+		// error bounds. K3PiHistSweep reads double columns, so keep Double for the in-memory pipeline and use Float for skims
+		K3PiOutputPrecision _phspPrecision = K3PiOutputPrecision::Double;
+
+		// RoundedFloat only: mantissa bits kept for cos12, cos34 and phi (m12 and m34 keep all 23)
+		int _angleMantissaBits = 16;
+	};
+
+	// everything derived from the 4 D0 daughters of one candidate, computed in a single pass
+	struct K3PiCandidate
+	{
+		// false if the daughter IDs are not K + 3 pi with the right charges; all other fields are then meaningless
+		bool _isValid;
+		bool _kaonIsNeg;
+		int _kaonInd;
+		int _osPion1Ind;
+		int _ssPionInd;
+		int _osPion2Ind;
+
+		// 4-momenta as read (lab frame), indexed by K3Pi_Roles (same order as K3PiRDFPipeline::_ROLE_NAMES)
+		double _px[4];
+		double _py[4];
+		double _pz[4];
+		double _pE[4];
+
+		// the same 4-momenta boosted into the D0 rest frame, which _phsp is computed from
+		double _pxD0CM[4];
+		double _pyD0CM[4];
+		double _pzD0CM[4];
+		double _pED0CM[4];
+
+		Phsp4BodyPoint _phsp;
+	};
+
+	class K3PiRDFPipeline final
+	{
+	public:
+		// suffixes used for the per-daughter output columns, in the order calc_phsp expects them
+		static inline const std::vector<std::string> _ROLE_NAMES = {"K", "OSPi1", "SSPi", "OSPi2"};
+
+		static std::vector<std::string> daughterBranchNames(const std::string &fitFlag, const std::string &varName);
+
+		static ROOT::RDF::RNode defineK3PiColumns(ROOT::RDF::RNode df, const K3PiColumnConfig &config);
+
+	}; // end K3PiRDFPipeline class
+
+} // end namespace K3PiStudies
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace K3PiStudies
+{
+
+	/**
+	 * Region and decay time bin lookup, resolved once from the region names and time bin edges
+	 * so the per-event checks are plain comparisons instead of string compares.
+	 *
+	 * Gives exactly the same answers as K3PiStudiesUtils::isInD0MassRegion, isInDeltaMRegion, getRegionAxisBounds*
+	 * and isWithinDecayTimeBin over the bins from makeTimeBins(upperTimeBinEdges).
+	 */
+	class K3PiRegionClassifier final
+	{
+	public:
+		// regions are K3PiStudiesUtils::_ALL_REGION_FLAG / _SIG_REGION_FLAG (case insensitive, at most 32); upperTimeBinEdges must be increasing
+		K3PiRegionClassifier(const std::vector<std::string> &regionFlags, const std::vector<double> &upperTimeBinEdges);
+
+		std::size_t numRegions() const;
+
+		std::size_t numTimeBins() const;
+
+		// number of distinct denseIndex values, numRegions() * numTimeBins()
+		std::size_t numBins() const;
+
+		// index into makeTimeBins(upperTimeBinEdges) of the bin containing decayTime, -1 if there is none (NaN or +inf)
+		int timeBin(double decayTime) const;
+
+		bool isInRegion(std::size_t regionInd, double d0MassMeV, double deltaMMeV) const;
+
+		// bit r is set if the candidate is in region r
+		std::uint32_t regionMask(double d0MassMeV, double deltaMMeV) const;
+
+		// regionInd * numTimeBins() + timeBin, or -1 if the candidate is not in region regionInd or in any time bin
+		int denseIndex(std::size_t regionInd, double d0MassMeV, double deltaMMeV, double decayTime) const;
+
+		/**
+		 * Batch version of timeBin and regionMask over columns of nEvents entries
+		 * @param timeBins output, nEvents entries
+		 * @param regionMasks output, nEvents entries
+		 */
+		void classify(
+			std::size_t nEvents,
+			const double *d0MassMeV,
+			const double *deltaMMeV,
+			const double *decayTime,
+			int *timeBins,
+			std::uint32_t *regionMasks) const;
+
+		const std::pair<double, double> &axisBoundsMD0MeV(std::size_t regionInd) const;
+
+		const std::pair<double, double> &axisBoundsDeltaMMeV(std::size_t regionInd) const;
+
+		const std::string &regionFlag(std::size_t regionInd) const;
+
+		const std::vector<std::pair<double, double>> &timeBins() const;
+
+	private:
+		struct Region
+		{
+			std::string _flag;
+			bool _acceptsAll;
+			double _lowMD0MeV;
+			double _highMD0MeV;
+			double _lowDeltaMMeV;
+			double _highDeltaMMeV;
+			std::pair<double, double> _axisBoundsMD0MeV;
+			std::pair<double, double> _axisBoundsDeltaMMeV;
+		};
+
+		std::vector<Region> _regions;
+		std::vector<double> _upperTimeBinEdges;
+		std::vector<std::pair<double, double>> _timeBins;
+
+		// set if all edges are equally spaced, so timeBin can use arithmetic instead of a binary search
+		bool _uniformTimeBins;
+		double _firstEdge;
+		double _invEdgeSpacing;
+	}; // end K3PiRegionClassifier class
+
+} // end namespace K3PiStudies
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+namespace K3PiStudies
+{
+
+	/**
+	 * Monotonic scratch memory for short-lived per-event objects (std::pmr containers and strings), e.g. the
+	 * std::pmr::memory_resource overloads of findOSPions or buildListFromCommaSepStr. Allocating is a pointer bump and
+	 * deallocating does nothing; reset() frees everything at once.
+	 *
+	 * The arena starts with one block of initialBytes. If an event or chunk needed more, the overflow comes from the global
+	 * allocator, and the next reset() grows the block to the high-water mark, so after the first few events an event loop
+	 * does not touch the global allocator at all.
+	 *
+	 * Not thread safe; use threadLocal() for one arena per thread.
+	 */
+	class K3PiScratchArena final
+	{
+	public:
+		static constexpr std::size_t _DEFAULT_INITIAL_BYTES = 64 * 1024;
+
+		explicit K3PiScratchArena(std::size_t initialBytes = _DEFAULT_INITIAL_BYTES);
+
+		K3PiScratchArena(const K3PiScratchArena &copyMe) = delete;
+		K3PiScratchArena &operator=(const K3PiScratchArena &copyMe) = delete;
+
+		/**
+		 * The calling thread's arena, created on first use.
+		 * K3PiChunkedDriver (and so K3PiParallelDriver) resets it after every chunk callback, so memory from it must not be
+		 * kept past the end of the chunk there.
+		 */
+		static K3PiScratchArena &threadLocal();
+
+		std::pmr::memory_resource *resource();
+
+		// invalidates everything allocated since the last reset
+		void reset();
+
+		// size of the arena's own block
+		std::size_t capacity() const;
+
+		// allocations that had to go to the global allocator since the arena was created (0 in a warmed up event loop)
+		std::uint64_t numUpstreamAllocations() const;
+
+	private:
+		// counts what the monotonic resource has to get from the global allocator
+		class UpstreamCounter final : public std::pmr::memory_resource
+		{
+		public:
+			std::size_t _bytesSinceReset = 0;
+			std::uint64_t _numAllocations = 0;
+
+		private:
+			void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+			void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override;
+			bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+		};
+
+		UpstreamCounter _upstream;
+		std::unique_ptr<std::byte[]> _block;
+		std::size_t _capacity;
+		std::optional<std::pmr::monotonic_buffer_resource> _resource;
+	}; // end K3PiScratchArena class
+
+	// resets an arena when it goes out of scope, e.g. at the end of each iteration of an event loop
+	class K3PiScratchScope final
+	{
+	public:
+		explicit K3PiScratchScope(K3PiScratchArena &arena = K3PiScratchArena::threadLocal());
+		~K3PiScratchScope();
+
+		K3PiScratchScope(const K3PiScratchScope &copyMe) = delete;
+		K3PiScratchScope &operator=(const K3PiScratchScope &copyMe) = delete;
+
+		std::pmr::memory_resource *resource();
+
+	private:
+		K3PiScratchArena &_arena;
+	}; // end K3PiScratchScope class
+
+} // end namespace K3PiStudies
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace K3PiStudies
+{
+
+	/**
+	 * Neumaier (improved Kahan) compensated sum; the error stays O(eps) instead of growing with the number of terms.
+	 * Do not build code using it with -ffast-math, which would optimize the compensation away.
+	 */
+	class NeumaierSum final
+	{
+	public:
+		void add(double x)
+		{
+			const double t = _sum + x;
+			if (std::abs(_sum) >= std::abs(x))
+			{
+				_compensation += (_sum - t) + x;
+			}
+			else
+			{
+				_compensation += (x - t) + _sum;
+			}
+			_sum = t;
+		}
+
+		void merge(const NeumaierSum &other)
+		{
+			add(other._sum);
+			add(other._compensation);
+		}
+
+		double value() const
+		{
+			return _sum + _compensation;
+		}
+
+		// raw state, e.g. for K3PiPartialResults; fromState(state()) gives back the same sum
+		std::array<double, 2> state() const
+		{
+			return {_sum, _compensation};
+		}
+
+		static NeumaierSum fromState(const std::array<double, 2> &state)
+		{
+			NeumaierSum sum;
+			sum._sum = state[0];
+			sum._compensation = state[1];
+			return sum;
+		}
+
+	private:
+		double _sum = 0.0;
+		double _compensation = 0.0;
+	}; // end NeumaierSum class
+
+	/**
+	 * Single-pass, O(1) memory version of K3PiStudiesUtils::invVarWeightedAvg.
+	 * Accumulators filled on different threads/files can be merged; the result does not depend on how the values were split up.
+	 */
+	class InvVarWeightedAvgAccumulator final
+	{
+	public:
+		void push(double val, double err)
+		{
+			const double w = 1.0 / (err * err);
+			_sumWeights.add(w);
+			_sumWeightedVals.add(val * w);
+			_count++;
+		}
+
+		void merge(const InvVarWeightedAvgAccumulator &other)
+		{
+			_sumWeights.merge(other._sumWeights);
+			_sumWeightedVals.merge(other._sumWeightedVals);
+			_count += other._count;
+		}
+
+		unsigned long long count() const
+		{
+			return _count;
+		}
+
+		/**
+		 * @return pair where ans.first = weighted mean, ans.second = error on weighted mean (both NaN if nothing was pushed)
+		 */
+		std::pair<double, double> result() const
+		{
+			if (_count == 0)
+			{
+				return std::make_pair(std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN());
+			}
+
+			const double sumWeights = _sumWeights.value();
+			return std::make_pair(_sumWeightedVals.value() / sumWeights, std::sqrt(1.0 / sumWeights));
+		}
+
+		// sum of weights, sum of weighted values (each as NeumaierSum::state) and the count, which is exact up to 2^53
+		std::array<double, 5> state() const
+		{
+			const std::array<double, 2> w = _sumWeights.state();
+			const std::array<double, 2> wv = _sumWeightedVals.state();
+			return {w[0], w[1], wv[0], wv[1], double(_count)};
+		}
+
+		static InvVarWeightedAvgAccumulator fromState(const std::array<double, 5> &state)
+		{
+			InvVarWeightedAvgAccumulator acc;
+			acc._sumWeights = NeumaierSum::fromState({state[0], state[1]});
+			acc._sumWeightedVals = NeumaierSum::fromState({state[2], state[3]});
+			acc._count = static_cast<unsigned long long>(state[4]);
+			return acc;
+		}
+
+	private:
+		NeumaierSum _sumWeights;
+		NeumaierSum _sumWeightedVals;
+		unsigned long long _count = 0;
+	}; // end InvVarWeightedAvgAccumulator class
+
+	/**
+	 * Streaming (optionally weighted) counts for K3PiStudiesUtils::calcAsymmetry.
+	 * Like countFuncResult, values >= 0 count as "above" and values < 0 as "below".
+	 */
+	class AsymmetryAccumulator final
+	{
+	public:
+		void push(double valToTest, double weight = 1.0)
+		{
+			if (valToTest >= 0.0)
+			{
+				pushAbove(weight);
+			}
+			else
+			{
+				pushBelow(weight);
+			}
+		}
+
+		void pushAbove(double weight = 1.0)
+		{
+			_nAbove.add(weight);
+			_sumW2Above.add(weight * weight);
+		}
+
+		void pushBelow(double weight = 1.0)
+		{
+			_nBelow.add(weight);
+			_sumW2Below.add(weight * weight);
+		}
+
+		// nAbove and nBelow unweighted entries at once, e.g. from RDataFrame Counts
+		void addCounts(double nAboveCount, double nBelowCount)
+		{
+			_nAbove.add(nAboveCount);
+			_nBelow.add(nBelowCount);
+			_sumW2Above.add(nAboveCount);
+			_sumW2Below.add(nBelowCount);
+		}
+
+		void merge(const AsymmetryAccumulator &other)
+		{
+			_nAbove.merge(other._nAbove);
+			_nBelow.merge(other._nBelow);
+			_sumW2Above.merge(other._sumW2Above);
+			_sumW2Below.merge(other._sumW2Below);
+		}
+
+		double nAbove() const
+		{
+			return _nAbove.value();
+		}
+
+		double nBelow() const
+		{
+			return _nBelow.value();
+		}
+
+		/**
+		 * Eqs. 1 and 2 in Mike's angular distributions ANA note, with the binomial error propagated from the sums of squared weights:
+		 * 2 sqrt(nBelow^2 sumW2Above + nAbove^2 sumW2Below) / (nAbove + nBelow)^2.
+		 * With unit weights this is the same as K3PiStudiesUtils::calcAsymmetry(nAbove(), nBelow()).
+		 *
+		 * @return pair where asym.first = asymmetry, asym.second = error
+		 */
+		std::pair<double, double> result() const
+		{
+			const double nAboveVal = nAbove();
+			const double nBelowVal = nBelow();
+			const double nTotal = nAboveVal + nBelowVal;
+			const double asym = (nAboveVal - nBelowVal) / nTotal;
+			const double asymErr = 2.0 * std::sqrt(nBelowVal * nBelowVal * _sumW2Above.value() + nAboveVal * nAboveVal * _sumW2Below.value()) / (nTotal * nTotal);
+
+			return std::make_pair(asym, asymErr);
+		}
+
+		// nAbove, nBelow, then the sums of squared weights above and below, each as NeumaierSum::state
+		std::array<double, 8> state() const
+		{
+			const std::array<double, 2> above = _nAbove.state();
+			const std::array<double, 2> below = _nBelow.state();
+			const std::array<double, 2> w2Above = _sumW2Above.state();
+			const std::array<double, 2> w2Below = _sumW2Below.state();
+			return {above[0], above[1], below[0], below[1], w2Above[0], w2Above[1], w2Below[0], w2Below[1]};
+		}
+
+		static AsymmetryAccumulator fromState(const std::array<double, 8> &state)
+		{
+			AsymmetryAccumulator acc;
+			acc._nAbove = NeumaierSum::fromState({state[0], state[1]});
+			acc._nBelow = NeumaierSum::fromState({state[2], state[3]});
+			acc._sumW2Above = NeumaierSum::fromState({state[4], state[5]});
+			acc._sumW2Below = NeumaierSum::fromState({state[6], state[7]});
+			return acc;
+		}
+
+	private:
+		NeumaierSum _nAbove;
+		NeumaierSum _nBelow;
+		NeumaierSum _sumW2Above;
+		NeumaierSum _sumW2Below;
+	}; // end AsymmetryAccumulator class
+
+} // end namespace K3PiStudies
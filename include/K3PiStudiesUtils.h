@@ -1,66 +1,29 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <memory_resource>
 #include <string>
 #include <vector>
 #include <utility>
 
 #include <TMath.h>
-#include <TLorentzVector.h>
-#include <ROOT/RVec.hxx>
 #include <TH1.h>
 #include <TLegend.h>
 #include <TPaveText.h>
 
+#include "K3PiDecayPermutation.h"
+#include "K3PiKinematics.h"
+#include "K3PiStreamingStats.h"
+
 namespace K3PiStudies
 {
 
-	struct InvalidDecayError : std::exception
-	{
-		const std::string _msg;
-
-		InvalidDecayError(const std::string &msg) : _msg(msg)
-		{
-		}
-
-		const char *what() const noexcept override
-		{
-			return _msg.c_str();
-		}
-	}; // end InvalidDecayError
-
-	struct ComputationError : std::exception
-	{
-		const std::string _msg;
-
-		ComputationError(const std::string &msg) : _msg(msg)
-		{
-		}
-
-		const char *what() const noexcept override
-		{
-			return _msg.c_str();
-		}
-	}; // end ComputationError
-
-	// names for the particles used in the "*D0Fit*" vars in the ntuple
-	enum D0Fit_PNames
-	{
-		D0Fit_D0_Kplus,
-		D0Fit_D0_piplus_0,
-		D0Fit_D0_piplus_1,
-		D0Fit_D0_piplus
-	};
-
-	// names for the particles used in the "*ReFit*" vars in the ntuple
-	enum ReFit_PNames
-	{
-		ReFit_D0_Kplus,
-		ReFit_D0_piplus_0,
-		ReFit_D0_piplus_1,
-		ReFit_D0_piplus
-	};
-
-	class K3PiStudiesUtils final
+	// the kinematics (calc_phsp, the angles, the particle masses) are in the K3PiKinematics base
+	class K3PiStudiesUtils final : public K3PiKinematics
 	{
 	public:
 		static inline const std::string _ALL_REGION_FLAG = "ALL";
@@ -77,22 +40,14 @@ namespace K3PiStudies
 		static const double _C_M_PER_SEC;
 		static constexpr double _MM_TO_M = 1.0 / 1000.0;
 		static const double _SEC_TO_NS;
-		static const unsigned int _KAON_ID = 321;
-		static const unsigned int _PION_ID = 211;
-		static constexpr double _PI = TMath::Pi();
-		static constexpr double _TWO_PI = 2.0 * TMath::Pi();
-		static constexpr double _GEV_TO_MEV = 1000.0;
 		static constexpr double _D0_LIFETIME_PS = 0.4103;
 		static constexpr double _NS_TO_PS = 1000.0;
 		static const std::string _RS_FLAG;
 		static const std::string _WS_FLAG;
 		static const std::string _BOTH_FLAG;
-		static constexpr double _KAON_MASS = 493.677;
-		static constexpr double _PION_MASS = 139.57061;
 		static const std::string _REFIT_FLAG;
 		static const std::string _D0_FIT_FLAG;
 		static const std::string _P_FLAG;
-		static constexpr double _COMPARE_EPS = std::numeric_limits<double>::epsilon();
 
 		K3PiStudiesUtils() = default;
 		K3PiStudiesUtils(const K3PiStudiesUtils &copyMe) = default;
@@ -103,19 +58,6 @@ namespace K3PiStudies
 
 		static void adjustYAxisForCompare(TH1 *const h1, TH1 *const h2);
 
-		static TLorentzVector toTLorentzVector(
-			double pE,
-			double px,
-			double py,
-			double pz);
-
-		static std::vector<double> calc_phsp(
-			const TLorentzVector &pD0_IN_D0CM,
-			const TLorentzVector &pA_IN_D0CM,  // K-
-			const TLorentzVector &pB_IN_D0CM,  // OS pi 1
-			const TLorentzVector &pC_IN_D0CM,  // SS pi
-			const TLorentzVector &pD_IN_D0CM); // OS pi 2
-
 		static std::pair<double, double> invVarWeightedAvg(
 			const std::vector<double> &vals,
 			const std::vector<double> &errs);
@@ -127,6 +69,45 @@ namespace K3PiStudies
 			std::function<double(double)> applyToEntry,
 			bool countPositiveEntries);
 
+		// same as above for any callable, which can then be inlined into the bin loop
+		template <typename ApplyToEntry>
+		static int countFuncResult(
+			const TH1 *const h,
+			const ApplyToEntry &applyToEntry,
+			bool countPositiveEntries)
+		{
+			if (!hasEmptyUnderOverflow(h))
+			{
+				return -1;
+			}
+
+			const int nBins = h->GetNbinsX();
+			unsigned int numNeg = 0;
+			unsigned int numPos = 0;
+			for (int b = 1; b <= nBins; b++)
+			{
+				if (applyToEntry(h->GetXaxis()->GetBinCenter(b)) >= 0.0)
+				{
+					numPos += h->GetBinContent(b);
+				}
+				else
+				{
+					numNeg += h->GetBinContent(b);
+				}
+			}
+
+			return selectFuncResultCount(h, numPos, numNeg, countPositiveEntries);
+		}
+
+		// helpers of countFuncResult, printing why the count cannot be made
+		static bool hasEmptyUnderOverflow(const TH1 *const h);
+
+		static int selectFuncResultCount(
+			const TH1 *const h,
+			unsigned int numPos,
+			unsigned int numNeg,
+			bool countPositiveEntries);
+
 		static void makeTLegendBkgTransparent(TLegend &leg);
 
 		static void makeTPaveTextBkgTransparent(TPaveText &pt);
@@ -153,12 +134,6 @@ namespace K3PiStudies
 			const TString& unit,
 			bool updateYLabel);
 
-		static double angleBetweenDecayPlanesKutschke(
-			const TVector3 &d4_motherRestFrame,
-			const TVector3 &d5_motherRestFrame,
-			const TVector3 &d6_motherRestFrame,
-			const TVector3 &d7_motherRestFrame);
-
 		static TString makeTitleStr(
 			const TString &title,
 			const TString &xLabel,
@@ -173,81 +148,12 @@ namespace K3PiStudies
 
 		static void changeToRainbowPalette();
 
-		static double verifyAngle(
-			const TVector3 &v1,
-			const TVector3 &v2,
-			double v1v2Angle,
-			bool v1v2AngleIsNegPiToPi,
-			const std::string &angleName,
-			bool printDiff);
-
-		static float helicity_angle_func(
-			float d0_px,
-			float d0_py,
-			float d0_pz,
-			float d0_m,
-			float pis_px,
-			float pis_py,
-			float pis_pz,
-			float pis_m);
-
-		static float helicity_angle_func(
-			float d0_px,
-			float d0_py,
-			float d0_pz,
-			float d0_m,
-			const ROOT::RVec<float> &pis_px,
-			const ROOT::RVec<float> &pis_py,
-			const ROOT::RVec<float> &pis_pz,
-			float pis_m);
-
-		static double compute_delta_angle(
-			double extra_px,
-			double extra_py,
-			double extra_pz,
-			double extra_m,
-			double d_px,
-			double d_py,
-			double d_pz,
-			double d_m);
-
-		static double compute_delta_angle(
-			double extra_px,
-			double extra_py,
-			double extra_pz,
-			double d_px,
-			double d_py,
-			double d_pz);
-
-		static double getPhi(
-			double px,
-			double py,
-			double pz,
-			double pE);
-
-		static double getEta(
-			double px,
-			double py,
-			double pz,
-			double pE);
-
-		static double getPT(
-			double px,
-			double py,
-			double pz,
-			double pE);
-
 		static bool isWithinDecayTimeBin(
 			double dtime,
 			const std::pair<double, double> &decayTimeLimits);
 
 		static unsigned int determineQuadrant(double sin2ThetaA, double sin2ThetaC);
 
-		static bool isKPi1LowerMassPair(
-			const TLorentzVector &kminus_4vec,
-			const TLorentzVector &piplus1_4vec,
-			const TLorentzVector &piplus2_4vec);
-
 		static bool isKaonNeg(
 			int kaonInd,
 			int D0_P0_ID,
@@ -269,18 +175,109 @@ namespace K3PiStudies
 			int D0_P2_ID,
 			int D0_P3_ID);
 
+		// same, with the vector allocated from scratch, e.g. K3PiScratchArena::threadLocal().resource()
+		static std::pmr::vector<int> findOSPions(
+			bool kaonIsNeg,
+			int D0_P0_ID,
+			int D0_P1_ID,
+			int D0_P2_ID,
+			int D0_P3_ID,
+			std::pmr::memory_resource *scratch);
+
+		static std::array<int, 2> findOSPionPair(
+			bool kaonIsNeg,
+			int D0_P0_ID,
+			int D0_P1_ID,
+			int D0_P2_ID,
+			int D0_P3_ID);
+
 		static int findKaon(
 			int D0_P0_ID,
 			int D0_P1_ID,
 			int D0_P2_ID,
 			int D0_P3_ID);
 
+		static DecayPermutation findDecayPermutation(
+			int D0_P0_ID,
+			int D0_P1_ID,
+			int D0_P2_ID,
+			int D0_P3_ID);
+
+		/**
+		 * noexcept versions of findKaon, isKaonNeg, findSSPion, findOSPionPair, getD0Part_* / getProbNNx (by index) and indexTo*_PName.
+		 * Same checks and results, but a failure comes back as the DecayStatus of the DecayLookup instead of an InvalidDecayError
+		 */
+		static DecayLookup<int> tryFindKaon(
+			int D0_P0_ID,
+			int D0_P1_ID,
+			int D0_P2_ID,
+			int D0_P3_ID) noexcept;
+
+		static DecayLookup<bool> tryIsKaonNeg(
+			int kaonInd,
+			int D0_P0_ID,
+			int D0_P1_ID,
+			int D0_P2_ID,
+			int D0_P3_ID) noexcept;
+
+		static DecayLookup<int> tryFindSSPion(
+			bool kaonIsNeg,
+			int D0_P0_ID,
+			int D0_P1_ID,
+			int D0_P2_ID,
+			int D0_P3_ID) noexcept;
+
+		static DecayLookup<std::array<int, 2>> tryFindOSPionPair(
+			bool kaonIsNeg,
+			int D0_P0_ID,
+			int D0_P1_ID,
+			int D0_P2_ID,
+			int D0_P3_ID) noexcept;
+
+		// any of the getD0Part_M / PE / PX / PY / PZ by index
+		static DecayLookup<double> tryGetD0Part(
+			int ind,
+			double D0_P0_var,
+			double D0_P1_var,
+			double D0_P2_var,
+			double D0_P3_var) noexcept;
+
+		static DecayLookup<double> tryGetProbNNx(
+			double D0_P0_ProbNNx,
+			double D0_P1_ProbNNx,
+			double D0_P2_ProbNNx,
+			double D0_P3_ProbNNx,
+			int ind) noexcept;
+
+		static DecayLookup<D0Fit_PNames> tryIndexToD0Fit_PName(int index) noexcept;
+
+		static DecayLookup<ReFit_PNames> tryIndexToReFit_PName(int index) noexcept;
+
+		/**
+		 * Batch findDecayPermutation for filtering columns of daughter IDs without any exceptions.
+		 * Writes one DecayPermutation per event to perms (check isValid() / status()) and adds each status to counters.
+		 *
+		 * @return number of valid candidates
+		 */
+		static std::size_t findDecayPermutations(
+			std::size_t nEvents,
+			const int *D0_P0_ID,
+			const int *D0_P1_ID,
+			const int *D0_P2_ID,
+			const int *D0_P3_ID,
+			DecayPermutation *perms,
+			DecayRejectCounters &counters) noexcept;
+
 		static bool isD0(int dStarPiID);
 
 		static bool isRS(bool isD0, bool isKaonNeg);
 
 		static std::vector<std::string> buildListFromCommaSepStr(const std::string &filesString);
 
+		static std::pmr::vector<std::pmr::string> buildListFromCommaSepStr(
+			const std::string &filesString,
+			std::pmr::memory_resource *scratch);
+
 		static double cTauMMToTauNS(double cTauMM);
 
 		static double tauNSToTauPS(double tauNS);
@@ -298,6 +295,14 @@ namespace K3PiStudies
 			double D0_P2_M,
 			double D0_P3_M);
 
+		static double getD0Part_M(
+			const DecayPermutation &perm,
+			K3Pi_Roles role,
+			double D0_P0_M,
+			double D0_P1_M,
+			double D0_P2_M,
+			double D0_P3_M);
+
 		static double getD0Part_PX(
 			int ind,
 			double D0_P0_PX,
@@ -305,6 +310,14 @@ namespace K3PiStudies
 			double D0_P2_PX,
 			double D0_P3_PX);
 
+		static double getD0Part_PX(
+			const DecayPermutation &perm,
+			K3Pi_Roles role,
+			double D0_P0_PX,
+			double D0_P1_PX,
+			double D0_P2_PX,
+			double D0_P3_PX);
+
 		static double getD0Part_PY(
 			int ind,
 			double D0_P0_PY,
@@ -312,6 +325,14 @@ namespace K3PiStudies
 			double D0_P2_PY,
 			double D0_P3_PY);
 
+		static double getD0Part_PY(
+			const DecayPermutation &perm,
+			K3Pi_Roles role,
+			double D0_P0_PY,
+			double D0_P1_PY,
+			double D0_P2_PY,
+			double D0_P3_PY);
+
 		static double getD0Part_PZ(
 			int ind,
 			double D0_P0_PZ,
@@ -319,6 +340,14 @@ namespace K3PiStudies
 			double D0_P2_PZ,
 			double D0_P3_PZ);
 
+		static double getD0Part_PZ(
+			const DecayPermutation &perm,
+			K3Pi_Roles role,
+			double D0_P0_PZ,
+			double D0_P1_PZ,
+			double D0_P2_PZ,
+			double D0_P3_PZ);
+
 		static double getD0Fit_PE(
 			D0Fit_PNames pName,
 			double Dst_D0Fit_D0_Kplus_PE,
@@ -326,6 +355,14 @@ namespace K3PiStudies
 			double Dst_D0Fit_D0_piplus_1_PE,
 			double Dst_D0Fit_D0_piplus_PE);
 
+		static double getD0Fit_PE(
+			const DecayPermutation &perm,
+			K3Pi_Roles role,
+			double Dst_D0Fit_D0_Kplus_PE,
+			double Dst_D0Fit_D0_piplus_0_PE,
+			double Dst_D0Fit_D0_piplus_1_PE,
+			double Dst_D0Fit_D0_piplus_PE);
+
 		static double getD0Fit_PX(
 			D0Fit_PNames pName,
 			double Dst_D0Fit_D0_Kplus_PX,
@@ -333,6 +370,14 @@ namespace K3PiStudies
 			double Dst_D0Fit_D0_piplus_1_PX,
 			double Dst_D0Fit_D0_piplus_PX);
 
+		static double getD0Fit_PX(
+			const DecayPermutation &perm,
+			K3Pi_Roles role,
+			double Dst_D0Fit_D0_Kplus_PX,
+			double Dst_D0Fit_D0_piplus_0_PX,
+			double Dst_D0Fit_D0_piplus_1_PX,
+			double Dst_D0Fit_D0_piplus_PX);
+
 		static double getD0Fit_PY(
 			D0Fit_PNames pName,
 			double Dst_D0Fit_D0_Kplus_PY,
@@ -340,6 +385,14 @@ namespace K3PiStudies
 			double Dst_D0Fit_D0_piplus_1_PY,
 			double Dst_D0Fit_D0_piplus_PY);
 
+		static double getD0Fit_PY(
+			const DecayPermutation &perm,
+			K3Pi_Roles role,
+			double Dst_D0Fit_D0_Kplus_PY,
+			double Dst_D0Fit_D0_piplus_0_PY,
+			double Dst_D0Fit_D0_piplus_1_PY,
+			double Dst_D0Fit_D0_piplus_PY);
+
 		static double getD0Fit_PZ(
 			D0Fit_PNames pName,
 			double Dst_D0Fit_D0_Kplus_PZ,
@@ -347,6 +400,14 @@ namespace K3PiStudies
 			double Dst_D0Fit_D0_piplus_1_PZ,
 			double Dst_D0Fit_D0_piplus_PZ);
 
+		static double getD0Fit_PZ(
+			const DecayPermutation &perm,
+			K3Pi_Roles role,
+			double Dst_D0Fit_D0_Kplus_PZ,
+			double Dst_D0Fit_D0_piplus_0_PZ,
+			double Dst_D0Fit_D0_piplus_1_PZ,
+			double Dst_D0Fit_D0_piplus_PZ);
+
 		static D0Fit_PNames findD0FitKaon(
 			int Dst_D0Fit_D0_Kplus_ID,
 			int Dst_D0Fit_D0_piplus_0_ID,
@@ -362,6 +423,21 @@ namespace K3PiStudies
 			int Dst_D0Fit_D0_piplus_1_ID,
 			int Dst_D0Fit_D0_piplus_ID);
 
+		static std::pmr::vector<D0Fit_PNames> findD0FitOSPions(
+			bool kaonIsNeg,
+			int Dst_D0Fit_D0_Kplus_ID,
+			int Dst_D0Fit_D0_piplus_0_ID,
+			int Dst_D0Fit_D0_piplus_1_ID,
+			int Dst_D0Fit_D0_piplus_ID,
+			std::pmr::memory_resource *scratch);
+
+		static std::array<D0Fit_PNames, 2> findD0FitOSPionPair(
+			bool kaonIsNeg,
+			int Dst_D0Fit_D0_Kplus_ID,
+			int Dst_D0Fit_D0_piplus_0_ID,
+			int Dst_D0Fit_D0_piplus_1_ID,
+			int Dst_D0Fit_D0_piplus_ID);
+
 		static D0Fit_PNames findD0FitSSPion(
 			bool kaonIsNeg,
 			int Dst_D0Fit_D0_Kplus_ID,
@@ -383,6 +459,14 @@ namespace K3PiStudies
 			double D0_P3_ProbNNx,
 			int ind);
 
+		static double getProbNNx(
+			double D0_P0_ProbNNx,
+			double D0_P1_ProbNNx,
+			double D0_P2_ProbNNx,
+			double D0_P3_ProbNNx,
+			const DecayPermutation &perm,
+			K3Pi_Roles role);
+
 		static ReFit_PNames indexToReFit_PName(int index);
 
 		static ReFit_PNames findReFitKaon(
@@ -398,6 +482,21 @@ namespace K3PiStudies
 			int Dst_ReFit_D0_piplus_1_ID,
 			int Dst_ReFit_D0_piplus_ID);
 
+		static std::pmr::vector<ReFit_PNames> findReFitOSPions(
+			bool kaonIsNeg,
+			int Dst_ReFit_D0_Kplus_ID,
+			int Dst_ReFit_D0_piplus_0_ID,
+			int Dst_ReFit_D0_piplus_1_ID,
+			int Dst_ReFit_D0_piplus_ID,
+			std::pmr::memory_resource *scratch);
+
+		static std::array<ReFit_PNames, 2> findReFitOSPionPair(
+			bool kaonIsNeg,
+			int Dst_ReFit_D0_Kplus_ID,
+			int Dst_ReFit_D0_piplus_0_ID,
+			int Dst_ReFit_D0_piplus_1_ID,
+			int Dst_ReFit_D0_piplus_ID);
+
 		static ReFit_PNames findReFitSSPion(
 			bool kaonIsNeg,
 			int Dst_ReFit_D0_Kplus_ID,
@@ -419,6 +518,14 @@ namespace K3PiStudies
 			double Dst_ReFit_D0_piplus_1_PE,
 			double Dst_ReFit_D0_piplus_PE);
 
+		static double getReFit_PE(
+			const DecayPermutation &perm,
+			K3Pi_Roles role,
+			double Dst_ReFit_D0_Kplus_PE,
+			double Dst_ReFit_D0_piplus_0_PE,
+			double Dst_ReFit_D0_piplus_1_PE,
+			double Dst_ReFit_D0_piplus_PE);
+
 		static double getReFit_PX(
 			ReFit_PNames pName,
 			double Dst_ReFit_D0_Kplus_PX,
@@ -426,6 +533,14 @@ namespace K3PiStudies
 			double Dst_ReFit_D0_piplus_1_PX,
 			double Dst_ReFit_D0_piplus_PX);
 
+		static double getReFit_PX(
+			const DecayPermutation &perm,
+			K3Pi_Roles role,
+			double Dst_ReFit_D0_Kplus_PX,
+			double Dst_ReFit_D0_piplus_0_PX,
+			double Dst_ReFit_D0_piplus_1_PX,
+			double Dst_ReFit_D0_piplus_PX);
+
 		static double getReFit_PY(
 			ReFit_PNames pName,
 			double Dst_ReFit_D0_Kplus_PY,
@@ -433,6 +548,14 @@ namespace K3PiStudies
 			double Dst_ReFit_D0_piplus_1_PY,
 			double Dst_ReFit_D0_piplus_PY);
 
+		static double getReFit_PY(
+			const DecayPermutation &perm,
+			K3Pi_Roles role,
+			double Dst_ReFit_D0_Kplus_PY,
+			double Dst_ReFit_D0_piplus_0_PY,
+			double Dst_ReFit_D0_piplus_1_PY,
+			double Dst_ReFit_D0_piplus_PY);
+
 		static double getReFit_PZ(
 			ReFit_PNames pName,
 			double Dst_ReFit_D0_Kplus_PZ,
@@ -440,22 +563,13 @@ namespace K3PiStudies
 			double Dst_ReFit_D0_piplus_1_PZ,
 			double Dst_ReFit_D0_piplus_PZ);
 
-		static std::vector<double> calc_phsp(
-			double K_D0Fit_PT,
-			double K_D0Fit_ETA,
-			double K_D0Fit_PHI,
-			double Pi_SS_D0Fit_PT,
-			double Pi_SS_D0Fit_ETA,
-			double Pi_SS_D0Fit_PHI,
-			double Pi_OS1_D0Fit_PT,
-			double Pi_OS1_D0Fit_ETA,
-			double Pi_OS1_D0Fit_PHI,
-			double Pi_OS2_D0Fit_PT,
-			double Pi_OS2_D0Fit_ETA,
-			double Pi_OS2_D0Fit_PHI,
-			bool pi1GoesWithK,
-			bool verifyAngles,
-			bool printDiff);
+		static double getReFit_PZ(
+			const DecayPermutation &perm,
+			K3Pi_Roles role,
+			double Dst_ReFit_D0_Kplus_PZ,
+			double Dst_ReFit_D0_piplus_0_PZ,
+			double Dst_ReFit_D0_piplus_1_PZ,
+			double Dst_ReFit_D0_piplus_PZ);
 
 		static double getD0Part_PE(
 			int ind,
@@ -464,25 +578,15 @@ namespace K3PiStudies
 			double D0_P2_PE,
 			double D0_P3_PE);
 
-		static bool areDoublesEqual(
-			std::function<bool(double, double)> isEqualFunc,
-			double d1,
-			double d2,
-			const std::string &varName,
-			bool printDiff);
-
-		static double changeAngleRange_neg_pi_to_pi(double angle_0_to_2pi);
-
-		static double radToDeg(double angleRad);
-
-		static double changeAngleRange_0_to_2pi(double angle_neg_pi_to_pi);
+		static double getD0Part_PE(
+			const DecayPermutation &perm,
+			K3Pi_Roles role,
+			double D0_P0_PE,
+			double D0_P1_PE,
+			double D0_P2_PE,
+			double D0_P3_PE);
 
 		static void silenceROOTHistSaveMsgs();
-
-		static bool combinedToleranceCompare(double x, double y);
-
-		static bool isExactlyEqual(double d1, double d2);
-
 	}; // end K3PiStudiesUtils class
 
 	struct Phsp4Body
@@ -522,20 +626,47 @@ namespace K3PiStudies
 		{
 		}
 
-		int compare5(const Phsp4Body &other, std::function<bool(double, double)> isEqualFunc, int eventNum, bool printSanityChecks) const
+		/**
+		 * @param isEqualFunc any callable taking two doubles, returning true if they are equal
+		 * @return number of the 5 phase space variables that differ; printSanityChecks prints each difference (the messages are
+		 * only built for those)
+		 */
+		template <typename IsEqualFunc>
+		int compare5(const Phsp4Body &other, const IsEqualFunc &isEqualFunc, int eventNum, bool printSanityChecks) const
+		{
+			if (!printSanityChecks)
+			{
+				return compare5(other, isEqualFunc);
+			}
+
+			static constexpr const char *names[5] = {"m12", "m34", "cos12", "cos34", "phi"};
+			const double mine[5] = {this->_m12_MeV, this->_m34_MeV, this->_cos12, this->_cos34, this->_phi_rad};
+			const double theirs[5] = {other._m12_MeV, other._m34_MeV, other._cos12, other._cos34, other._phi_rad};
+
+			int numDiffs = 0;
+			for (int i = 0; i < 5; i++)
+			{
+				if (!isEqualFunc(mine[i], theirs[i]))
+				{
+					K3PiStudiesUtils::printDoublesDiff("Event " + std::to_string(eventNum) + " " + names[i], mine[i], theirs[i]);
+					numDiffs++;
+				}
+			}
+
+			return numDiffs;
+		}
+
+		// same as compare5 with printSanityChecks = false, without building any of the per-field messages
+		template <typename IsEqualFunc>
+		int compare5(const Phsp4Body &other, const IsEqualFunc &isEqualFunc) const
 		{
-			std::string evt = std::to_string(eventNum);
-			bool isEqual[5];
-			isEqual[0] = K3PiStudiesUtils::areDoublesEqual(isEqualFunc, this->_m12_MeV, other._m12_MeV, "Event " + evt + " m12", printSanityChecks);
-			isEqual[1] = K3PiStudiesUtils::areDoublesEqual(isEqualFunc, this->_m34_MeV, other._m34_MeV, "Event " + evt + " m34", printSanityChecks);
-			isEqual[2] = K3PiStudiesUtils::areDoublesEqual(isEqualFunc, this->_cos12, other._cos12, "Event " + evt + " cos12", printSanityChecks);
-			isEqual[3] = K3PiStudiesUtils::areDoublesEqual(isEqualFunc, this->_cos34, other._cos34, "Event " + evt + " cos34", printSanityChecks);
-			isEqual[4] = K3PiStudiesUtils::areDoublesEqual(isEqualFunc, this->_phi_rad, other._phi_rad, "Event " + evt + " phi", printSanityChecks);
+			const double mine[5] = {this->_m12_MeV, this->_m34_MeV, this->_cos12, this->_cos34, this->_phi_rad};
+			const double theirs[5] = {other._m12_MeV, other._m34_MeV, other._cos12, other._cos34, other._phi_rad};
 
 			int numDiffs = 0;
 			for (int i = 0; i < 5; i++)
 			{
-				if (!isEqual[i])
+				if (!isEqualFunc(mine[i], theirs[i]))
 				{
 					numDiffs++;
 				}
@@ -0,0 +1,33 @@
+// selection for the rootcling dictionary of libK3PiStudiesUtils (ROOT_GENERATE_DICTIONARY in src/CMakeLists.txt): every public
+// header but the plain C K3PiCAPI.h (ctypes only); loading the library then needs no header parsing in cling
+#ifdef __CLING__
+
+#pragma link off all globals;
+#pragma link off all classes;
+#pragma link off all functions;
+#pragma link C++ nestedclasses;
+
+#pragma link C++ namespace K3PiStudies;
+
+#pragma link C++ defined_in "K3PiKinematicsTypes.h";
+#pragma link C++ defined_in "K3PiKinematics.h";
+#pragma link C++ defined_in "K3PiDecayPermutation.h";
+#pragma link C++ defined_in "K3PiStreamingStats.h";
+#pragma link C++ defined_in "K3PiStudiesUtils.h";
+#pragma link C++ defined_in "K3PiOutputPrecision.h";
+#pragma link C++ defined_in "K3PiRDFPipeline.h";
+#pragma link C++ defined_in "K3PiHistSweep.h";
+#pragma link C++ defined_in "K3PiEventFile.h";
+#pragma link C++ defined_in "K3PiChunkedDriver.h";
+#pragma link C++ defined_in "K3PiParallelDriver.h";
+#pragma link C++ defined_in "K3PiPartialResults.h";
+#pragma link C++ defined_in "K3PiPhspCache.h";
+#pragma link C++ defined_in "K3PiRegionClassifier.h";
+#pragma link C++ defined_in "K3PiBinIndex.h";
+#pragma link C++ defined_in "K3PiToyGenerator.h";
+#pragma link C++ defined_in "K3PiComparisonReport.h";
+#pragma link C++ defined_in "K3PiFastMath.h";
+#pragma link C++ defined_in "K3PiScratchArena.h";
+#pragma link C++ defined_in "K3PiInstrumentation.h";
+
+#endif
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <Math/Vector4D.h>
+
+#include "K3PiKinematicsTypes.h"
+
+namespace K3PiStudies
+{
+
+	/**
+	 * Counter-based random numbers (Philox4x32-10, Salmon et al., SC11): the n-th number of stream s under a seed is a pure
+	 * function of (seed, s, n), so any event can be generated on its own, on any thread, in any order.
+	 */
+	class K3PiCounterRNG final
+	{
+	public:
+		K3PiCounterRNG(std::uint64_t seed, std::uint64_t stream);
+
+		// uniform in [0, 1), 53 random bits
+		double uniform();
+
+	private:
+		void nextBlock();
+
+		std::array<std::uint32_t, 2> _key;
+		std::uint64_t _stream;
+		std::uint32_t _blockInd = 0;
+		std::array<std::uint32_t, 4> _block;
+		unsigned int _numUsed = 4;
+	}; // end K3PiCounterRNG class
+
+	// settings for K3PiToyGenerator
+	struct K3PiToyGeneratorConfig
+	{
+		std::uint64_t _seed = 0;
+
+		// mass of the mother; the daughters use K3PiStudiesUtils::_KAON_MASS and _PION_MASS
+		double _d0MassMeV = 1864.84;
+
+		// otherwise the K pi pair always moves along +z, with the K in the x-z plane
+		bool _randomOrientation = true;
+	};
+
+	// caller-owned output momentum columns of one particle, each nEvents long
+	struct P4OutColumns
+	{
+		double *_px;
+		double *_py;
+		double *_pz;
+		double *_pE;
+	};
+
+	// one toy event: its phase space point and the 4-vectors (MeV, D0 CM frame) in K3Pi_Roles order
+	struct K3PiToyEvent
+	{
+		Phsp4BodyPoint _phsp;
+		std::array<ROOT::Math::PxPyPzEVector, 4> _p4;
+	};
+
+	/**
+	 * Unbinned, unweighted D0 -> K- pi+ pi+ pi- events flat in 4-body phase space, in place of generating them externally and
+	 * converting them with python/src/ConvertPhsp.py.
+	 *
+	 * Phase space is sampled directly in the calc_phsp variables: uniform cos12, cos34 and phi, and (m12, m34) accepted with
+	 * probability proportional to p * q12 * q34 (the momentum of the pairs in the D0 frame times the momenta of the daughters in
+	 * the pair frames). The 4-vectors are built back from the point, with calc_phsp's conventions (K = A, OS pi 1 = B, ...), so
+	 * calc_phsp of the 4-vectors gives the point back up to rounding.
+	 *
+	 * Event i uses its own K3PiCounterRNG stream (seed, i), so a sample is the same for any number of threads or split of the
+	 * event range, and e.g. events [n, 2n) of a seed can be generated by a second job.
+	 */
+	class K3PiToyGenerator final
+	{
+	public:
+		// throws std::invalid_argument if _d0MassMeV is below the K 3pi threshold
+		explicit K3PiToyGenerator(const K3PiToyGeneratorConfig &config);
+
+		K3PiToyEvent generateEvent(std::uint64_t eventInd) const;
+
+		Phsp4BodyPoint generatePoint(std::uint64_t eventInd) const;
+
+		/**
+		 * Events [firstEvent, firstEvent + nEvents) into the caller's columns, split over numThreads threads (0 =
+		 * std::thread::hardware_concurrency()).
+		 *
+		 * @param p4 if not null, also the 4-vectors, in K3Pi_Roles order
+		 */
+		void generate(
+			std::uint64_t firstEvent,
+			std::size_t nEvents,
+			const Phsp4BodyColumns &phsp,
+			const std::array<P4OutColumns, 4> *p4 = nullptr,
+			unsigned int numThreads = 1) const;
+
+		// fraction of the (m12, m34) proposals that are accepted; each event needs about 1 / efficiency() of them
+		double efficiency() const;
+
+		const K3PiToyGeneratorConfig &config() const;
+
+	private:
+		Phsp4BodyPoint generateOne(std::uint64_t eventInd, ROOT::Math::PxPyPzEVector *p4) const;
+
+		K3PiToyGeneratorConfig _config;
+		double _m12Min;
+		double _m34Min;
+		double _massesMax; // m12 + m34 <= _massesMax
+		double _maxWeight;
+		double _efficiency;
+	}; // end K3PiToyGenerator class
+
+} // end namespace K3PiStudies
@@ -0,0 +1,103 @@
+import argparse
+import os
+import sys
+
+import ROOT
+
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import py_k3pi_utilities.utils
+
+# generalized ConvertPhsp.py: write reconstructed ntuples or AmpGen CSV samples as a K3PiEventFile (see K3PiEventFile.h),
+# which later jobs mmap and pass straight to the batch calc_phsp instead of decompressing the 16 momentum branches again
+#
+# examples:
+#   python ConvertToK3PiEvents.py --build-dir <utils build dir> --inc-dir <utils include dir> \
+#       root --tree DecayTree --fit-flag D0_FIT --dst-pi-id-col Dst_piplus_ID "f1.root, f2.root" sample.k3pievts
+#   python ConvertToK3PiEvents.py --build-dir <utils build dir> --inc-dir <utils include dir> \
+#       ampgen --wrong-sign --float ampgen_ws.csv ampgen_ws.k3pievts
+
+
+def loadEventFileLib(buildDir, incDir):
+    py_k3pi_utilities.utils.loadK3PiCUtils(buildDir, incDir, ('K3PiEventFile.h',))
+
+
+def makeConfig(args, units):
+    config = ROOT.K3PiStudies.K3PiEventFileConfig()
+    config._units = units
+    config._precision = ROOT.K3PiStudies.K3PiEventPrecision.Float if args.float else ROOT.K3PiStudies.K3PiEventPrecision.Double
+    return config
+
+
+def convertRoot(args):
+    columnConfig = ROOT.K3PiStudies.K3PiColumnConfig()
+    columnConfig._fitFlag = args.fit_flag
+    columnConfig._floatMomenta = args.float_momenta
+    columnConfig._dstPiIDColumn = args.dst_pi_id_col
+
+    config = makeConfig(args, ROOT.K3PiStudies.K3PiEventUnits.MeV)
+
+    inputFiles = ROOT.K3PiStudies.K3PiStudiesUtils.buildListFromCommaSepStr(args.inputs)
+    ROOT.K3PiStudies.K3PiEventFile.convertTree(inputFiles, args.tree, columnConfig, args.output, config)
+
+
+def convertAmpGen(args):
+    df = py_k3pi_utilities.utils.trimSpaceColNames(py_k3pi_utilities.utils.csvFileToDF(args.inputs))
+
+    # AmpGen names the particles by charge (K#, K~, pi#, pi~); alias them to names that don't depend on the flavour / RS-WS
+    isD0 = not args.d0bar
+    isRS = not args.wrong_sign
+    df = py_k3pi_utilities.utils.aliasAmpGen4VecComponents(df, args.k_num, py_k3pi_utilities.utils.getAmpGenKName, "K", isD0, isRS)
+    df = py_k3pi_utilities.utils.aliasAmpGen4VecComponents(df, args.os_pi1_num, py_k3pi_utilities.utils.getAmpGenOSPiName, "OSPi1", isD0, isRS)
+    df = py_k3pi_utilities.utils.aliasAmpGen4VecComponents(df, args.ss_pi_num, py_k3pi_utilities.utils.getAmpGenSSPiName, "SSPi", isD0, isRS)
+    df = py_k3pi_utilities.utils.aliasAmpGen4VecComponents(df, args.os_pi2_num, py_k3pi_utilities.utils.getAmpGenOSPiName, "OSPi2", isD0, isRS)
+
+    # K3Pi_Roles order, px, py, pz, E for each
+    p4Columns = ROOT.std.vector["std::string"]()
+    for pNum, name in [(args.k_num, "K"), (args.os_pi1_num, "OSPi1"), (args.ss_pi_num, "SSPi"), (args.os_pi2_num, "OSPi2")]:
+        for comp in ["Px", "Py", "Pz", "E"]:
+            p4Columns.push_back("_{}_{}_{}".format(pNum, name, comp))
+
+    config = makeConfig(args, ROOT.K3PiStudies.K3PiEventUnits.GeV)
+    config._isD0 = isD0
+    config._isRS = isRS
+
+    ROOT.K3PiStudies.K3PiEventFile.write(ROOT.RDF.AsRNode(df), p4Columns, args.output, config)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert ROOT ntuples or AmpGen CSV files to a K3PiEventFile")
+    parser.add_argument("--build-dir", required=True, help="k3pi_utilities build dir (containing src/libK3PiStudiesUtils.so)")
+    parser.add_argument("--inc-dir", required=True, help="k3pi_utilities include dir")
+    parser.add_argument("--float", action="store_true", help="store the momenta in float instead of double precision")
+    sub = parser.add_subparsers(dest="format", required=True)
+
+    root = sub.add_parser("root", help="reconstructed ntuples; daughters are assigned with K3PiRDFPipeline::defineK3PiColumns")
+    root.add_argument("inputs", help="comma separated list of input ROOT files")
+    root.add_argument("output")
+    root.add_argument("--tree", required=True)
+    root.add_argument("--fit-flag", default="P", help="P (D0_P0_*), D0_FIT (Dst_D0Fit_D0_*) or REFIT (Dst_ReFit_D0_*)")
+    root.add_argument("--float-momenta", action="store_true", help="the PX/PY/PZ/PE branches are floats")
+    root.add_argument("--dst-pi-id-col", default="", help="D* soft pion ID branch; if given, the per event isD0 / isRS flags are stored")
+
+    ampGen = sub.add_parser("ampgen", help="AmpGen CSV output (GeV, D0 rest frame)")
+    ampGen.add_argument("inputs", help="input CSV file")
+    ampGen.add_argument("output")
+    ampGen.add_argument("--d0bar", action="store_true", help="the sample is D0bar (default D0)")
+    ampGen.add_argument("--wrong-sign", action="store_true", help="the sample is WS (default RS)")
+    ampGen.add_argument("--k-num", type=int, default=1, help="AmpGen particle number of the kaon")
+    ampGen.add_argument("--os-pi1-num", type=int, default=2, help="AmpGen particle number of OS pion 1")
+    ampGen.add_argument("--os-pi2-num", type=int, default=3, help="AmpGen particle number of OS pion 2")
+    ampGen.add_argument("--ss-pi-num", type=int, default=4, help="AmpGen particle number of the SS pion")
+
+    args = parser.parse_args()
+
+    loadEventFileLib(args.build_dir, args.inc_dir)
+
+    if args.format == "root":
+        convertRoot(args)
+    else:
+        convertAmpGen(args)
+# end main
+
+if __name__ == "__main__":
+    main()
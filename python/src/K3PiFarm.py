@@ -0,0 +1,148 @@
+import argparse
+import importlib.util
+import json
+import os
+import sys
+
+import ROOT
+
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import py_k3pi_utilities.utils
+
+# map/reduce runner for spreading a study over a batch farm (or any pool of processes, e.g. Dask's client.map over mapJob)
+#
+#   plan:   split the input files into (file, entry range) tasks at TTree cluster boundaries (K3PiParallelDriver) and
+#           balance them over N jobs by number of entries
+#   map:    run one job: for every task, call the study's processRange(df, partial) on an RDataFrame of just that range,
+#           and write the K3PiPartialResults (histograms, accumulators, task labels) to one ROOT file
+#   reduce: merge the partial files, refusing tasks that are in two partials and reporting tasks of the plan that are missing
+#
+# a study is a python file defining processRange(df, partial), e.g.:
+#   def processRange(df, partial):
+#       config = ROOT.K3PiStudies.K3PiHistSweepConfig()
+#       ...
+#       grid = ROOT.K3PiStudies.K3PiHistSweep.book(df, config)
+#       asym = df.Filter("cos12 >= 0").Count(), df.Filter("cos12 < 0").Count()
+#       partial.addGrid(grid.GetValue())
+#       partial.asymmetry("cos12").addCounts(asym[0].GetValue(), asym[1].GetValue())
+#
+# examples:
+#   python K3PiFarm.py --build-dir <utils build dir> --inc-dir <utils include dir> plan --tree DecayTree --jobs 200 "f1.root, f2.root" plan.json
+#   python K3PiFarm.py --build-dir <utils build dir> --inc-dir <utils include dir> map --study myStudy.py plan.json 17 partial_17.root
+#   python K3PiFarm.py --build-dir <utils build dir> --inc-dir <utils include dir> reduce plan.json merged.root partial_*.root
+
+
+def loadFarmLibs(buildDir, incDir):
+    py_k3pi_utilities.utils.loadK3PiCUtils(buildDir, incDir, ('K3PiHistSweep.h', 'K3PiParallelDriver.h', 'K3PiPartialResults.h'))
+
+
+def taskLabel(plan, task):
+    return str(ROOT.K3PiStudies.K3PiPartialResults.taskLabel(plan["files"][task["file"]], task["first"], task["end"]))
+
+
+def makePlan(inputFiles, treeName, numJobs, taskEntries):
+    config = ROOT.K3PiStudies.K3PiParallelDriverConfig()
+    config._chunkConfig._treeName = treeName
+    config._taskEntries = taskEntries
+    driver = ROOT.K3PiStudies.K3PiParallelDriver(inputFiles, config)
+
+    tasks = [{"file": int(t._fileInd), "first": int(t._firstEntry), "end": int(t._endEntry)} for t in driver.tasks()]
+
+    # largest task first onto the job with the fewest entries so far
+    jobs = [[] for _ in range(max(1, min(numJobs, len(tasks))))]
+    jobEntries = [0] * len(jobs)
+    for task in sorted(tasks, key=lambda t: t["end"] - t["first"], reverse=True):
+        j = jobEntries.index(min(jobEntries))
+        jobs[j].append(task)
+        jobEntries[j] += task["end"] - task["first"]
+
+    # in file and entry order within a job
+    for job in jobs:
+        job.sort(key=lambda t: (t["file"], t["first"]))
+
+    return {"tree": treeName, "files": [str(f) for f in inputFiles], "jobs": jobs}
+
+
+def loadStudy(studyPath):
+    spec = importlib.util.spec_from_file_location("k3pi_study", studyPath)
+    study = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(study)
+    if not hasattr(study, "processRange"):
+        raise RuntimeError("{} does not define processRange(df, partial)".format(studyPath))
+    return study
+
+
+def mapJob(plan, jobInd, studyPath, outPath):
+    study = loadStudy(studyPath)
+    partial = ROOT.K3PiStudies.K3PiPartialResults()
+
+    for task in plan["jobs"][jobInd]:
+        # Range needs a single threaded event loop; run several map jobs per node to use its cores
+        df = ROOT.RDataFrame(plan["tree"], plan["files"][task["file"]]).Range(task["first"], task["end"])
+        study.processRange(ROOT.RDF.AsRNode(df), partial)
+        partial.addTask(taskLabel(plan, task))
+
+    partial.write(outPath)
+    return outPath
+
+
+def reduce(plan, partialPaths, outPath, allowMissing=False):
+    paths = ROOT.std.vector["std::string"]()
+    for p in partialPaths:
+        paths.push_back(p)
+    merged = ROOT.K3PiStudies.K3PiPartialResults.mergeFiles(paths)
+
+    done = set(str(t) for t in merged.tasks())
+    missing = [taskLabel(plan, t) for job in plan["jobs"] for t in job if taskLabel(plan, t) not in done]
+    if missing and not allowMissing:
+        raise RuntimeError("{} of the planned tasks are missing, e.g. {}".format(len(missing), missing[0]))
+
+    merged.write(outPath)
+    return missing
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Map/reduce a K3Pi study over a batch farm")
+    parser.add_argument("--build-dir", required=True, help="k3pi_utilities build dir (containing src/libK3PiStudiesUtils.so)")
+    parser.add_argument("--inc-dir", required=True, help="k3pi_utilities include dir")
+    sub = parser.add_subparsers(dest="step", required=True)
+
+    plan = sub.add_parser("plan", help="split the inputs into tasks and jobs")
+    plan.add_argument("inputs", help="comma separated list of input ROOT files")
+    plan.add_argument("plan", help="output plan (JSON)")
+    plan.add_argument("--tree", required=True)
+    plan.add_argument("--jobs", type=int, required=True, help="number of map jobs")
+    plan.add_argument("--task-entries", type=int, default=200000, help="approximate entries per task (whole TTree clusters)")
+
+    mapStep = sub.add_parser("map", help="run one job of the plan")
+    mapStep.add_argument("plan")
+    mapStep.add_argument("job", type=int)
+    mapStep.add_argument("output", help="partial results ROOT file")
+    mapStep.add_argument("--study", required=True, help="python file defining processRange(df, partial)")
+
+    reduceStep = sub.add_parser("reduce", help="merge the partial results of the jobs")
+    reduceStep.add_argument("plan")
+    reduceStep.add_argument("output", help="merged results ROOT file")
+    reduceStep.add_argument("partials", nargs="+")
+    reduceStep.add_argument("--allow-missing", action="store_true", help="write the merged results even if some tasks are missing")
+
+    args = parser.parse_args()
+
+    loadFarmLibs(args.build_dir, args.inc_dir)
+
+    if args.step == "plan":
+        inputFiles = ROOT.K3PiStudies.K3PiStudiesUtils.buildListFromCommaSepStr(args.inputs)
+        with open(args.plan, "w") as f:
+            json.dump(makePlan(inputFiles, args.tree, args.jobs, args.task_entries), f, indent=1)
+    elif args.step == "map":
+        with open(args.plan) as f:
+            mapJob(json.load(f), args.job, args.study, args.output)
+    else:
+        with open(args.plan) as f:
+            missing = reduce(json.load(f), args.partials, args.output, args.allow_missing)
+        if missing:
+            print("{} planned tasks were missing".format(len(missing)))
+# end main
+
+if __name__ == "__main__":
+    main()
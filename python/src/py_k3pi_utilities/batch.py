@@ -0,0 +1,132 @@
+import ctypes
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+
+# batch phase space for whole numpy / awkward samples, through the plain C entry points in K3PiCAPI.h:
+# the input columns are passed to the C++ kernel in place (no copy if they are already contiguous float64) and the
+# outputs are written straight into numpy arrays. ctypes releases the GIL for every call, so nThreads > 1 runs the
+# slices of a sample on several cores and other Python threads keep running meanwhile
+#
+# example:
+#   py_k3pi_utilities.batch.loadBatchLib(buildDir)
+#   phsp = py_k3pi_utilities.batch.calcPhspBatch(k, osPi1, ssPi, osPi2, units="GeV")
+#   phsp["m12_MeV"], phsp["cos12"], ...
+# with each particle given as (px, py, pz, E) columns, e.g. (ak_arr.px, ak_arr.py, ak_arr.pz, ak_arr.E), or a (4, n) array
+
+PHSP_NAMES = ["m12_MeV", "m34_MeV", "cos12", "cos34", "phi_rad"]
+P4_NAMES = ["{}_{}".format(p, c) for p in ["K", "OSPi1", "SSPi", "OSPi2"] for c in ["PX", "PY", "PZ", "PE"]]
+_TO_MEV = {"MeV": 1.0, "GeV": 1000.0}
+
+_lib = None
+
+
+def loadBatchLib(buildDir):
+    global _lib
+    lib = ctypes.CDLL('{}/src/libK3PiStudiesUtils.so'.format(buildDir))
+    lib.k3pi_calc_phsp_batch.argtypes = [ctypes.c_size_t, ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_void_p), ctypes.c_double]
+    lib.k3pi_calc_phsp_batch.restype = ctypes.c_int
+    lib.k3pi_generate_toy_phsp.argtypes = [ctypes.c_uint64, ctypes.c_double, ctypes.c_uint64, ctypes.c_size_t, ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint]
+    lib.k3pi_generate_toy_phsp.restype = ctypes.c_int
+    lib.k3pi_last_error.restype = ctypes.c_char_p
+    lib.k3pi_batch_kernel_isa.restype = ctypes.c_char_p
+    _lib = lib
+    return lib
+
+
+def batchKernelISA():
+    return _getLib().k3pi_batch_kernel_isa().decode()
+
+
+def _getLib():
+    if _lib is None:
+        raise RuntimeError("py_k3pi_utilities.batch: call loadBatchLib first")
+    return _lib
+
+
+def asColumn(values):
+    # a view if values is already a contiguous float64 array, otherwise a converted copy
+    col = np.ascontiguousarray(np.asarray(values), dtype=np.float64)
+    if col.ndim != 1:
+        raise ValueError("asColumn: expected a 1d column, got shape {}".format(col.shape))
+    return col
+
+
+def _particleColumns(p4):
+    # (px, py, pz, E) columns or a (4, n) array; an (n, 4) array with one AmpGen 4 vector per row also works, but is copied
+    if isinstance(p4, np.ndarray) and p4.ndim == 2 and p4.shape[0] != 4 and p4.shape[1] == 4:
+        p4 = p4.T
+    if len(p4) != 4:
+        raise ValueError("expected the 4 columns px, py, pz, E")
+    return [asColumn(c) for c in p4]
+
+
+def calcPhspBatch(k, osPi1, ssPi, osPi2, units="MeV", out=None, nThreads=1):
+    # K3PiStudiesUtils::calc_phsp_batch on D0 CM frame momenta; returns a dict of the PHSP_NAMES columns (masses in MeV),
+    # written into out (a dict of preallocated float64 arrays with the same keys) if given
+    if units not in _TO_MEV:
+        raise ValueError("calcPhspBatch: units must be one of {}".format(list(_TO_MEV)))
+    lib = _getLib()
+
+    p4Cols = _particleColumns(k) + _particleColumns(osPi1) + _particleColumns(ssPi) + _particleColumns(osPi2)
+    n = len(p4Cols[0])
+    if any(len(c) != n for c in p4Cols):
+        raise ValueError("calcPhspBatch: the momentum columns have different lengths")
+
+    if out is None:
+        out = {name: np.empty(n, dtype=np.float64) for name in PHSP_NAMES}
+    phspCols = [out[name] for name in PHSP_NAMES]
+    if any(c.dtype != np.float64 or not c.flags.c_contiguous or len(c) != n for c in phspCols):
+        raise ValueError("calcPhspBatch: out must hold contiguous float64 arrays of the input length")
+
+    def run(begin, end):
+        offset = begin * 8
+        p4Ptrs = (ctypes.c_void_p * 16)(*[c.ctypes.data + offset for c in p4Cols])
+        phspPtrs = (ctypes.c_void_p * 5)(*[c.ctypes.data + offset for c in phspCols])
+        if lib.k3pi_calc_phsp_batch(end - begin, p4Ptrs, phspPtrs, _TO_MEV[units]) != 0:
+            raise RuntimeError(lib.k3pi_last_error().decode())
+
+    if nThreads <= 1 or n < 2 * nThreads:
+        run(0, n)
+    else:
+        edges = np.linspace(0, n, nThreads + 1, dtype=np.int64)
+        with ThreadPoolExecutor(nThreads) as pool:
+            for f in [pool.submit(run, int(edges[i]), int(edges[i + 1])) for i in range(nThreads)]:
+                f.result()
+
+    return out
+
+
+def generateToyPhsp(nEvents, seed=0, firstEvent=0, d0MassMeV=1864.84, with4Vectors=False, nThreads=1):
+    # K3PiToyGenerator: flat D0 -> K3pi phase space straight into numpy, instead of generating externally and converting with
+    # ConvertPhsp.py; returns a dict of the PHSP_NAMES columns, plus the P4_NAMES columns (MeV, D0 CM) if with4Vectors.
+    # the events only depend on seed and their index, so e.g. job j of a toy study can use firstEvent=j * nEvents
+    lib = _getLib()
+
+    out = {name: np.empty(nEvents, dtype=np.float64) for name in PHSP_NAMES + (P4_NAMES if with4Vectors else [])}
+    phspPtrs = (ctypes.c_void_p * 5)(*[out[name].ctypes.data for name in PHSP_NAMES])
+    p4Ptrs = (ctypes.c_void_p * 16)(*[out[name].ctypes.data for name in P4_NAMES]) if with4Vectors else None
+    if lib.k3pi_generate_toy_phsp(seed, d0MassMeV, firstEvent, nEvents, phspPtrs, p4Ptrs, nThreads) != 0:
+        raise RuntimeError(lib.k3pi_last_error().decode())
+    return out
+
+
+def ampGenCSVToPhsp(csvFile, isD0=True, isRS=True, kNum=1, osPi1Num=2, osPi2Num=3, ssPiNum=4, nThreads=1):
+    # whole-sample version of ConvertPhsp.py: reads the AmpGen CSV (GeV, D0 rest frame) into numpy and converts it in one call
+    # utils imports ROOT (for the CSV data frame), so only this function pays for its start up
+    import py_k3pi_utilities.utils
+
+    df = py_k3pi_utilities.utils.trimSpaceColNames(py_k3pi_utilities.utils.csvFileToDF(csvFile))
+
+    roles = [(kNum, py_k3pi_utilities.utils.getAmpGenKName, "K"),
+             (osPi1Num, py_k3pi_utilities.utils.getAmpGenOSPiName, "OSPi1"),
+             (ssPiNum, py_k3pi_utilities.utils.getAmpGenSSPiName, "SSPi"),
+             (osPi2Num, py_k3pi_utilities.utils.getAmpGenOSPiName, "OSPi2")]
+    names = []
+    for pNum, ampGenName, noSymName in roles:
+        df = py_k3pi_utilities.utils.aliasAmpGen4VecComponents(df, pNum, ampGenName, noSymName, isD0, isRS)
+        names.append(["_{}_{}_{}".format(pNum, noSymName, comp) for comp in ["Px", "Py", "Pz", "E"]])
+
+    cols = df.AsNumpy([n for p in names for n in p])
+    p4 = [[cols[n] for n in p] for p in names]
+    return calcPhspBatch(p4[0], p4[1], p4[2], p4[3], units="GeV", nThreads=nThreads)
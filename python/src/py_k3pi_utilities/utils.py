@@ -1,3 +1,5 @@
+import os
+
 import ROOT
 
 def drawHist(h, statStyleStr, saveName):
@@ -52,12 +54,18 @@ def getAmpGenSSPiName(IS_D0, IS_RS):
             return "pi#"
 
 
-def loadK3PiCUtils(buildDir, incDir):
-    include = '#include "{}/K3PiStudiesUtils.h"'.format(incDir)
+def loadK3PiCUtils(buildDir, incDir, headers=()):
     lib = '{}/src/libK3PiStudiesUtils.so'.format(buildDir)
+    rootmap = '{}/src/libK3PiStudiesUtils.rootmap'.format(buildDir)
+
+    # with the dictionary (K3PISTUDIESUTILS_BUILD_DICTIONARY) ROOT knows every class of the public headers from the
+    # rootmap/pcm next to the library, so K3PiStudiesUtils.h need not be parsed; otherwise include it first
+    if not os.path.exists(rootmap):
+        ROOT.gInterpreter.ProcessLine('#include "{}/K3PiStudiesUtils.h"'.format(incDir))
 
-    # First include header, then load C++ library
-    ROOT.gInterpreter.ProcessLine(include)
+    # the extra headers are always included, e.g. for headers that are not in the dictionary or for their inline templates
+    for header in headers:
+        ROOT.gInterpreter.ProcessLine('#include "{}/{}"'.format(incDir, header))
     ROOT.gSystem.Load(lib)
 
 
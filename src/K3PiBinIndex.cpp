@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "K3PiBinIndex.h"
+#include "K3PiInstrumentation.h"
+
+namespace K3PiStudies
+{
+	namespace
+	{
+		constexpr std::size_t _MAX_BINS_8 = std::numeric_limits<std::uint8_t>::max();
+		constexpr std::size_t _MAX_BINS_16 = std::numeric_limits<std::uint16_t>::max();
+
+		// NaN and values outside [edges.front(), edges.back()) give numBins
+		template <typename T>
+		std::size_t findFineBin(const std::vector<double> &edges, bool isUniform, double invBinWidth, T value)
+		{
+			const double x = value;
+			const std::size_t numBins = edges.size() - 1;
+			if (!(x >= edges.front() && x < edges.back()))
+			{
+				return numBins;
+			}
+
+			if (!isUniform)
+			{
+				return std::size_t(std::upper_bound(edges.begin(), edges.end(), x) - edges.begin()) - 1;
+			}
+
+			// the arithmetic guess can be one off at an edge; the edges themselves decide
+			std::size_t b = std::min(numBins - 1, std::size_t((x - edges.front()) * invBinWidth));
+			if (x < edges[b])
+			{
+				b--;
+			}
+			else if (x >= edges[b + 1])
+			{
+				b++;
+			}
+			return b;
+		}
+	} // end anonymous namespace
+
+	K3PiBinAxis K3PiBinAxis::uniform(const std::string &name, std::size_t numBins, double low, double high)
+	{
+		if (numBins == 0 || !(high > low))
+		{
+			throw std::invalid_argument("K3PiBinAxis::uniform: " + name + " needs at least one bin and high > low.");
+		}
+
+		K3PiBinAxis axis{name, std::vector<double>(numBins + 1)};
+		for (std::size_t b = 0; b < numBins; b++)
+		{
+			axis._edges[b] = low + (high - low) * double(b) / double(numBins);
+		}
+		axis._edges[numBins] = high;
+		return axis;
+	}
+
+	K3PiBinAxis K3PiBinAxis::fromUpperEdges(const std::string &name, const std::vector<double> &upperBinEdges)
+	{
+		K3PiBinAxis axis{name, {-std::numeric_limits<double>::infinity()}};
+		axis._edges.insert(axis._edges.end(), upperBinEdges.begin(), upperBinEdges.end());
+		axis._edges.push_back(std::numeric_limits<double>::infinity());
+		return axis;
+	}
+
+	std::size_t K3PiBinAxis::numBins() const
+	{
+		return _edges.empty() ? 0 : _edges.size() - 1;
+	}
+
+	K3PiBinMap K3PiBinMap::identity(const K3PiBinAxis &axis)
+	{
+		return merge(axis, 1);
+	}
+
+	K3PiBinMap K3PiBinMap::fromEdges(const K3PiBinAxis &axis, const std::vector<double> &coarseEdges)
+	{
+		if (coarseEdges.size() < 2)
+		{
+			throw std::invalid_argument("K3PiBinMap::fromEdges: " + axis._name + " needs at least 2 coarse edges.");
+		}
+
+		K3PiBinMap map{std::vector<std::int32_t>(axis.numBins(), -1), coarseEdges.size() - 1};
+		std::size_t fine = 0;
+		for (std::size_t c = 0; c < coarseEdges.size(); c++)
+		{
+			const auto edge = std::find(axis._edges.begin() + (c > 0 ? fine + 1 : 0), axis._edges.end(), coarseEdges[c]);
+			if (edge == axis._edges.end())
+			{
+				throw std::invalid_argument("K3PiBinMap::fromEdges: " + std::to_string(coarseEdges[c]) + " is not a fine edge of " + axis._name + " (or the edges are not increasing).");
+			}
+
+			const std::size_t edgeInd = std::size_t(edge - axis._edges.begin());
+			if (c > 0)
+			{
+				std::fill(map._fineToCoarse.begin() + fine, map._fineToCoarse.begin() + edgeInd, std::int32_t(c - 1));
+			}
+			fine = edgeInd;
+		}
+		return map;
+	}
+
+	K3PiBinMap K3PiBinMap::merge(const K3PiBinAxis &axis, std::size_t groupSize)
+	{
+		if (groupSize == 0)
+		{
+			throw std::invalid_argument("K3PiBinMap::merge: groupSize must be positive.");
+		}
+
+		const std::size_t numBins = axis.numBins();
+		K3PiBinMap map{std::vector<std::int32_t>(numBins), (numBins + groupSize - 1) / groupSize};
+		for (std::size_t b = 0; b < numBins; b++)
+		{
+			map._fineToCoarse[b] = std::int32_t(b / groupSize);
+		}
+		return map;
+	}
+
+	K3PiBinMap K3PiBinMap::slice(const K3PiBinAxis &axis, std::size_t firstBin, std::size_t endBin)
+	{
+		if (firstBin >= endBin || endBin > axis.numBins())
+		{
+			throw std::invalid_argument("K3PiBinMap::slice: [firstBin, endBin) is not a non-empty range of bins of " + axis._name + ".");
+		}
+
+		K3PiBinMap map{std::vector<std::int32_t>(axis.numBins(), -1), 1};
+		std::fill(map._fineToCoarse.begin() + firstBin, map._fineToCoarse.begin() + endBin, 0);
+		return map;
+	}
+
+	K3PiBinIndex::K3PiBinIndex(const std::vector<K3PiBinAxis> &axes)
+		: _axes(axes), _bins(axes.size())
+	{
+		K3PI_PROFILE_FUNCTION();
+		for (std::size_t a = 0; a < _axes.size(); a++)
+		{
+			const std::vector<double> &edges = _axes[a]._edges;
+			const std::size_t numBins = _axes[a].numBins();
+			if (numBins == 0 || numBins > _MAX_BINS_16)
+			{
+				throw std::invalid_argument("K3PiBinIndex: Axis " + _axes[a]._name + " must have 1 to 65535 bins.");
+			}
+			for (std::size_t b = 0; b < numBins; b++)
+			{
+				if (!(edges[b] < edges[b + 1]))
+				{
+					throw std::invalid_argument("K3PiBinIndex: The edges of axis " + _axes[a]._name + " are not increasing.");
+				}
+			}
+
+			// equal widths up to rounding; findFineBin checks the guess against the edges anyway
+			const double width = (edges.back() - edges.front()) / double(numBins);
+			bool isUniform = std::isfinite(width);
+			for (std::size_t b = 0; isUniform && b < numBins; b++)
+			{
+				isUniform = std::abs((edges[b + 1] - edges[b]) - width) <= 1e-9 * width;
+			}
+			_bins[a]._isUniform = isUniform;
+			_bins[a]._invBinWidth = isUniform ? 1.0 / width : 0.0;
+		}
+	}
+
+	std::uint8_t K3PiBinIndex::makeFlags(bool isD0, bool isRS, unsigned int quadrant)
+	{
+		return std::uint8_t((isD0 ? K3PiBinFlag_IsD0 : 0) | (isRS ? K3PiBinFlag_IsRS : 0) | ((quadrant & 7u) << K3PiBinFlag_QuadrantShift));
+	}
+
+	template <typename T>
+	void K3PiBinIndex::fillColumns(std::size_t nEvents, const T *const *columns, const std::uint8_t *flags)
+	{
+		if (nEvents > 0 && !_axes.empty() && !columns)
+		{
+			throw std::invalid_argument("K3PiBinIndex::fill: null column array");
+		}
+
+		const std::size_t first = numEvents();
+		for (std::size_t a = 0; a < _axes.size(); a++)
+		{
+			const std::vector<double> &edges = _axes[a]._edges;
+			AxisBins &bins = _bins[a];
+			const T *column = columns[a];
+			if (_axes[a].numBins() <= _MAX_BINS_8)
+			{
+				bins._bins8.resize(first + nEvents);
+				for (std::size_t i = 0; i < nEvents; i++)
+				{
+					bins._bins8[first + i] = std::uint8_t(findFineBin(edges, bins._isUniform, bins._invBinWidth, column[i]));
+				}
+			}
+			else
+			{
+				bins._bins16.resize(first + nEvents);
+				for (std::size_t i = 0; i < nEvents; i++)
+				{
+					bins._bins16[first + i] = std::uint16_t(findFineBin(edges, bins._isUniform, bins._invBinWidth, column[i]));
+				}
+			}
+		}
+
+		if (flags)
+		{
+			_flags.insert(_flags.end(), flags, flags + nEvents);
+		}
+		else
+		{
+			_flags.resize(first + nEvents, 0);
+		}
+	}
+
+	void K3PiBinIndex::fill(std::size_t nEvents, const double *const *columns, const std::uint8_t *flags)
+	{
+		K3PI_PROFILE_FUNCTION();
+		fillColumns(nEvents, columns, flags);
+	}
+
+	void K3PiBinIndex::fill(std::size_t nEvents, const float *const *columns, const std::uint8_t *flags)
+	{
+		K3PI_PROFILE_FUNCTION();
+		fillColumns(nEvents, columns, flags);
+	}
+
+	std::size_t K3PiBinIndex::numEvents() const
+	{
+		return _flags.size();
+	}
+
+	const std::vector<K3PiBinAxis> &K3PiBinIndex::axes() const
+	{
+		return _axes;
+	}
+
+	int K3PiBinIndex::fineBin(std::size_t axisInd, std::size_t event) const
+	{
+		const std::size_t numBins = _axes.at(axisInd).numBins();
+		const std::size_t bin = numBins <= _MAX_BINS_8 ? _bins[axisInd]._bins8.at(event) : _bins[axisInd]._bins16.at(event);
+		return bin == numBins ? -1 : int(bin);
+	}
+
+	std::uint8_t K3PiBinIndex::flags(std::size_t event) const
+	{
+		return _flags.at(event);
+	}
+
+	void K3PiBinIndex::checkMaps(const std::vector<K3PiBinMap> &maps) const
+	{
+		if (maps.size() != _axes.size())
+		{
+			throw std::invalid_argument("K3PiBinIndex: Need one K3PiBinMap per axis.");
+		}
+
+		std::size_t numDense = 1;
+		for (std::size_t a = 0; a < _axes.size(); a++)
+		{
+			if (maps[a]._fineToCoarse.size() != _axes[a].numBins())
+			{
+				throw std::invalid_argument("K3PiBinIndex: The K3PiBinMap for axis " + _axes[a]._name + " is for a different number of fine bins.");
+			}
+			numDense *= std::max<std::size_t>(1, maps[a]._numCoarse);
+		}
+		if (numDense > std::size_t(std::numeric_limits<std::int32_t>::max()))
+		{
+			throw std::invalid_argument("K3PiBinIndex: Too many coarse bins.");
+		}
+	}
+
+	void K3PiBinIndex::denseIndices(
+		const std::vector<K3PiBinMap> &maps,
+		std::uint8_t flagMask,
+		std::uint8_t flagValue,
+		std::int32_t *out) const
+	{
+		K3PI_PROFILE_FUNCTION();
+		checkMaps(maps);
+
+		const std::size_t n = numEvents();
+		for (std::size_t i = 0; i < n; i++)
+		{
+			out[i] = (_flags[i] & flagMask) == flagValue ? 0 : -1;
+		}
+
+		// one axis at a time, last axis varying fastest; the extra table entry sends "outside the axis" to -1
+		std::int32_t stride = 1;
+		for (std::size_t a = _axes.size(); a-- > 0;)
+		{
+			std::vector<std::int32_t> table = maps[a]._fineToCoarse;
+			table.push_back(-1);
+
+			auto addAxis = [&](const auto &bins)
+			{
+				for (std::size_t i = 0; i < n; i++)
+				{
+					const std::int32_t coarse = table[bins[i]];
+					out[i] = (out[i] < 0 || coarse < 0) ? -1 : out[i] + stride * coarse;
+				}
+			};
+			if (_axes[a].numBins() <= _MAX_BINS_8)
+			{
+				addAxis(_bins[a]._bins8);
+			}
+			else
+			{
+				addAxis(_bins[a]._bins16);
+			}
+			stride *= std::int32_t(std::max<std::size_t>(1, maps[a]._numCoarse));
+		}
+	}
+
+	std::vector<double> K3PiBinIndex::histogram(
+		const std::vector<K3PiBinMap> &maps,
+		std::uint8_t flagMask,
+		std::uint8_t flagValue,
+		const double *weights) const
+	{
+		K3PI_PROFILE_FUNCTION();
+		std::vector<std::int32_t> indices(numEvents());
+		denseIndices(maps, flagMask, flagValue, indices.data());
+
+		std::size_t numDense = 1;
+		for (const K3PiBinMap &map : maps)
+		{
+			numDense *= std::max<std::size_t>(1, map._numCoarse);
+		}
+
+		std::vector<double> counts(numDense, 0.0);
+		for (std::size_t i = 0; i < indices.size(); i++)
+		{
+			if (indices[i] >= 0)
+			{
+				counts[indices[i]] += weights ? weights[i] : 1.0;
+			}
+		}
+		return counts;
+	}
+
+} // end namespace K3PiStudies
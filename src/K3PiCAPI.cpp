@@ -0,0 +1,155 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <string>
+
+#include "K3PiCAPI.h"
+#include "K3PiDecayPermutation.h"
+#include "K3PiInstrumentation.h"
+#include "K3PiKinematics.h"
+#include "K3PiToyGenerator.h"
+
+using namespace K3PiStudies;
+
+namespace
+{
+	thread_local std::string _lastError;
+
+	// exceptions must not cross the C boundary
+	template <typename Func>
+	int callNoThrow(Func func) noexcept
+	{
+		try
+		{
+			_lastError.clear();
+			func();
+			return 0;
+		}
+		catch (const std::exception &e)
+		{
+			_lastError = e.what();
+		}
+		catch (...)
+		{
+			_lastError = "unknown exception";
+		}
+		return 1;
+	}
+
+	void calcPhspBatch(
+		std::size_t nEvents,
+		const double *const *p4Columns,
+		double *const *phspColumns,
+		double toMeV)
+	{
+		// profiled here, inside callNoThrow, so registering the probe cannot throw across the C boundary
+		K3PI_PROFILE_FUNCTION();
+
+		// nothing to compute, and the column arrays may be null then
+		if (nEvents == 0)
+		{
+			return;
+		}
+		if (!p4Columns || !phspColumns)
+		{
+			throw std::invalid_argument("k3pi_calc_phsp_batch: null column array");
+		}
+
+		P4Columns p4[4];
+		for (int r = 0; r < 4; r++)
+		{
+			p4[r] = {p4Columns[4 * r], p4Columns[4 * r + 1], p4Columns[4 * r + 2], p4Columns[4 * r + 3]};
+		}
+		const Phsp4BodyColumns phsp = {phspColumns[0], phspColumns[1], phspColumns[2], phspColumns[3], phspColumns[4]};
+
+		K3PiKinematics::calc_phsp_batch(nEvents, p4[K3Pi_Kaon], p4[K3Pi_OSPion1], p4[K3Pi_SSPion], p4[K3Pi_OSPion2], phsp);
+
+		// the invariant masses scale with the momenta and the angles don't depend on the units
+		if (toMeV != 1.0)
+		{
+			for (std::size_t i = 0; i < nEvents; i++)
+			{
+				phsp._m12_MeV[i] *= toMeV;
+				phsp._m34_MeV[i] *= toMeV;
+			}
+		}
+	}
+
+	void generateToyPhsp(
+		std::uint64_t seed,
+		double d0MassMeV,
+		std::uint64_t firstEvent,
+		std::size_t nEvents,
+		double *const *phspColumns,
+		double *const *p4Columns,
+		unsigned int numThreads)
+	{
+		// profiled here, inside callNoThrow, so registering the probe cannot throw across the C boundary
+		K3PI_PROFILE_FUNCTION();
+
+		K3PiToyGeneratorConfig config;
+		config._seed = seed;
+		config._d0MassMeV = d0MassMeV;
+		const K3PiToyGenerator generator(config);
+
+		// nothing to generate (the config is still checked above), and the column arrays may be null then
+		if (nEvents == 0)
+		{
+			return;
+		}
+		if (!phspColumns)
+		{
+			throw std::invalid_argument("k3pi_generate_toy_phsp: null column array");
+		}
+
+		const Phsp4BodyColumns phsp = {phspColumns[0], phspColumns[1], phspColumns[2], phspColumns[3], phspColumns[4]};
+		std::array<P4OutColumns, 4> p4;
+		if (p4Columns)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				p4[r] = {p4Columns[4 * r], p4Columns[4 * r + 1], p4Columns[4 * r + 2], p4Columns[4 * r + 3]};
+			}
+		}
+
+		generator.generate(firstEvent, nEvents, phsp, p4Columns ? &p4 : nullptr, numThreads);
+	}
+} // end anonymous namespace
+
+extern "C"
+{
+	int k3pi_calc_phsp_batch(
+		std::size_t nEvents,
+		const double *const *p4Columns,
+		double *const *phspColumns,
+		double toMeV)
+	{
+		return callNoThrow([&]() { calcPhspBatch(nEvents, p4Columns, phspColumns, toMeV); });
+	}
+
+	int k3pi_generate_toy_phsp(
+		std::uint64_t seed,
+		double d0MassMeV,
+		std::uint64_t firstEvent,
+		std::size_t nEvents,
+		double *const *phspColumns,
+		double *const *p4Columns,
+		unsigned int numThreads)
+	{
+		return callNoThrow([&]() { generateToyPhsp(seed, d0MassMeV, firstEvent, nEvents, phspColumns, p4Columns, numThreads); });
+	}
+
+	const char *k3pi_last_error()
+	{
+		return _lastError.c_str();
+	}
+
+	const char *k3pi_batch_kernel_isa()
+	{
+		thread_local std::string isa;
+		isa = K3PiKinematics::batchKernelISA();
+		return isa.c_str();
+	}
+}
@@ -0,0 +1,415 @@
+#include <algorithm>
+#include <future>
+#include <limits>
+#include <stdexcept>
+
+#include <TFile.h>
+#include <TROOT.h>
+#include <TTree.h>
+
+#include "K3PiChunkedDriver.h"
+#include "K3PiDecayPermutation.h"
+#include "K3PiKinematicsKernels.h"
+#include "K3PiScratchArena.h"
+
+namespace K3PiStudies
+{
+	namespace
+	{
+		constexpr int _NUM_P4 = 4 * 4;
+
+		// everything one chunk needs, allocated once for chunkEntries entries and reused
+		struct ChunkBuffers
+		{
+			explicit ChunkBuffers(std::size_t capacity, std::size_t numDoubleColumns)
+				: _ids(4, std::vector<int>(capacity)),
+				  _rawP4(_NUM_P4, std::vector<double>(capacity)),
+				  _dstPiID(capacity),
+				  _doubles(numDoubleColumns, std::vector<double>(capacity)),
+				  _isValid(new bool[capacity]),
+				  _kaonIsNeg(new bool[capacity]),
+				  _isRS(new bool[capacity]),
+				  _p4(_NUM_P4, std::vector<double>(capacity)),
+				  _p4D0CM(_NUM_P4, std::vector<double>(capacity)),
+				  _phsp(5, std::vector<double>(capacity)),
+				  _timeBins(capacity),
+				  _regionMasks(capacity)
+			{
+			}
+
+			std::size_t _fileInd = 0;
+			std::uint64_t _firstEntry = 0;
+			std::size_t _size = 0;
+
+			// as read, in ntuple (D0_P0...D0_P3) order
+			std::vector<std::vector<int>> _ids;
+			std::vector<std::vector<double>> _rawP4; // daughter-major: P0 px, py, pz, E, P1 px, ...
+			std::vector<int> _dstPiID;
+			std::vector<std::vector<double>> _doubles;
+
+			// computed
+			std::unique_ptr<bool[]> _isValid;
+			std::unique_ptr<bool[]> _kaonIsNeg;
+			std::unique_ptr<bool[]> _isRS;
+			std::vector<std::vector<double>> _p4; // role-major, same layout as _rawP4
+			std::vector<std::vector<double>> _p4D0CM; // _p4 boosted into the D0 rest frame, what calc_phsp_batch needs
+			std::vector<std::vector<double>> _phsp;
+			std::vector<int> _timeBins;
+			std::vector<std::uint32_t> _regionMasks;
+		};
+
+		std::size_t chunkBytesPerEntry(std::size_t numDoubleColumns)
+		{
+			return 4 * sizeof(int) + _NUM_P4 * sizeof(double) + sizeof(int) + numDoubleColumns * sizeof(double) +
+				   3 * sizeof(bool) + 2 * _NUM_P4 * sizeof(double) + 5 * sizeof(double) + sizeof(int) + sizeof(std::uint32_t);
+		}
+
+		// reads the entry ranges given by a RangeSource into ChunkBuffers; only used by one thread at a time
+		class ChunkReader final
+		{
+		public:
+			ChunkReader(
+				const std::vector<std::string> &inputFiles,
+				const K3PiChunkedDriverConfig &config,
+				const std::vector<std::string> &doubleColumns,
+				const K3PiChunkedDriver::RangeSource &nextRange)
+				: _inputFiles(inputFiles),
+				  _config(config),
+				  _doubleColumns(doubleColumns),
+				  _nextRange(nextRange),
+				  _doubleVals(doubleColumns.size())
+			{
+			}
+
+			// fills buf with up to maxEntries entries, never spanning two ranges; false once nextRange has no more
+			bool read(ChunkBuffers &buf, std::size_t maxEntries)
+			{
+				while (_nextEntry >= _endEntry)
+				{
+					K3PiEntryRange range;
+					if (!_nextRange(range))
+					{
+						return false;
+					}
+					if (range._fileInd >= _inputFiles.size())
+					{
+						throw std::out_of_range("K3PiChunkedDriver: Entry range of file " + std::to_string(range._fileInd) + ", but only " +
+												std::to_string(_inputFiles.size()) + " input files.");
+					}
+
+					// consecutive ranges of the same file keep it open
+					if (!_tree || range._fileInd != _fileInd)
+					{
+						openFile(range._fileInd);
+					}
+					_nextEntry = range._firstEntry;
+					_endEntry = std::min(range._endEntry, _numEntries);
+				}
+
+				const bool floatMomenta = _config._columnConfig._floatMomenta;
+				const bool hasDstPiID = !_config._columnConfig._dstPiIDColumn.empty();
+				const std::size_t n = std::min<std::uint64_t>(maxEntries, _endEntry - _nextEntry);
+
+				buf._fileInd = _fileInd;
+				buf._firstEntry = _nextEntry;
+				buf._size = n;
+				for (std::size_t e = 0; e < n; e++)
+				{
+					if (_tree->GetEntry(_nextEntry + e) <= 0)
+					{
+						throw std::runtime_error("K3PiChunkedDriver: Could not read entry " + std::to_string(_nextEntry + e) + " of " +
+												 _inputFiles[buf._fileInd] + ".");
+					}
+
+					for (int d = 0; d < 4; d++)
+					{
+						buf._ids[d][e] = _ids[d];
+					}
+					for (int a = 0; a < _NUM_P4; a++)
+					{
+						buf._rawP4[a][e] = floatMomenta ? double(_p4Float[a]) : _p4Double[a];
+					}
+					if (hasDstPiID)
+					{
+						buf._dstPiID[e] = _dstPiID;
+					}
+					for (std::size_t c = 0; c < _doubleVals.size(); c++)
+					{
+						buf._doubles[c][e] = _doubleVals[c];
+					}
+				}
+				_nextEntry += n;
+
+				return true;
+			}
+
+		private:
+			void openFile(std::size_t fileInd)
+			{
+				_tree = nullptr;
+				_fileInd = fileInd;
+				_file.reset(TFile::Open(_inputFiles[fileInd].c_str(), "READ"));
+				if (!_file || _file->IsZombie())
+				{
+					throw std::runtime_error("K3PiChunkedDriver: Could not open " + _inputFiles[fileInd] + ".");
+				}
+
+				_tree = dynamic_cast<TTree *>(_file->Get(_config._treeName.c_str()));
+				if (!_tree)
+				{
+					throw std::runtime_error("K3PiChunkedDriver: No tree " + _config._treeName + " in " + _inputFiles[fileInd] + ".");
+				}
+				_numEntries = _tree->GetEntries();
+
+				// only decompress the branches that are used
+				_tree->SetBranchStatus("*", false);
+
+				const std::string &fitFlag = _config._columnConfig._fitFlag;
+				const std::vector<std::string> idNames = K3PiRDFPipeline::daughterBranchNames(fitFlag, "ID");
+				for (int d = 0; d < 4; d++)
+				{
+					connect(idNames[d], &_ids[d]);
+				}
+
+				const char *vars[4] = {"PX", "PY", "PZ", "PE"};
+				for (int v = 0; v < 4; v++)
+				{
+					const std::vector<std::string> names = K3PiRDFPipeline::daughterBranchNames(fitFlag, vars[v]);
+					for (int d = 0; d < 4; d++)
+					{
+						// _rawP4 is daughter-major
+						const int ind = d * 4 + v;
+						if (_config._columnConfig._floatMomenta)
+						{
+							connect(names[d], &_p4Float[ind]);
+						}
+						else
+						{
+							connect(names[d], &_p4Double[ind]);
+						}
+					}
+				}
+
+				if (!_config._columnConfig._dstPiIDColumn.empty())
+				{
+					connect(_config._columnConfig._dstPiIDColumn, &_dstPiID);
+				}
+
+				for (std::size_t c = 0; c < _doubleColumns.size(); c++)
+				{
+					connect(_doubleColumns[c], &_doubleVals[c]);
+				}
+			}
+
+			template <typename T>
+			void connect(const std::string &branchName, T *address)
+			{
+				_tree->SetBranchStatus(branchName.c_str(), true);
+				if (_tree->SetBranchAddress(branchName.c_str(), address) < 0)
+				{
+					throw std::runtime_error("K3PiChunkedDriver: Could not read branch " + branchName + " of " + _config._treeName +
+											 " (missing, or not of the expected type).");
+				}
+				_tree->AddBranchToCache(branchName.c_str(), true);
+			}
+
+			const std::vector<std::string> &_inputFiles;
+			const K3PiChunkedDriverConfig &_config;
+			const std::vector<std::string> &_doubleColumns;
+			const K3PiChunkedDriver::RangeSource &_nextRange;
+
+			std::unique_ptr<TFile> _file;
+			TTree *_tree = nullptr;
+			std::size_t _fileInd = 0;
+			std::uint64_t _numEntries = 0;
+
+			// of the current range
+			std::uint64_t _nextEntry = 0;
+			std::uint64_t _endEntry = 0;
+
+			// branch addresses
+			int _ids[4];
+			double _p4Double[_NUM_P4];
+			float _p4Float[_NUM_P4];
+			int _dstPiID;
+			std::vector<double> _doubleVals;
+		};
+
+		// daughter identification, calc_phsp_batch and region classification of a chunk that has been read
+		void computeChunk(ChunkBuffers &buf, const K3PiChunkedDriverConfig &config, const K3PiRegionClassifier *classifier, int d0MassInd, int deltaMInd, int decayTimeInd)
+		{
+			const std::size_t n = buf._size;
+			const double nan = std::numeric_limits<double>::quiet_NaN();
+			const bool hasDstPiID = !config._columnConfig._dstPiIDColumn.empty();
+
+			for (std::size_t e = 0; e < n; e++)
+			{
+				const DecayPermutation perm = DecayPermutation::fromIDs(buf._ids[0][e], buf._ids[1][e], buf._ids[2][e], buf._ids[3][e]);
+				buf._isValid[e] = perm.isValid();
+				buf._kaonIsNeg[e] = perm.isValid() && perm.kaonIsNeg();
+				detail::Vec4 lab[4];
+				for (int r = 0; r < 4; r++)
+				{
+					const int d = perm.isValid() ? perm.index(static_cast<K3Pi_Roles>(r)) : 0;
+					for (int c = 0; c < 4; c++)
+					{
+						buf._p4[r * 4 + c][e] = perm.isValid() ? buf._rawP4[d * 4 + c][e] : nan;
+					}
+					lab[r] = {buf._p4[r * 4][e], buf._p4[r * 4 + 1][e], buf._p4[r * 4 + 2][e], buf._p4[r * 4 + 3][e]};
+				}
+
+				// the branches are lab frame, calc_phsp_batch (like calc_phsp) takes the daughters in the D0 rest frame
+				detail::Vec4 rest[4];
+				detail::boostToRestFrame(lab, rest);
+				for (int r = 0; r < 4; r++)
+				{
+					buf._p4D0CM[r * 4][e] = rest[r]._x;
+					buf._p4D0CM[r * 4 + 1][e] = rest[r]._y;
+					buf._p4D0CM[r * 4 + 2][e] = rest[r]._z;
+					buf._p4D0CM[r * 4 + 3][e] = rest[r]._t;
+				}
+				if (hasDstPiID)
+				{
+					buf._isRS[e] = K3PiStudiesUtils::isRS(K3PiStudiesUtils::isD0(buf._dstPiID[e]), buf._kaonIsNeg[e]);
+				}
+			}
+
+			P4Columns p4[4];
+			for (int r = 0; r < 4; r++)
+			{
+				p4[r] = {buf._p4D0CM[r * 4].data(), buf._p4D0CM[r * 4 + 1].data(), buf._p4D0CM[r * 4 + 2].data(), buf._p4D0CM[r * 4 + 3].data()};
+			}
+			const Phsp4BodyColumns phsp = {buf._phsp[0].data(), buf._phsp[1].data(), buf._phsp[2].data(), buf._phsp[3].data(), buf._phsp[4].data()};
+			K3PiStudiesUtils::calc_phsp_batch(n, p4[0], p4[1], p4[2], p4[3], phsp);
+
+			if (classifier)
+			{
+				classifier->classify(n, buf._doubles[d0MassInd].data(), buf._doubles[deltaMInd].data(), buf._doubles[decayTimeInd].data(),
+									 buf._timeBins.data(), buf._regionMasks.data());
+			}
+		}
+	} // end anonymous namespace
+
+	K3PiChunkedDriver::K3PiChunkedDriver(const std::vector<std::string> &inputFiles, const K3PiChunkedDriverConfig &config)
+		: _inputFiles(inputFiles),
+		  _config(config),
+		  _doubleColumns(config._extraColumns)
+	{
+		ROOT::EnableThreadSafety();
+
+		if (!config._decayTimeColumn.empty())
+		{
+			if (config._d0MassMeVColumn.empty() || config._deltaMMeVColumn.empty())
+			{
+				throw std::invalid_argument("K3PiChunkedDriver: Region classification needs the D0 mass, delta m and decay time columns.");
+			}
+
+			auto columnInd = [this](const std::string &name)
+			{
+				const auto it = std::find(_doubleColumns.begin(), _doubleColumns.end(), name);
+				if (it != _doubleColumns.end())
+				{
+					return int(it - _doubleColumns.begin());
+				}
+				_doubleColumns.push_back(name);
+				return int(_doubleColumns.size() - 1);
+			};
+			_d0MassInd = columnInd(config._d0MassMeVColumn);
+			_deltaMInd = columnInd(config._deltaMMeVColumn);
+			_decayTimeInd = columnInd(config._decayTimeColumn);
+			_classifier = std::make_unique<K3PiRegionClassifier>(config._regionFlags, config._upperTimeBinEdges);
+		}
+
+		_bytesPerEntry = chunkBytesPerEntry(_doubleColumns.size());
+		_chunkEntries = std::max<std::size_t>(1, config._maxMemoryBytes / (2 * _bytesPerEntry));
+	}
+
+	std::size_t K3PiChunkedDriver::chunkEntries() const
+	{
+		return _chunkEntries;
+	}
+
+	std::size_t K3PiChunkedDriver::bytesPerEntry() const
+	{
+		return _bytesPerEntry;
+	}
+
+	std::uint64_t K3PiChunkedDriver::run(const ChunkFunc &func) const
+	{
+		// every file, whole
+		std::size_t nextFileInd = 0;
+		auto wholeFiles = [&nextFileInd, this](K3PiEntryRange &range)
+		{
+			if (nextFileInd >= _inputFiles.size())
+			{
+				return false;
+			}
+			range = {nextFileInd++, 0, std::numeric_limits<std::uint64_t>::max()};
+			return true;
+		};
+		return run(func, wholeFiles);
+	}
+
+	std::uint64_t K3PiChunkedDriver::run(const ChunkFunc &func, const RangeSource &nextRange) const
+	{
+		ChunkReader reader(_inputFiles, _config, _doubleColumns, nextRange);
+		ChunkBuffers buffers[2] = {ChunkBuffers(_chunkEntries, _doubleColumns.size()), ChunkBuffers(_chunkEntries, _doubleColumns.size())};
+		const bool hasDstPiID = !_config._columnConfig._dstPiIDColumn.empty();
+
+		std::uint64_t numProcessed = 0;
+		int current = 0;
+		bool haveChunk = reader.read(buffers[current], _chunkEntries);
+		while (haveChunk)
+		{
+			// read the next chunk into the other buffer while this one is processed
+			ChunkBuffers &next = buffers[1 - current];
+			std::future<bool> nextRead = std::async(std::launch::async, [&reader, &next, this]() { return reader.read(next, _chunkEntries); });
+
+			ChunkBuffers &buf = buffers[current];
+			try
+			{
+				computeChunk(buf, _config, _classifier.get(), _d0MassInd, _deltaMInd, _decayTimeInd);
+
+				K3PiChunk chunk;
+				chunk._fileInd = buf._fileInd;
+				chunk._firstEntry = buf._firstEntry;
+				chunk._size = buf._size;
+				chunk._isValid = buf._isValid.get();
+				chunk._kaonIsNeg = buf._kaonIsNeg.get();
+				chunk._isRS = hasDstPiID ? buf._isRS.get() : nullptr;
+				for (int r = 0; r < 4; r++)
+				{
+					chunk._p4[r] = {buf._p4[r * 4].data(), buf._p4[r * 4 + 1].data(), buf._p4[r * 4 + 2].data(), buf._p4[r * 4 + 3].data()};
+					chunk._p4D0CM[r] = {buf._p4D0CM[r * 4].data(), buf._p4D0CM[r * 4 + 1].data(), buf._p4D0CM[r * 4 + 2].data(), buf._p4D0CM[r * 4 + 3].data()};
+				}
+				chunk._m12_MeV = buf._phsp[0].data();
+				chunk._m34_MeV = buf._phsp[1].data();
+				chunk._cos12 = buf._phsp[2].data();
+				chunk._cos34 = buf._phsp[3].data();
+				chunk._phi_rad = buf._phsp[4].data();
+				chunk._timeBins = _classifier ? buf._timeBins.data() : nullptr;
+				chunk._regionMasks = _classifier ? buf._regionMasks.data() : nullptr;
+				for (std::size_t c = 0; c < _config._extraColumns.size(); c++)
+				{
+					chunk._extra.push_back(buf._doubles[c].data());
+				}
+
+				func(chunk);
+				K3PiScratchArena::threadLocal().reset();
+			}
+			catch (...)
+			{
+				// don't leave the reader running on buffers that are about to go away
+				nextRead.wait();
+				throw;
+			}
+
+			numProcessed += buf._size;
+			haveChunk = nextRead.get();
+			current = 1 - current;
+		}
+
+		return numProcessed;
+	}
+
+} // end namespace K3PiStudies
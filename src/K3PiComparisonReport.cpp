@@ -0,0 +1,310 @@
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#include <TCanvas.h>
+#include <TFile.h>
+#include <TLegend.h>
+#include <TMath.h>
+#include <TPaveText.h>
+#include <TROOT.h>
+
+#include "K3PiComparisonReport.h"
+#include "K3PiInstrumentation.h"
+#include "K3PiStudiesUtils.h"
+
+namespace K3PiStudies
+{
+	namespace
+	{
+		// in-range bin contents, without under/overflow
+		std::vector<double> binContents(const TH1 &h)
+		{
+			std::vector<double> contents(h.GetNbinsX());
+			for (int b = 1; b <= h.GetNbinsX(); b++)
+			{
+				contents[b - 1] = h.GetBinContent(b);
+			}
+			return contents;
+		}
+
+		std::unique_ptr<TH1> normalizedClone(const TH1 &h, const char *name)
+		{
+			std::unique_ptr<TH1> clone(static_cast<TH1 *>(h.Clone(name)));
+			clone->SetDirectory(nullptr);
+			clone->Scale(1.0 / clone->Integral());
+			return clone;
+		}
+	} // end anonymous namespace
+
+	K3PiComparisonReport::K3PiComparisonReport(const K3PiComparisonReportConfig &config)
+		: _config(config)
+	{
+		K3PI_PROFILE_FUNCTION();
+		if (_config._output == K3PiReportOutput::MetricsOnly)
+		{
+			return;
+		}
+		if (_config._path.empty())
+		{
+			throw std::invalid_argument("K3PiComparisonReport: _path is needed unless the output is MetricsOnly.");
+		}
+
+		// nothing is shown on screen, and no window is created per canvas
+		_wasBatch = gROOT->IsBatch();
+		gROOT->SetBatch(kTRUE);
+
+		_canvas = std::make_unique<TCanvas>("K3PiComparisonReport", "", _config._canvasWidth, _config._canvasHeight);
+		_legend = std::make_unique<TLegend>(0.12, 0.76, 0.32, 0.89);
+		K3PiStudiesUtils::makeTLegendBkgTransparent(*_legend);
+		_numEntriesText = std::make_unique<TPaveText>(0.60, 0.8, 0.9, 0.9, "NDC"); // NDC sets coords
+		K3PiStudiesUtils::makeTPaveTextBkgTransparent(*_numEntriesText);
+
+		if (_config._output == K3PiReportOutput::MultiPagePDF)
+		{
+			// "[" opens the file without drawing a page
+			_canvas->Print((_config._path + "[").c_str());
+		}
+		else
+		{
+			_file.reset(TFile::Open(_config._path.c_str(), "RECREATE"));
+			if (!_file || _file->IsZombie())
+			{
+				gROOT->SetBatch(_wasBatch);
+				throw std::runtime_error("K3PiComparisonReport: Could not create " + _config._path + ".");
+			}
+		}
+	}
+
+	K3PiComparisonReport::~K3PiComparisonReport()
+	{
+		try
+		{
+			close();
+		}
+		catch (const std::exception &e)
+		{
+			std::cout << "WARNING: K3PiComparisonReport could not close " << _config._path << ": " << e.what() << std::endl;
+		}
+	}
+
+	K3PiComparisonMetrics K3PiComparisonReport::computeMetrics(
+		const std::string &name,
+		std::size_t numBins,
+		const double *h1,
+		const double *h2)
+	{
+		K3PI_PROFILE_FUNCTION();
+		K3PiComparisonMetrics m;
+		m._name = name;
+		m._n1 = 0.0;
+		m._n2 = 0.0;
+		for (std::size_t b = 0; b < numBins; b++)
+		{
+			m._n1 += h1[b];
+			m._n2 += h2[b];
+		}
+
+		const double nan = std::numeric_limits<double>::quiet_NaN();
+		if (m._n1 <= 0.0 || m._n2 <= 0.0)
+		{
+			m._chi2 = nan;
+			m._ndf = 0;
+			m._chi2Prob = nan;
+			m._ksDistance = nan;
+			m._ksProb = nan;
+			m._maxAbsNormDiff = nan;
+			m._sumAbsNormDiff = nan;
+			return m;
+		}
+
+		// one pass for all of them
+		double chi2 = 0.0;
+		int numFilledBins = 0;
+		double cdf1 = 0.0;
+		double cdf2 = 0.0;
+		double ksDistance = 0.0;
+		double maxAbsNormDiff = 0.0;
+		double sumAbsNormDiff = 0.0;
+		for (std::size_t b = 0; b < numBins; b++)
+		{
+			const double sum = h1[b] + h2[b];
+			if (sum > 0.0)
+			{
+				const double diff = m._n2 * h1[b] - m._n1 * h2[b];
+				chi2 += diff * diff / sum;
+				numFilledBins++;
+			}
+
+			const double norm1 = h1[b] / m._n1;
+			const double norm2 = h2[b] / m._n2;
+			const double absNormDiff = std::abs(norm1 - norm2);
+			maxAbsNormDiff = std::max(maxAbsNormDiff, absNormDiff);
+			sumAbsNormDiff += absNormDiff;
+
+			cdf1 += norm1;
+			cdf2 += norm2;
+			ksDistance = std::max(ksDistance, std::abs(cdf1 - cdf2));
+		}
+
+		m._chi2 = chi2 / (m._n1 * m._n2);
+		m._ndf = numFilledBins - 1;
+		m._chi2Prob = m._ndf > 0 ? TMath::Prob(m._chi2, m._ndf) : nan;
+		m._ksDistance = ksDistance;
+		m._ksProb = TMath::KolmogorovProb(ksDistance * std::sqrt(m._n1 * m._n2 / (m._n1 + m._n2)));
+		m._maxAbsNormDiff = maxAbsNormDiff;
+		m._sumAbsNormDiff = sumAbsNormDiff;
+		return m;
+	}
+
+	K3PiComparisonMetrics K3PiComparisonReport::computeMetrics(const std::string &name, const TH1 &h1, const TH1 &h2)
+	{
+		K3PI_PROFILE_FUNCTION();
+		if (h1.GetNbinsX() != h2.GetNbinsX())
+		{
+			throw std::invalid_argument("K3PiComparisonReport::computeMetrics: " + name + " histograms have different numbers of bins.");
+		}
+
+		const std::vector<double> contents1 = binContents(h1);
+		const std::vector<double> contents2 = binContents(h2);
+		return computeMetrics(name, contents1.size(), contents1.data(), contents2.data());
+	}
+
+	const K3PiComparisonMetrics &K3PiComparisonReport::add(
+		const std::string &name,
+		const TH1 &h1,
+		const TH1 &h2,
+		const TString &legLine1,
+		const TString &legLine2)
+	{
+		K3PI_PROFILE_FUNCTION();
+		if (!_isOpen)
+		{
+			throw std::logic_error("K3PiComparisonReport::add: The report was already closed.");
+		}
+
+		_metrics.push_back(computeMetrics(name, h1, h2));
+
+		// same test computeMetrics uses for its NaN results, so a pair is skipped exactly when its metrics are NaN
+		const K3PiComparisonMetrics &m = _metrics.back();
+		if (m._n1 <= 0.0 || m._n2 <= 0.0)
+		{
+			std::cout << "WARNING: For " << name << ", h1 or h2 has nothing in its in-range bins. Cannot make comparison histogram!" << std::endl;
+		}
+		else if (_config._output != K3PiReportOutput::MetricsOnly)
+		{
+			draw(name, h1, h2, legLine1, legLine2);
+		}
+		return _metrics.back();
+	}
+
+	void K3PiComparisonReport::draw(
+		const std::string &name,
+		const TH1 &h1,
+		const TH1 &h2,
+		const TString &legLine1,
+		const TString &legLine2)
+	{
+		std::unique_ptr<TH1> norm1 = normalizedClone(h1, (name + "_1").c_str());
+		std::unique_ptr<TH1> norm2 = normalizedClone(h2, (name + "_2").c_str());
+
+		if (_config._updateYLabel)
+		{
+			const TString updatedYLabel = K3PiStudiesUtils::makeYAxisLabel(
+				norm1->GetNbinsX(), norm1->GetXaxis()->GetXmin(), norm1->GetXaxis()->GetXmax(), _config._unit, true);
+			norm1->SetYTitle(updatedYLabel);
+			norm2->SetYTitle(updatedYLabel);
+		}
+
+		K3PiStudiesUtils::adjustYAxisForCompare(norm1.get(), norm2.get());
+
+		_canvas->Clear();
+		_canvas->cd();
+
+		norm1->SetLineColor(kBlue);
+		norm1->SetLineWidth(2);
+		norm1->Draw("HIST");
+
+		norm2->SetLineColor(kRed + 1);
+		norm2->SetLineWidth(2);
+		norm2->Draw("HIST SAME");
+
+		_legend->Clear();
+		_legend->AddEntry(norm1.get(), legLine1, "L");
+		_legend->AddEntry(norm2.get(), legLine2, "L");
+		_legend->Draw("SAME");
+
+		if (_config._addNumEntries)
+		{
+			_numEntriesText->Clear();
+			_numEntriesText->AddText("n(" + legLine1 + ") = " + TString(std::to_string((unsigned int)h1.GetEntries())));
+			_numEntriesText->AddText("n(" + legLine2 + ") = " + TString(std::to_string((unsigned int)h2.GetEntries())));
+			_numEntriesText->Draw("SAME");
+		}
+
+		if (_config._output == K3PiReportOutput::MultiPagePDF)
+		{
+			_canvas->Print(_config._path.c_str(), ("Title:" + name).c_str());
+		}
+		else
+		{
+			_canvas->SetName(name.c_str());
+			_file->WriteObject(_canvas.get(), name.c_str());
+		}
+
+		// the canvas must not point at the clones once they are gone
+		_canvas->Clear();
+	}
+
+	const std::vector<K3PiComparisonMetrics> &K3PiComparisonReport::metrics() const
+	{
+		return _metrics;
+	}
+
+	void K3PiComparisonReport::writeMetricsCSV(const std::string &path) const
+	{
+		K3PI_PROFILE_FUNCTION();
+		std::ofstream out(path);
+		if (!out)
+		{
+			throw std::runtime_error("K3PiComparisonReport::writeMetricsCSV: Could not create " + path + ".");
+		}
+
+		out.precision(10);
+		out << "name,n1,n2,chi2,ndf,chi2Prob,ksDistance,ksProb,maxAbsNormDiff,sumAbsNormDiff\n";
+		for (const K3PiComparisonMetrics &m : _metrics)
+		{
+			out << m._name << "," << m._n1 << "," << m._n2 << "," << m._chi2 << "," << m._ndf << "," << m._chi2Prob << ","
+				<< m._ksDistance << "," << m._ksProb << "," << m._maxAbsNormDiff << "," << m._sumAbsNormDiff << "\n";
+		}
+	}
+
+	void K3PiComparisonReport::close()
+	{
+		K3PI_PROFILE_FUNCTION();
+		if (!_isOpen)
+		{
+			return;
+		}
+		_isOpen = false;
+
+		if (_config._output == K3PiReportOutput::MetricsOnly)
+		{
+			return;
+		}
+
+		if (_config._output == K3PiReportOutput::MultiPagePDF)
+		{
+			// "]" closes the file without drawing a page
+			_canvas->Print((_config._path + "]").c_str());
+		}
+		else
+		{
+			_file->Close();
+		}
+		gROOT->SetBatch(_wasBatch);
+	}
+
+} // end namespace K3PiStudies
@@ -0,0 +1,424 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "K3PiEventFile.h"
+
+namespace K3PiStudies
+{
+	namespace
+	{
+		constexpr char _EVENT_FILE_MAGIC[8] = {'K', '3', 'P', 'i', 'E', 'v', 't', 's'};
+		// 2: convertTree stores D0 rest frame momenta (version 1 ones stored the lab frame momenta as read)
+		constexpr std::uint32_t _EVENT_FILE_VERSION = 2;
+		constexpr std::uint64_t _ARRAY_ALIGNMENT = 64;
+		constexpr int _NUM_ARRAYS = 4 * K3PiEvent_NumComponents;
+
+		// block size for the float -> double conversion in calc_phsp, small enough to stay in L1/L2
+		constexpr std::size_t _CONVERT_BLOCK_SIZE = 256;
+
+		// on disk layout of the event file header
+		struct EventFileHeader
+		{
+			char _magic[8];
+			std::uint32_t _version;
+			std::uint32_t _headerSize;
+			std::uint64_t _numEvents;
+			std::uint64_t _arrayStride; // bytes from the start of one momentum array to the next
+			std::uint8_t _units;
+			std::uint8_t _precision;
+			std::uint8_t _perEventFlags;
+			std::uint8_t _isD0;
+			std::uint8_t _isRS;
+			char _reserved[91];
+		};
+		static_assert(sizeof(EventFileHeader) == 128, "EventFileHeader must stay 128 bytes");
+
+		std::uint64_t arrayStride(std::uint64_t numEvents, K3PiEventPrecision precision)
+		{
+			const std::uint64_t bytes = numEvents * (precision == K3PiEventPrecision::Float ? sizeof(float) : sizeof(double));
+			return (bytes + _ARRAY_ALIGNMENT - 1) / _ARRAY_ALIGNMENT * _ARRAY_ALIGNMENT;
+		}
+
+		std::uint64_t expectedFileSize(const EventFileHeader &header)
+		{
+			return sizeof(EventFileHeader) + _NUM_ARRAYS * header._arrayStride + (header._perEventFlags ? header._numEvents : 0);
+		}
+
+		constexpr std::uint8_t _IS_D0_BIT = 1;
+		constexpr std::uint8_t _IS_RS_BIT = 2;
+	} // end anonymous namespace
+
+	K3PiEventFile::K3PiEventFile(const std::string &path)
+	{
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			throw std::runtime_error("K3PiEventFile: Could not open " + path + ".");
+		}
+
+		struct stat st;
+		if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(EventFileHeader)))
+		{
+			::close(fd);
+			throw std::runtime_error("K3PiEventFile: " + path + " is too small to be an event file.");
+		}
+
+		_mapSize = st.st_size;
+		_map = ::mmap(nullptr, _mapSize, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (_map == MAP_FAILED)
+		{
+			_map = nullptr;
+			throw std::runtime_error("K3PiEventFile: Could not map " + path + ".");
+		}
+
+		EventFileHeader header;
+		std::memcpy(&header, _map, sizeof(header));
+		const bool isEventFile = std::memcmp(header._magic, _EVENT_FILE_MAGIC, sizeof(_EVENT_FILE_MAGIC)) == 0 &&
+								 header._version == _EVENT_FILE_VERSION &&
+								 header._headerSize == sizeof(EventFileHeader) &&
+								 header._units <= static_cast<std::uint8_t>(K3PiEventUnits::GeV) &&
+								 header._precision <= static_cast<std::uint8_t>(K3PiEventPrecision::Double) &&
+								 header._arrayStride == arrayStride(header._numEvents, static_cast<K3PiEventPrecision>(header._precision)) &&
+								 _mapSize == expectedFileSize(header);
+		if (!isEventFile)
+		{
+			unmap();
+			throw std::runtime_error("K3PiEventFile: " + path + " is not a version " + std::to_string(_EVENT_FILE_VERSION) + " event file.");
+		}
+
+		_numEvents = header._numEvents;
+		_arrayStride = header._arrayStride;
+		_units = static_cast<K3PiEventUnits>(header._units);
+		_precision = static_cast<K3PiEventPrecision>(header._precision);
+		_isD0 = header._isD0;
+		_isRS = header._isRS;
+		if (header._perEventFlags)
+		{
+			_flags = static_cast<const std::uint8_t *>(_map) + sizeof(EventFileHeader) + _NUM_ARRAYS * _arrayStride;
+		}
+	}
+
+	K3PiEventFile::K3PiEventFile(K3PiEventFile &&moveMe) noexcept
+		: _map(moveMe._map),
+		  _mapSize(moveMe._mapSize),
+		  _numEvents(moveMe._numEvents),
+		  _arrayStride(moveMe._arrayStride),
+		  _units(moveMe._units),
+		  _precision(moveMe._precision),
+		  _isD0(moveMe._isD0),
+		  _isRS(moveMe._isRS),
+		  _flags(moveMe._flags)
+	{
+		moveMe._map = nullptr;
+		moveMe._mapSize = 0;
+		moveMe._numEvents = 0;
+		moveMe._flags = nullptr;
+	}
+
+	K3PiEventFile &K3PiEventFile::operator=(K3PiEventFile &&moveMe) noexcept
+	{
+		if (this != &moveMe)
+		{
+			unmap();
+			std::swap(_map, moveMe._map);
+			std::swap(_mapSize, moveMe._mapSize);
+			std::swap(_numEvents, moveMe._numEvents);
+			std::swap(_flags, moveMe._flags);
+			_arrayStride = moveMe._arrayStride;
+			_units = moveMe._units;
+			_precision = moveMe._precision;
+			_isD0 = moveMe._isD0;
+			_isRS = moveMe._isRS;
+		}
+		return *this;
+	}
+
+	K3PiEventFile::~K3PiEventFile()
+	{
+		unmap();
+	}
+
+	void K3PiEventFile::unmap()
+	{
+		if (_map)
+		{
+			::munmap(_map, _mapSize);
+		}
+		_map = nullptr;
+		_mapSize = 0;
+		_numEvents = 0;
+		_flags = nullptr;
+	}
+
+	void K3PiEventFile::write(ROOT::RDF::RNode df, const std::vector<std::string> &p4Columns, const std::string &path, const K3PiEventFileConfig &config)
+	{
+		if (p4Columns.size() != _NUM_ARRAYS)
+		{
+			throw std::invalid_argument("K3PiEventFile::write: Expected " + std::to_string(_NUM_ARRAYS) + " momentum columns, got " +
+										std::to_string(p4Columns.size()) + ".");
+		}
+
+		const bool perEventFlags = !config._isD0Column.empty() && !config._isRSColumn.empty();
+
+		// book everything before running, so it is a single event loop (which also keeps the columns in the same order with implicit MT)
+		std::vector<ROOT::RDF::RResultPtr<std::vector<double>>> momenta;
+		for (const std::string &col : p4Columns)
+		{
+			momenta.push_back(df.Take<double>(col));
+		}
+		ROOT::RDF::RResultPtr<std::vector<bool>> isD0, isRS;
+		if (perEventFlags)
+		{
+			isD0 = df.Take<bool>(config._isD0Column);
+			isRS = df.Take<bool>(config._isRSColumn);
+		}
+
+		std::vector<const double *> p4Values;
+		for (ROOT::RDF::RResultPtr<std::vector<double>> &col : momenta)
+		{
+			p4Values.push_back(col->data());
+		}
+
+		write(path, momenta[0]->size(), p4Values, perEventFlags ? *isD0 : std::vector<bool>(), perEventFlags ? *isRS : std::vector<bool>(), config);
+	}
+
+	void K3PiEventFile::write(
+		const std::string &path,
+		std::uint64_t numEvents,
+		const std::vector<const double *> &p4Columns,
+		const std::vector<bool> &isD0,
+		const std::vector<bool> &isRS,
+		const K3PiEventFileConfig &config)
+	{
+		if (p4Columns.size() != _NUM_ARRAYS)
+		{
+			throw std::invalid_argument("K3PiEventFile::write: Expected " + std::to_string(_NUM_ARRAYS) + " momentum columns, got " +
+										std::to_string(p4Columns.size()) + ".");
+		}
+
+		const bool perEventFlags = !isD0.empty() || !isRS.empty();
+		if (perEventFlags && (isD0.size() != numEvents || isRS.size() != numEvents))
+		{
+			throw std::invalid_argument("K3PiEventFile::write: The isD0 / isRS flags must be empty or have numEvents entries.");
+		}
+
+		EventFileHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header._magic, _EVENT_FILE_MAGIC, sizeof(_EVENT_FILE_MAGIC));
+		header._version = _EVENT_FILE_VERSION;
+		header._headerSize = sizeof(EventFileHeader);
+		header._numEvents = numEvents;
+		header._arrayStride = arrayStride(numEvents, config._precision);
+		header._units = static_cast<std::uint8_t>(config._units);
+		header._precision = static_cast<std::uint8_t>(config._precision);
+		header._perEventFlags = perEventFlags;
+		header._isD0 = config._isD0;
+		header._isRS = config._isRS;
+
+		// a fresh name for every write, also when jobs on several hosts write to the same directory
+		std::string tmpPath = path + ".tmpXXXXXX";
+		const int fd = ::mkstemp(&tmpPath[0]);
+		if (fd < 0)
+		{
+			throw std::runtime_error("K3PiEventFile::write: Could not create a temporary file for " + path + ".");
+		}
+		// mkstemp makes the file readable by its owner only; event files are read by other jobs and users
+		::fchmod(fd, 0644);
+
+		std::FILE *out = ::fdopen(fd, "wb");
+		if (!out)
+		{
+			::close(fd);
+			std::remove(tmpPath.c_str());
+			throw std::runtime_error("K3PiEventFile::write: Could not write " + tmpPath + ".");
+		}
+
+		bool written = true;
+		const auto writeBytes = [&](const void *data, std::size_t bytes)
+		{
+			written = written && std::fwrite(data, 1, bytes, out) == bytes;
+		};
+
+		writeBytes(&header, sizeof(header));
+
+		const std::vector<char> padding(_ARRAY_ALIGNMENT, 0);
+		for (const double *col : p4Columns)
+		{
+			std::uint64_t bytes;
+			if (config._precision == K3PiEventPrecision::Float)
+			{
+				const std::vector<float> asFloat(col, col + numEvents);
+				bytes = asFloat.size() * sizeof(float);
+				writeBytes(asFloat.data(), bytes);
+			}
+			else
+			{
+				bytes = numEvents * sizeof(double);
+				writeBytes(col, bytes);
+			}
+			writeBytes(padding.data(), header._arrayStride - bytes);
+		}
+
+		if (perEventFlags)
+		{
+			std::vector<std::uint8_t> flags(numEvents);
+			for (std::uint64_t i = 0; i < numEvents; i++)
+			{
+				flags[i] = (isD0[i] ? _IS_D0_BIT : 0) | (isRS[i] ? _IS_RS_BIT : 0);
+			}
+			writeBytes(flags.data(), flags.size());
+		}
+
+		// a failed close can also lose data, so it is checked before the file replaces a good one
+		written = std::fclose(out) == 0 && written;
+		if (!written)
+		{
+			std::remove(tmpPath.c_str());
+			throw std::runtime_error("K3PiEventFile::write: Could not write " + tmpPath + ".");
+		}
+
+		if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+		{
+			std::remove(tmpPath.c_str());
+			throw std::runtime_error("K3PiEventFile::write: Could not rename " + tmpPath + " to " + path + ".");
+		}
+	}
+
+	void K3PiEventFile::convertTree(
+		const std::vector<std::string> &inputFiles,
+		const std::string &treeName,
+		const K3PiColumnConfig &columnConfig,
+		const std::string &path,
+		K3PiEventFileConfig config)
+	{
+		ROOT::RDataFrame df(treeName, inputFiles);
+		ROOT::RDF::RNode withK3Pi = K3PiRDFPipeline::defineK3PiColumns(df, columnConfig);
+
+		const std::string &pre = columnConfig._outPrefix;
+		withK3Pi = withK3Pi.Filter([](bool isValidDecay) { return isValidDecay; }, {pre + "isValidDecay"});
+
+		std::vector<std::string> p4Columns;
+		for (const std::string &role : K3PiRDFPipeline::_ROLE_NAMES)
+		{
+			for (const char *comp : {"_PX_D0CM", "_PY_D0CM", "_PZ_D0CM", "_PE_D0CM"})
+			{
+				p4Columns.push_back(pre + role + comp);
+			}
+		}
+
+		if (!columnConfig._dstPiIDColumn.empty())
+		{
+			config._isD0Column = pre + "isD0";
+			config._isRSColumn = pre + "isRS";
+		}
+
+		write(withK3Pi, p4Columns, path, config);
+	}
+
+	std::uint64_t K3PiEventFile::numEvents() const
+	{
+		return _numEvents;
+	}
+
+	K3PiEventUnits K3PiEventFile::units() const
+	{
+		return _units;
+	}
+
+	K3PiEventPrecision K3PiEventFile::precision() const
+	{
+		return _precision;
+	}
+
+	bool K3PiEventFile::hasPerEventFlags() const
+	{
+		return _flags != nullptr;
+	}
+
+	bool K3PiEventFile::isD0(std::uint64_t event) const
+	{
+		return _flags ? (_flags[event] & _IS_D0_BIT) : _isD0;
+	}
+
+	bool K3PiEventFile::isRS(std::uint64_t event) const
+	{
+		return _flags ? (_flags[event] & _IS_RS_BIT) : _isRS;
+	}
+
+	const void *K3PiEventFile::array(K3Pi_Roles role, K3PiEvent_Components comp) const
+	{
+		return static_cast<const char *>(_map) + sizeof(EventFileHeader) + (role * K3PiEvent_NumComponents + comp) * _arrayStride;
+	}
+
+	const double *K3PiEventFile::column(K3Pi_Roles role, K3PiEvent_Components comp) const
+	{
+		if (_precision != K3PiEventPrecision::Double)
+		{
+			throw std::logic_error("K3PiEventFile::column: The file is stored in float precision, use floatColumn.");
+		}
+		return static_cast<const double *>(array(role, comp));
+	}
+
+	const float *K3PiEventFile::floatColumn(K3Pi_Roles role, K3PiEvent_Components comp) const
+	{
+		if (_precision != K3PiEventPrecision::Float)
+		{
+			throw std::logic_error("K3PiEventFile::floatColumn: The file is stored in double precision, use column.");
+		}
+		return static_cast<const float *>(array(role, comp));
+	}
+
+	P4Columns K3PiEventFile::p4Columns(K3Pi_Roles role) const
+	{
+		return {column(role, K3PiEvent_PX), column(role, K3PiEvent_PY), column(role, K3PiEvent_PZ), column(role, K3PiEvent_PE)};
+	}
+
+	void K3PiEventFile::calc_phsp(const Phsp4BodyColumns &phsp) const
+	{
+		if (_precision == K3PiEventPrecision::Double)
+		{
+			K3PiStudiesUtils::calc_phsp_batch(_numEvents, p4Columns(K3Pi_Kaon), p4Columns(K3Pi_OSPion1), p4Columns(K3Pi_SSPion), p4Columns(K3Pi_OSPion2), phsp);
+		}
+		else
+		{
+			std::vector<double> block(_NUM_ARRAYS * _CONVERT_BLOCK_SIZE);
+			auto blockColumns = [&block](int role)
+			{
+				const double *p = block.data() + role * K3PiEvent_NumComponents * _CONVERT_BLOCK_SIZE;
+				return P4Columns{p, p + _CONVERT_BLOCK_SIZE, p + 2 * _CONVERT_BLOCK_SIZE, p + 3 * _CONVERT_BLOCK_SIZE};
+			};
+
+			for (std::uint64_t begin = 0; begin < _numEvents; begin += _CONVERT_BLOCK_SIZE)
+			{
+				const std::size_t n = std::min<std::uint64_t>(_CONVERT_BLOCK_SIZE, _numEvents - begin);
+				for (int a = 0; a < _NUM_ARRAYS; a++)
+				{
+					const float *in = static_cast<const float *>(array(static_cast<K3Pi_Roles>(a / K3PiEvent_NumComponents), static_cast<K3PiEvent_Components>(a % K3PiEvent_NumComponents))) + begin;
+					std::copy(in, in + n, block.begin() + a * _CONVERT_BLOCK_SIZE);
+				}
+
+				const Phsp4BodyColumns out = {phsp._m12_MeV + begin, phsp._m34_MeV + begin, phsp._cos12 + begin, phsp._cos34 + begin, phsp._phi_rad + begin};
+				K3PiStudiesUtils::calc_phsp_batch(n, blockColumns(K3Pi_Kaon), blockColumns(K3Pi_OSPion1), blockColumns(K3Pi_SSPion), blockColumns(K3Pi_OSPion2), out);
+			}
+		}
+
+		// the masses come out in the units of the inputs, the angles don't depend on them
+		if (_units == K3PiEventUnits::GeV)
+		{
+			for (std::uint64_t i = 0; i < _numEvents; i++)
+			{
+				phsp._m12_MeV[i] *= K3PiStudiesUtils::_GEV_TO_MEV;
+				phsp._m34_MeV[i] *= K3PiStudiesUtils::_GEV_TO_MEV;
+			}
+		}
+	}
+
+} // end namespace K3PiStudies
@@ -0,0 +1,245 @@
+#include <cmath>
+#include <stdexcept>
+
+#include "K3PiFastMath.h"
+#include "K3PiKinematicsKernels.h"
+
+namespace K3PiStudies
+{
+	namespace
+	{
+		constexpr float _PI_F = 3.14159265358979f;
+		constexpr float _HALF_PI_F = 1.57079632679490f;
+
+		// atan on [-1, 1], Abramowitz & Stegun 4.4.49
+		inline float atanUnit(float x)
+		{
+			const float x2 = x * x;
+			return x * (1.0f + x2 * (-0.3333314528f + x2 * (0.1999355085f + x2 * (-0.1420889944f + x2 * (0.1065626393f + x2 * (-0.0752896400f + x2 * (0.0429096138f + x2 * (-0.0161657367f + x2 * 0.0028662257f))))))));
+		}
+
+		// branch-free so the loops using it still vectorize
+		inline float fastAtan2(float y, float x)
+		{
+			const float ax = std::fabs(x);
+			const float ay = std::fabs(y);
+			const float mx = ax > ay ? ax : ay;
+			const float mn = ax > ay ? ay : ax;
+			float a = atanUnit(mx > 0.0f ? mn / mx : 0.0f);
+			a = ay > ax ? _HALF_PI_F - a : a;
+			a = x < 0.0f ? _PI_F - a : a;
+			return y < 0.0f ? -a : a;
+		}
+
+		// acos on [-1, 1], Abramowitz & Stegun 4.4.46; 1 - |x| is taken before rounding x to float, which keeps small angles accurate
+		inline float fastAcos(double x)
+		{
+			x = x > 1.0 ? 1.0 : (x < -1.0 ? -1.0 : x);
+			const float oneMinusAx = 1.0 - std::fabs(x);
+			const float ax = std::fabs(x);
+			const float a = std::sqrt(oneMinusAx) * (1.5707963050f + ax * (-0.2145988016f + ax * (0.0889789874f + ax * (-0.0501743046f + ax * (0.0308918810f + ax * (-0.0170881256f + ax * (0.0066700901f + ax * (-0.0012624911f))))))));
+			return x < 0.0 ? _PI_F - a : a;
+		}
+
+		// atan2 of the angle between the decay planes with normals n1, n2; sinPhi and cosPhi only need to be right up to a common positive factor
+		float planeAngle(const detail::Vec3 &n1, const detail::Vec3 &n2, const detail::Vec3 &axis)
+		{
+			return fastAtan2(float(detail::dot(detail::cross(n1, n2), axis)), float(detail::dot(n1, n2) * detail::mag(axis)));
+		}
+
+		/**
+		 * cos of the soft pion helicity angle, from the invariants of the D* = D0 + pis system in the lab
+		 * (see detail::helicityCosFromInvariants, with the lab frame playing the role of the parent).
+		 * The lab frame products are taken in double: in float, E(D0) E(pis) - p(D0).p(pis) would lose all precision for boosted D*s.
+		 */
+		double softPiHelicityCos(float d0_px, float d0_py, float d0_pz, float d0_m, float pis_px, float pis_py, float pis_pz, float pis_m)
+		{
+			const detail::Vec4 d0 = detail::fromXYZM(d0_px, d0_py, d0_pz, d0_m);
+			const detail::Vec4 pis = detail::fromXYZM(pis_px, pis_py, pis_pz, pis_m);
+			const detail::Vec4 dstar = detail::add(d0, pis);
+
+			const double d0M2 = double(d0_m) * d0_m;
+			const double pisM2 = double(pis_m) * pis_m;
+			const double d0DotPis = d0._t * pis._t - detail::dot(detail::vect(d0), detail::vect(pis));
+			const double dstarM2 = d0M2 + pisM2 + 2.0 * d0DotPis;
+
+			return detail::helicityCosFromInvariants(pis._t, dstar, dstarM2, pisM2, d0M2);
+		}
+	} // end anonymous namespace
+
+	float K3PiFastMath::atan2(float y, float x)
+	{
+		return fastAtan2(y, x);
+	}
+
+	float K3PiFastMath::acos(float x)
+	{
+		return fastAcos(x);
+	}
+
+	float K3PiFastMath::sqrt(float x)
+	{
+		return std::sqrt(x);
+	}
+
+	float K3PiFastMath::changeAngleRange_0_to_2pi(float angle_neg_pi_to_pi)
+	{
+		return angle_neg_pi_to_pi < 0.0f ? angle_neg_pi_to_pi + 2.0f * _PI_F : angle_neg_pi_to_pi;
+	}
+
+	float K3PiFastMath::changeAngleRange_neg_pi_to_pi(float angle_0_to_2pi)
+	{
+		return angle_0_to_2pi > _PI_F ? angle_0_to_2pi - 2.0f * _PI_F : angle_0_to_2pi;
+	}
+
+	float K3PiFastMath::angleBetweenDecayPlanesKutschke(
+		const TVector3 &d4_motherRestFrame,
+		const TVector3 &d5_motherRestFrame,
+		const TVector3 &d6_motherRestFrame,
+		const TVector3 &d7_motherRestFrame)
+	{
+		return angleBetweenDecayPlanesKutschke(
+			ROOT::Math::XYZVector(d4_motherRestFrame.X(), d4_motherRestFrame.Y(), d4_motherRestFrame.Z()),
+			ROOT::Math::XYZVector(d5_motherRestFrame.X(), d5_motherRestFrame.Y(), d5_motherRestFrame.Z()),
+			ROOT::Math::XYZVector(d6_motherRestFrame.X(), d6_motherRestFrame.Y(), d6_motherRestFrame.Z()),
+			ROOT::Math::XYZVector(d7_motherRestFrame.X(), d7_motherRestFrame.Y(), d7_motherRestFrame.Z()));
+	}
+
+	/**
+	 * Same as K3PiKinematics::angleBetweenDecayPlanesKutschke, without normalizing the normals and with the fast atan2
+	 */
+	float K3PiFastMath::angleBetweenDecayPlanesKutschke(
+		const ROOT::Math::XYZVector &d4_motherRestFrame,
+		const ROOT::Math::XYZVector &d5_motherRestFrame,
+		const ROOT::Math::XYZVector &d6_motherRestFrame,
+		const ROOT::Math::XYZVector &d7_motherRestFrame)
+	{
+		const detail::Vec3 d4 = detail::fromGenVector(d4_motherRestFrame);
+		const detail::Vec3 d5 = detail::fromGenVector(d5_motherRestFrame);
+		const detail::Vec3 d6 = detail::fromGenVector(d6_motherRestFrame);
+		const detail::Vec3 d7 = detail::fromGenVector(d7_motherRestFrame);
+
+		return planeAngle(detail::cross(d6, d7), detail::cross(d4, d5), detail::add(d4, d5));
+	}
+
+	/**
+	 * Same as K3PiKinematics::calc_phsp_point (D0 CM inputs) with the fast atan2. The cosines come from invariants
+	 * instead of boosts into the AB and CD rest frames, as in calc_phsp_point_fused.
+	 */
+	Phsp4BodyPoint K3PiFastMath::calc_phsp_point(
+		const ROOT::Math::PxPyPzEVector &pA_IN_D0CM, // K-
+		const ROOT::Math::PxPyPzEVector &pB_IN_D0CM, // OS pi 1
+		const ROOT::Math::PxPyPzEVector &pC_IN_D0CM, // SS pi
+		const ROOT::Math::PxPyPzEVector &pD_IN_D0CM) // OS pi 2
+	{
+		const detail::Vec4 pA = detail::fromGenVector(pA_IN_D0CM);
+		const detail::Vec4 pB = detail::fromGenVector(pB_IN_D0CM);
+		const detail::Vec4 pC = detail::fromGenVector(pC_IN_D0CM);
+		const detail::Vec4 pD = detail::fromGenVector(pD_IN_D0CM);
+
+		const detail::Vec4 pAB = detail::add(pA, pB);
+		const detail::Vec4 pCD = detail::add(pC, pD);
+		const double mAB = detail::invMass(pAB);
+		const double mCD = detail::invMass(pCD);
+
+		// both cosines are measured along zhat = AB direction, and the CD system moves along -zhat
+		const double cosThetaA = detail::helicityCosFromInvariants(pA._t, pAB, mAB * mAB, detail::mass2(pA), detail::mass2(pB));
+		const double cosThetaC = -detail::helicityCosFromInvariants(pC._t, pCD, mCD * mCD, detail::mass2(pC), detail::mass2(pD));
+
+		// xhat = yhat x zhat, so sinPhi = (yhat x zhat) . yhatPrime = (yhatPrime x yhat) . zhat
+		const detail::Vec3 yhat = detail::cross(detail::vect(pA), detail::vect(pB));
+		const detail::Vec3 yhatPrime = detail::cross(detail::vect(pC), detail::vect(pD));
+		const float phi = changeAngleRange_0_to_2pi(planeAngle(yhatPrime, yhat, detail::vect(pAB)));
+
+		return {mAB, mCD, cosThetaA, cosThetaC, phi};
+	}
+
+	/**
+	 * K3PiKinematics::calc_phsp_point_fused with the fast atan2
+	 */
+	Phsp4BodyPtEtaPhiPoint K3PiFastMath::calc_phsp_point(
+		double K_D0Fit_PT,
+		double K_D0Fit_ETA,
+		double K_D0Fit_PHI,
+		double Pi_SS_D0Fit_PT,
+		double Pi_SS_D0Fit_ETA,
+		double Pi_SS_D0Fit_PHI,
+		double Pi_OS1_D0Fit_PT,
+		double Pi_OS1_D0Fit_ETA,
+		double Pi_OS1_D0Fit_PHI,
+		double Pi_OS2_D0Fit_PT,
+		double Pi_OS2_D0Fit_ETA,
+		double Pi_OS2_D0Fit_PHI,
+		bool pi1GoesWithK)
+	{
+		const detail::Vec4 d2_ssPi = detail::fromPtEtaPhiM(Pi_SS_D0Fit_PT, Pi_SS_D0Fit_ETA, Pi_SS_D0Fit_PHI, K3PiKinematics::_PION_MASS);
+		const detail::Vec4 d3_k = detail::fromPtEtaPhiM(K_D0Fit_PT, K_D0Fit_ETA, K_D0Fit_PHI, K3PiKinematics::_KAON_MASS);
+		const detail::Vec4 osPi1 = detail::fromPtEtaPhiM(Pi_OS1_D0Fit_PT, Pi_OS1_D0Fit_ETA, Pi_OS1_D0Fit_PHI, K3PiKinematics::_PION_MASS);
+		const detail::Vec4 osPi2 = detail::fromPtEtaPhiM(Pi_OS2_D0Fit_PT, Pi_OS2_D0Fit_ETA, Pi_OS2_D0Fit_PHI, K3PiKinematics::_PION_MASS);
+
+		// figure out which pi to associate with k
+		const detail::Vec4 &d1_piGoesWithPi = pi1GoesWithK ? osPi2 : osPi1;
+		const detail::Vec4 &d4_piGoesWithK = pi1GoesWithK ? osPi1 : osPi2;
+
+		double m12, m34, cos1, cos2, m13, sinp, cosp;
+		detail::calcPhspPtEtaPhiFusedNoAtan2(d1_piGoesWithPi, d2_ssPi, d3_k, d4_piGoesWithK, m12, m34, cos1, cos2, m13, sinp, cosp);
+		const float phi = fastAtan2(float(sinp), float(cosp));
+
+		return {m12, m34, cos1, cos2, phi, m13, 0.0};
+	}
+
+	float K3PiFastMath::helicity_angle_func(
+		float d0_px,
+		float d0_py,
+		float d0_pz,
+		float d0_m,
+		float pis_px,
+		float pis_py,
+		float pis_pz,
+		float pis_m)
+	{
+		return fastAcos(softPiHelicityCos(d0_px, d0_py, d0_pz, d0_m, pis_px, pis_py, pis_pz, pis_m));
+	}
+
+	/**
+	 * helicity_angle_func for every D0 / soft pion candidate at once; with the polynomial acos there are no library calls left,
+	 * so the whole loop vectorizes
+	 */
+	ROOT::RVec<float> K3PiFastMath::helicity_angle_func(
+		const ROOT::RVec<float> &d0_px,
+		const ROOT::RVec<float> &d0_py,
+		const ROOT::RVec<float> &d0_pz,
+		const ROOT::RVec<float> &d0_m,
+		const ROOT::RVec<float> &pis_px,
+		const ROOT::RVec<float> &pis_py,
+		const ROOT::RVec<float> &pis_pz,
+		float pis_m)
+	{
+		const std::size_t n = d0_px.size();
+		for (std::size_t size : {d0_py.size(), d0_pz.size(), d0_m.size(), pis_px.size(), pis_py.size(), pis_pz.size()})
+		{
+			if (size != n)
+			{
+				throw std::invalid_argument("K3PiFastMath::helicity_angle_func: All RVec inputs must have the same size.");
+			}
+		}
+
+		ROOT::RVec<float> angles(n);
+		const float *d0PxData = d0_px.data();
+		const float *d0PyData = d0_py.data();
+		const float *d0PzData = d0_pz.data();
+		const float *d0MData = d0_m.data();
+		const float *pisPxData = pis_px.data();
+		const float *pisPyData = pis_py.data();
+		const float *pisPzData = pis_pz.data();
+		float *anglesData = angles.data();
+
+		K3PI_IVDEP
+		for (std::size_t i = 0; i < n; i++)
+		{
+			anglesData[i] = fastAcos(softPiHelicityCos(d0PxData[i], d0PyData[i], d0PzData[i], d0MData[i], pisPxData[i], pisPyData[i], pisPzData[i], pis_m));
+		}
+		return angles;
+	}
+
+} // end namespace K3PiStudies
@@ -0,0 +1,179 @@
+#include <stdexcept>
+
+#include <boost/algorithm/string.hpp>
+
+#include "K3PiHistSweep.h"
+#include "K3PiInstrumentation.h"
+
+namespace K3PiStudies
+{
+
+	K3PiHistGrid::K3PiHistGrid(const K3PiHistSweepConfig &config, const std::string &nameSuffix)
+		: _rsWsFlags(config._rsWsFlags),
+		  _regionFlags(config._regionFlags),
+		  _timeBins(K3PiStudiesUtils::makeTimeBins(config._upperTimeBinEdges))
+	{
+		// the histograms are owned here, keep them out of gDirectory
+		const bool addDirStatus = TH1::AddDirectoryStatus();
+		TH1::AddDirectory(false);
+
+		_hists.reserve(_rsWsFlags.size() * _regionFlags.size() * _timeBins.size());
+		for (const std::string &flag : _rsWsFlags)
+		{
+			for (const std::string &region : _regionFlags)
+			{
+				for (std::size_t t = 0; t < _timeBins.size(); t++)
+				{
+					const std::string name = config._histNamePrefix + "_" + flag + "_" + region + "_t" + std::to_string(t) + nameSuffix;
+					_hists.push_back(std::make_unique<TH1D>(name.c_str(), config._histTitle.c_str(), config._nBins, config._xMin, config._xMax));
+				}
+			}
+		}
+
+		TH1::AddDirectory(addDirStatus);
+	}
+
+	std::size_t K3PiHistGrid::flatIndex(std::size_t flagInd, std::size_t regionInd, std::size_t timeBin) const
+	{
+		return (flagInd * _regionFlags.size() + regionInd) * _timeBins.size() + timeBin;
+	}
+
+	TH1D &K3PiHistGrid::get(std::size_t flagInd, std::size_t regionInd, std::size_t timeBin)
+	{
+		return *_hists.at(flatIndex(flagInd, regionInd, timeBin));
+	}
+
+	const TH1D &K3PiHistGrid::get(std::size_t flagInd, std::size_t regionInd, std::size_t timeBin) const
+	{
+		return *_hists.at(flatIndex(flagInd, regionInd, timeBin));
+	}
+
+	void K3PiHistGrid::add(const K3PiHistGrid &other)
+	{
+		if (other._hists.size() != _hists.size())
+		{
+			throw std::invalid_argument("K3PiHistGrid::add: Grids have different sizes.");
+		}
+
+		for (std::size_t i = 0; i < _hists.size(); i++)
+		{
+			_hists[i]->Add(other._hists[i].get());
+		}
+	}
+
+	const std::vector<std::string> &K3PiHistGrid::rsWsFlags() const
+	{
+		return _rsWsFlags;
+	}
+
+	const std::vector<std::string> &K3PiHistGrid::regionFlags() const
+	{
+		return _regionFlags;
+	}
+
+	const std::vector<std::pair<double, double>> &K3PiHistGrid::timeBins() const
+	{
+		return _timeBins;
+	}
+
+	std::size_t K3PiHistGrid::size() const
+	{
+		return _hists.size();
+	}
+
+	K3PiHistSweepHelper::K3PiHistSweepHelper(const K3PiHistSweepConfig &config, unsigned int nSlots)
+		: _result(std::make_shared<K3PiHistGrid>(config, "")),
+		  _classifier(config._regionFlags, config._upperTimeBinEdges)
+	{
+		for (const std::string &flag : config._rsWsFlags)
+		{
+			const bool isRSFlag = boost::iequals(flag, K3PiStudiesUtils::_RS_FLAG);
+			const bool isWSFlag = boost::iequals(flag, K3PiStudiesUtils::_WS_FLAG);
+			const bool isBothFlag = boost::iequals(flag, K3PiStudiesUtils::_BOTH_FLAG);
+			if (!isRSFlag && !isWSFlag && !isBothFlag)
+			{
+				throw std::invalid_argument("K3PiHistSweepHelper: Unknown RS/WS flag " + flag + ".");
+			}
+
+			_flagTakesRS.push_back(isRSFlag || isBothFlag);
+			_flagTakesWS.push_back(isWSFlag || isBothFlag);
+		}
+
+		for (unsigned int s = 1; s < nSlots; s++)
+		{
+			_slotGrids.push_back(std::make_unique<K3PiHistGrid>(config, "_slot" + std::to_string(s)));
+		}
+	}
+
+	std::shared_ptr<K3PiHistGrid> K3PiHistSweepHelper::GetResultPtr() const
+	{
+		return _result;
+	}
+
+	void K3PiHistSweepHelper::Initialize()
+	{
+	}
+
+	void K3PiHistSweepHelper::InitTask(TTreeReader *, unsigned int)
+	{
+	}
+
+	void K3PiHistSweepHelper::Exec(unsigned int slot, double value, double d0MassMeV, double deltaMMeV, double decayTime, bool isRS)
+	{
+		K3PiHistGrid &grid = (slot == 0) ? *_result : *_slotGrids[slot - 1];
+
+		// NaN or +inf decay time, not in any bin
+		const int timeBin = _classifier.timeBin(decayTime);
+		if (timeBin < 0)
+		{
+			return;
+		}
+
+		const std::uint32_t regionMask = _classifier.regionMask(d0MassMeV, deltaMMeV);
+		for (std::size_t f = 0; f < _flagTakesRS.size(); f++)
+		{
+			if (isRS ? !_flagTakesRS[f] : !_flagTakesWS[f])
+			{
+				continue;
+			}
+
+			for (std::size_t r = 0; r < _classifier.numRegions(); r++)
+			{
+				if (regionMask & (std::uint32_t(1) << r))
+				{
+					grid.get(f, r, timeBin).Fill(value);
+				}
+			}
+		}
+	}
+
+	void K3PiHistSweepHelper::Finalize()
+	{
+		K3PI_PROFILE_FUNCTION();
+		for (const std::unique_ptr<K3PiHistGrid> &slotGrid : _slotGrids)
+		{
+			_result->add(*slotGrid);
+		}
+		_slotGrids.clear();
+	}
+
+	std::string K3PiHistSweepHelper::GetActionName() const
+	{
+		return "K3PiHistSweep";
+	}
+
+	/**
+	 * Fills every histogram of the sweep in a single (multithreaded, if ROOT::EnableImplicitMT was called before building df) pass,
+	 * instead of one event loop per (flag, region, time bin).
+	 */
+	ROOT::RDF::RResultPtr<K3PiHistGrid> K3PiHistSweep::book(ROOT::RDF::RNode df, const K3PiHistSweepConfig &config)
+	{
+		// the number of slots df's event loop runs with (1 without implicit MT)
+		const unsigned int nSlots = df.GetNSlots();
+
+		return df.Book<double, double, double, double, bool>(
+			K3PiHistSweepHelper(config, nSlots),
+			{config._valueColumn, config._d0MassMeVColumn, config._deltaMMeVColumn, config._decayTimeColumn, config._isRSColumn});
+	}
+
+} // end namespace K3PiStudies
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <vector>
+
+#include "K3PiInstrumentation.h"
+
+namespace K3PiStudies
+{
+#ifdef K3PI_INSTRUMENTATION
+	namespace
+	{
+		struct ProbeTotals
+		{
+			std::string _name;
+			std::uint64_t _calls;
+			double _totalNs;
+		};
+
+		class Registry final
+		{
+		public:
+			static Registry &instance()
+			{
+				// never destroyed, so threads still running at exit can keep writing their counters
+				static Registry *registry = new Registry();
+				return *registry;
+			}
+
+			int registerProbe(const char *name)
+			{
+				const std::string shortName = shorten(name);
+
+				std::lock_guard<std::mutex> lock(_mutex);
+				const auto it = std::find(_names.begin(), _names.end(), shortName);
+				if (it != _names.end())
+				{
+					return int(it - _names.begin());
+				}
+
+				// the last slot collects everything past the limit
+				if (_names.size() == detail::_MAX_PROBES - 1)
+				{
+					_names.push_back("(other probes)");
+				}
+				if (_names.size() >= detail::_MAX_PROBES)
+				{
+					return detail::_MAX_PROBES - 1;
+				}
+
+				_names.push_back(shortName);
+				return int(_names.size() - 1);
+			}
+
+			detail::ThreadCounters *registerThread()
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_threads.push_back(std::make_unique<detail::ThreadCounters>());
+				return _threads.back().get();
+			}
+
+			// summed over threads, in registration order
+			std::vector<ProbeTotals> totals()
+			{
+				const double nsPerTick = 1.0 / ticksPerNs();
+
+				std::lock_guard<std::mutex> lock(_mutex);
+				std::vector<ProbeTotals> result;
+				for (std::size_t p = 0; p < _names.size(); p++)
+				{
+					std::uint64_t calls = 0, ticks = 0;
+					for (const std::unique_ptr<detail::ThreadCounters> &t : _threads)
+					{
+						calls += t->_probes[p]._calls.load(std::memory_order_relaxed);
+						ticks += t->_probes[p]._ticks.load(std::memory_order_relaxed);
+					}
+					result.push_back({_names[p], calls, ticks * nsPerTick});
+				}
+				return result;
+			}
+
+			void reset()
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				for (const std::unique_ptr<detail::ThreadCounters> &t : _threads)
+				{
+					for (detail::ProbeCounters &c : t->_probes)
+					{
+						c._calls.store(0, std::memory_order_relaxed);
+						c._ticks.store(0, std::memory_order_relaxed);
+					}
+				}
+			}
+
+			// TSC rate, calibrated against steady_clock over the time since the registry was created
+			double ticksPerNs() const
+			{
+#if defined(__x86_64__) || defined(__i386__)
+				const std::uint64_t ticks = detail::readTicks() - _startTicks;
+				const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _startTime).count();
+				return ns > 0.0 ? ticks / ns : 1.0;
+#else
+				// readTicks is already in ns
+				return 1.0;
+#endif
+			}
+
+		private:
+			Registry() : _startTicks(detail::readTicks()), _startTime(std::chrono::steady_clock::now())
+			{
+			}
+
+			// "static double K3PiStudies::K3PiStudiesUtils::radToDeg(double)" -> "K3PiStudiesUtils::radToDeg(double)"
+			static std::string shorten(const std::string &name)
+			{
+				const std::size_t paren = name.find('(');
+				const std::size_t ns = name.rfind("K3PiStudies::", paren);
+				return ns == std::string::npos ? name : name.substr(ns + std::string("K3PiStudies::").size());
+			}
+
+			std::mutex _mutex;
+			std::vector<std::string> _names;
+			std::vector<std::unique_ptr<detail::ThreadCounters>> _threads;
+			const std::uint64_t _startTicks;
+			const std::chrono::steady_clock::time_point _startTime;
+		};
+
+		std::string escapeJSON(const std::string &str)
+		{
+			std::string out;
+			for (const char c : str)
+			{
+				if (c == '"' || c == '\\')
+				{
+					out += '\\';
+				}
+				out += c;
+			}
+			return out;
+		}
+	} // end anonymous namespace
+
+	detail::ThreadCounters &detail::threadCounters()
+	{
+		thread_local ThreadCounters *counters = Registry::instance().registerThread();
+		return *counters;
+	}
+#endif
+
+	bool K3PiInstrumentation::isEnabled()
+	{
+#ifdef K3PI_INSTRUMENTATION
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	int K3PiInstrumentation::registerProbe(const char *name)
+	{
+#ifdef K3PI_INSTRUMENTATION
+		return Registry::instance().registerProbe(name);
+#else
+		(void)name;
+		return 0;
+#endif
+	}
+
+	void K3PiInstrumentation::printTable(std::ostream &out)
+	{
+#ifdef K3PI_INSTRUMENTATION
+		std::vector<ProbeTotals> totals = Registry::instance().totals();
+		std::stable_sort(totals.begin(), totals.end(), [](const ProbeTotals &a, const ProbeTotals &b) { return a._totalNs > b._totalNs; });
+
+		char line[64];
+		out << "        calls    total [ms]  per call [ns]  probe\n";
+		for (const ProbeTotals &t : totals)
+		{
+			if (t._calls == 0)
+			{
+				continue;
+			}
+			std::snprintf(line, sizeof(line), "%13llu %13.3f %14.1f  ", static_cast<unsigned long long>(t._calls), t._totalNs * 1e-6, t._totalNs / t._calls);
+			out << line << t._name << "\n";
+		}
+#else
+		out << "K3PiInstrumentation: not compiled in (configure with -DK3PISTUDIESUTILS_INSTRUMENTATION=ON)\n";
+#endif
+	}
+
+	std::string K3PiInstrumentation::toJSON()
+	{
+		std::ostringstream json;
+#ifdef K3PI_INSTRUMENTATION
+		json << "{\"enabled\": true, \"ticksPerNs\": " << Registry::instance().ticksPerNs() << ", \"probes\": [";
+		bool first = true;
+		for (const ProbeTotals &t : Registry::instance().totals())
+		{
+			if (t._calls == 0)
+			{
+				continue;
+			}
+			json << (first ? "" : ", ") << "{\"name\": \"" << escapeJSON(t._name) << "\", \"calls\": " << t._calls
+				 << ", \"totalNs\": " << t._totalNs << ", \"nsPerCall\": " << t._totalNs / t._calls << "}";
+			first = false;
+		}
+		json << "]}";
+#else
+		json << "{\"enabled\": false, \"probes\": []}";
+#endif
+		return json.str();
+	}
+
+	void K3PiInstrumentation::reset()
+	{
+#ifdef K3PI_INSTRUMENTATION
+		Registry::instance().reset();
+#endif
+	}
+
+} // end namespace K3PiStudies
@@ -0,0 +1,596 @@
+#include <iostream>
+
+#include "K3PiKinematics.h"
+#include "K3PiInstrumentation.h"
+#include "K3PiKinematicsKernels.h"
+
+namespace K3PiStudies
+{
+
+	InvalidDecayError::InvalidDecayError(const std::string &msg) : _msg(msg)
+	{
+		K3PI_COUNT("InvalidDecayError");
+	}
+
+	ComputationError::ComputationError(const std::string &msg) : _msg(msg)
+	{
+		K3PI_COUNT("ComputationError");
+	}
+
+	TLorentzVector K3PiKinematics::toTLorentzVector(
+		double pE,
+		double px,
+		double py,
+		double pz)
+	{
+		K3PI_PROFILE_FUNCTION();
+		TLorentzVector v;
+		v.SetPxPyPzE(px, py, pz, pE);
+		return v;
+	}
+
+	/**
+	 * See Eq. 42 in Kutschke's An Angular Distribution Cookbook
+	 * @return angle between the (4,5) decay plane and the (6,7) decay plane in mother rest frame, ranging from -pi to pi
+	 */
+	double K3PiKinematics::angleBetweenDecayPlanesKutschke(
+		const TVector3 &d4_motherRestFrame,
+		const TVector3 &d5_motherRestFrame,
+		const TVector3 &d6_motherRestFrame,
+		const TVector3 &d7_motherRestFrame)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return angleBetweenDecayPlanesKutschke(
+			ROOT::Math::XYZVector(d4_motherRestFrame.X(), d4_motherRestFrame.Y(), d4_motherRestFrame.Z()),
+			ROOT::Math::XYZVector(d5_motherRestFrame.X(), d5_motherRestFrame.Y(), d5_motherRestFrame.Z()),
+			ROOT::Math::XYZVector(d6_motherRestFrame.X(), d6_motherRestFrame.Y(), d6_motherRestFrame.Z()),
+			ROOT::Math::XYZVector(d7_motherRestFrame.X(), d7_motherRestFrame.Y(), d7_motherRestFrame.Z()));
+	}
+
+	/**
+	 * See Eq. 42 in Kutschke's An Angular Distribution Cookbook
+	 * @return angle between the (4,5) decay plane and the (6,7) decay plane in mother rest frame, ranging from -pi to pi
+	 */
+	double K3PiKinematics::angleBetweenDecayPlanesKutschke(
+		const ROOT::Math::XYZVector &d4_motherRestFrame,
+		const ROOT::Math::XYZVector &d5_motherRestFrame,
+		const ROOT::Math::XYZVector &d6_motherRestFrame,
+		const ROOT::Math::XYZVector &d7_motherRestFrame)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return detail::kutschkePhi(
+			detail::fromGenVector(d4_motherRestFrame),
+			detail::fromGenVector(d5_motherRestFrame),
+			detail::fromGenVector(d6_motherRestFrame),
+			detail::fromGenVector(d7_motherRestFrame));
+	}
+
+	/**
+	 * @param v1v2AngleIsNegPiToPi true if `v1v2Angle` ranges from -pi to pi, false if it ranges from 0 to 2 pi
+	 * @return diff between .Angle method and our angle calculation (`v1v2Angle`)
+	 */
+	double K3PiKinematics::verifyAngle(
+		const TVector3 &v1,
+		const TVector3 &v2,
+		double v1v2Angle,
+		bool v1v2AngleIsNegPiToPi,
+		const std::string &angleName,
+		bool printDiff)
+	{
+		K3PI_PROFILE_FUNCTION();
+		double angleDiff = 0.0;
+
+		double angleToCompare = v1.Angle(v2);
+		// .Angle uses acos, which ranges from 0 to pi. Need to get correct quadrant and put it in range -pi to pi
+		if (sin(v1v2Angle) < 0.0)
+		{
+			angleToCompare *= -1.0;
+		}
+
+		if (!v1v2AngleIsNegPiToPi)
+		{
+			angleToCompare = changeAngleRange_0_to_2pi(angleToCompare);
+		}
+
+		// std::cout << angleName << ": " << v1v2Angle << std::endl;
+		// std::cout << "From .Angle(): " << angleToCompare << std::endl;
+		// std::cout << angleName << " (deg) : " << radToDeg(v1v2Angle) << std::endl;
+		// std::cout << "From .Angle() (deg) : " << radToDeg(angleToCompare) << std::endl;
+
+		// only prints, so the name is only built when it would be
+		if (printDiff)
+		{
+			areDoublesEqual(combinedToleranceCompare, v1v2Angle, angleToCompare, angleName + " / .Angle()", printDiff);
+		}
+		angleDiff = std::fabs(v1v2Angle - angleToCompare);
+
+		return angleDiff;
+	}
+
+	double K3PiKinematics::radToDeg(double angleRad)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return TMath::RadToDeg() * angleRad;
+	}
+
+	/**
+	 * @param angle_0_to_2pi angle in range 0 to 2pi
+	 * @return angle in range -pi to pi
+	 */
+	double K3PiKinematics::changeAngleRange_neg_pi_to_pi(double angle_0_to_2pi)
+	{
+		K3PI_PROFILE_FUNCTION();
+		if (angle_0_to_2pi > _PI)
+		{
+			return angle_0_to_2pi - 2.0 * _PI;
+		}
+		else
+		{
+			return angle_0_to_2pi;
+		}
+	}
+
+	/**
+	 * @param angle_neg_pi_to_pi angle that ranges from -pi to pi
+	 * @return angle that ranges from 0 to 2pi
+	 */
+	double K3PiKinematics::changeAngleRange_0_to_2pi(double angle_neg_pi_to_pi)
+	{
+		K3PI_PROFILE_FUNCTION();
+		if (angle_neg_pi_to_pi < 0.0)
+		{
+			// std::cout << "Neg phi" << std::endl;
+			return angle_neg_pi_to_pi + 2.0 * K3PiKinematics::_PI;
+		}
+		else
+		{
+			return angle_neg_pi_to_pi;
+		}
+	}
+
+	/**
+	 * @param isEqualFunc returns true if the d1, d2 are equal; false otherwise
+	 */
+	bool K3PiKinematics::areDoublesEqual(
+		std::function<bool(double, double)> isEqualFunc,
+		double d1,
+		double d2,
+		const std::string &varName,
+		bool printDiff)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return areDoublesEqual<std::function<bool(double, double)>>(isEqualFunc, d1, d2, varName, printDiff);
+	}
+
+	void K3PiKinematics::printDoublesDiff(const std::string &varName, double d1, double d2)
+	{
+		K3PI_PROFILE_FUNCTION();
+		std::cout << "Found difference for " << varName << ": " << d1 << ", " << d2 << "; diff = " << d1 - d2 << std::endl;
+	}
+
+	double K3PiKinematics::getPhi(
+		double px,
+		double py,
+		double pz,
+		double pE)
+	{
+		K3PI_PROFILE_FUNCTION();
+		ROOT::Math::PxPyPzEVector v(px, py, pz, pE);
+		return v.Phi();
+	}
+
+	double K3PiKinematics::getEta(
+		double px,
+		double py,
+		double pz,
+		double pE)
+	{
+		K3PI_PROFILE_FUNCTION();
+		ROOT::Math::PxPyPzEVector v(px, py, pz, pE);
+		return v.Eta();
+	}
+
+	double K3PiKinematics::getPT(
+		double px,
+		double py,
+		double pz,
+		double pE)
+	{
+		K3PI_PROFILE_FUNCTION();
+		ROOT::Math::PxPyPzEVector v(px, py, pz, pE);
+		return v.Pt();
+	}
+
+	/**
+	 * @param pA_IN_D0CM K
+	 * @param pB_IN_D0CM OS pi 1
+	 * @param pC_IN_D0CM SS pi
+	 * @param pD_IN_D0CM OS pi 2
+	 * @returns vector with entries m12, m34, cos12, cos34, phi
+	 */
+	std::vector<double> K3PiKinematics::calc_phsp(
+		const TLorentzVector &pD0_IN_D0CM,
+		const TLorentzVector &pA_IN_D0CM, // K-
+		const TLorentzVector &pB_IN_D0CM, // OS pi 1
+		const TLorentzVector &pC_IN_D0CM, // SS pi
+		const TLorentzVector &pD_IN_D0CM) // OS pi 2
+	{
+		K3PI_PROFILE_FUNCTION();
+		const Phsp4BodyPoint p = calc_phsp_point(pD0_IN_D0CM, pA_IN_D0CM, pB_IN_D0CM, pC_IN_D0CM, pD_IN_D0CM);
+		std::vector<double> vars = {p._m12_MeV, p._m34_MeV, p._cos12, p._cos34, p._phi_rad};
+		return vars;
+	}
+
+	/**
+	 * Same as calc_phsp, but returns a fixed-size struct instead of allocating a vector
+	 *
+	 * @param pA_IN_D0CM K
+	 * @param pB_IN_D0CM OS pi 1
+	 * @param pC_IN_D0CM SS pi
+	 * @param pD_IN_D0CM OS pi 2
+	 */
+	Phsp4BodyPoint K3PiKinematics::calc_phsp_point(
+		const TLorentzVector &pD0_IN_D0CM,
+		const TLorentzVector &pA_IN_D0CM, // K-
+		const TLorentzVector &pB_IN_D0CM, // OS pi 1
+		const TLorentzVector &pC_IN_D0CM, // SS pi
+		const TLorentzVector &pD_IN_D0CM) // OS pi 2
+	{
+		K3PI_PROFILE_FUNCTION();
+		return calc_phsp_point(
+			ROOT::Math::PxPyPzEVector(pA_IN_D0CM.Px(), pA_IN_D0CM.Py(), pA_IN_D0CM.Pz(), pA_IN_D0CM.E()),
+			ROOT::Math::PxPyPzEVector(pB_IN_D0CM.Px(), pB_IN_D0CM.Py(), pB_IN_D0CM.Pz(), pB_IN_D0CM.E()),
+			ROOT::Math::PxPyPzEVector(pC_IN_D0CM.Px(), pC_IN_D0CM.Py(), pC_IN_D0CM.Pz(), pC_IN_D0CM.E()),
+			ROOT::Math::PxPyPzEVector(pD_IN_D0CM.Px(), pD_IN_D0CM.Py(), pD_IN_D0CM.Pz(), pD_IN_D0CM.E()));
+	}
+
+	/**
+	 * GenVector version of calc_phsp_point(const TLorentzVector &...), computed with plain doubles; same results bit-for-bit.
+	 *
+	 * note that the inputs are in the D0 CM.
+	 * zhat is the pA_3vec+pB_3vec direction. to consider the helicity angles of the AB and CD pairs in their
+	 * respective CMs, we make Lorentz transformations along the zhat (or -zhat) directions.
+	 * Note that the CD system is moving along the -zhat direction to start.
+	 */
+	Phsp4BodyPoint K3PiKinematics::calc_phsp_point(
+		const ROOT::Math::PxPyPzEVector &pA_IN_D0CM, // K-
+		const ROOT::Math::PxPyPzEVector &pB_IN_D0CM, // OS pi 1
+		const ROOT::Math::PxPyPzEVector &pC_IN_D0CM, // SS pi
+		const ROOT::Math::PxPyPzEVector &pD_IN_D0CM) // OS pi 2
+	{
+		K3PI_PROFILE_FUNCTION();
+		return detail::calcPhspPoint(
+			detail::fromGenVector(pA_IN_D0CM),
+			detail::fromGenVector(pB_IN_D0CM),
+			detail::fromGenVector(pC_IN_D0CM),
+			detail::fromGenVector(pD_IN_D0CM));
+	}
+
+	/**
+	 * Picks the OS pion pairing like isKPi1LowerMassPair and returns calc_phsp_point(kminus, chosen OS pi, ssPi, other OS pi),
+	 * reusing the K pi sums and masses the choice was made with. Same results bit-for-bit as calling the two functions.
+	 */
+	Phsp4BodyPairedPoint K3PiKinematics::calc_phsp_point_pairLowerMKPi(
+		const ROOT::Math::PxPyPzEVector &kminus_IN_D0CM,
+		const ROOT::Math::PxPyPzEVector &osPi1_IN_D0CM,
+		const ROOT::Math::PxPyPzEVector &ssPi_IN_D0CM,
+		const ROOT::Math::PxPyPzEVector &osPi2_IN_D0CM)
+	{
+		K3PI_PROFILE_FUNCTION();
+		const detail::Vec4 k = detail::fromGenVector(kminus_IN_D0CM);
+		const detail::Vec4 pi1 = detail::fromGenVector(osPi1_IN_D0CM);
+		const detail::Vec4 ssPi = detail::fromGenVector(ssPi_IN_D0CM);
+		const detail::Vec4 pi2 = detail::fromGenVector(osPi2_IN_D0CM);
+
+		const detail::Vec4 kPi1 = detail::add(k, pi1);
+		const detail::Vec4 kPi2 = detail::add(k, pi2);
+		const double mKPi1 = detail::invMass(kPi1);
+		const double mKPi2 = detail::invMass(kPi2);
+
+		if (mKPi1 < mKPi2)
+		{
+			return {detail::calcPhspPointGivenAB(k, pi1, ssPi, pi2, kPi1, mKPi1), mKPi2, true};
+		}
+		return {detail::calcPhspPointGivenAB(k, pi2, ssPi, pi1, kPi2, mKPi2), mKPi1, false};
+	}
+
+	/**
+	 * calc_phsp_point for both OS pion pairings in one call (for symmetrization studies); each K pi sum and mass is formed once
+	 * and also used to decide which pairing has the lower m(K pi)
+	 */
+	Phsp4BodyPairings K3PiKinematics::calc_phsp_point_bothPairings(
+		const ROOT::Math::PxPyPzEVector &kminus_IN_D0CM,
+		const ROOT::Math::PxPyPzEVector &osPi1_IN_D0CM,
+		const ROOT::Math::PxPyPzEVector &ssPi_IN_D0CM,
+		const ROOT::Math::PxPyPzEVector &osPi2_IN_D0CM)
+	{
+		K3PI_PROFILE_FUNCTION();
+		const detail::Vec4 k = detail::fromGenVector(kminus_IN_D0CM);
+		const detail::Vec4 pi1 = detail::fromGenVector(osPi1_IN_D0CM);
+		const detail::Vec4 ssPi = detail::fromGenVector(ssPi_IN_D0CM);
+		const detail::Vec4 pi2 = detail::fromGenVector(osPi2_IN_D0CM);
+
+		const detail::Vec4 kPi1 = detail::add(k, pi1);
+		const detail::Vec4 kPi2 = detail::add(k, pi2);
+		const double mKPi1 = detail::invMass(kPi1);
+		const double mKPi2 = detail::invMass(kPi2);
+
+		return {detail::calcPhspPointGivenAB(k, pi1, ssPi, pi2, kPi1, mKPi1),
+				detail::calcPhspPointGivenAB(k, pi2, ssPi, pi1, kPi2, mKPi2),
+				mKPi1 < mKPi2};
+	}
+
+	/*
+	 * Function to calculate phase space from John's apply_full_selection.py code
+	 * returns vector with entries: {m12, m34, cos1, cos2, phi, m13, phiAngleDiff}
+	 */
+	std::vector<double> K3PiKinematics::calc_phsp(
+		double K_D0Fit_PT,
+		double K_D0Fit_ETA,
+		double K_D0Fit_PHI,
+		double Pi_SS_D0Fit_PT,
+		double Pi_SS_D0Fit_ETA,
+		double Pi_SS_D0Fit_PHI,
+		double Pi_OS1_D0Fit_PT,
+		double Pi_OS1_D0Fit_ETA,
+		double Pi_OS1_D0Fit_PHI,
+		double Pi_OS2_D0Fit_PT,
+		double Pi_OS2_D0Fit_ETA,
+		double Pi_OS2_D0Fit_PHI,
+		bool pi1GoesWithK,
+		bool verifyAngles,
+		bool printDiff)
+	{
+		K3PI_PROFILE_FUNCTION();
+		const Phsp4BodyPtEtaPhiPoint p = calc_phsp_point(
+			K_D0Fit_PT,
+			K_D0Fit_ETA,
+			K_D0Fit_PHI,
+			Pi_SS_D0Fit_PT,
+			Pi_SS_D0Fit_ETA,
+			Pi_SS_D0Fit_PHI,
+			Pi_OS1_D0Fit_PT,
+			Pi_OS1_D0Fit_ETA,
+			Pi_OS1_D0Fit_PHI,
+			Pi_OS2_D0Fit_PT,
+			Pi_OS2_D0Fit_ETA,
+			Pi_OS2_D0Fit_PHI,
+			pi1GoesWithK,
+			verifyAngles,
+			printDiff);
+
+		std::vector<double> vars = {p._m12_MeV, p._m34_MeV, p._cos1, p._cos2, p._phi_rad, p._m13_MeV, p._phi_diff};
+		return vars;
+	}
+
+	/**
+	 * Same as the PtEtaPhi calc_phsp, but returns a fixed-size struct instead of allocating a vector.
+	 * Dispatches to the calc_phsp_point<Pairing, Verify> specialization for the flags; printDiff is not used (as before)
+	 */
+	Phsp4BodyPtEtaPhiPoint K3PiKinematics::calc_phsp_point(
+		double K_D0Fit_PT,
+		double K_D0Fit_ETA,
+		double K_D0Fit_PHI,
+		double Pi_SS_D0Fit_PT,
+		double Pi_SS_D0Fit_ETA,
+		double Pi_SS_D0Fit_PHI,
+		double Pi_OS1_D0Fit_PT,
+		double Pi_OS1_D0Fit_ETA,
+		double Pi_OS1_D0Fit_PHI,
+		double Pi_OS2_D0Fit_PT,
+		double Pi_OS2_D0Fit_ETA,
+		double Pi_OS2_D0Fit_PHI,
+		bool pi1GoesWithK,
+		bool verifyAngles,
+		bool printDiff)
+	{
+		K3PI_PROFILE_FUNCTION();
+		using Specialization = Phsp4BodyPtEtaPhiPoint (*)(double, double, double, double, double, double, double, double, double, double, double, double);
+		static constexpr Specialization specializations[2][2] = {
+			{&calc_phsp_point<Pairing::Pi2WithK, Verify::Off>, &calc_phsp_point<Pairing::Pi2WithK, Verify::On>},
+			{&calc_phsp_point<Pairing::Pi1WithK, Verify::Off>, &calc_phsp_point<Pairing::Pi1WithK, Verify::On>}};
+
+		return specializations[pi1GoesWithK][verifyAngles](
+			K_D0Fit_PT,
+			K_D0Fit_ETA,
+			K_D0Fit_PHI,
+			Pi_SS_D0Fit_PT,
+			Pi_SS_D0Fit_ETA,
+			Pi_SS_D0Fit_PHI,
+			Pi_OS1_D0Fit_PT,
+			Pi_OS1_D0Fit_ETA,
+			Pi_OS1_D0Fit_PHI,
+			Pi_OS2_D0Fit_PT,
+			Pi_OS2_D0Fit_ETA,
+			Pi_OS2_D0Fit_PHI);
+	}
+
+	/**
+	 * PtEtaPhi calc_phsp_point with the K/pi pairing and the angle verification fixed at compile time,
+	 * so the Verify::Off versions contain no verification code (and no TVector3 or std::string construction) at all
+	 */
+	template <Pairing pairing, Verify verify>
+	Phsp4BodyPtEtaPhiPoint K3PiKinematics::calc_phsp_point(
+		double K_D0Fit_PT,
+		double K_D0Fit_ETA,
+		double K_D0Fit_PHI,
+		double Pi_SS_D0Fit_PT,
+		double Pi_SS_D0Fit_ETA,
+		double Pi_SS_D0Fit_PHI,
+		double Pi_OS1_D0Fit_PT,
+		double Pi_OS1_D0Fit_ETA,
+		double Pi_OS1_D0Fit_PHI,
+		double Pi_OS2_D0Fit_PT,
+		double Pi_OS2_D0Fit_ETA,
+		double Pi_OS2_D0Fit_PHI)
+	{
+		K3PI_PROFILE_FUNCTION();
+		const detail::Vec4 d2_ssPi = detail::fromPtEtaPhiM(Pi_SS_D0Fit_PT, Pi_SS_D0Fit_ETA, Pi_SS_D0Fit_PHI, K3PiKinematics::_PION_MASS);
+		const detail::Vec4 d3_k = detail::fromPtEtaPhiM(K_D0Fit_PT, K_D0Fit_ETA, K_D0Fit_PHI, K3PiKinematics::_KAON_MASS);
+		const detail::Vec4 osPi1 = detail::fromPtEtaPhiM(Pi_OS1_D0Fit_PT, Pi_OS1_D0Fit_ETA, Pi_OS1_D0Fit_PHI, K3PiKinematics::_PION_MASS);
+		const detail::Vec4 osPi2 = detail::fromPtEtaPhiM(Pi_OS2_D0Fit_PT, Pi_OS2_D0Fit_ETA, Pi_OS2_D0Fit_PHI, K3PiKinematics::_PION_MASS);
+
+		// figure out which pi to associate with k
+		constexpr bool pi1GoesWithK = pairing == Pairing::Pi1WithK;
+		const detail::Vec4 &d1_piGoesWithPi = pi1GoesWithK ? osPi2 : osPi1;
+		const detail::Vec4 &d4_piGoesWithK = pi1GoesWithK ? osPi1 : osPi2;
+
+		// boosts to the D0 and resonance rest frames, see detail::calcPhspPtEtaPhiNoAtan2
+		double m12, m34, cos1, cos2, m13, sinp, cosp;
+		detail::Vec3 n1Unit, n2Unit;
+		constexpr bool verifyAngles = verify == Verify::On;
+		detail::calcPhspPtEtaPhiNoAtan2(d1_piGoesWithPi, d2_ssPi, d3_k, d4_piGoesWithK, m12, m34, cos1, cos2, m13, sinp, cosp,
+										verifyAngles ? &n1Unit : nullptr, verifyAngles ? &n2Unit : nullptr);
+
+		// Calculation of the angle Phi between the planes, in range -pi to pi
+		double phi = TMath::ATan2(sinp, cosp);
+
+		double phiDiff = 0.0;
+		if constexpr (verifyAngles)
+		{
+			phiDiff = K3PiKinematics::verifyAngle(TVector3(n1Unit._x, n1Unit._y, n1Unit._z), TVector3(n2Unit._x, n2Unit._y, n2Unit._z), phi, true, "phi", false);
+		}
+
+		return {m12, m34, cos1, cos2, phi, m13, phiDiff};
+	}
+
+	// every combination is compiled in here, the kernels are not part of the installed headers
+	template Phsp4BodyPtEtaPhiPoint K3PiKinematics::calc_phsp_point<Pairing::Pi2WithK, Verify::Off>(double, double, double, double, double, double, double, double, double, double, double, double);
+	template Phsp4BodyPtEtaPhiPoint K3PiKinematics::calc_phsp_point<Pairing::Pi2WithK, Verify::On>(double, double, double, double, double, double, double, double, double, double, double, double);
+	template Phsp4BodyPtEtaPhiPoint K3PiKinematics::calc_phsp_point<Pairing::Pi1WithK, Verify::Off>(double, double, double, double, double, double, double, double, double, double, double, double);
+	template Phsp4BodyPtEtaPhiPoint K3PiKinematics::calc_phsp_point<Pairing::Pi1WithK, Verify::On>(double, double, double, double, double, double, double, double, double, double, double, double);
+
+	/**
+	 * Fused version of the PtEtaPhi calc_phsp_point without angle verification (_phi_diff is always 0), see detail::calcPhspPtEtaPhiFusedNoAtan2.
+	 * Boosts once into the D0 frame and gets the cosines from the invariant masses, so the cosines are not bit-for-bit those of
+	 * calc_phsp_point: within 1e-9, or 5e-6 within 1 MeV of their threshold (see detail::calcPhspPtEtaPhiFusedNoAtan2).
+	 */
+	Phsp4BodyPtEtaPhiPoint K3PiKinematics::calc_phsp_point_fused(
+		double K_D0Fit_PT,
+		double K_D0Fit_ETA,
+		double K_D0Fit_PHI,
+		double Pi_SS_D0Fit_PT,
+		double Pi_SS_D0Fit_ETA,
+		double Pi_SS_D0Fit_PHI,
+		double Pi_OS1_D0Fit_PT,
+		double Pi_OS1_D0Fit_ETA,
+		double Pi_OS1_D0Fit_PHI,
+		double Pi_OS2_D0Fit_PT,
+		double Pi_OS2_D0Fit_ETA,
+		double Pi_OS2_D0Fit_PHI,
+		bool pi1GoesWithK)
+	{
+		K3PI_PROFILE_FUNCTION();
+		const detail::Vec4 d2_ssPi = detail::fromPtEtaPhiM(Pi_SS_D0Fit_PT, Pi_SS_D0Fit_ETA, Pi_SS_D0Fit_PHI, K3PiKinematics::_PION_MASS);
+		const detail::Vec4 d3_k = detail::fromPtEtaPhiM(K_D0Fit_PT, K_D0Fit_ETA, K_D0Fit_PHI, K3PiKinematics::_KAON_MASS);
+		const detail::Vec4 osPi1 = detail::fromPtEtaPhiM(Pi_OS1_D0Fit_PT, Pi_OS1_D0Fit_ETA, Pi_OS1_D0Fit_PHI, K3PiKinematics::_PION_MASS);
+		const detail::Vec4 osPi2 = detail::fromPtEtaPhiM(Pi_OS2_D0Fit_PT, Pi_OS2_D0Fit_ETA, Pi_OS2_D0Fit_PHI, K3PiKinematics::_PION_MASS);
+
+		// figure out which pi to associate with k
+		const detail::Vec4 &d1_piGoesWithPi = pi1GoesWithK ? osPi2 : osPi1;
+		const detail::Vec4 &d4_piGoesWithK = pi1GoesWithK ? osPi1 : osPi2;
+
+		double m12, m34, cos1, cos2, m13, sinp, cosp;
+		detail::calcPhspPtEtaPhiFusedNoAtan2(d1_piGoesWithPi, d2_ssPi, d3_k, d4_piGoesWithK, m12, m34, cos1, cos2, m13, sinp, cosp);
+
+		return {m12, m34, cos1, cos2, TMath::ATan2(sinp, cosp), m13, 0.0};
+	}
+
+	bool K3PiKinematics::isKPi1LowerMassPair(
+		const TLorentzVector &kminus_4vec,
+		const TLorentzVector &piplus1_4vec,
+		const TLorentzVector &piplus2_4vec)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return isKPi1LowerMassPair(
+			ROOT::Math::PxPyPzEVector(kminus_4vec.Px(), kminus_4vec.Py(), kminus_4vec.Pz(), kminus_4vec.E()),
+			ROOT::Math::PxPyPzEVector(piplus1_4vec.Px(), piplus1_4vec.Py(), piplus1_4vec.Pz(), piplus1_4vec.E()),
+			ROOT::Math::PxPyPzEVector(piplus2_4vec.Px(), piplus2_4vec.Py(), piplus2_4vec.Pz(), piplus2_4vec.E()));
+	}
+
+	bool K3PiKinematics::isKPi1LowerMassPair(
+		const ROOT::Math::PxPyPzEVector &kminus_4vec,
+		const ROOT::Math::PxPyPzEVector &piplus1_4vec,
+		const ROOT::Math::PxPyPzEVector &piplus2_4vec)
+	{
+		K3PI_PROFILE_FUNCTION();
+		const detail::Vec4 k = detail::fromGenVector(kminus_4vec);
+		const double mkpi1 = detail::invMass(detail::add(k, detail::fromGenVector(piplus1_4vec)));
+		const double mkpi2 = detail::invMass(detail::add(k, detail::fromGenVector(piplus2_4vec)));
+
+		return mkpi1 < mkpi2;
+	}
+
+	/**
+	 * From John's apply_full_selection.py code
+	 */
+	double K3PiKinematics::compute_delta_angle(
+		double extra_px,
+		double extra_py,
+		double extra_pz,
+		double d_px,
+		double d_py,
+		double d_pz)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return detail::angle({d_px, d_py, d_pz}, {extra_px, extra_py, extra_pz});
+	}
+
+	/**
+	 * From John's apply_full_selection.py code
+	 */
+	double K3PiKinematics::compute_delta_angle(
+		double extra_px,
+		double extra_py,
+		double extra_pz,
+		double extra_m,
+		double d_px,
+		double d_py,
+		double d_pz,
+		double d_m)
+	{
+		K3PI_PROFILE_FUNCTION();
+		// the opening angle only depends on the 3-momenta, the masses do not enter
+		return detail::angle({d_px, d_py, d_pz}, {extra_px, extra_py, extra_pz});
+	}
+
+	/**
+	 * function to calculate helicity angle of soft pion
+	 * From John's apply_full_selection.py code
+	 */
+	float K3PiKinematics::helicity_angle_func(
+		float d0_px,
+		float d0_py,
+		float d0_pz,
+		float d0_m,
+		const ROOT::RVec<float> &pis_px,
+		const ROOT::RVec<float> &pis_py,
+		const ROOT::RVec<float> &pis_pz,
+		float pis_m)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return helicity_angle_func(d0_px, d0_py, d0_pz, d0_m, pis_px[0], pis_py[0], pis_pz[0], pis_m);
+	}
+
+	/**
+	 * function to calculate helicity angle of soft pion
+	 * From John's apply_full_selection.py code
+	 */
+	float K3PiKinematics::helicity_angle_func(
+		float d0_px,
+		float d0_py,
+		float d0_pz,
+		float d0_m,
+		float pis_px,
+		float pis_py,
+		float pis_pz,
+		float pis_m)
+	{
+		K3PI_PROFILE_FUNCTION();
+		// D* = D0 + soft pi in the lab; helicity angle is the angle of the soft pi in the D* rest frame relative to the D* lab frame momentum
+		return detail::helicityAngle(
+			detail::fromXYZM(d0_px, d0_py, d0_pz, d0_m),
+			detail::fromXYZM(pis_px, pis_py, pis_pz, pis_m));
+	}
+
+} // end namespace K3PiStudies
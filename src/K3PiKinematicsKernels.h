@@ -0,0 +1,436 @@
+#pragma once
+
+#include <cstddef>
+
+#include <TMath.h>
+#include <Math/Vector3D.h>
+#include <Math/Vector4D.h>
+
+#include "K3PiKinematics.h"
+
+/**
+ * Internal plain-double kinematics shared by the batch and scalar phase space code. Not part of the installed interface.
+ */
+
+// runtime ISA dispatch: build one clone of the marked block kernel per ISA, the loader picks the best one for the host CPU.
+// flatten inlines the helpers below into the kernel so its event loop can be vectorized as a whole
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__ELF__)
+#define K3PI_BLOCK_KERNEL __attribute__((target_clones("avx512f", "avx2", "default"), flatten))
+#elif defined(__GNUC__)
+#define K3PI_BLOCK_KERNEL __attribute__((flatten))
+#else
+#define K3PI_BLOCK_KERNEL
+#endif
+
+// the batch event loops never write to memory they read from in a later iteration
+#if defined(__clang__)
+#define K3PI_IVDEP _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__)
+#define K3PI_IVDEP _Pragma("GCC ivdep")
+#else
+#define K3PI_IVDEP
+#endif
+
+namespace K3PiStudies
+{
+	namespace detail
+	{
+		/**
+		 * Plain-double stand-ins for TVector3/TLorentzVector.
+		 * Each helper performs exactly the same floating point operations, in the same order, as the ROOT method it is named after,
+		 * so results agree bit-for-bit with the TLorentzVector code paths.
+		 */
+		struct Vec3
+		{
+			double _x;
+			double _y;
+			double _z;
+		};
+
+		struct Vec4
+		{
+			double _x;
+			double _y;
+			double _z;
+			double _t;
+		};
+
+		inline Vec4 add(const Vec4 &a, const Vec4 &b)
+		{
+			return {a._x + b._x, a._y + b._y, a._z + b._z, a._t + b._t};
+		}
+
+		inline Vec3 add(const Vec3 &a, const Vec3 &b)
+		{
+			return {a._x + b._x, a._y + b._y, a._z + b._z};
+		}
+
+		inline Vec3 vect(const Vec4 &v)
+		{
+			return {v._x, v._y, v._z};
+		}
+
+		inline double mag2(const Vec3 &v)
+		{
+			return v._x * v._x + v._y * v._y + v._z * v._z;
+		}
+
+		inline double mag(const Vec3 &v)
+		{
+			return TMath::Sqrt(mag2(v));
+		}
+
+		inline double dot(const Vec3 &a, const Vec3 &b)
+		{
+			return a._x * b._x + a._y * b._y + a._z * b._z;
+		}
+
+		inline Vec3 cross(const Vec3 &a, const Vec3 &b)
+		{
+			return {a._y * b._z - b._y * a._z, a._z * b._x - b._z * a._x, a._x * b._y - b._x * a._y};
+		}
+
+		// TVector3::Unit
+		inline Vec3 unit(const Vec3 &v)
+		{
+			const double tot2 = mag2(v);
+			const double tot = (tot2 > 0) ? 1.0 / TMath::Sqrt(tot2) : 1.0;
+			return {v._x * tot, v._y * tot, v._z * tot};
+		}
+
+		// the (clamped) argument TVector3::Angle passes to acos; 1 (i.e. a zero angle) if either vector is null
+		inline double angleCos(const Vec3 &a, const Vec3 &b)
+		{
+			const double ptot2 = mag2(a) * mag2(b);
+			double arg = dot(a, b) / TMath::Sqrt(ptot2);
+			arg = arg > 1.0 ? 1.0 : arg;
+			arg = arg < -1.0 ? -1.0 : arg;
+			return ptot2 <= 0 ? 1.0 : arg;
+		}
+
+		// TVector3::Angle
+		inline double angle(const Vec3 &a, const Vec3 &b)
+		{
+			return TMath::ACos(angleCos(a, b));
+		}
+
+		// TLorentzVector::M2
+		inline double mass2(const Vec4 &v)
+		{
+			return v._t * v._t - mag2(vect(v));
+		}
+
+		// TLorentzVector::M
+		inline double invMass(const Vec4 &v)
+		{
+			const double mm = mass2(v);
+			return mm < 0.0 ? -TMath::Sqrt(-mm) : TMath::Sqrt(mm);
+		}
+
+		// -TLorentzVector::BoostVector
+		inline Vec3 minusBoostVector(const Vec4 &v)
+		{
+			return {-(v._x / v._t), -(v._y / v._t), -(v._z / v._t)};
+		}
+
+		// the v-independent part of TLorentzVector::Boost(const TVector3 &), so several vectors can share one boost
+		struct Boost
+		{
+			explicit Boost(const Vec3 &b)
+				: _b(b)
+			{
+				const double b2 = b._x * b._x + b._y * b._y + b._z * b._z;
+				_gamma = 1.0 / TMath::Sqrt(1.0 - b2);
+				_gamma2 = b2 > 0 ? (_gamma - 1.0) / b2 : 0.0;
+			}
+
+			Vec4 operator()(const Vec4 &v) const
+			{
+				const double bp = _b._x * v._x + _b._y * v._y + _b._z * v._z;
+
+				return {v._x + _gamma2 * bp * _b._x + _gamma * _b._x * v._t,
+						v._y + _gamma2 * bp * _b._y + _gamma * _b._y * v._t,
+						v._z + _gamma2 * bp * _b._z + _gamma * _b._z * v._t,
+						_gamma * (v._t + bp)};
+			}
+
+			Vec3 _b;
+			double _gamma;
+			double _gamma2;
+		};
+
+		// TLorentzVector::Boost(const TVector3 &)
+		inline Vec4 boost(const Vec4 &v, const Vec3 &b)
+		{
+			return Boost(b)(v);
+		}
+
+		// TLorentzVector::SetXYZM
+		inline Vec4 fromXYZM(double x, double y, double z, double m)
+		{
+			if (m >= 0)
+			{
+				return {x, y, z, TMath::Sqrt(x * x + y * y + z * z + m * m)};
+			}
+			return {x, y, z, TMath::Sqrt(TMath::Max((x * x + y * y + z * z - m * m), 0.))};
+		}
+
+		// TLorentzVector::SetPtEtaPhiM
+		inline Vec4 fromPtEtaPhiM(double pt, double eta, double phi, double m)
+		{
+			pt = TMath::Abs(pt);
+			return fromXYZM(pt * TMath::Cos(phi), pt * TMath::Sin(phi), pt * sinh(eta), m);
+		}
+
+		inline Vec4 fromGenVector(const ROOT::Math::PxPyPzEVector &v)
+		{
+			return {v.Px(), v.Py(), v.Pz(), v.E()};
+		}
+
+		inline Vec3 fromGenVector(const ROOT::Math::XYZVector &v)
+		{
+			return {v.X(), v.Y(), v.Z()};
+		}
+
+		inline Vec4 columnEntry(const P4Columns &p, std::size_t i)
+		{
+			return {p._px[i], p._py[i], p._pz[i], p._pE[i]};
+		}
+
+		/**
+		 * The four daughters boosted into their combined (D0) rest frame, which is what calcPhspPoint and
+		 * calc_phsp(const TLorentzVector &...) expect; same arithmetic as TLorentzVector::Boost(-(p0 + p1 + p2 + p3).BoostVector())
+		 */
+		inline void boostToRestFrame(const Vec4 (&lab)[4], Vec4 (&rest)[4])
+		{
+			const Boost toRest(minusBoostVector(add(add(add(lab[0], lab[1]), lab[2]), lab[3])));
+			for (int i = 0; i < 4; i++)
+			{
+				rest[i] = toRest(lab[i]);
+			}
+		}
+
+		/**
+		 * calcPhspNoAtan2 for callers that already formed pAB_4vec = pA + pB and its mass m12 (e.g. to pick the K/pi pairing)
+		 */
+		inline void calcPhspNoAtan2GivenAB(
+			const Vec4 &pA,
+			const Vec4 &pB,
+			const Vec4 &pC,
+			const Vec4 &pD,
+			const Vec4 &pAB_4vec,
+			double m12,
+			double &m34,
+			double &cos12,
+			double &cos34,
+			double &sinPhi,
+			double &cosPhi)
+		{
+			const Vec4 pCD_4vec = add(pC, pD);
+			m34 = invMass(pCD_4vec);
+
+			const Vec3 yhat = unit(cross(vect(pA), vect(pB)));
+			const Vec3 yhatPrime = unit(cross(vect(pC), vect(pD)));
+			const Vec3 zhat = unit(vect(pAB_4vec));
+			const Vec3 xhat = unit(cross(yhat, zhat));
+
+			cosPhi = dot(yhat, yhatPrime);
+			sinPhi = dot(xhat, yhatPrime);
+
+			const Vec3 pAprime_3vec = vect(boost(pA, minusBoostVector(pAB_4vec)));
+			const Vec3 pCprime_3vec = vect(boost(pC, minusBoostVector(pCD_4vec)));
+
+			cos12 = dot(pAprime_3vec, zhat) / mag(pAprime_3vec);
+			cos34 = dot(pCprime_3vec, zhat) / mag(pCprime_3vec);
+		}
+
+		/**
+		 * Everything calc_phsp(const TLorentzVector &...) computes except the final atan2, which is left to the caller
+		 * so this part stays free of library calls and can be vectorized.
+		 */
+		inline void calcPhspNoAtan2(
+			const Vec4 &pA,
+			const Vec4 &pB,
+			const Vec4 &pC,
+			const Vec4 &pD,
+			double &m12,
+			double &m34,
+			double &cos12,
+			double &cos34,
+			double &sinPhi,
+			double &cosPhi)
+		{
+			const Vec4 pAB_4vec = add(pA, pB);
+			m12 = invMass(pAB_4vec);
+			calcPhspNoAtan2GivenAB(pA, pB, pC, pD, pAB_4vec, m12, m34, cos12, cos34, sinPhi, cosPhi);
+		}
+
+		/**
+		 * Scalar version of calcPhspNoAtan2 including phi; bit-for-bit equal to calc_phsp_point(const TLorentzVector &...)
+		 */
+		inline Phsp4BodyPoint calcPhspPoint(const Vec4 &pA, const Vec4 &pB, const Vec4 &pC, const Vec4 &pD)
+		{
+			Phsp4BodyPoint p;
+			double sinPhi, cosPhi;
+			calcPhspNoAtan2(pA, pB, pC, pD, p._m12_MeV, p._m34_MeV, p._cos12, p._cos34, sinPhi, cosPhi);
+			p._phi_rad = K3PiKinematics::changeAngleRange_0_to_2pi(TMath::ATan2(sinPhi, cosPhi));
+			return p;
+		}
+
+		// calcPhspPoint given pAB_4vec = pA + pB and its mass m12
+		inline Phsp4BodyPoint calcPhspPointGivenAB(const Vec4 &pA, const Vec4 &pB, const Vec4 &pC, const Vec4 &pD, const Vec4 &pAB_4vec, double m12)
+		{
+			Phsp4BodyPoint p;
+			double sinPhi, cosPhi;
+			p._m12_MeV = m12;
+			calcPhspNoAtan2GivenAB(pA, pB, pC, pD, pAB_4vec, m12, p._m34_MeV, p._cos12, p._cos34, sinPhi, cosPhi);
+			p._phi_rad = K3PiKinematics::changeAngleRange_0_to_2pi(TMath::ATan2(sinPhi, cosPhi));
+			return p;
+		}
+
+		/**
+		 * Everything the PtEtaPhi calc_phsp computes (without angle verification) except the final atan2,
+		 * starting from the daughters after SetPtEtaPhiM and the K/pi pairing.
+		 * n1Unit/n2Unit, if given, get the unit normals of the two decay planes (for verifyAngle).
+		 */
+		inline void calcPhspPtEtaPhiNoAtan2(
+			const Vec4 &d1_lab, // pi that goes with pi
+			const Vec4 &d2_lab, // SS pi
+			const Vec4 &d3_lab, // K
+			const Vec4 &d4_lab, // pi that goes with K
+			double &m12,
+			double &m34,
+			double &cos1,
+			double &cos2,
+			double &m13,
+			double &sinPhi,
+			double &cosPhi,
+			Vec3 *n1Unit = nullptr,
+			Vec3 *n2Unit = nullptr)
+		{
+			const Vec4 mum = add(add(add(d1_lab, d2_lab), d3_lab), d4_lab);
+			m12 = invMass(add(d1_lab, d2_lab));
+			m34 = invMass(add(d3_lab, d4_lab));
+			m13 = invMass(add(d1_lab, d3_lab));
+
+			const Vec3 toD0 = minusBoostVector(mum);
+			const Vec4 d1 = boost(d1_lab, toD0);
+			const Vec4 d2 = boost(d2_lab, toD0);
+			const Vec4 d3 = boost(d3_lab, toD0);
+			const Vec4 d4 = boost(d4_lab, toD0);
+
+			const Vec4 d12 = add(d1, d2);
+			const Vec4 d34 = add(d3, d4);
+			const Vec3 d12n = unit(vect(d12));
+			const Vec3 d34n = unit(vect(d34));
+
+			const Vec3 n1 = unit(cross(unit(vect(d1)), unit(vect(d2))));
+			const Vec3 n2 = unit(cross(unit(vect(d3)), unit(vect(d4))));
+			const Vec3 n3 = cross(n1, n2);
+
+			cosPhi = dot(n1, n2);
+			sinPhi = dot(n3, d34n);
+			if (n1Unit && n2Unit)
+			{
+				*n1Unit = n1;
+				*n2Unit = n2;
+			}
+
+			const Vec3 d1rn = unit(vect(boost(d1, minusBoostVector(d12))));
+			const Vec3 d3rn = unit(vect(boost(d3, minusBoostVector(d34))));
+
+			cos1 = dot(d12n, d1rn);
+			cos2 = dot(d34n, d3rn);
+		}
+
+		// Kallen triangle function lambda(x, y, z)
+		inline double kallen(double x, double y, double z)
+		{
+			return x * x + y * y + z * z - 2.0 * (x * y + x * z + y * z);
+		}
+
+		/**
+		 * Helicity angle cosine of daughter a of the resonance r = a + b, relative to the flight direction of r in the D0 rest frame,
+		 * from invariants: with E_a, E_r and |p_r| taken in the D0 rest frame, the r rest frame momentum of a never has to be formed.
+		 */
+		inline double helicityCosFromInvariants(double eA, const Vec4 &r, double mR2, double mA2, double mB2)
+		{
+			return (2.0 * mR2 * eA - r._t * (mR2 + mA2 - mB2)) / (mag(vect(r)) * TMath::Sqrt(kallen(mR2, mA2, mB2)));
+		}
+
+		/**
+		 * Same quantities as calcPhspPtEtaPhiNoAtan2, sharing the frame computations instead of repeating them:
+		 * the D0 boost is set up once for all four daughters, there are no boosts into the resonance frames
+		 * (the cosines come from m12, m34 and the D0 frame energies, see helicityCosFromInvariants),
+		 * and the plane normals are never normalized (atan2 only needs sinPhi and cosPhi up to a common positive factor).
+		 * Agrees with calcPhspPtEtaPhiNoAtan2 to 1e-9 in cos1 and cos2, except within 1 MeV of the pi pi (cos1) or K pi (cos2) threshold:
+		 * there the numerator of helicityCosFromInvariants cancels, and for D* momenta up to 150 GeV the cosines differ by up to 5e-6
+		 * (BM_validate_calc_phsp_point_fused in the benchmarks). The masses and phi agree to 1e-9 everywhere.
+		 */
+		inline void calcPhspPtEtaPhiFusedNoAtan2(
+			const Vec4 &d1_lab, // pi that goes with pi
+			const Vec4 &d2_lab, // SS pi
+			const Vec4 &d3_lab, // K
+			const Vec4 &d4_lab, // pi that goes with K
+			double &m12,
+			double &m34,
+			double &cos1,
+			double &cos2,
+			double &m13,
+			double &sinPhiScaled,
+			double &cosPhiScaled)
+		{
+			const Vec4 d12_lab = add(d1_lab, d2_lab);
+			const Vec4 d34_lab = add(d3_lab, d4_lab);
+			m12 = invMass(d12_lab);
+			m34 = invMass(d34_lab);
+			m13 = invMass(add(d1_lab, d3_lab));
+
+			const Boost toD0(minusBoostVector(add(d12_lab, d34_lab)));
+			const Vec4 d1 = toD0(d1_lab);
+			const Vec4 d2 = toD0(d2_lab);
+			const Vec4 d3 = toD0(d3_lab);
+			const Vec4 d4 = toD0(d4_lab);
+			const Vec4 d12 = add(d1, d2);
+			const Vec4 d34 = add(d3, d4);
+
+			const double pionMass2 = K3PiKinematics::_PION_MASS * K3PiKinematics::_PION_MASS;
+			const double kaonMass2 = K3PiKinematics::_KAON_MASS * K3PiKinematics::_KAON_MASS;
+			cos1 = helicityCosFromInvariants(d1._t, d12, m12 * m12, pionMass2, pionMass2);
+			cos2 = helicityCosFromInvariants(d3._t, d34, m34 * m34, kaonMass2, pionMass2);
+
+			const Vec3 n1 = cross(vect(d1), vect(d2));
+			const Vec3 n2 = cross(vect(d3), vect(d4));
+			cosPhiScaled = dot(n1, n2) * mag(vect(d34));
+			sinPhiScaled = dot(cross(n1, n2), vect(d34));
+		}
+
+		// angleBetweenDecayPlanesKutschke
+		inline double kutschkePhi(const Vec3 &d4, const Vec3 &d5, const Vec3 &d6, const Vec3 &d7)
+		{
+			const Vec3 nHatPrime = unit(cross(unit(d4), unit(d5)));
+			const Vec3 nHatDoublePrime = unit(cross(unit(d6), unit(d7)));
+			const Vec3 p2Hat = unit(add(d4, d5));
+
+			const double cosPhi = dot(nHatDoublePrime, nHatPrime);
+			const double sinPhi = dot(cross(nHatDoublePrime, nHatPrime), p2Hat);
+
+			return TMath::ATan2(sinPhi, cosPhi);
+		}
+
+		// cosine of helicityAngle, as passed to acos
+		inline double helicityAngleCos(const Vec4 &d0, const Vec4 &pis)
+		{
+			const Vec4 dstar = add(d0, pis);
+			const Vec3 labN = unit(vect(dstar));
+			const Vec3 pisBoostN = unit(vect(boost(pis, minusBoostVector(dstar))));
+			return angleCos(pisBoostN, labN);
+		}
+
+		// helicity_angle_func: angle of the soft pion in the D* rest frame relative to the D* lab momentum
+		inline double helicityAngle(const Vec4 &d0, const Vec4 &pis)
+		{
+			return TMath::ACos(helicityAngleCos(d0, pis));
+		}
+	} // end namespace detail
+} // end namespace K3PiStudies
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include "K3PiParallelDriver.h"
+
+namespace K3PiStudies
+{
+	namespace
+	{
+		// consecutive clusters of one file, grouped into tasks of at least taskEntries entries (except the last of the file)
+		void appendFileTasks(
+			const std::string &inputFile,
+			std::size_t fileInd,
+			const std::string &treeName,
+			std::uint64_t taskEntries,
+			std::vector<K3PiEntryRange> &tasks)
+		{
+			std::unique_ptr<TFile> file(TFile::Open(inputFile.c_str(), "READ"));
+			if (!file || file->IsZombie())
+			{
+				throw std::runtime_error("K3PiParallelDriver: Could not open " + inputFile + ".");
+			}
+
+			TTree *tree = dynamic_cast<TTree *>(file->Get(treeName.c_str()));
+			if (!tree)
+			{
+				throw std::runtime_error("K3PiParallelDriver: No tree " + treeName + " in " + inputFile + ".");
+			}
+
+			const std::uint64_t numEntries = tree->GetEntries();
+			auto clusters = tree->GetClusterIterator(0);
+			std::uint64_t taskBegin = 0;
+			for (std::uint64_t clusterBegin = clusters(); clusterBegin < numEntries; clusterBegin = clusters())
+			{
+				const std::uint64_t clusterEnd = std::min<std::uint64_t>(clusters.GetNextEntry(), numEntries);
+				if (clusterEnd - taskBegin >= taskEntries)
+				{
+					tasks.push_back({fileInd, taskBegin, clusterEnd});
+					taskBegin = clusterEnd;
+				}
+			}
+			if (taskBegin < numEntries)
+			{
+				tasks.push_back({fileInd, taskBegin, numEntries});
+			}
+		}
+	} // end anonymous namespace
+
+	K3PiParallelDriver::K3PiParallelDriver(const std::vector<std::string> &inputFiles, const K3PiParallelDriverConfig &config)
+		: _driver(inputFiles, config._chunkConfig)
+	{
+		if (config._taskEntries == 0)
+		{
+			throw std::invalid_argument("K3PiParallelDriver: _taskEntries must be positive.");
+		}
+
+		for (std::size_t f = 0; f < inputFiles.size(); f++)
+		{
+			appendFileTasks(inputFiles[f], f, config._chunkConfig._treeName, config._taskEntries, _tasks);
+		}
+		for (const K3PiEntryRange &task : _tasks)
+		{
+			_numEntries += task._endEntry - task._firstEntry;
+		}
+
+		// no point in more workers than tasks
+		const unsigned int numThreads = config._numThreads > 0 ? config._numThreads : std::max(1u, std::thread::hardware_concurrency());
+		_numThreads = unsigned(std::max<std::size_t>(1, std::min<std::size_t>(numThreads, _tasks.size())));
+	}
+
+	unsigned int K3PiParallelDriver::numThreads() const
+	{
+		return _numThreads;
+	}
+
+	const std::vector<K3PiEntryRange> &K3PiParallelDriver::tasks() const
+	{
+		return _tasks;
+	}
+
+	std::uint64_t K3PiParallelDriver::numEntries() const
+	{
+		return _numEntries;
+	}
+
+	std::uint64_t K3PiParallelDriver::run(const WorkerChunkFunc &func) const
+	{
+		std::atomic<std::size_t> nextTask{0};
+		std::atomic<bool> failed{false};
+		std::atomic<std::uint64_t> numProcessed{0};
+		std::mutex errorMutex;
+		std::exception_ptr firstError;
+
+		// the shared queue: a worker that is done with its task takes the next one, until there are none left or a worker failed
+		auto nextRange = [&nextTask, &failed, this](K3PiEntryRange &range)
+		{
+			const std::size_t t = failed.load(std::memory_order_relaxed) ? _tasks.size() : nextTask.fetch_add(1, std::memory_order_relaxed);
+			if (t >= _tasks.size())
+			{
+				return false;
+			}
+			range = _tasks[t];
+			return true;
+		};
+
+		auto work = [&](unsigned int worker)
+		{
+			try
+			{
+				auto workerFunc = [&func, worker](const K3PiChunk &chunk)
+				{
+					func(worker, chunk);
+				};
+				numProcessed += _driver.run(workerFunc, nextRange);
+			}
+			catch (...)
+			{
+				failed = true;
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!firstError)
+				{
+					firstError = std::current_exception();
+				}
+			}
+		};
+
+		// the calling thread is worker 0
+		std::vector<std::thread> workers;
+		for (unsigned int w = 1; w < _numThreads; w++)
+		{
+			workers.emplace_back(work, w);
+		}
+		work(0);
+		for (std::thread &t : workers)
+		{
+			t.join();
+		}
+
+		if (firstError)
+		{
+			std::rethrow_exception(firstError);
+		}
+		return numProcessed;
+	}
+
+} // end namespace K3PiStudies
@@ -0,0 +1,360 @@
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <TDirectory.h>
+#include <TFile.h>
+#include <TKey.h>
+#include <TMath.h>
+#include <TObjString.h>
+#include <TVectorD.h>
+
+#include "K3PiPartialResults.h"
+
+namespace K3PiStudies
+{
+	namespace
+	{
+		constexpr const char *_HISTS_DIR = "hists";
+		constexpr const char *_WEIGHTED_AVGS_DIR = "weightedAvgs";
+		constexpr const char *_ASYMMETRIES_DIR = "asymmetries";
+		constexpr const char *_TASKS_NAME = "tasks";
+
+		template <std::size_t N>
+		TVectorD toVector(const std::array<double, N> &state)
+		{
+			TVectorD vec(static_cast<int>(N));
+			for (std::size_t i = 0; i < N; i++)
+			{
+				vec[int(i)] = state[i];
+			}
+			return vec;
+		}
+
+		template <std::size_t N>
+		std::array<double, N> fromVector(const TVectorD &vec, const std::string &name, const std::string &path)
+		{
+			if (vec.GetNrows() != int(N))
+			{
+				throw std::runtime_error("K3PiPartialResults::read: Accumulator " + name + " in " + path + " has the wrong size.");
+			}
+
+			std::array<double, N> state;
+			for (std::size_t i = 0; i < N; i++)
+			{
+				state[i] = vec[int(i)];
+			}
+			return state;
+		}
+
+		bool sameAxis(const TAxis &a, const TAxis &b)
+		{
+			if (a.GetNbins() != b.GetNbins())
+			{
+				return false;
+			}
+			for (int i = 1; i <= a.GetNbins() + 1; i++)
+			{
+				if (!TMath::AreEqualRel(a.GetBinLowEdge(i), b.GetBinLowEdge(i), 1e-10))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// the binning part of the consistency check in TH1::Add, so merge can refuse a histogram before it changes anything
+		bool sameBinning(const TH1 &a, const TH1 &b)
+		{
+			return a.GetDimension() == b.GetDimension() && sameAxis(*a.GetXaxis(), *b.GetXaxis()) && sameAxis(*a.GetYaxis(), *b.GetYaxis()) &&
+				   sameAxis(*a.GetZaxis(), *b.GetZaxis());
+		}
+
+		TDirectory *getDir(TFile &file, const char *dirName, const std::string &path)
+		{
+			TDirectory *dir = file.GetDirectory(dirName);
+			if (!dir)
+			{
+				throw std::runtime_error("K3PiPartialResults::read: No directory " + std::string(dirName) + " in " + path + ".");
+			}
+			return dir;
+		}
+	} // end anonymous namespace
+
+	std::string K3PiPartialResults::taskLabel(const std::string &inputFile, std::uint64_t firstEntry, std::uint64_t endEntry)
+	{
+		return inputFile + ":" + std::to_string(firstEntry) + "-" + std::to_string(endEntry);
+	}
+
+	void K3PiPartialResults::addTask(const std::string &taskLabel)
+	{
+		if (!_taskSet.insert(taskLabel).second)
+		{
+			throw std::invalid_argument("K3PiPartialResults::addTask: Task " + taskLabel + " was already processed.");
+		}
+		_tasks.push_back(taskLabel);
+	}
+
+	const std::vector<std::string> &K3PiPartialResults::tasks() const
+	{
+		return _tasks;
+	}
+
+	void K3PiPartialResults::addHist(const TH1 &h)
+	{
+		const std::string name = h.GetName();
+		const auto it = _hists.find(name);
+		if (it == _hists.end())
+		{
+			std::unique_ptr<TH1> copy(static_cast<TH1 *>(h.Clone(name.c_str())));
+			copy->SetDirectory(nullptr);
+			_hists.emplace(name, std::move(copy));
+		}
+		else if (!it->second->Add(&h))
+		{
+			throw std::invalid_argument("K3PiPartialResults::addHist: Could not add histogram " + name + " (different binning?).");
+		}
+	}
+
+	void K3PiPartialResults::addGrid(const K3PiHistGrid &grid)
+	{
+		for (std::size_t f = 0; f < grid.rsWsFlags().size(); f++)
+		{
+			for (std::size_t r = 0; r < grid.regionFlags().size(); r++)
+			{
+				for (std::size_t t = 0; t < grid.timeBins().size(); t++)
+				{
+					addHist(grid.get(f, r, t));
+				}
+			}
+		}
+	}
+
+	bool K3PiPartialResults::hasHist(const std::string &name) const
+	{
+		return _hists.count(name) > 0;
+	}
+
+	const TH1 &K3PiPartialResults::hist(const std::string &name) const
+	{
+		const auto it = _hists.find(name);
+		if (it == _hists.end())
+		{
+			throw std::out_of_range("K3PiPartialResults::hist: No histogram " + name + ".");
+		}
+		return *it->second;
+	}
+
+	std::vector<std::string> K3PiPartialResults::histNames() const
+	{
+		std::vector<std::string> names;
+		for (const auto &nameHist : _hists)
+		{
+			names.push_back(nameHist.first);
+		}
+		return names;
+	}
+
+	InvVarWeightedAvgAccumulator &K3PiPartialResults::weightedAvg(const std::string &name)
+	{
+		return _weightedAvgs[name];
+	}
+
+	AsymmetryAccumulator &K3PiPartialResults::asymmetry(const std::string &name)
+	{
+		return _asymmetries[name];
+	}
+
+	const std::map<std::string, InvVarWeightedAvgAccumulator> &K3PiPartialResults::weightedAvgs() const
+	{
+		return _weightedAvgs;
+	}
+
+	const std::map<std::string, AsymmetryAccumulator> &K3PiPartialResults::asymmetries() const
+	{
+		return _asymmetries;
+	}
+
+	void K3PiPartialResults::merge(const K3PiPartialResults &other)
+	{
+		// check first, so a duplicate task or a histogram that can't be added leaves this unchanged
+		for (const std::string &task : other._tasks)
+		{
+			if (_taskSet.count(task))
+			{
+				throw std::invalid_argument("K3PiPartialResults::merge: Task " + task + " is in both results.");
+			}
+		}
+		for (const auto &nameHist : other._hists)
+		{
+			const auto it = _hists.find(nameHist.first);
+			if (it != _hists.end() && !sameBinning(*it->second, *nameHist.second))
+			{
+				throw std::invalid_argument("K3PiPartialResults::merge: Histogram " + nameHist.first + " has a different binning in the two results.");
+			}
+		}
+
+		for (const auto &nameHist : other._hists)
+		{
+			addHist(*nameHist.second);
+		}
+		for (const auto &nameAcc : other._weightedAvgs)
+		{
+			_weightedAvgs[nameAcc.first].merge(nameAcc.second);
+		}
+		for (const auto &nameAcc : other._asymmetries)
+		{
+			_asymmetries[nameAcc.first].merge(nameAcc.second);
+		}
+
+		// last, so the tasks are only recorded once their results are in
+		for (const std::string &task : other._tasks)
+		{
+			addTask(task);
+		}
+	}
+
+	void K3PiPartialResults::write(const std::string &path) const
+	{
+		// written under a temporary name, so a reducer never picks up a half-written file; a fresh name for every write, also
+		// when jobs on several hosts write to the same directory
+		std::string tmpPath = path + ".tmpXXXXXX";
+		const int fd = ::mkstemp(&tmpPath[0]);
+		if (fd < 0)
+		{
+			throw std::runtime_error("K3PiPartialResults::write: Could not create a temporary file for " + path + ".");
+		}
+		// mkstemp makes the file readable by its owner only; the reducer may run as someone else
+		::fchmod(fd, 0644);
+		::close(fd);
+
+		bool written = true;
+		{
+			std::unique_ptr<TFile> file(TFile::Open(tmpPath.c_str(), "RECREATE"));
+			if (!file || file->IsZombie())
+			{
+				std::remove(tmpPath.c_str());
+				throw std::runtime_error("K3PiPartialResults::write: Could not create " + tmpPath + ".");
+			}
+
+			TDirectory *histsDir = file->mkdir(_HISTS_DIR);
+			for (const auto &nameHist : _hists)
+			{
+				written = histsDir->WriteObject(nameHist.second.get(), nameHist.first.c_str()) > 0 && written;
+			}
+
+			TDirectory *avgsDir = file->mkdir(_WEIGHTED_AVGS_DIR);
+			for (const auto &nameAcc : _weightedAvgs)
+			{
+				const TVectorD state = toVector(nameAcc.second.state());
+				written = avgsDir->WriteObject(&state, nameAcc.first.c_str()) > 0 && written;
+			}
+
+			TDirectory *asymsDir = file->mkdir(_ASYMMETRIES_DIR);
+			for (const auto &nameAcc : _asymmetries)
+			{
+				const TVectorD state = toVector(nameAcc.second.state());
+				written = asymsDir->WriteObject(&state, nameAcc.first.c_str()) > 0 && written;
+			}
+
+			std::string tasks;
+			for (const std::string &task : _tasks)
+			{
+				tasks += task + "\n";
+			}
+			const TObjString tasksStr(tasks.c_str());
+			written = file->WriteObject(&tasksStr, _TASKS_NAME) > 0 && written;
+
+			// Close flushes the rest; a failed write there only shows in kWriteError
+			file->Close();
+			written = !file->TestBit(TFile::kWriteError) && written;
+		}
+
+		// a truncated partial file must never replace a good one
+		if (!written)
+		{
+			std::remove(tmpPath.c_str());
+			throw std::runtime_error("K3PiPartialResults::write: Could not write " + tmpPath + ".");
+		}
+
+		if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+		{
+			std::remove(tmpPath.c_str());
+			throw std::runtime_error("K3PiPartialResults::write: Could not rename " + tmpPath + " to " + path + ".");
+		}
+	}
+
+	K3PiPartialResults K3PiPartialResults::read(const std::string &path)
+	{
+		std::unique_ptr<TFile> file(TFile::Open(path.c_str(), "READ"));
+		if (!file || file->IsZombie())
+		{
+			throw std::runtime_error("K3PiPartialResults::read: Could not open " + path + ".");
+		}
+
+		K3PiPartialResults results;
+
+		for (TObject *keyObj : *getDir(*file, _HISTS_DIR, path)->GetListOfKeys())
+		{
+			std::unique_ptr<TH1> h(dynamic_cast<TH1 *>(static_cast<TKey *>(keyObj)->ReadObj()));
+			if (!h)
+			{
+				throw std::runtime_error("K3PiPartialResults::read: " + std::string(keyObj->GetName()) + " in " + path + " is not a histogram.");
+			}
+			h->SetDirectory(nullptr);
+			results._hists[keyObj->GetName()] = std::move(h);
+		}
+
+		for (TObject *keyObj : *getDir(*file, _WEIGHTED_AVGS_DIR, path)->GetListOfKeys())
+		{
+			const std::string name = keyObj->GetName();
+			std::unique_ptr<TVectorD> state(static_cast<TKey *>(keyObj)->ReadObject<TVectorD>());
+			if (!state)
+			{
+				throw std::runtime_error("K3PiPartialResults::read: Accumulator " + name + " in " + path + " is not a TVectorD.");
+			}
+			results._weightedAvgs[name] = InvVarWeightedAvgAccumulator::fromState(fromVector<5>(*state, name, path));
+		}
+
+		for (TObject *keyObj : *getDir(*file, _ASYMMETRIES_DIR, path)->GetListOfKeys())
+		{
+			const std::string name = keyObj->GetName();
+			std::unique_ptr<TVectorD> state(static_cast<TKey *>(keyObj)->ReadObject<TVectorD>());
+			if (!state)
+			{
+				throw std::runtime_error("K3PiPartialResults::read: Accumulator " + name + " in " + path + " is not a TVectorD.");
+			}
+			results._asymmetries[name] = AsymmetryAccumulator::fromState(fromVector<8>(*state, name, path));
+		}
+
+		std::unique_ptr<TObjString> tasksStr(dynamic_cast<TObjString *>(file->Get(_TASKS_NAME)));
+		if (!tasksStr)
+		{
+			throw std::runtime_error("K3PiPartialResults::read: No task list in " + path + ".");
+		}
+		std::istringstream tasks(tasksStr->GetString().Data());
+		std::string task;
+		while (std::getline(tasks, task))
+		{
+			results.addTask(task);
+		}
+
+		return results;
+	}
+
+	K3PiPartialResults K3PiPartialResults::mergeFiles(const std::vector<std::string> &paths)
+	{
+		K3PiPartialResults merged;
+		for (const std::string &path : paths)
+		{
+			merged.merge(read(path));
+		}
+		return merged;
+	}
+
+} // end namespace K3PiStudies
@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <TMath.h>
+
+#include "K3PiKinematics.h"
+#include "K3PiInstrumentation.h"
+#include "K3PiKinematicsKernels.h"
+
+/**
+ * Batch phase space and angle kernels.
+ *
+ * Events are processed in fixed-size blocks: the trigonometric library calls (sin/cos/sinh for PtEtaPhi inputs, atan2 for phi)
+ * and the K/pi pairing run as short scalar loops, everything in between is branch-free arithmetic that the compiler vectorizes for the ISA
+ * selected at load time (see K3PI_BLOCK_KERNEL). Only IEEE add/mul/div/sqrt are vectorized and no contraction into FMA is
+ * allowed (see src/CMakeLists.txt), so every ISA gives bit-for-bit the same results as the scalar TLorentzVector versions.
+ * The RVec angle overloads work the same way, with acos as the only library call.
+ */
+
+namespace K3PiStudies
+{
+	namespace
+	{
+		constexpr std::size_t _BLOCK_SIZE = 64;
+
+		K3PI_BLOCK_KERNEL
+		void calcPhspBlock(
+			std::size_t begin,
+			std::size_t n,
+			const P4Columns &pA,
+			const P4Columns &pB,
+			const P4Columns &pC,
+			const P4Columns &pD,
+			const Phsp4BodyColumns &phsp)
+		{
+			double sinPhi[_BLOCK_SIZE];
+			double cosPhi[_BLOCK_SIZE];
+
+			K3PI_IVDEP
+			for (std::size_t j = 0; j < n; j++)
+			{
+				const std::size_t i = begin + j;
+				detail::calcPhspNoAtan2(
+					detail::columnEntry(pA, i),
+					detail::columnEntry(pB, i),
+					detail::columnEntry(pC, i),
+					detail::columnEntry(pD, i),
+					phsp._m12_MeV[i],
+					phsp._m34_MeV[i],
+					phsp._cos12[i],
+					phsp._cos34[i],
+					sinPhi[j],
+					cosPhi[j]);
+			}
+
+			for (std::size_t j = 0; j < n; j++)
+			{
+				phsp._phi_rad[begin + j] = K3PiKinematics::changeAngleRange_0_to_2pi(TMath::ATan2(sinPhi[j], cosPhi[j]));
+			}
+		}
+
+		struct PxPyPzBlock
+		{
+			double _px[_BLOCK_SIZE];
+			double _py[_BLOCK_SIZE];
+			double _pz[_BLOCK_SIZE];
+		};
+
+		// pt, eta, phi -> px, py, pz as done by TLorentzVector::SetPtEtaPhiM
+		void toPxPyPz(std::size_t begin, std::size_t n, const PtEtaPhiColumns &p, PxPyPzBlock &out)
+		{
+			for (std::size_t j = 0; j < n; j++)
+			{
+				const double pt = TMath::Abs(p._pt[begin + j]);
+				out._px[j] = pt * TMath::Cos(p._phi[begin + j]);
+				out._py[j] = pt * TMath::Sin(p._phi[begin + j]);
+				out._pz[j] = pt * sinh(p._eta[begin + j]);
+			}
+		}
+
+		// d1 = pi that goes with pi, d4 = pi that goes with K; start as OS pi 1, OS pi 2 and swap where pi 1 goes with K
+		void pairOSPions(std::size_t begin, std::size_t n, const bool *pi1GoesWithK, PxPyPzBlock &d1, PxPyPzBlock &d4)
+		{
+			for (std::size_t j = 0; j < n; j++)
+			{
+				if (pi1GoesWithK[begin + j])
+				{
+					std::swap(d1._px[j], d4._px[j]);
+					std::swap(d1._py[j], d4._py[j]);
+					std::swap(d1._pz[j], d4._pz[j]);
+				}
+			}
+		}
+
+		K3PI_BLOCK_KERNEL
+		void calcPhspPtEtaPhiBlock(
+			std::size_t begin,
+			std::size_t n,
+			const PxPyPzBlock &d1_piGoesWithPi,
+			const PxPyPzBlock &d2_ssPi,
+			const PxPyPzBlock &d3_k,
+			const PxPyPzBlock &d4_piGoesWithK,
+			const Phsp4BodyPtEtaPhiColumns &phsp)
+		{
+			double sinPhi[_BLOCK_SIZE];
+			double cosPhi[_BLOCK_SIZE];
+
+			K3PI_IVDEP
+			for (std::size_t j = 0; j < n; j++)
+			{
+				const std::size_t i = begin + j;
+				detail::calcPhspPtEtaPhiNoAtan2(
+					detail::fromXYZM(d1_piGoesWithPi._px[j], d1_piGoesWithPi._py[j], d1_piGoesWithPi._pz[j], K3PiKinematics::_PION_MASS),
+					detail::fromXYZM(d2_ssPi._px[j], d2_ssPi._py[j], d2_ssPi._pz[j], K3PiKinematics::_PION_MASS),
+					detail::fromXYZM(d3_k._px[j], d3_k._py[j], d3_k._pz[j], K3PiKinematics::_KAON_MASS),
+					detail::fromXYZM(d4_piGoesWithK._px[j], d4_piGoesWithK._py[j], d4_piGoesWithK._pz[j], K3PiKinematics::_PION_MASS),
+					phsp._m12_MeV[i],
+					phsp._m34_MeV[i],
+					phsp._cos1[i],
+					phsp._cos2[i],
+					phsp._m13_MeV[i],
+					sinPhi[j],
+					cosPhi[j]);
+			}
+
+			for (std::size_t j = 0; j < n; j++)
+			{
+				phsp._phi_rad[begin + j] = TMath::ATan2(sinPhi[j], cosPhi[j]);
+			}
+		}
+
+		K3PI_BLOCK_KERNEL
+		void helicityAngleCosines(
+			std::size_t n,
+			const float *d0_px,
+			const float *d0_py,
+			const float *d0_pz,
+			const float *d0_m,
+			const float *pis_px,
+			const float *pis_py,
+			const float *pis_pz,
+			float pis_m,
+			double *cosAngle)
+		{
+			K3PI_IVDEP
+			for (std::size_t i = 0; i < n; i++)
+			{
+				cosAngle[i] = detail::helicityAngleCos(
+					detail::fromXYZM(d0_px[i], d0_py[i], d0_pz[i], d0_m[i]),
+					detail::fromXYZM(pis_px[i], pis_py[i], pis_pz[i], pis_m));
+			}
+		}
+
+		K3PI_BLOCK_KERNEL
+		void deltaAngleCosines(
+			std::size_t n,
+			const double *extra_px,
+			const double *extra_py,
+			const double *extra_pz,
+			const detail::Vec3 &d,
+			double *cosAngle)
+		{
+			K3PI_IVDEP
+			for (std::size_t i = 0; i < n; i++)
+			{
+				cosAngle[i] = detail::angleCos(d, {extra_px[i], extra_py[i], extra_pz[i]});
+			}
+		}
+
+		K3PI_BLOCK_KERNEL
+		void deltaAngleCosines(
+			std::size_t n,
+			const double *extra_px,
+			const double *extra_py,
+			const double *extra_pz,
+			const double *d_px,
+			const double *d_py,
+			const double *d_pz,
+			double *cosAngle)
+		{
+			K3PI_IVDEP
+			for (std::size_t i = 0; i < n; i++)
+			{
+				cosAngle[i] = detail::angleCos({d_px[i], d_py[i], d_pz[i]}, {extra_px[i], extra_py[i], extra_pz[i]});
+			}
+		}
+
+		void checkSameSize(std::size_t n, std::initializer_list<std::size_t> sizes, const std::string &funcName)
+		{
+			for (std::size_t size : sizes)
+			{
+				if (size != n)
+				{
+					throw std::invalid_argument(funcName + ": All RVec inputs must have the same size.");
+				}
+			}
+		}
+	} // end anonymous namespace
+
+	/**
+	 * Batch version of calc_phsp(const TLorentzVector &...) working directly on structure-of-arrays columns.
+	 * Gives bit-for-bit the same results as calling the TLorentzVector version event by event, without building any temporaries.
+	 *
+	 * @param nEvents number of entries in every input and output column
+	 * @param phsp output columns, filled with m12, m34, cos12, cos34, phi (0 to 2pi) for each event
+	 */
+	void K3PiKinematics::calc_phsp_batch(
+		std::size_t nEvents,
+		const P4Columns &pA_IN_D0CM, // K-
+		const P4Columns &pB_IN_D0CM, // OS pi 1
+		const P4Columns &pC_IN_D0CM, // SS pi
+		const P4Columns &pD_IN_D0CM, // OS pi 2
+		const Phsp4BodyColumns &phsp)
+	{
+		K3PI_PROFILE_FUNCTION();
+		for (std::size_t begin = 0; begin < nEvents; begin += _BLOCK_SIZE)
+		{
+			const std::size_t n = std::min(_BLOCK_SIZE, nEvents - begin);
+			calcPhspBlock(begin, n, pA_IN_D0CM, pB_IN_D0CM, pC_IN_D0CM, pD_IN_D0CM, phsp);
+		}
+	}
+
+	/**
+	 * Batch version of the PtEtaPhi calc_phsp (John's apply_full_selection.py code) with verifyAngles = false.
+	 * Gives bit-for-bit the same m12, m34, cos1, cos2, phi (-pi to pi), m13 as the scalar version.
+	 *
+	 * @param pi1GoesWithK per event flag, same meaning as in the scalar version
+	 */
+	void K3PiKinematics::calc_phsp_batch(
+		std::size_t nEvents,
+		const PtEtaPhiColumns &K_D0Fit,
+		const PtEtaPhiColumns &Pi_SS_D0Fit,
+		const PtEtaPhiColumns &Pi_OS1_D0Fit,
+		const PtEtaPhiColumns &Pi_OS2_D0Fit,
+		const bool *pi1GoesWithK,
+		const Phsp4BodyPtEtaPhiColumns &phsp)
+	{
+		K3PI_PROFILE_FUNCTION();
+		PxPyPzBlock d1_piGoesWithPi, d2_ssPi, d3_k, d4_piGoesWithK;
+		for (std::size_t begin = 0; begin < nEvents; begin += _BLOCK_SIZE)
+		{
+			const std::size_t n = std::min(_BLOCK_SIZE, nEvents - begin);
+			toPxPyPz(begin, n, Pi_OS1_D0Fit, d1_piGoesWithPi);
+			toPxPyPz(begin, n, Pi_SS_D0Fit, d2_ssPi);
+			toPxPyPz(begin, n, K_D0Fit, d3_k);
+			toPxPyPz(begin, n, Pi_OS2_D0Fit, d4_piGoesWithK);
+			pairOSPions(begin, n, pi1GoesWithK, d1_piGoesWithPi, d4_piGoesWithK);
+			calcPhspPtEtaPhiBlock(begin, n, d1_piGoesWithPi, d2_ssPi, d3_k, d4_piGoesWithK, phsp);
+		}
+	}
+
+	/**
+	 * helicity_angle_func for every D0 / soft pion candidate at once (element i of the result uses element i of every input).
+	 * Same values as calling the scalar version per candidate.
+	 */
+	ROOT::RVec<float> K3PiKinematics::helicity_angle_func(
+		const ROOT::RVec<float> &d0_px,
+		const ROOT::RVec<float> &d0_py,
+		const ROOT::RVec<float> &d0_pz,
+		const ROOT::RVec<float> &d0_m,
+		const ROOT::RVec<float> &pis_px,
+		const ROOT::RVec<float> &pis_py,
+		const ROOT::RVec<float> &pis_pz,
+		float pis_m)
+	{
+		K3PI_PROFILE_FUNCTION();
+		const std::size_t n = d0_px.size();
+		checkSameSize(n, {d0_py.size(), d0_pz.size(), d0_m.size(), pis_px.size(), pis_py.size(), pis_pz.size()}, "helicity_angle_func");
+
+		ROOT::RVec<double> cosAngle(n);
+		helicityAngleCosines(n, d0_px.data(), d0_py.data(), d0_pz.data(), d0_m.data(), pis_px.data(), pis_py.data(), pis_pz.data(), pis_m, cosAngle.data());
+
+		ROOT::RVec<float> angles(n);
+		for (std::size_t i = 0; i < n; i++)
+		{
+			angles[i] = TMath::ACos(cosAngle[i]);
+		}
+		return angles;
+	}
+
+	/**
+	 * compute_delta_angle between one daughter and every extra track, e.g. all the candidates for a clone
+	 */
+	ROOT::RVec<double> K3PiKinematics::compute_delta_angle(
+		const ROOT::RVec<double> &extra_px,
+		const ROOT::RVec<double> &extra_py,
+		const ROOT::RVec<double> &extra_pz,
+		double d_px,
+		double d_py,
+		double d_pz)
+	{
+		K3PI_PROFILE_FUNCTION();
+		const std::size_t n = extra_px.size();
+		checkSameSize(n, {extra_py.size(), extra_pz.size()}, "compute_delta_angle");
+
+		ROOT::RVec<double> angles(n);
+		deltaAngleCosines(n, extra_px.data(), extra_py.data(), extra_pz.data(), {d_px, d_py, d_pz}, angles.data());
+		for (std::size_t i = 0; i < n; i++)
+		{
+			angles[i] = TMath::ACos(angles[i]);
+		}
+		return angles;
+	}
+
+	/**
+	 * compute_delta_angle for every (extra track, daughter) pair at once (element i of the result uses element i of every input)
+	 */
+	ROOT::RVec<double> K3PiKinematics::compute_delta_angle(
+		const ROOT::RVec<double> &extra_px,
+		const ROOT::RVec<double> &extra_py,
+		const ROOT::RVec<double> &extra_pz,
+		const ROOT::RVec<double> &d_px,
+		const ROOT::RVec<double> &d_py,
+		const ROOT::RVec<double> &d_pz)
+	{
+		K3PI_PROFILE_FUNCTION();
+		const std::size_t n = extra_px.size();
+		checkSameSize(n, {extra_py.size(), extra_pz.size(), d_px.size(), d_py.size(), d_pz.size()}, "compute_delta_angle");
+
+		ROOT::RVec<double> angles(n);
+		deltaAngleCosines(n, extra_px.data(), extra_py.data(), extra_pz.data(), d_px.data(), d_py.data(), d_pz.data(), angles.data());
+		for (std::size_t i = 0; i < n; i++)
+		{
+			angles[i] = TMath::ACos(angles[i]);
+		}
+		return angles;
+	}
+
+	/**
+	 * @return name of the instruction set the batch kernels were dispatched to on this machine
+	 */
+	std::string K3PiKinematics::batchKernelISA()
+	{
+		K3PI_PROFILE_FUNCTION();
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__ELF__)
+		if (__builtin_cpu_supports("avx512f"))
+		{
+			return "avx512f";
+		}
+		else if (__builtin_cpu_supports("avx2"))
+		{
+			return "avx2";
+		}
+#endif
+		return "default";
+	}
+
+} // end namespace K3PiStudies
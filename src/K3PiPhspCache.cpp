@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/algorithm/string.hpp>
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include "K3PiPhspCache.h"
+#include "K3PiChunkedDriver.h"
+
+namespace K3PiStudies
+{
+	namespace
+	{
+		constexpr char _SIDECAR_MAGIC[8] = {'K', '3', 'P', 'i', 'P', 'h', 's', 'p'};
+
+		// bump whenever the file layout or the phase space calculation changes, so old sidecars get rebuilt
+		// 2: angles from the D0 rest frame momenta (version 1 ones were computed from the lab frame momenta)
+		constexpr std::uint32_t _SIDECAR_VERSION = 2;
+
+		// on disk layout of the sidecar header; 128 bytes so the columns after it stay aligned for vector loads
+		struct SidecarHeader
+		{
+			char _magic[8];
+			std::uint32_t _version;
+			std::uint32_t _numColumns;
+			std::uint64_t _numEntries;
+			std::uint64_t _fileSize;
+			std::uint64_t _configHash;
+			std::uint32_t _fileModDate;
+			std::uint32_t _reserved0;
+			char _fileUUID[40];
+			char _reserved1[40];
+		};
+		static_assert(sizeof(SidecarHeader) == 128, "SidecarHeader must stay 128 bytes");
+
+		std::uint64_t fnv1a(const std::string &str, std::uint64_t hash = 14695981039346656037ULL)
+		{
+			for (const char c : str)
+			{
+				hash ^= static_cast<unsigned char>(c);
+				hash *= 1099511628211ULL;
+			}
+			return hash;
+		}
+
+		std::string toHex(std::uint64_t val)
+		{
+			static const char digits[] = "0123456789abcdef";
+			std::string hex(16, '0');
+			for (int i = 15; i >= 0; i--, val >>= 4)
+			{
+				hex[i] = digits[val & 0xf];
+			}
+			return hex;
+		}
+
+		// compute the phase space of every entry of inputFile, stored column after column
+		std::vector<float> computeColumns(const std::string &inputFile, const K3PiPhspCacheConfig &config, std::uint64_t numEntries)
+		{
+			std::vector<float> values(K3PiPhsp_NumColumns * numEntries, std::numeric_limits<float>::quiet_NaN());
+
+			// K3PiChunkedDriver reads the tree in entry order and gives the entry number of each chunk; rdfentry_ is not guaranteed
+			// to be the tree entry number with implicit MT in all the ROOT versions we support
+			K3PiChunkedDriverConfig driverConfig;
+			driverConfig._treeName = config._treeName;
+			driverConfig._columnConfig = config._columnConfig;
+			driverConfig._columnConfig._dstPiIDColumn = "";
+
+			// sidecars are float anyway; only RoundedFloat changes what is stored
+			float *out = values.data();
+			const K3PiColumnConfig &columnConfig = config._columnConfig;
+			const int bits = columnConfig._phspPrecision == K3PiOutputPrecision::RoundedFloat ? columnConfig._angleMantissaBits : K3PiPrecision::_FLOAT_MANTISSA_BITS;
+			K3PiChunkedDriver({inputFile}, driverConfig).run(
+				[out, numEntries, bits](const K3PiChunk &chunk)
+				{
+					for (std::size_t i = 0; i < chunk._size; i++)
+					{
+						const std::uint64_t entry = chunk._firstEntry + i;
+						out[K3PiPhsp_m12 * numEntries + entry] = K3PiPrecision::roundToFloat(chunk._m12_MeV[i]);
+						out[K3PiPhsp_m34 * numEntries + entry] = K3PiPrecision::roundToFloat(chunk._m34_MeV[i]);
+						out[K3PiPhsp_cos12 * numEntries + entry] = K3PiPrecision::roundToFloat(chunk._cos12[i], bits);
+						out[K3PiPhsp_cos34 * numEntries + entry] = K3PiPrecision::roundToFloat(chunk._cos34[i], bits);
+						out[K3PiPhsp_phi * numEntries + entry] = K3PiPrecision::roundToFloat(chunk._phi_rad[i], bits);
+					}
+				});
+
+			return values;
+		}
+	} // end anonymous namespace
+
+	bool K3PiPhspCacheKey::operator==(const K3PiPhspCacheKey &other) const
+	{
+		return _fileUUID == other._fileUUID && _fileSize == other._fileSize && _fileModDate == other._fileModDate &&
+			   _numEntries == other._numEntries && _configHash == other._configHash;
+	}
+
+	K3PiPhspSidecar::K3PiPhspSidecar(const std::string &path)
+	{
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			throw std::runtime_error("K3PiPhspSidecar: Could not open " + path + ".");
+		}
+
+		struct stat st;
+		if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(SidecarHeader)))
+		{
+			::close(fd);
+			throw std::runtime_error("K3PiPhspSidecar: " + path + " is too small to be a sidecar.");
+		}
+
+		_mapSize = st.st_size;
+		_map = ::mmap(nullptr, _mapSize, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (_map == MAP_FAILED)
+		{
+			_map = nullptr;
+			throw std::runtime_error("K3PiPhspSidecar: Could not map " + path + ".");
+		}
+
+		SidecarHeader header;
+		std::memcpy(&header, _map, sizeof(header));
+		const bool isSidecar = std::memcmp(header._magic, _SIDECAR_MAGIC, sizeof(_SIDECAR_MAGIC)) == 0 &&
+							   header._version == _SIDECAR_VERSION &&
+							   header._numColumns == K3PiPhsp_NumColumns &&
+							   _mapSize == sizeof(SidecarHeader) + K3PiPhsp_NumColumns * header._numEntries * sizeof(float);
+		if (!isSidecar)
+		{
+			unmap();
+			throw std::runtime_error("K3PiPhspSidecar: " + path + " is not a version " + std::to_string(_SIDECAR_VERSION) + " sidecar.");
+		}
+
+		header._fileUUID[sizeof(header._fileUUID) - 1] = '\0';
+		_key = {header._fileUUID, header._fileSize, header._fileModDate, header._numEntries, header._configHash};
+		_values = reinterpret_cast<const float *>(static_cast<const char *>(_map) + sizeof(SidecarHeader));
+
+		// the columns are read front to back
+		::madvise(_map, _mapSize, MADV_SEQUENTIAL);
+	}
+
+	K3PiPhspSidecar::K3PiPhspSidecar(K3PiPhspSidecar &&moveMe) noexcept
+		: _map(moveMe._map),
+		  _mapSize(moveMe._mapSize),
+		  _key(std::move(moveMe._key)),
+		  _values(moveMe._values)
+	{
+		moveMe._map = nullptr;
+		moveMe._mapSize = 0;
+		moveMe._values = nullptr;
+	}
+
+	K3PiPhspSidecar &K3PiPhspSidecar::operator=(K3PiPhspSidecar &&moveMe) noexcept
+	{
+		if (this != &moveMe)
+		{
+			unmap();
+			std::swap(_map, moveMe._map);
+			std::swap(_mapSize, moveMe._mapSize);
+			std::swap(_values, moveMe._values);
+			_key = std::move(moveMe._key);
+		}
+		return *this;
+	}
+
+	K3PiPhspSidecar::~K3PiPhspSidecar()
+	{
+		unmap();
+	}
+
+	void K3PiPhspSidecar::unmap()
+	{
+		if (_map)
+		{
+			::munmap(_map, _mapSize);
+		}
+		_map = nullptr;
+		_mapSize = 0;
+		_values = nullptr;
+	}
+
+	void K3PiPhspSidecar::write(const std::string &path, const K3PiPhspCacheKey &key, const std::vector<float> &columnMajorValues)
+	{
+		if (columnMajorValues.size() != K3PiPhsp_NumColumns * key._numEntries)
+		{
+			throw std::invalid_argument("K3PiPhspSidecar::write: Expected " + std::to_string(K3PiPhsp_NumColumns * key._numEntries) +
+										" values, got " + std::to_string(columnMajorValues.size()) + ".");
+		}
+
+		SidecarHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header._magic, _SIDECAR_MAGIC, sizeof(_SIDECAR_MAGIC));
+		header._version = _SIDECAR_VERSION;
+		header._numColumns = K3PiPhsp_NumColumns;
+		header._numEntries = key._numEntries;
+		header._fileSize = key._fileSize;
+		header._configHash = key._configHash;
+		header._fileModDate = key._fileModDate;
+		std::strncpy(header._fileUUID, key._fileUUID.c_str(), sizeof(header._fileUUID) - 1);
+
+		// a fresh name for every write, also when jobs on several hosts share the cache directory
+		std::string tmpPath = path + ".tmpXXXXXX";
+		const int fd = ::mkstemp(&tmpPath[0]);
+		if (fd < 0)
+		{
+			throw std::runtime_error("K3PiPhspSidecar::write: Could not create a temporary file for " + path + ".");
+		}
+		// mkstemp makes the file readable by its owner only; sidecars are read by whoever reads the ntuple
+		::fchmod(fd, 0644);
+
+		std::FILE *out = ::fdopen(fd, "wb");
+		if (!out)
+		{
+			::close(fd);
+			std::remove(tmpPath.c_str());
+			throw std::runtime_error("K3PiPhspSidecar::write: Could not write " + tmpPath + ".");
+		}
+		bool written = std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+					   std::fwrite(columnMajorValues.data(), sizeof(float), columnMajorValues.size(), out) == columnMajorValues.size();
+		written = std::fclose(out) == 0 && written;
+		if (!written)
+		{
+			std::remove(tmpPath.c_str());
+			throw std::runtime_error("K3PiPhspSidecar::write: Could not write " + tmpPath + ".");
+		}
+
+		if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+		{
+			std::remove(tmpPath.c_str());
+			throw std::runtime_error("K3PiPhspSidecar::write: Could not rename " + tmpPath + " to " + path + ".");
+		}
+	}
+
+	const K3PiPhspCacheKey &K3PiPhspSidecar::key() const
+	{
+		return _key;
+	}
+
+	std::uint64_t K3PiPhspSidecar::numEntries() const
+	{
+		return _key._numEntries;
+	}
+
+	const float *K3PiPhspSidecar::column(K3PiPhsp_Columns col) const
+	{
+		return _values + col * _key._numEntries;
+	}
+
+	K3PiPhspCache::K3PiPhspCache(const std::vector<std::string> &inputFiles, const K3PiPhspCacheConfig &config)
+		: _sidecars(std::make_shared<std::vector<K3PiPhspSidecar>>())
+	{
+		_sidecars->reserve(inputFiles.size());
+		_fileOffsets.reserve(inputFiles.size() + 1);
+		_fileOffsets.push_back(0);
+
+		for (const std::string &inputFile : inputFiles)
+		{
+			const std::string path = sidecarPath(inputFile, config);
+			const K3PiPhspCacheKey key = makeKey(inputFile, config);
+
+			bool upToDate = false;
+			if (std::filesystem::exists(path))
+			{
+				try
+				{
+					K3PiPhspSidecar existing(path);
+					upToDate = existing.key() == key;
+					if (upToDate)
+					{
+						_sidecars->push_back(std::move(existing));
+					}
+				}
+				catch (const std::runtime_error &)
+				{
+					// unreadable or an old format, rebuild it
+				}
+			}
+
+			if (!upToDate)
+			{
+				K3PiPhspSidecar::write(path, key, computeColumns(inputFile, config, key._numEntries));
+				_sidecars->emplace_back(path);
+			}
+
+			_fileOffsets.push_back(_fileOffsets.back() + key._numEntries);
+		}
+	}
+
+	std::string K3PiPhspCache::sidecarPath(const std::string &inputFile, const K3PiPhspCacheConfig &config)
+	{
+		const std::string fileName = std::filesystem::path(inputFile).filename().string();
+		return (std::filesystem::path(config._cacheDir) / (fileName + "." + toHex(fnv1a(inputFile)) + ".k3piphsp")).string();
+	}
+
+	K3PiPhspCacheKey K3PiPhspCache::makeKey(const std::string &inputFile, const K3PiPhspCacheConfig &config)
+	{
+		std::unique_ptr<TFile> file(TFile::Open(inputFile.c_str(), "READ"));
+		if (!file || file->IsZombie())
+		{
+			throw std::runtime_error("K3PiPhspCache: Could not open " + inputFile + ".");
+		}
+
+		TTree *tree = dynamic_cast<TTree *>(file->Get(config._treeName.c_str()));
+		if (!tree)
+		{
+			throw std::runtime_error("K3PiPhspCache: No tree " + config._treeName + " in " + inputFile + ".");
+		}
+
+		// the flag is matched case insensitively everywhere else, so hash it in one case
+		std::uint64_t configHash = fnv1a(config._treeName);
+		configHash = fnv1a(std::string(1, '\0') + boost::to_upper_copy(config._columnConfig._fitFlag), configHash);
+		configHash = fnv1a(config._columnConfig._floatMomenta ? "F" : "D", configHash);
+		if (config._columnConfig._phspPrecision == K3PiOutputPrecision::RoundedFloat && config._columnConfig._angleMantissaBits < K3PiPrecision::_FLOAT_MANTISSA_BITS)
+		{
+			// Double and Float both give plain float sidecars, which keep their existing keys
+			configHash = fnv1a("R" + std::to_string(config._columnConfig._angleMantissaBits), configHash);
+		}
+
+		return {file->GetUUID().AsString(),
+				static_cast<std::uint64_t>(file->GetSize()),
+				file->GetModificationDate().Get(),
+				static_cast<std::uint64_t>(tree->GetEntries()),
+				configHash};
+	}
+
+	std::size_t K3PiPhspCache::numFiles() const
+	{
+		return _sidecars->size();
+	}
+
+	std::uint64_t K3PiPhspCache::numEntries() const
+	{
+		return _fileOffsets.back();
+	}
+
+	std::uint64_t K3PiPhspCache::fileOffset(std::size_t fileInd) const
+	{
+		return _fileOffsets.at(fileInd);
+	}
+
+	const K3PiPhspSidecar &K3PiPhspCache::sidecar(std::size_t fileInd) const
+	{
+		return _sidecars->at(fileInd);
+	}
+
+	ROOT::RDF::RNode K3PiPhspCache::dataFrame(const std::string &prefix) const
+	{
+		const std::shared_ptr<const std::vector<K3PiPhspSidecar>> sidecars = _sidecars;
+		const std::vector<std::uint64_t> offsets = _fileOffsets;
+
+		ROOT::RDF::RNode out = ROOT::RDataFrame(numEntries());
+		out = out.Define(
+			prefix + "fileInd",
+			[offsets](ULong64_t entry)
+			{ return static_cast<unsigned int>(std::upper_bound(offsets.begin() + 1, offsets.end(), entry) - (offsets.begin() + 1)); },
+			{"rdfentry_"});
+		out = out.Define(
+			prefix + "entry",
+			[offsets](ULong64_t entry, unsigned int fileInd) { return ULong64_t(entry - offsets[fileInd]); },
+			{"rdfentry_", prefix + "fileInd"});
+
+		const ROOT::RDF::ColumnNames_t pos = {prefix + "fileInd", prefix + "entry"};
+		const char *names[K3PiPhsp_NumColumns] = {"m12", "m34", "cos12", "cos34", "phi"};
+		for (int c = 0; c < K3PiPhsp_NumColumns; c++)
+		{
+			const K3PiPhsp_Columns col = static_cast<K3PiPhsp_Columns>(c);
+			out = out.Define(
+				prefix + names[c],
+				[sidecars, col](unsigned int fileInd, ULong64_t entry) { return (*sidecars)[fileInd].column(col)[entry]; },
+				pos);
+		}
+
+		return out;
+	}
+
+} // end namespace K3PiStudies
@@ -0,0 +1,194 @@
+#include <limits>
+#include <stdexcept>
+
+#include <boost/algorithm/string.hpp>
+
+#include "K3PiRDFPipeline.h"
+#include "K3PiKinematicsKernels.h"
+
+namespace K3PiStudies
+{
+	namespace
+	{
+		/**
+		 * The whole daughter identification -> getD0Part_* -> calc_phsp chain for one candidate.
+		 * MomT is the type of the PX/PY/PZ/PE branches; RDF needs it to match exactly so it can skip the jitting.
+		 */
+		template <typename MomT>
+		struct BuildK3PiCandidate
+		{
+			K3PiCandidate operator()(
+				int p0_ID, int p1_ID, int p2_ID, int p3_ID,
+				MomT p0_PX, MomT p1_PX, MomT p2_PX, MomT p3_PX,
+				MomT p0_PY, MomT p1_PY, MomT p2_PY, MomT p3_PY,
+				MomT p0_PZ, MomT p1_PZ, MomT p2_PZ, MomT p3_PZ,
+				MomT p0_PE, MomT p1_PE, MomT p2_PE, MomT p3_PE) const
+			{
+				const DecayPermutation perm = DecayPermutation::fromIDs(p0_ID, p1_ID, p2_ID, p3_ID);
+				if (!perm.isValid())
+				{
+					const double nan = std::numeric_limits<double>::quiet_NaN();
+					return {false, false, -1, -1, -1, -1,
+							{nan, nan, nan, nan}, {nan, nan, nan, nan}, {nan, nan, nan, nan}, {nan, nan, nan, nan},
+							{nan, nan, nan, nan}, {nan, nan, nan, nan}, {nan, nan, nan, nan}, {nan, nan, nan, nan},
+							{nan, nan, nan, nan, nan}};
+				}
+
+				K3PiCandidate cand;
+				cand._isValid = true;
+				cand._kaonIsNeg = perm.kaonIsNeg();
+				cand._kaonInd = perm.index(K3Pi_Kaon);
+				cand._osPion1Ind = perm.index(K3Pi_OSPion1);
+				cand._ssPionInd = perm.index(K3Pi_SSPion);
+				cand._osPion2Ind = perm.index(K3Pi_OSPion2);
+
+				const double px[4] = {double(p0_PX), double(p1_PX), double(p2_PX), double(p3_PX)};
+				const double py[4] = {double(p0_PY), double(p1_PY), double(p2_PY), double(p3_PY)};
+				const double pz[4] = {double(p0_PZ), double(p1_PZ), double(p2_PZ), double(p3_PZ)};
+				const double pE[4] = {double(p0_PE), double(p1_PE), double(p2_PE), double(p3_PE)};
+
+				detail::Vec4 p4[4];
+				for (int r = 0; r < 4; r++)
+				{
+					const int i = perm.index(static_cast<K3Pi_Roles>(r));
+					cand._px[r] = px[i];
+					cand._py[r] = py[i];
+					cand._pz[r] = pz[i];
+					cand._pE[r] = pE[i];
+					p4[r] = {px[i], py[i], pz[i], pE[i]};
+				}
+
+				// the branches are lab frame; the angles are defined in the D0 rest frame
+				detail::Vec4 p4D0CM[4];
+				detail::boostToRestFrame(p4, p4D0CM);
+				for (int r = 0; r < 4; r++)
+				{
+					cand._pxD0CM[r] = p4D0CM[r]._x;
+					cand._pyD0CM[r] = p4D0CM[r]._y;
+					cand._pzD0CM[r] = p4D0CM[r]._z;
+					cand._pED0CM[r] = p4D0CM[r]._t;
+				}
+
+				cand._phsp = detail::calcPhspPoint(p4D0CM[0], p4D0CM[1], p4D0CM[2], p4D0CM[3]);
+
+				return cand;
+			}
+		};
+
+		template <typename MomT>
+		ROOT::RDF::RNode defineCandidateColumn(ROOT::RDF::RNode df, const std::string &colName, const std::string &fitFlag)
+		{
+			ROOT::RDF::ColumnNames_t inputs;
+			for (const char *var : {"ID", "PX", "PY", "PZ", "PE"})
+			{
+				const std::vector<std::string> names = K3PiRDFPipeline::daughterBranchNames(fitFlag, var);
+				inputs.insert(inputs.end(), names.begin(), names.end());
+			}
+
+			return df.Define(colName, BuildK3PiCandidate<MomT>(), inputs);
+		}
+	} // end anonymous namespace
+
+	/**
+	 * @param fitFlag K3PiStudiesUtils::_P_FLAG, _D0_FIT_FLAG or _REFIT_FLAG
+	 * @param varName branch suffix, e.g. "ID" or "PX"
+	 * @return the 4 daughter branch names, in the same order as the D0_P0...D0_P3 / *_PNames indices
+	 */
+	std::vector<std::string> K3PiRDFPipeline::daughterBranchNames(const std::string &fitFlag, const std::string &varName)
+	{
+		if (boost::iequals(fitFlag, K3PiStudiesUtils::_P_FLAG))
+		{
+			return {"D0_P0_" + varName, "D0_P1_" + varName, "D0_P2_" + varName, "D0_P3_" + varName};
+		}
+		else if (boost::iequals(fitFlag, K3PiStudiesUtils::_D0_FIT_FLAG))
+		{
+			return {"Dst_D0Fit_D0_Kplus_" + varName,
+					"Dst_D0Fit_D0_piplus_0_" + varName,
+					"Dst_D0Fit_D0_piplus_1_" + varName,
+					"Dst_D0Fit_D0_piplus_" + varName};
+		}
+		else if (boost::iequals(fitFlag, K3PiStudiesUtils::_REFIT_FLAG))
+		{
+			return {"Dst_ReFit_D0_Kplus_" + varName,
+					"Dst_ReFit_D0_piplus_0_" + varName,
+					"Dst_ReFit_D0_piplus_1_" + varName,
+					"Dst_ReFit_D0_piplus_" + varName};
+		}
+		else
+		{
+			throw std::invalid_argument("daughterBranchNames: Unknown fit flag " + fitFlag + ".");
+		}
+	}
+
+	/**
+	 * Attaches all K3Pi derived columns to df using compiled (not jitted) Defines.
+	 * The particle assignment and phase space are computed once per event into the <prefix>candidate column;
+	 * every other column just reads a field of it.
+	 *
+	 * Defines (all prefixed with config._outPrefix):
+	 * candidate, isValidDecay, kaonIsNeg, kaonInd, osPion1Ind, ssPionInd, osPion2Ind,
+	 * {K, OSPi1, SSPi, OSPi2}_{PX, PY, PZ, PE} (as read), the same boosted into the D0 rest frame as {...}_{PX, ...}_D0CM,
+	 * m12, m34, cos12, cos34, phi (computed from the D0 rest frame momenta, like calc_phsp expects them)
+	 * and, if config._dstPiIDColumn is set, isD0 and isRS.
+	 * m12 ... phi are double, or float if config._phspPrecision asks for it; the candidate column always keeps the double values.
+	 *
+	 * Candidates that fail the daughter identification are not dropped; filter on isValidDecay before using the other columns.
+	 */
+	ROOT::RDF::RNode K3PiRDFPipeline::defineK3PiColumns(ROOT::RDF::RNode df, const K3PiColumnConfig &config)
+	{
+		const std::string &pre = config._outPrefix;
+		const std::string candCol = pre + "candidate";
+		const ROOT::RDF::ColumnNames_t cand = {candCol};
+
+		ROOT::RDF::RNode out = config._floatMomenta
+								   ? defineCandidateColumn<float>(df, candCol, config._fitFlag)
+								   : defineCandidateColumn<double>(df, candCol, config._fitFlag);
+
+		out = out.Define(pre + "isValidDecay", [](const K3PiCandidate &c) { return c._isValid; }, cand);
+		out = out.Define(pre + "kaonIsNeg", [](const K3PiCandidate &c) { return c._kaonIsNeg; }, cand);
+		out = out.Define(pre + "kaonInd", [](const K3PiCandidate &c) { return c._kaonInd; }, cand);
+		out = out.Define(pre + "osPion1Ind", [](const K3PiCandidate &c) { return c._osPion1Ind; }, cand);
+		out = out.Define(pre + "ssPionInd", [](const K3PiCandidate &c) { return c._ssPionInd; }, cand);
+		out = out.Define(pre + "osPion2Ind", [](const K3PiCandidate &c) { return c._osPion2Ind; }, cand);
+
+		for (int r = 0; r < 4; r++)
+		{
+			const std::string role = pre + _ROLE_NAMES[r];
+			out = out.Define(role + "_PX", [r](const K3PiCandidate &c) { return c._px[r]; }, cand);
+			out = out.Define(role + "_PY", [r](const K3PiCandidate &c) { return c._py[r]; }, cand);
+			out = out.Define(role + "_PZ", [r](const K3PiCandidate &c) { return c._pz[r]; }, cand);
+			out = out.Define(role + "_PE", [r](const K3PiCandidate &c) { return c._pE[r]; }, cand);
+			out = out.Define(role + "_PX_D0CM", [r](const K3PiCandidate &c) { return c._pxD0CM[r]; }, cand);
+			out = out.Define(role + "_PY_D0CM", [r](const K3PiCandidate &c) { return c._pyD0CM[r]; }, cand);
+			out = out.Define(role + "_PZ_D0CM", [r](const K3PiCandidate &c) { return c._pzD0CM[r]; }, cand);
+			out = out.Define(role + "_PE_D0CM", [r](const K3PiCandidate &c) { return c._pED0CM[r]; }, cand);
+		}
+
+		if (config._phspPrecision == K3PiOutputPrecision::Double)
+		{
+			out = out.Define(pre + "m12", [](const K3PiCandidate &c) { return c._phsp._m12_MeV; }, cand);
+			out = out.Define(pre + "m34", [](const K3PiCandidate &c) { return c._phsp._m34_MeV; }, cand);
+			out = out.Define(pre + "cos12", [](const K3PiCandidate &c) { return c._phsp._cos12; }, cand);
+			out = out.Define(pre + "cos34", [](const K3PiCandidate &c) { return c._phsp._cos34; }, cand);
+			out = out.Define(pre + "phi", [](const K3PiCandidate &c) { return c._phsp._phi_rad; }, cand);
+		}
+		else
+		{
+			const int bits = config._phspPrecision == K3PiOutputPrecision::RoundedFloat ? config._angleMantissaBits : K3PiPrecision::_FLOAT_MANTISSA_BITS;
+			out = out.Define(pre + "m12", [](const K3PiCandidate &c) { return K3PiPrecision::roundToFloat(c._phsp._m12_MeV); }, cand);
+			out = out.Define(pre + "m34", [](const K3PiCandidate &c) { return K3PiPrecision::roundToFloat(c._phsp._m34_MeV); }, cand);
+			out = out.Define(pre + "cos12", [bits](const K3PiCandidate &c) { return K3PiPrecision::roundToFloat(c._phsp._cos12, bits); }, cand);
+			out = out.Define(pre + "cos34", [bits](const K3PiCandidate &c) { return K3PiPrecision::roundToFloat(c._phsp._cos34, bits); }, cand);
+			out = out.Define(pre + "phi", [bits](const K3PiCandidate &c) { return K3PiPrecision::roundToFloat(c._phsp._phi_rad, bits); }, cand);
+		}
+
+		if (!config._dstPiIDColumn.empty())
+		{
+			out = out.Define(pre + "isD0", [](int dStarPiID) { return K3PiStudiesUtils::isD0(dStarPiID); }, {config._dstPiIDColumn});
+			out = out.Define(pre + "isRS", [](bool isD0, const K3PiCandidate &c) { return K3PiStudiesUtils::isRS(isD0, c._kaonIsNeg); }, {pre + "isD0", candCol});
+		}
+
+		return out;
+	}
+
+} // end namespace K3PiStudies
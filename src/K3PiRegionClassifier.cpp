@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include <boost/algorithm/string.hpp>
+
+#include "K3PiRegionClassifier.h"
+#include "K3PiStudiesUtils.h"
+
+namespace K3PiStudies
+{
+
+	K3PiRegionClassifier::K3PiRegionClassifier(const std::vector<std::string> &regionFlags, const std::vector<double> &upperTimeBinEdges)
+		: _upperTimeBinEdges(upperTimeBinEdges),
+		  _timeBins(K3PiStudiesUtils::makeTimeBins(upperTimeBinEdges)),
+		  _uniformTimeBins(false),
+		  _firstEdge(0.0),
+		  _invEdgeSpacing(0.0)
+	{
+		if (regionFlags.size() > 32)
+		{
+			throw std::invalid_argument("K3PiRegionClassifier: At most 32 regions are supported.");
+		}
+
+		for (const std::string &flag : regionFlags)
+		{
+			const double inf = std::numeric_limits<double>::infinity();
+			if (boost::iequals(flag, K3PiStudiesUtils::_ALL_REGION_FLAG))
+			{
+				_regions.push_back({flag, true, -inf, inf, -inf, inf,
+									K3PiStudiesUtils::getRegionAxisBoundsMD0MeV(flag),
+									K3PiStudiesUtils::getRegionAxisBoundsDeltaMMeV(flag)});
+			}
+			else if (boost::iequals(flag, K3PiStudiesUtils::_SIG_REGION_FLAG))
+			{
+				_regions.push_back({flag, false,
+									K3PiStudiesUtils::_SIG_REGION_LOW_MD0_BOUND_MEV, K3PiStudiesUtils::_SIG_REGION_HIGH_MD0_BOUND_MEV,
+									K3PiStudiesUtils::_SIG_REGION_LOW_DELTAM_BOUND_MEV, K3PiStudiesUtils::_SIG_REGION_HIGH_DELTAM_BOUND_MEV,
+									K3PiStudiesUtils::getRegionAxisBoundsMD0MeV(flag),
+									K3PiStudiesUtils::getRegionAxisBoundsDeltaMMeV(flag)});
+			}
+			else
+			{
+				throw std::invalid_argument("K3PiRegionClassifier: Unknown region " + flag + ".");
+			}
+		}
+
+		for (std::size_t e = 1; e < _upperTimeBinEdges.size(); e++)
+		{
+			if (!(_upperTimeBinEdges[e - 1] < _upperTimeBinEdges[e]))
+			{
+				throw std::invalid_argument("K3PiRegionClassifier: Time bin edges must be strictly increasing.");
+			}
+		}
+
+		if (_upperTimeBinEdges.size() >= 2)
+		{
+			const double spacing = _upperTimeBinEdges[1] - _upperTimeBinEdges[0];
+			_uniformTimeBins = true;
+			for (std::size_t e = 1; e < _upperTimeBinEdges.size(); e++)
+			{
+				const double expectedEdge = _upperTimeBinEdges[0] + e * spacing;
+				_uniformTimeBins &= std::abs(_upperTimeBinEdges[e] - expectedEdge) <= 1e-9 * spacing;
+			}
+			_firstEdge = _upperTimeBinEdges[0];
+			_invEdgeSpacing = 1.0 / spacing;
+		}
+	}
+
+	std::size_t K3PiRegionClassifier::numRegions() const
+	{
+		return _regions.size();
+	}
+
+	std::size_t K3PiRegionClassifier::numTimeBins() const
+	{
+		return _timeBins.size();
+	}
+
+	std::size_t K3PiRegionClassifier::numBins() const
+	{
+		return _regions.size() * _timeBins.size();
+	}
+
+	int K3PiRegionClassifier::timeBin(double decayTime) const
+	{
+		// last bin is [edge, inf), so neither NaN nor +inf fall in any bin
+		if (!(decayTime < std::numeric_limits<double>::infinity()))
+		{
+			return -1;
+		}
+
+		const int numEdges = _upperTimeBinEdges.size();
+		if (_uniformTimeBins)
+		{
+			// the arithmetic guess can be off by one next to an edge because of rounding; fix it up with the same comparisons the bins use
+			const double guess = std::floor((decayTime - _firstEdge) * _invEdgeSpacing) + 1.0;
+			int bin = guess < 0.0 ? 0 : (guess > numEdges ? numEdges : static_cast<int>(guess));
+			if (bin > 0 && decayTime < _upperTimeBinEdges[bin - 1])
+			{
+				bin--;
+			}
+			else if (bin < numEdges && decayTime >= _upperTimeBinEdges[bin])
+			{
+				bin++;
+			}
+			return bin;
+		}
+
+		// bin b is [edge b-1, edge b), i.e. the number of edges <= decayTime
+		return std::upper_bound(_upperTimeBinEdges.begin(), _upperTimeBinEdges.end(), decayTime) - _upperTimeBinEdges.begin();
+	}
+
+	bool K3PiRegionClassifier::isInRegion(std::size_t regionInd, double d0MassMeV, double deltaMMeV) const
+	{
+		const Region &reg = _regions[regionInd];
+		return reg._acceptsAll |
+			   ((d0MassMeV >= reg._lowMD0MeV) & (d0MassMeV <= reg._highMD0MeV) &
+				(deltaMMeV >= reg._lowDeltaMMeV) & (deltaMMeV <= reg._highDeltaMMeV));
+	}
+
+	std::uint32_t K3PiRegionClassifier::regionMask(double d0MassMeV, double deltaMMeV) const
+	{
+		std::uint32_t mask = 0;
+		for (std::size_t r = 0; r < _regions.size(); r++)
+		{
+			mask |= std::uint32_t(isInRegion(r, d0MassMeV, deltaMMeV)) << r;
+		}
+		return mask;
+	}
+
+	int K3PiRegionClassifier::denseIndex(std::size_t regionInd, double d0MassMeV, double deltaMMeV, double decayTime) const
+	{
+		const int bin = timeBin(decayTime);
+		if (bin < 0 || !isInRegion(regionInd, d0MassMeV, deltaMMeV))
+		{
+			return -1;
+		}
+		return regionInd * _timeBins.size() + bin;
+	}
+
+	void K3PiRegionClassifier::classify(
+		std::size_t nEvents,
+		const double *d0MassMeV,
+		const double *deltaMMeV,
+		const double *decayTime,
+		int *timeBins,
+		std::uint32_t *regionMasks) const
+	{
+		for (std::size_t i = 0; i < nEvents; i++)
+		{
+			timeBins[i] = timeBin(decayTime[i]);
+		}
+
+		for (std::size_t i = 0; i < nEvents; i++)
+		{
+			regionMasks[i] = 0;
+		}
+
+		// region-major so the inner loop is the same few comparisons for every event
+		for (std::size_t r = 0; r < _regions.size(); r++)
+		{
+			const Region &reg = _regions[r];
+			for (std::size_t i = 0; i < nEvents; i++)
+			{
+				const bool inRegion = reg._acceptsAll |
+									  ((d0MassMeV[i] >= reg._lowMD0MeV) & (d0MassMeV[i] <= reg._highMD0MeV) &
+									   (deltaMMeV[i] >= reg._lowDeltaMMeV) & (deltaMMeV[i] <= reg._highDeltaMMeV));
+				regionMasks[i] |= std::uint32_t(inRegion) << r;
+			}
+		}
+	}
+
+	const std::pair<double, double> &K3PiRegionClassifier::axisBoundsMD0MeV(std::size_t regionInd) const
+	{
+		return _regions.at(regionInd)._axisBoundsMD0MeV;
+	}
+
+	const std::pair<double, double> &K3PiRegionClassifier::axisBoundsDeltaMMeV(std::size_t regionInd) const
+	{
+		return _regions.at(regionInd)._axisBoundsDeltaMMeV;
+	}
+
+	const std::string &K3PiRegionClassifier::regionFlag(std::size_t regionInd) const
+	{
+		return _regions.at(regionInd)._flag;
+	}
+
+	const std::vector<std::pair<double, double>> &K3PiRegionClassifier::timeBins() const
+	{
+		return _timeBins;
+	}
+
+} // end namespace K3PiStudies
@@ -0,0 +1,83 @@
+#include "K3PiScratchArena.h"
+
+namespace K3PiStudies
+{
+
+	void *K3PiScratchArena::UpstreamCounter::do_allocate(std::size_t bytes, std::size_t alignment)
+	{
+		_bytesSinceReset += bytes;
+		_numAllocations++;
+		return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+
+	void K3PiScratchArena::UpstreamCounter::do_deallocate(void *p, std::size_t bytes, std::size_t alignment)
+	{
+		std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+	}
+
+	bool K3PiScratchArena::UpstreamCounter::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+	{
+		return this == &other;
+	}
+
+	K3PiScratchArena::K3PiScratchArena(std::size_t initialBytes)
+		: _block(new std::byte[initialBytes > 0 ? initialBytes : 1]), _capacity(initialBytes > 0 ? initialBytes : 1)
+	{
+		_resource.emplace(_block.get(), _capacity, &_upstream);
+	}
+
+	K3PiScratchArena &K3PiScratchArena::threadLocal()
+	{
+		thread_local K3PiScratchArena arena;
+		return arena;
+	}
+
+	std::pmr::memory_resource *K3PiScratchArena::resource()
+	{
+		return &*_resource;
+	}
+
+	void K3PiScratchArena::reset()
+	{
+		if (_upstream._bytesSinceReset == 0)
+		{
+			// nothing went past the block, so rewinding is all there is to do
+			_resource->release();
+			return;
+		}
+
+		// grow the block to what was needed, with the same headroom the overflow blocks had
+		const std::size_t needed = _capacity + _upstream._bytesSinceReset;
+		_resource.reset();
+		_block.reset(new std::byte[needed]);
+		_capacity = needed;
+		_upstream._bytesSinceReset = 0;
+		_resource.emplace(_block.get(), _capacity, &_upstream);
+	}
+
+	std::size_t K3PiScratchArena::capacity() const
+	{
+		return _capacity;
+	}
+
+	std::uint64_t K3PiScratchArena::numUpstreamAllocations() const
+	{
+		return _upstream._numAllocations;
+	}
+
+	K3PiScratchScope::K3PiScratchScope(K3PiScratchArena &arena)
+		: _arena(arena)
+	{
+	}
+
+	K3PiScratchScope::~K3PiScratchScope()
+	{
+		_arena.reset();
+	}
+
+	std::pmr::memory_resource *K3PiScratchScope::resource()
+	{
+		return _arena.resource();
+	}
+
+} // end namespace K3PiStudies
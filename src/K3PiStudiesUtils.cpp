@@ -11,6 +11,8 @@
 #include <boost/algorithm/string.hpp>
 
 #include "K3PiStudiesUtils.h"
+#include "K3PiInstrumentation.h"
+#include "K3PiKinematicsKernels.h"
 
 namespace K3PiStudies
 {
@@ -24,26 +26,16 @@ namespace K3PiStudies
 	const std::string K3PiStudiesUtils::_D0_FIT_FLAG = "D0_FIT";
 	const std::string K3PiStudiesUtils::_P_FLAG = "P";
 
-	TLorentzVector K3PiStudiesUtils::toTLorentzVector(
-		double pE,
-		double px,
-		double py,
-		double pz)
-	{
-		TLorentzVector v;
-		v.SetPxPyPzE(px, py, pz, pE);
-		return v;
-	}
-
 	/**
 	 * @see https://en.wikipedia.org/wiki/Inverse-variance_weighting
 	 *
-	 * @return pair where ans.first = weighted mean, ans.second = error on weighted mean
+	 * @return pair where ans.first = weighted mean, ans.second = error on weighted mean (both NaN for empty inputs)
 	 */
 	std::pair<double, double> K3PiStudiesUtils::invVarWeightedAvg(
 		const std::vector<double> &vals,
 		const std::vector<double> &errs)
 	{
+		K3PI_PROFILE_FUNCTION();
 		const unsigned int N = vals.size();
 		if (errs.size() != N)
 		{
@@ -51,30 +43,14 @@ namespace K3PiStudies
 			return std::make_pair(std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN());
 		}
 
-		std::vector<double> weightingFactors;
-		weightingFactors.reserve(N);
-		for (auto const &err : errs)
-		{
-			weightingFactors.push_back(1.0 / (err * err));
-		}
-
-		double sumInvWeightingFactors = 0.0;
-		for (auto const &w : weightingFactors)
-		{
-			sumInvWeightingFactors += w;
-		}
-		// std::cout << "sumInvWeightingFactors: " << sumInvWeightingFactors << std::endl;
-
-		double weightedMean = 0.0;
-		for (int i = 0; i < N; i++)
+		// single pass with compensated sums, see InvVarWeightedAvgAccumulator
+		InvVarWeightedAvgAccumulator acc;
+		for (unsigned int i = 0; i < N; i++)
 		{
-			weightedMean += vals[i] * weightingFactors[i];
+			acc.push(vals[i], errs[i]);
 		}
-		// std::cout << "weightedMean: " << weightedMean << std::endl;
-		weightedMean /= sumInvWeightingFactors;
-		// std::cout << "weightedMean after division: " << weightedMean << std::endl;
 
-		return std::make_pair(weightedMean, sqrt(1.0 / sumInvWeightingFactors));
+		return acc.result();
 	}
 
 	/**
@@ -84,6 +60,7 @@ namespace K3PiStudies
 	 */
 	std::pair<double, double> K3PiStudiesUtils::calcAsymmetry(double nAbove, double nBelow)
 	{
+		K3PI_PROFILE_FUNCTION();
 		double asym = (nAbove - nBelow) / (nAbove + nBelow);
 		double asymErr = sqrt((1.0 - asym * asym) / (nAbove + nBelow));
 
@@ -99,9 +76,13 @@ namespace K3PiStudies
 		std::function<double(double)> applyToEntry,
 		bool countPositiveEntries)
 	{
-		unsigned int nBins = h->GetNbinsX();
-		// std::cout << "Num bins: " << nBins << std::endl;
+		K3PI_PROFILE_FUNCTION();
+		return countFuncResult<std::function<double(double)>>(h, applyToEntry, countPositiveEntries);
+	}
 
+	bool K3PiStudiesUtils::hasEmptyUnderOverflow(const TH1 *const h)
+	{
+		K3PI_PROFILE_FUNCTION();
 		/**
 		 * From ROOT doc:
 		 * bin = 0;       underflow bin
@@ -110,29 +91,22 @@ namespace K3PiStudies
 		 * bin = nbins+1; overflow bin
 		 */
 		unsigned int numUnderflow = h->GetBinContent(0);
-		unsigned int numOverflow = h->GetBinContent(nBins + 1);
+		unsigned int numOverflow = h->GetBinContent(h->GetNbinsX() + 1);
 		if (numUnderflow != 0 || numOverflow != 0)
 		{
 			std::cout << "Underflow/overflow bins not empty. Cannot calculate number positive/negative entries accurately for " << h->GetName() << "." << std::endl;
-			return -1;
-		}
-
-		unsigned int numNeg = 0;
-		unsigned int numPos = 0;
-		for (int b = 1; b <= nBins; b++)
-		{
-			double binCenter = h->GetXaxis()->GetBinCenter(b);
-			double valToTest = applyToEntry(binCenter);
-			if (valToTest >= 0.0)
-			{
-				numPos += h->GetBinContent(b);
-			}
-			else
-			{
-				numNeg += h->GetBinContent(b);
-			}
+			return false;
 		}
+		return true;
+	}
 
+	int K3PiStudiesUtils::selectFuncResultCount(
+		const TH1 *const h,
+		unsigned int numPos,
+		unsigned int numNeg,
+		bool countPositiveEntries)
+	{
+		K3PI_PROFILE_FUNCTION();
 		unsigned int totEntries = h->GetEntries();
 		if (numPos + numNeg != totEntries)
 		{
@@ -152,17 +126,20 @@ namespace K3PiStudies
 
 	void K3PiStudiesUtils::makeTLegendBkgTransparent(TLegend &leg)
 	{
+		K3PI_PROFILE_FUNCTION();
 		leg.SetBorderSize(0);
 		leg.SetFillColorAlpha(kWhite, 0.0);
 	}
 
 	void K3PiStudiesUtils::makeTPaveTextBkgTransparent(TPaveText &pt)
 	{
+		K3PI_PROFILE_FUNCTION();
 		pt.SetFillColorAlpha(kWhite, 0.0);
 	}
 
 	std::string K3PiStudiesUtils::printRegionBoundsDeltaM(const std::string &regionName)
 	{
+		K3PI_PROFILE_FUNCTION();
 		double upperBound = 0.0;
 		double lowerBound = 0.0;
 		if (boost::iequals(regionName, _ALL_REGION_FLAG))
@@ -187,6 +164,7 @@ namespace K3PiStudies
 
 	std::string K3PiStudiesUtils::printRegionBoundsMD0(const std::string &regionName)
 	{
+		K3PI_PROFILE_FUNCTION();
 		double upperBound = 0.0;
 		double lowerBound = 0.0;
 		if (boost::iequals(regionName, _ALL_REGION_FLAG))
@@ -214,6 +192,7 @@ namespace K3PiStudies
 	 */
 	std::pair<double, double> K3PiStudiesUtils::getRegionAxisBoundsDeltaMMeV(const std::string &regionName)
 	{
+		K3PI_PROFILE_FUNCTION();
 		if (boost::iequals(regionName, _ALL_REGION_FLAG))
 		{
 			return std::make_pair(_ALL_REGS_DELTAM_AXIS_MIN_MEV, _ALL_REGS_DELTAM_AXIS_MAX_MEV);
@@ -234,6 +213,7 @@ namespace K3PiStudies
 	 */
 	std::pair<double, double> K3PiStudiesUtils::getRegionAxisBoundsMD0MeV(const std::string &regionName)
 	{
+		K3PI_PROFILE_FUNCTION();
 		if (boost::iequals(regionName, _ALL_REGION_FLAG))
 		{
 			return std::make_pair(_ALL_REGS_D0_MASS_AXIS_MIN_MEV, _ALL_REGS_D0_MASS_AXIS_MAX_MEV);
@@ -253,6 +233,7 @@ namespace K3PiStudies
 		const std::string &regionName,
 		double deltaMMeV)
 	{
+		K3PI_PROFILE_FUNCTION();
 		if (boost::iequals(regionName, _ALL_REGION_FLAG))
 		{
 			return true;
@@ -272,6 +253,7 @@ namespace K3PiStudies
 		const std::string &regionName,
 		double d0MassMeV)
 	{
+		K3PI_PROFILE_FUNCTION();
 		if (boost::iequals(regionName, _ALL_REGION_FLAG))
 		{
 			return true;
@@ -291,6 +273,7 @@ namespace K3PiStudies
 		TH1 *const h1,
 		TH1 *const h2)
 	{
+		K3PI_PROFILE_FUNCTION();
 		const double yMax1 = h1->GetMaximum();
 		const double yMax2 = h2->GetMaximum();
 		const double overallMax = yMax1 > yMax2 ? yMax1 : yMax2;
@@ -309,6 +292,7 @@ namespace K3PiStudies
 		const TString& unit,
 		bool updateYLabel)
 	{
+		K3PI_PROFILE_FUNCTION();
 		const unsigned int n1 = h1->GetEntries();
 		const unsigned int n2 = h2->GetEntries();
 		if (n1 == 0 || n2 == 0)
@@ -367,35 +351,12 @@ namespace K3PiStudies
 		}
 	}
 
-	/**
-	 * See Eq. 42 in Kutschke's An Angular Distribution Cookbook
-	 * @return angle between the (4,5) decay plane and the (6,7) decay plane in mother rest frame, ranging from -pi to pi
-	 */
-	double K3PiStudiesUtils::angleBetweenDecayPlanesKutschke(
-		const TVector3 &d4_motherRestFrame,
-		const TVector3 &d5_motherRestFrame,
-		const TVector3 &d6_motherRestFrame,
-		const TVector3 &d7_motherRestFrame)
-	{
-		TVector3 nPrime = (d4_motherRestFrame.Unit()).Cross(d5_motherRestFrame.Unit());
-		TVector3 nHatPrime = nPrime.Unit();
-
-		TVector3 nDoublePrime = (d6_motherRestFrame.Unit()).Cross(d7_motherRestFrame.Unit());
-		TVector3 nHatDoublePrime = nDoublePrime.Unit();
-
-		TVector3 p2Hat = (d4_motherRestFrame + d5_motherRestFrame).Unit();
-
-		double cosPhi = nHatDoublePrime.Dot(nHatPrime);
-		double sinPhi = (nHatDoublePrime.Cross(nHatPrime)).Dot(p2Hat);
-
-		return TMath::ATan2(sinPhi, cosPhi);
-	}
-
 	TString K3PiStudiesUtils::makeTitleStr(
 		const TString &title,
 		const TString &xLabel,
 		const TString &yLabel)
 	{
+		K3PI_PROFILE_FUNCTION();
 		return title + ";" + xLabel + ";" + yLabel;
 	}
 
@@ -406,6 +367,7 @@ namespace K3PiStudies
 		const TString &unit,
 		bool normalizedPlot)
 	{
+		K3PI_PROFILE_FUNCTION();
 		double axisLength = axisMax - axisMin;
 		double binSize = axisLength / numBins;
 
@@ -416,133 +378,16 @@ namespace K3PiStudies
 
 	void K3PiStudiesUtils::changeToRainbowPalette()
 	{
+		K3PI_PROFILE_FUNCTION();
 		gStyle->SetPalette(kRainBow);
 	}
 
-	/**
-	 * @param v1v2AngleIsNegPiToPi true if `v1v2Angle` ranges from -pi to pi, false if it ranges from 0 to 2 pi
-	 * @return diff between .Angle method and our angle calculation (`v1v2Angle`)
-	 */
-	double K3PiStudiesUtils::verifyAngle(
-		const TVector3 &v1,
-		const TVector3 &v2,
-		double v1v2Angle,
-		bool v1v2AngleIsNegPiToPi,
-		const std::string &angleName,
-		bool printDiff)
-	{
-		double angleDiff = 0.0;
-
-		double angleToCompare = v1.Angle(v2);
-		// .Angle uses acos, which ranges from 0 to pi. Need to get correct quadrant and put it in range -pi to pi
-		if (sin(v1v2Angle) < 0.0)
-		{
-			angleToCompare *= -1.0;
-		}
-
-		if (!v1v2AngleIsNegPiToPi)
-		{
-			angleToCompare = changeAngleRange_0_to_2pi(angleToCompare);
-		}
-
-		// std::cout << angleName << ": " << v1v2Angle << std::endl;
-		// std::cout << "From .Angle(): " << angleToCompare << std::endl;
-		// std::cout << angleName << " (deg) : " << radToDeg(v1v2Angle) << std::endl;
-		// std::cout << "From .Angle() (deg) : " << radToDeg(angleToCompare) << std::endl;
-
-		areDoublesEqual(combinedToleranceCompare, v1v2Angle, angleToCompare, angleName + " / .Angle()", printDiff);
-		angleDiff = std::fabs(v1v2Angle - angleToCompare);
-
-		return angleDiff;
-	}
-
-	bool K3PiStudiesUtils::isExactlyEqual(double d1, double d2)
-	{
-		return d1 == d2;
-	}
-
-	/**
-	 * @see https://stackoverflow.com/a/15012792
-	 */
-	bool K3PiStudiesUtils::combinedToleranceCompare(double x, double y)
-	{
-		double maxXYOne = std::max({1.0, std::fabs(x), std::fabs(y)});
-
-		// std::cout << "maxXYOne: " << maxXYOne << std::endl;
-		// std::cout << "EPS: " << std::numeric_limits<double>::epsilon() * maxXYOne << std::endl;
-		// std::cout << "diff: " << std::fabs(x - y) << std::endl;
-
-		return std::fabs(x - y) <= _COMPARE_EPS * maxXYOne;
-	}
-
 	void K3PiStudiesUtils::silenceROOTHistSaveMsgs()
 	{
+		K3PI_PROFILE_FUNCTION();
 		gErrorIgnoreLevel = kWarning;
 	}
 
-	double K3PiStudiesUtils::radToDeg(double angleRad)
-	{
-		return TMath::RadToDeg() * angleRad;
-	}
-
-	/**
-	 * @param angle_0_to_2pi angle in range 0 to 2pi
-	 * @return angle in range -pi to pi
-	 */
-	double K3PiStudiesUtils::changeAngleRange_neg_pi_to_pi(double angle_0_to_2pi)
-	{
-		if (angle_0_to_2pi > _PI)
-		{
-			return angle_0_to_2pi - 2.0 * _PI;
-		}
-		else
-		{
-			return angle_0_to_2pi;
-		}
-	}
-
-	/**
-	 * @param angle_neg_pi_to_pi angle that ranges from -pi to pi
-	 * @return angle that ranges from 0 to 2pi
-	 */
-	double K3PiStudiesUtils::changeAngleRange_0_to_2pi(double angle_neg_pi_to_pi)
-	{
-		if (angle_neg_pi_to_pi < 0.0)
-		{
-			// std::cout << "Neg phi" << std::endl;
-			return angle_neg_pi_to_pi + 2.0 * K3PiStudiesUtils::_PI;
-		}
-		else
-		{
-			return angle_neg_pi_to_pi;
-		}
-	}
-
-	/**
-	 * @param isEqualFunc returns true if the d1, d2 are equal; false otherwise
-	 */
-	bool K3PiStudiesUtils::areDoublesEqual(
-		std::function<bool(double, double)> isEqualFunc,
-		double d1,
-		double d2,
-		const std::string &varName,
-		bool printDiff)
-	{
-		if (!isEqualFunc(d1, d2))
-		{
-			if (printDiff)
-			{
-				std::cout << "Found difference for " << varName << ": " << d1 << ", " << d2 << "; diff = " << d1 - d2 << std::endl;
-			}
-
-			return false;
-		}
-		else
-		{
-			return true;
-		}
-	}
-
 	/**
 	 * For the D0_P0_*, D0_P1_*, D0_P2_*, D0_P3_* vars
 	 */
@@ -553,26 +398,14 @@ namespace K3PiStudies
 		double D0_P2_M,
 		double D0_P3_M)
 	{
-		double m;
-		switch (ind)
-		{
-		case 0:
-			m = D0_P0_M;
-			break;
-		case 1:
-			m = D0_P1_M;
-			break;
-		case 2:
-			m = D0_P2_M;
-			break;
-		case 3:
-			m = D0_P3_M;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		const DecayLookup<double> part = tryGetD0Part(ind, D0_P0_M, D0_P1_M, D0_P2_M, D0_P3_M);
+		if (!part)
+		{
 			throw InvalidDecayError("getD0Part_M: Cannot find daughter with index " + std::to_string(ind) + " in daughters.");
 		}
 
-		return m;
+		return part._value;
 	}
 
 	/**
@@ -585,26 +418,14 @@ namespace K3PiStudies
 		double D0_P2_PE,
 		double D0_P3_PE)
 	{
-		double pE;
-		switch (ind)
-		{
-		case 0:
-			pE = D0_P0_PE;
-			break;
-		case 1:
-			pE = D0_P1_PE;
-			break;
-		case 2:
-			pE = D0_P2_PE;
-			break;
-		case 3:
-			pE = D0_P3_PE;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		const DecayLookup<double> part = tryGetD0Part(ind, D0_P0_PE, D0_P1_PE, D0_P2_PE, D0_P3_PE);
+		if (!part)
+		{
 			throw InvalidDecayError("getD0Part_PE: Cannot find daughter with index " + std::to_string(ind) + " in daughters.");
 		}
 
-		return pE;
+		return part._value;
 	}
 
 	/**
@@ -617,26 +438,14 @@ namespace K3PiStudies
 		double D0_P2_PZ,
 		double D0_P3_PZ)
 	{
-		double pz;
-		switch (ind)
-		{
-		case 0:
-			pz = D0_P0_PZ;
-			break;
-		case 1:
-			pz = D0_P1_PZ;
-			break;
-		case 2:
-			pz = D0_P2_PZ;
-			break;
-		case 3:
-			pz = D0_P3_PZ;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		const DecayLookup<double> part = tryGetD0Part(ind, D0_P0_PZ, D0_P1_PZ, D0_P2_PZ, D0_P3_PZ);
+		if (!part)
+		{
 			throw InvalidDecayError("getD0Part_PZ: Cannot find daughter with index " + std::to_string(ind) + " in daughters.");
 		}
 
-		return pz;
+		return part._value;
 	}
 
 	/**
@@ -649,26 +458,14 @@ namespace K3PiStudies
 		double D0_P2_PY,
 		double D0_P3_PY)
 	{
-		double py;
-		switch (ind)
-		{
-		case 0:
-			py = D0_P0_PY;
-			break;
-		case 1:
-			py = D0_P1_PY;
-			break;
-		case 2:
-			py = D0_P2_PY;
-			break;
-		case 3:
-			py = D0_P3_PY;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		const DecayLookup<double> part = tryGetD0Part(ind, D0_P0_PY, D0_P1_PY, D0_P2_PY, D0_P3_PY);
+		if (!part)
+		{
 			throw InvalidDecayError("getD0Part_PY: Cannot find daughter with index " + std::to_string(ind) + " in daughters.");
 		}
 
-		return py;
+		return part._value;
 	}
 
 	/**
@@ -681,208 +478,33 @@ namespace K3PiStudies
 		double D0_P2_PX,
 		double D0_P3_PX)
 	{
-		double px;
-		switch (ind)
-		{
-		case 0:
-			px = D0_P0_PX;
-			break;
-		case 1:
-			px = D0_P1_PX;
-			break;
-		case 2:
-			px = D0_P2_PX;
-			break;
-		case 3:
-			px = D0_P3_PX;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		const DecayLookup<double> part = tryGetD0Part(ind, D0_P0_PX, D0_P1_PX, D0_P2_PX, D0_P3_PX);
+		if (!part)
+		{
 			throw InvalidDecayError("getD0Part_PX: Cannot find daughter with index " + std::to_string(ind) + " in daughters.");
 		}
 
-		return px;
-	}
-
-	double K3PiStudiesUtils::getPhi(
-		double px,
-		double py,
-		double pz,
-		double pE)
-	{
-		ROOT::Math::PxPyPzEVector v(px, py, pz, pE);
-		return v.Phi();
-	}
-
-	double K3PiStudiesUtils::getEta(
-		double px,
-		double py,
-		double pz,
-		double pE)
-	{
-		ROOT::Math::PxPyPzEVector v(px, py, pz, pE);
-		return v.Eta();
-	}
-
-	double K3PiStudiesUtils::getPT(
-		double px,
-		double py,
-		double pz,
-		double pE)
-	{
-		ROOT::Math::PxPyPzEVector v(px, py, pz, pE);
-		return v.Pt();
+		return part._value;
 	}
 
 	/**
-	 * @param pA_IN_D0CM K
-	 * @param pB_IN_D0CM OS pi 1
-	 * @param pC_IN_D0CM SS pi
-	 * @param pD_IN_D0CM OS pi 2
-	 * @returns vector with entries m12, m34, cos12, cos34, phi
-	 */
-	std::vector<double> K3PiStudiesUtils::calc_phsp(
-		const TLorentzVector &pD0_IN_D0CM,
-		const TLorentzVector &pA_IN_D0CM, // K-
-		const TLorentzVector &pB_IN_D0CM, // OS pi 1
-		const TLorentzVector &pC_IN_D0CM, // SS pi
-		const TLorentzVector &pD_IN_D0CM) // OS pi 2
-	{
-		//  note that _pA_IN_D0CM_MEV, _pB_IN_D0CM_MEV, etc., are in the D0 CM.
-		//  we are going to define zhat as the pA_3vec+pB_3vec direction.
-		//  to consider the helicity angles of the AB and CD pairs in their
-		//  respective CMs, we should make Lorentz transformations along
-		//  the zhat (or -zhat) directions. Note that the CD system is moving
-		//  along the -zhat direction to start.
-		const TLorentzVector pAB_4vec = pA_IN_D0CM + pB_IN_D0CM;
-		const double mAB = pAB_4vec.M(); // m12
-
-		const TLorentzVector pCD_4vec = pC_IN_D0CM + pD_IN_D0CM;
-		const double mCD = pCD_4vec.M(); // m34
-
-		const TVector3 pA_3vec = pA_IN_D0CM.Vect();
-		const TVector3 pB_3vec = pB_IN_D0CM.Vect();
-		const TVector3 pC_3vec = pC_IN_D0CM.Vect();
-		const TVector3 pD_3vec = pD_IN_D0CM.Vect();
-		const TVector3 pAB_3vec = pAB_4vec.Vect();
-
-		const TVector3 yhat = (pA_3vec.Cross(pB_3vec)).Unit();
-		const TVector3 yhatPrime = (pC_3vec.Cross(pD_3vec)).Unit();
-		const TVector3 zhat = pAB_3vec.Unit();
-		const TVector3 xhat = (yhat.Cross(zhat)).Unit();
-
-		const double cosPhi = (yhat.Dot(yhatPrime));
-		const double sinPhi = (xhat.Dot(yhatPrime));
-		const double phi = changeAngleRange_0_to_2pi(TMath::ATan2(sinPhi, cosPhi));
-
-		const double energyAB = pAB_4vec.E();
-		TVector3 betaAB;
-		betaAB.SetXYZ(pAB_4vec.Px() / energyAB, pAB_4vec.Py() / energyAB, pAB_4vec.Pz() / energyAB);
-		const double energyCD = pCD_4vec.E();
-		TVector3 betaCD;
-		betaCD.SetXYZ(pCD_4vec.Px() / energyCD, pCD_4vec.Py() / energyCD, pCD_4vec.Pz() / energyCD);
-
-		TLorentzVector pAprime_4vec = pA_IN_D0CM;
-		pAprime_4vec.Boost(-1. * betaAB);
-		const TVector3 pAprime_3vec = pAprime_4vec.Vect();
-		const double paPrimeZ = pAprime_3vec.Dot(zhat);
-		const double paPrimeMag = pAprime_3vec.Mag();
-
-		TLorentzVector pCprime_4vec = pC_IN_D0CM;
-		pCprime_4vec.Boost(-1. * betaCD);
-		const TVector3 pCprime_3vec = pCprime_4vec.Vect();
-		const double pcPrimeZ = pCprime_3vec.Dot(zhat);
-		const double pcPrimeMag = pCprime_3vec.Mag();
-
-		const double cosThetaA = paPrimeZ / paPrimeMag; // cos theta 12
-		const double cosThetaC = pcPrimeZ / pcPrimeMag; // cos theta 34
-
-		std::vector<double> vars = {mAB, mCD, cosThetaA, cosThetaC, phi};
-		return vars;
-	}
-
-	/*
-	 * Function to calculate phase space from John's apply_full_selection.py code
-	 * returns vector with entries: {m12, m34, cos1, cos2, phi, m13, phiAngleDiff}
+	 * For the D0_P0_*, D0_P1_*, D0_P2_*, D0_P3_* vars
 	 */
-	std::vector<double> K3PiStudiesUtils::calc_phsp(
-		double K_D0Fit_PT,
-		double K_D0Fit_ETA,
-		double K_D0Fit_PHI,
-		double Pi_SS_D0Fit_PT,
-		double Pi_SS_D0Fit_ETA,
-		double Pi_SS_D0Fit_PHI,
-		double Pi_OS1_D0Fit_PT,
-		double Pi_OS1_D0Fit_ETA,
-		double Pi_OS1_D0Fit_PHI,
-		double Pi_OS2_D0Fit_PT,
-		double Pi_OS2_D0Fit_ETA,
-		double Pi_OS2_D0Fit_PHI,
-		bool pi1GoesWithK,
-		bool verifyAngles,
-		bool printDiff)
-	{
-		TLorentzVector d1_piGoesWithPi, d2_ssPi, d3_k, d4_piGoesWithK;
-		d2_ssPi.SetPtEtaPhiM(Pi_SS_D0Fit_PT, Pi_SS_D0Fit_ETA, Pi_SS_D0Fit_PHI, K3PiStudiesUtils::_PION_MASS);
-		d3_k.SetPtEtaPhiM(K_D0Fit_PT, K_D0Fit_ETA, K_D0Fit_PHI, K3PiStudiesUtils::_KAON_MASS);
-
-		// figure out which pi to associate with k
-		if (pi1GoesWithK)
-		{ // case where kpi1 goes with k
-			d1_piGoesWithPi.SetPtEtaPhiM(Pi_OS2_D0Fit_PT, Pi_OS2_D0Fit_ETA, Pi_OS2_D0Fit_PHI, K3PiStudiesUtils::_PION_MASS);
-			d4_piGoesWithK.SetPtEtaPhiM(Pi_OS1_D0Fit_PT, Pi_OS1_D0Fit_ETA, Pi_OS1_D0Fit_PHI, K3PiStudiesUtils::_PION_MASS);
+	DecayLookup<double> K3PiStudiesUtils::tryGetD0Part(
+		int ind,
+		double D0_P0_var,
+		double D0_P1_var,
+		double D0_P2_var,
+		double D0_P3_var) noexcept
+	{
+		if (static_cast<unsigned int>(ind) > 3)
+		{
+			return {std::numeric_limits<double>::quiet_NaN(), DecayStatus::BadIndex};
 		}
-		else
-		{ // case where kpi2 goes with k
-			d1_piGoesWithPi.SetPtEtaPhiM(Pi_OS1_D0Fit_PT, Pi_OS1_D0Fit_ETA, Pi_OS1_D0Fit_PHI, K3PiStudiesUtils::_PION_MASS);
-			d4_piGoesWithK.SetPtEtaPhiM(Pi_OS2_D0Fit_PT, Pi_OS2_D0Fit_ETA, Pi_OS2_D0Fit_PHI, K3PiStudiesUtils::_PION_MASS);
-		}
-
-		// Boost everything to D0 restframe
-		auto mum = d1_piGoesWithPi + d2_ssPi + d3_k + d4_piGoesWithK;
-		double m12 = (d1_piGoesWithPi + d2_ssPi).M();
-		double m34 = (d3_k + d4_piGoesWithK).M();
-		double m13 = (d1_piGoesWithPi + d3_k).M();
-		d1_piGoesWithPi.Boost(-mum.BoostVector());
-		d2_ssPi.Boost(-mum.BoostVector());
-		d3_k.Boost(-mum.BoostVector());
-		d4_piGoesWithK.Boost(-mum.BoostVector());
-
-		TLorentzVector d1_piGoesWithPi2, d3_k4;
-		d1_piGoesWithPi2 = d1_piGoesWithPi + d2_ssPi;
-		d3_k4 = d3_k + d4_piGoesWithK;
-
-		TVector3 d1_piGoesWithPin = d1_piGoesWithPi.Vect().Unit();
-		TVector3 d2_ssPin = d2_ssPi.Vect().Unit();
-		TVector3 d3_kn = d3_k.Vect().Unit();
-		TVector3 d4_piGoesWithKn = d4_piGoesWithK.Vect().Unit();
-		TVector3 d1_piGoesWithPi2n = d1_piGoesWithPi2.Vect().Unit();
-		TVector3 d3_k4n = d3_k4.Vect().Unit();
-
-		TVector3 n1 = d1_piGoesWithPin.Cross(d2_ssPin);
-		TVector3 n2 = d3_kn.Cross(d4_piGoesWithKn);
-		TVector3 n3 = n1.Unit().Cross(n2.Unit());
-
-		// Calculation of the angle Phi between the planes, in range -pi to pi
-		double cosp = n1.Unit().Dot(n2.Unit());
-		double sinp = n3.Dot(d3_k4n);
-		double phi = TMath::ATan2(sinp, cosp);
-
-		double phiDiff = (verifyAngles) ? K3PiStudiesUtils::verifyAngle(n1.Unit(), n2.Unit(), phi, true, "phi", false) : 0.0;
-
-		// Vectors in rest fram of their resonance.
-		TLorentzVector d1_piGoesWithPir = d1_piGoesWithPi;
-		TLorentzVector d3_kr = d3_k;
-		d1_piGoesWithPir.Boost(-d1_piGoesWithPi2.BoostVector());
-		d3_kr.Boost(-d3_k4.BoostVector());
-		TVector3 d1_piGoesWithPirn = d1_piGoesWithPir.Vect().Unit();
-		TVector3 d3_krn = d3_kr.Vect().Unit();
-
-		// helicity angle for d1_piGoesWithPi2 and d3_k4 frame
-		double cos1 = d1_piGoesWithPi2n.Dot(d1_piGoesWithPirn);
-		double cos2 = d3_k4n.Dot(d3_krn);
-
-		std::vector<double> vars = {m12, m34, cos1, cos2, phi, m13, phiDiff};
-		return vars;
+
+		const double var[4] = {D0_P0_var, D0_P1_var, D0_P2_var, D0_P3_var};
+		return {var[ind], DecayStatus::Ok};
 	}
 
 	bool K3PiStudiesUtils::isReFitKaonNeg(
@@ -892,26 +514,14 @@ namespace K3PiStudies
 		int Dst_ReFit_D0_piplus_1_ID,
 		int Dst_ReFit_D0_piplus_ID)
 	{
-		bool isKaonNeg;
-		switch (kaonName)
-		{
-		case ReFit_PNames::ReFit_D0_Kplus:
-			isKaonNeg = Dst_ReFit_D0_Kplus_ID < 0;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus_0:
-			isKaonNeg = Dst_ReFit_D0_piplus_0_ID < 0;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus_1:
-			isKaonNeg = Dst_ReFit_D0_piplus_1_ID < 0;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus:
-			isKaonNeg = Dst_ReFit_D0_piplus_ID < 0;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		if (static_cast<unsigned int>(kaonName) > 3)
+		{
 			throw InvalidDecayError("isReFitKaonNeg: Cannot find daughter with name " + std::to_string(kaonName) + " in daughters.");
 		}
 
-		return isKaonNeg;
+		const bool isKaonNeg[4] = {Dst_ReFit_D0_Kplus_ID < 0, Dst_ReFit_D0_piplus_0_ID < 0, Dst_ReFit_D0_piplus_1_ID < 0, Dst_ReFit_D0_piplus_ID < 0};
+		return isKaonNeg[kaonName];
 	}
 
 	bool K3PiStudiesUtils::isD0FitKaonNeg(
@@ -921,26 +531,14 @@ namespace K3PiStudies
 		int Dst_D0Fit_D0_piplus_1_ID,
 		int Dst_D0Fit_D0_piplus_ID)
 	{
-		bool isKaonNeg;
-		switch (kaonName)
-		{
-		case D0Fit_PNames::D0Fit_D0_Kplus:
-			isKaonNeg = Dst_D0Fit_D0_Kplus_ID < 0;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus_0:
-			isKaonNeg = Dst_D0Fit_D0_piplus_0_ID < 0;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus_1:
-			isKaonNeg = Dst_D0Fit_D0_piplus_1_ID < 0;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus:
-			isKaonNeg = Dst_D0Fit_D0_piplus_ID < 0;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		if (static_cast<unsigned int>(kaonName) > 3)
+		{
 			throw InvalidDecayError("isD0FitKaonNeg: Cannot find daughter with name " + std::to_string(kaonName) + " in daughters.");
 		}
 
-		return isKaonNeg;
+		const bool isKaonNeg[4] = {Dst_D0Fit_D0_Kplus_ID < 0, Dst_D0Fit_D0_piplus_0_ID < 0, Dst_D0Fit_D0_piplus_1_ID < 0, Dst_D0Fit_D0_piplus_ID < 0};
+		return isKaonNeg[kaonName];
 	}
 
 	double K3PiStudiesUtils::getD0Fit_PE(
@@ -950,26 +548,14 @@ namespace K3PiStudies
 		double Dst_D0Fit_D0_piplus_1_PE,
 		double Dst_D0Fit_D0_piplus_PE)
 	{
-		double pE;
-		switch (pName)
-		{
-		case D0Fit_PNames::D0Fit_D0_Kplus:
-			pE = Dst_D0Fit_D0_Kplus_PE;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus_0:
-			pE = Dst_D0Fit_D0_piplus_0_PE;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus_1:
-			pE = Dst_D0Fit_D0_piplus_1_PE;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus:
-			pE = Dst_D0Fit_D0_piplus_PE;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		if (static_cast<unsigned int>(pName) > 3)
+		{
 			throw InvalidDecayError("getD0Fit_PE: Cannot find daughter with name " + std::to_string(pName) + " in daughters.");
 		}
 
-		return pE;
+		const double pE[4] = {Dst_D0Fit_D0_Kplus_PE, Dst_D0Fit_D0_piplus_0_PE, Dst_D0Fit_D0_piplus_1_PE, Dst_D0Fit_D0_piplus_PE};
+		return pE[pName];
 	}
 
 	double K3PiStudiesUtils::getD0Fit_PX(
@@ -979,26 +565,14 @@ namespace K3PiStudies
 		double Dst_D0Fit_D0_piplus_1_PX,
 		double Dst_D0Fit_D0_piplus_PX)
 	{
-		double px;
-		switch (pName)
-		{
-		case D0Fit_PNames::D0Fit_D0_Kplus:
-			px = Dst_D0Fit_D0_Kplus_PX;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus_0:
-			px = Dst_D0Fit_D0_piplus_0_PX;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus_1:
-			px = Dst_D0Fit_D0_piplus_1_PX;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus:
-			px = Dst_D0Fit_D0_piplus_PX;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		if (static_cast<unsigned int>(pName) > 3)
+		{
 			throw InvalidDecayError("getD0Fit_PX: Cannot find daughter with name " + std::to_string(pName) + " in daughters.");
 		}
 
-		return px;
+		const double px[4] = {Dst_D0Fit_D0_Kplus_PX, Dst_D0Fit_D0_piplus_0_PX, Dst_D0Fit_D0_piplus_1_PX, Dst_D0Fit_D0_piplus_PX};
+		return px[pName];
 	}
 
 	double K3PiStudiesUtils::getD0Fit_PY(
@@ -1008,26 +582,14 @@ namespace K3PiStudies
 		double Dst_D0Fit_D0_piplus_1_PY,
 		double Dst_D0Fit_D0_piplus_PY)
 	{
-		double py;
-		switch (pName)
-		{
-		case D0Fit_PNames::D0Fit_D0_Kplus:
-			py = Dst_D0Fit_D0_Kplus_PY;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus_0:
-			py = Dst_D0Fit_D0_piplus_0_PY;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus_1:
-			py = Dst_D0Fit_D0_piplus_1_PY;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus:
-			py = Dst_D0Fit_D0_piplus_PY;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		if (static_cast<unsigned int>(pName) > 3)
+		{
 			throw InvalidDecayError("getD0Fit_PY: Cannot find daughter with name " + std::to_string(pName) + " in daughters.");
 		}
 
-		return py;
+		const double py[4] = {Dst_D0Fit_D0_Kplus_PY, Dst_D0Fit_D0_piplus_0_PY, Dst_D0Fit_D0_piplus_1_PY, Dst_D0Fit_D0_piplus_PY};
+		return py[pName];
 	}
 
 	double K3PiStudiesUtils::getD0Fit_PZ(
@@ -1037,30 +599,19 @@ namespace K3PiStudies
 		double Dst_D0Fit_D0_piplus_1_PZ,
 		double Dst_D0Fit_D0_piplus_PZ)
 	{
-		double pz;
-		switch (pName)
-		{
-		case D0Fit_PNames::D0Fit_D0_Kplus:
-			pz = Dst_D0Fit_D0_Kplus_PZ;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus_0:
-			pz = Dst_D0Fit_D0_piplus_0_PZ;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus_1:
-			pz = Dst_D0Fit_D0_piplus_1_PZ;
-			break;
-		case D0Fit_PNames::D0Fit_D0_piplus:
-			pz = Dst_D0Fit_D0_piplus_PZ;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		if (static_cast<unsigned int>(pName) > 3)
+		{
 			throw InvalidDecayError("getD0Fit_PZ: Cannot find daughter with name " + std::to_string(pName) + " in daughters.");
 		}
 
-		return pz;
+		const double pz[4] = {Dst_D0Fit_D0_Kplus_PZ, Dst_D0Fit_D0_piplus_0_PZ, Dst_D0Fit_D0_piplus_1_PZ, Dst_D0Fit_D0_piplus_PZ};
+		return pz[pName];
 	}
 
 	double K3PiStudiesUtils::cTauMMToTauNS(double cTauMM)
 	{
+		K3PI_PROFILE_FUNCTION();
 		double cTauM = cTauMM * _MM_TO_M;
 		double tauSec = cTauM / _C_M_PER_SEC;
 		double tauNS = tauSec * _SEC_TO_NS;
@@ -1070,6 +621,7 @@ namespace K3PiStudies
 
 	double K3PiStudiesUtils::tauNSToTauPS(double tauNS)
 	{
+		K3PI_PROFILE_FUNCTION();
 		return tauNS * _NS_TO_PS;
 	}
 
@@ -1077,6 +629,7 @@ namespace K3PiStudies
 		double dtime,
 		const std::pair<double, double> &decayTimeLimits)
 	{
+		K3PI_PROFILE_FUNCTION();
 		double lowerBinEdge = decayTimeLimits.first;
 		double upperBinEdge = decayTimeLimits.second;
 
@@ -1085,6 +638,7 @@ namespace K3PiStudies
 
 	unsigned int K3PiStudiesUtils::determineQuadrant(double sin2ThetaA, double sin2ThetaC)
 	{
+		K3PI_PROFILE_FUNCTION();
 		unsigned int quadrant = 0;
 
 		if (sin2ThetaA < 0 && sin2ThetaC < 0)
@@ -1107,47 +661,37 @@ namespace K3PiStudies
 		return quadrant;
 	}
 
-	bool K3PiStudiesUtils::isKPi1LowerMassPair(
-		const TLorentzVector &kminus_4vec,
-		const TLorentzVector &piplus1_4vec,
-		const TLorentzVector &piplus2_4vec)
+	bool K3PiStudiesUtils::isKaonNeg(
+		int kaonInd,
+		int D0_P0_ID,
+		int D0_P1_ID,
+		int D0_P2_ID,
+		int D0_P3_ID)
 	{
-		TLorentzVector kpiplus1_4vec = kminus_4vec + piplus1_4vec;
-		TLorentzVector kpiplus2_4vec = kminus_4vec + piplus2_4vec;
-
-		double mkpi1 = kpiplus1_4vec.M();
-		double mkpi2 = kpiplus2_4vec.M();
+		K3PI_PROFILE_FUNCTION();
+		const DecayLookup<bool> kaonIsNeg = tryIsKaonNeg(kaonInd, D0_P0_ID, D0_P1_ID, D0_P2_ID, D0_P3_ID);
+		if (!kaonIsNeg)
+		{
+			throw InvalidDecayError("isKaonNeg: Cannot find kaon with index " + std::to_string(kaonInd) + " in daughters.");
+		}
 
-		return mkpi1 < mkpi2;
+		return kaonIsNeg._value;
 	}
 
-	bool K3PiStudiesUtils::isKaonNeg(
+	DecayLookup<bool> K3PiStudiesUtils::tryIsKaonNeg(
 		int kaonInd,
 		int D0_P0_ID,
 		int D0_P1_ID,
 		int D0_P2_ID,
-		int D0_P3_ID)
+		int D0_P3_ID) noexcept
 	{
-		bool isKaonNeg;
-		switch (kaonInd)
-		{
-		case 0:
-			isKaonNeg = D0_P0_ID < 0;
-			break;
-		case 1:
-			isKaonNeg = D0_P1_ID < 0;
-			break;
-		case 2:
-			isKaonNeg = D0_P2_ID < 0;
-			break;
-		case 3:
-			isKaonNeg = D0_P3_ID < 0;
-			break;
-		default:
-			throw InvalidDecayError("isKaonNeg: Cannot find kaon with index " + std::to_string(kaonInd) + " in daughters.");
+		if (static_cast<unsigned int>(kaonInd) > 3)
+		{
+			return {false, DecayStatus::BadIndex};
 		}
 
-		return isKaonNeg;
+		const bool isKaonNeg[4] = {D0_P0_ID < 0, D0_P1_ID < 0, D0_P2_ID < 0, D0_P3_ID < 0};
+		return {isKaonNeg[kaonInd], DecayStatus::Ok};
 	}
 
 	int K3PiStudiesUtils::findSSPion(
@@ -1157,33 +701,36 @@ namespace K3PiStudies
 		int D0_P2_ID,
 		int D0_P3_ID)
 	{
-		std::vector<int> ssSignPionIndices;
-		ssSignPionIndices.reserve(1);
-
-		int ssPionID = kaonIsNeg ? -1 * _PION_ID : _PION_ID;
-		if (D0_P0_ID == ssPionID)
-		{
-			ssSignPionIndices.push_back(0);
-		}
-		if (D0_P1_ID == ssPionID)
-		{
-			ssSignPionIndices.push_back(1);
-		}
-		if (D0_P2_ID == ssPionID)
-		{
-			ssSignPionIndices.push_back(2);
-		}
-		if (D0_P3_ID == ssPionID)
+		K3PI_PROFILE_FUNCTION();
+		const DecayLookup<int> ssPion = tryFindSSPion(kaonIsNeg, D0_P0_ID, D0_P1_ID, D0_P2_ID, D0_P3_ID);
+		if (!ssPion)
 		{
-			ssSignPionIndices.push_back(3);
+			throw InvalidDecayError("findSSPion: Did not find same sign pion in daughters.");
 		}
 
-		if (ssSignPionIndices.size() != 1)
+		return ssPion._value;
+	}
+
+	DecayLookup<int> K3PiStudiesUtils::tryFindSSPion(
+		bool kaonIsNeg,
+		int D0_P0_ID,
+		int D0_P1_ID,
+		int D0_P2_ID,
+		int D0_P3_ID) noexcept
+	{
+		const int ids[4] = {D0_P0_ID, D0_P1_ID, D0_P2_ID, D0_P3_ID};
+		int ssPionIndex = -1;
+		int numSSPions = 0;
+
+		int ssPionID = kaonIsNeg ? -1 * _PION_ID : _PION_ID;
+		for (int i = 0; i < 4; i++)
 		{
-			throw InvalidDecayError("findSSPion: Did not find same sign pion in daughters.");
+			const bool isSSPion = ids[i] == ssPionID;
+			ssPionIndex = isSSPion ? i : ssPionIndex;
+			numSSPions += isSSPion;
 		}
 
-		return ssSignPionIndices[0];
+		return {ssPionIndex, numSSPions == 1 ? DecayStatus::Ok : DecayStatus::WrongNumSSPions};
 	}
 
 	std::vector<int> K3PiStudiesUtils::findOSPions(
@@ -1193,33 +740,70 @@ namespace K3PiStudies
 		int D0_P2_ID,
 		int D0_P3_ID)
 	{
-		std::vector<int> osPionIndices;
-		osPionIndices.reserve(2);
+		K3PI_PROFILE_FUNCTION();
+		std::array<int, 2> osPionIndices = findOSPionPair(kaonIsNeg, D0_P0_ID, D0_P1_ID, D0_P2_ID, D0_P3_ID);
+		return {osPionIndices[0], osPionIndices[1]};
+	}
 
-		int osPionID = kaonIsNeg ? _PION_ID : -1 * _PION_ID;
-		if (D0_P0_ID == osPionID)
-		{
-			osPionIndices.push_back(0);
-		}
-		if (D0_P1_ID == osPionID)
-		{
-			osPionIndices.push_back(1);
-		}
-		if (D0_P2_ID == osPionID)
-		{
-			osPionIndices.push_back(2);
-		}
-		if (D0_P3_ID == osPionID)
+	std::pmr::vector<int> K3PiStudiesUtils::findOSPions(
+		bool kaonIsNeg,
+		int D0_P0_ID,
+		int D0_P1_ID,
+		int D0_P2_ID,
+		int D0_P3_ID,
+		std::pmr::memory_resource *scratch)
+	{
+		K3PI_PROFILE_FUNCTION();
+		std::array<int, 2> osPionIndices = findOSPionPair(kaonIsNeg, D0_P0_ID, D0_P1_ID, D0_P2_ID, D0_P3_ID);
+		return std::pmr::vector<int>({osPionIndices[0], osPionIndices[1]}, scratch);
+	}
+
+	/**
+	 * Allocation-free version of findOSPions
+	 * @return indices of the two opposite sign pions, in increasing order
+	 */
+	std::array<int, 2> K3PiStudiesUtils::findOSPionPair(
+		bool kaonIsNeg,
+		int D0_P0_ID,
+		int D0_P1_ID,
+		int D0_P2_ID,
+		int D0_P3_ID)
+	{
+		K3PI_PROFILE_FUNCTION();
+		const DecayLookup<std::array<int, 2>> osPions = tryFindOSPionPair(kaonIsNeg, D0_P0_ID, D0_P1_ID, D0_P2_ID, D0_P3_ID);
+		if (!osPions)
 		{
-			osPionIndices.push_back(3);
+			throw InvalidDecayError("findOSPions: Did not find the two opposite sign pions in daughters.");
 		}
 
-		if (osPionIndices.size() != 2)
+		return osPions._value;
+	}
+
+	DecayLookup<std::array<int, 2>> K3PiStudiesUtils::tryFindOSPionPair(
+		bool kaonIsNeg,
+		int D0_P0_ID,
+		int D0_P1_ID,
+		int D0_P2_ID,
+		int D0_P3_ID) noexcept
+	{
+		const int ids[4] = {D0_P0_ID, D0_P1_ID, D0_P2_ID, D0_P3_ID};
+		std::array<int, 2> osPionIndices = {-1, -1};
+		int numOSPions = 0;
+
+		int osPionID = kaonIsNeg ? _PION_ID : -1 * _PION_ID;
+		for (int i = 0; i < 4; i++)
 		{
-			throw InvalidDecayError("findOSPions: Did not find the two opposite sign pions in daughters.");
+			if (ids[i] == osPionID)
+			{
+				if (numOSPions < 2)
+				{
+					osPionIndices[numOSPions] = i;
+				}
+				numOSPions++;
+			}
 		}
 
-		return osPionIndices;
+		return {osPionIndices, numOSPions == 2 ? DecayStatus::Ok : DecayStatus::WrongNumOSPions};
 	}
 
 	D0Fit_PNames K3PiStudiesUtils::findD0FitSSPion(
@@ -1229,6 +813,7 @@ namespace K3PiStudies
 		int Dst_D0Fit_D0_piplus_1_ID,
 		int Dst_D0Fit_D0_piplus_ID)
 	{
+		K3PI_PROFILE_FUNCTION();
 		int index = findSSPion(kaonIsNeg,
 							   Dst_D0Fit_D0_Kplus_ID,
 							   Dst_D0Fit_D0_piplus_0_ID,
@@ -1245,6 +830,7 @@ namespace K3PiStudies
 		int Dst_ReFit_D0_piplus_1_ID,
 		int Dst_ReFit_D0_piplus_ID)
 	{
+		K3PI_PROFILE_FUNCTION();
 		int index = findSSPion(kaonIsNeg,
 							   Dst_ReFit_D0_Kplus_ID,
 							   Dst_ReFit_D0_piplus_0_ID,
@@ -1261,21 +847,52 @@ namespace K3PiStudies
 		int Dst_D0Fit_D0_piplus_1_ID,
 		int Dst_D0Fit_D0_piplus_ID)
 	{
-		std::vector<int> indices = findOSPions(
+		K3PI_PROFILE_FUNCTION();
+		std::array<D0Fit_PNames, 2> osPionNames = findD0FitOSPionPair(
 			kaonIsNeg,
 			Dst_D0Fit_D0_Kplus_ID,
 			Dst_D0Fit_D0_piplus_0_ID,
 			Dst_D0Fit_D0_piplus_1_ID,
 			Dst_D0Fit_D0_piplus_ID);
 
-		std::vector<D0Fit_PNames> osPionNames;
-		osPionNames.reserve(2);
-		for (int i = 0; i < 2; i++)
-		{
-			osPionNames[i] = indexToD0Fit_PName(indices[i]);
-		}
+		return {osPionNames[0], osPionNames[1]};
+	}
+
+	std::pmr::vector<D0Fit_PNames> K3PiStudiesUtils::findD0FitOSPions(
+		bool kaonIsNeg,
+		int Dst_D0Fit_D0_Kplus_ID,
+		int Dst_D0Fit_D0_piplus_0_ID,
+		int Dst_D0Fit_D0_piplus_1_ID,
+		int Dst_D0Fit_D0_piplus_ID,
+		std::pmr::memory_resource *scratch)
+	{
+		K3PI_PROFILE_FUNCTION();
+		std::array<D0Fit_PNames, 2> osPionNames = findD0FitOSPionPair(
+			kaonIsNeg,
+			Dst_D0Fit_D0_Kplus_ID,
+			Dst_D0Fit_D0_piplus_0_ID,
+			Dst_D0Fit_D0_piplus_1_ID,
+			Dst_D0Fit_D0_piplus_ID);
+
+		return std::pmr::vector<D0Fit_PNames>({osPionNames[0], osPionNames[1]}, scratch);
+	}
+
+	std::array<D0Fit_PNames, 2> K3PiStudiesUtils::findD0FitOSPionPair(
+		bool kaonIsNeg,
+		int Dst_D0Fit_D0_Kplus_ID,
+		int Dst_D0Fit_D0_piplus_0_ID,
+		int Dst_D0Fit_D0_piplus_1_ID,
+		int Dst_D0Fit_D0_piplus_ID)
+	{
+		K3PI_PROFILE_FUNCTION();
+		std::array<int, 2> indices = findOSPionPair(
+			kaonIsNeg,
+			Dst_D0Fit_D0_Kplus_ID,
+			Dst_D0Fit_D0_piplus_0_ID,
+			Dst_D0Fit_D0_piplus_1_ID,
+			Dst_D0Fit_D0_piplus_ID);
 
-		return osPionNames;
+		return {indexToD0Fit_PName(indices[0]), indexToD0Fit_PName(indices[1])};
 	}
 
 	std::vector<ReFit_PNames> K3PiStudiesUtils::findReFitOSPions(
@@ -1285,45 +902,75 @@ namespace K3PiStudies
 		int Dst_ReFit_D0_piplus_1_ID,
 		int Dst_ReFit_D0_piplus_ID)
 	{
-		std::vector<int> indices = findOSPions(
+		K3PI_PROFILE_FUNCTION();
+		std::array<ReFit_PNames, 2> osPionNames = findReFitOSPionPair(
 			kaonIsNeg,
 			Dst_ReFit_D0_Kplus_ID,
 			Dst_ReFit_D0_piplus_0_ID,
 			Dst_ReFit_D0_piplus_1_ID,
 			Dst_ReFit_D0_piplus_ID);
 
-		std::vector<ReFit_PNames> osPionNames;
-		osPionNames.reserve(2);
-		for (int i = 0; i < 2; i++)
-		{
-			osPionNames[i] = indexToReFit_PName(indices[i]);
-		}
+		return {osPionNames[0], osPionNames[1]};
+	}
+
+	std::pmr::vector<ReFit_PNames> K3PiStudiesUtils::findReFitOSPions(
+		bool kaonIsNeg,
+		int Dst_ReFit_D0_Kplus_ID,
+		int Dst_ReFit_D0_piplus_0_ID,
+		int Dst_ReFit_D0_piplus_1_ID,
+		int Dst_ReFit_D0_piplus_ID,
+		std::pmr::memory_resource *scratch)
+	{
+		K3PI_PROFILE_FUNCTION();
+		std::array<ReFit_PNames, 2> osPionNames = findReFitOSPionPair(
+			kaonIsNeg,
+			Dst_ReFit_D0_Kplus_ID,
+			Dst_ReFit_D0_piplus_0_ID,
+			Dst_ReFit_D0_piplus_1_ID,
+			Dst_ReFit_D0_piplus_ID);
 
-		return osPionNames;
+		return std::pmr::vector<ReFit_PNames>({osPionNames[0], osPionNames[1]}, scratch);
+	}
+
+	std::array<ReFit_PNames, 2> K3PiStudiesUtils::findReFitOSPionPair(
+		bool kaonIsNeg,
+		int Dst_ReFit_D0_Kplus_ID,
+		int Dst_ReFit_D0_piplus_0_ID,
+		int Dst_ReFit_D0_piplus_1_ID,
+		int Dst_ReFit_D0_piplus_ID)
+	{
+		K3PI_PROFILE_FUNCTION();
+		std::array<int, 2> indices = findOSPionPair(
+			kaonIsNeg,
+			Dst_ReFit_D0_Kplus_ID,
+			Dst_ReFit_D0_piplus_0_ID,
+			Dst_ReFit_D0_piplus_1_ID,
+			Dst_ReFit_D0_piplus_ID);
+
+		return {indexToReFit_PName(indices[0]), indexToReFit_PName(indices[1])};
 	}
 
 	D0Fit_PNames K3PiStudiesUtils::indexToD0Fit_PName(int index)
 	{
-		D0Fit_PNames pName;
-		switch (index)
-		{
-		case 0:
-			pName = D0Fit_PNames::D0Fit_D0_Kplus;
-			break;
-		case 1:
-			pName = D0Fit_PNames::D0Fit_D0_piplus_0;
-			break;
-		case 2:
-			pName = D0Fit_PNames::D0Fit_D0_piplus_1;
-			break;
-		case 3:
-			pName = D0Fit_PNames::D0Fit_D0_piplus;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		const DecayLookup<D0Fit_PNames> name = tryIndexToD0Fit_PName(index);
+		if (!name)
+		{
 			throw InvalidDecayError("indexToD0Fit_PName: Cannot find particle with index " + std::to_string(index) + " in daughters.");
 		}
 
-		return pName;
+		return name._value;
+	}
+
+	DecayLookup<D0Fit_PNames> K3PiStudiesUtils::tryIndexToD0Fit_PName(int index) noexcept
+	{
+		if (static_cast<unsigned int>(index) > 3)
+		{
+			return {static_cast<D0Fit_PNames>(0), DecayStatus::BadIndex};
+		}
+
+		// enum values are the daughter indices
+		return {static_cast<D0Fit_PNames>(index), DecayStatus::Ok};
 	}
 
 	D0Fit_PNames K3PiStudiesUtils::findD0FitKaon(
@@ -1332,6 +979,7 @@ namespace K3PiStudies
 		int Dst_D0Fit_D0_piplus_1_ID,
 		int Dst_D0Fit_D0_piplus_ID)
 	{
+		K3PI_PROFILE_FUNCTION();
 		int index = findKaon(
 			Dst_D0Fit_D0_Kplus_ID,
 			Dst_D0Fit_D0_piplus_0_ID,
@@ -1343,26 +991,25 @@ namespace K3PiStudies
 
 	ReFit_PNames K3PiStudiesUtils::indexToReFit_PName(int index)
 	{
-		ReFit_PNames pName;
-		switch (index)
-		{
-		case 0:
-			pName = ReFit_PNames::ReFit_D0_Kplus;
-			break;
-		case 1:
-			pName = ReFit_PNames::ReFit_D0_piplus_0;
-			break;
-		case 2:
-			pName = ReFit_PNames::ReFit_D0_piplus_1;
-			break;
-		case 3:
-			pName = ReFit_PNames::ReFit_D0_piplus;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		const DecayLookup<ReFit_PNames> name = tryIndexToReFit_PName(index);
+		if (!name)
+		{
 			throw InvalidDecayError("indexToReFit_PName: Cannot find particle with index " + std::to_string(index) + " in daughters.");
 		}
 
-		return pName;
+		return name._value;
+	}
+
+	DecayLookup<ReFit_PNames> K3PiStudiesUtils::tryIndexToReFit_PName(int index) noexcept
+	{
+		if (static_cast<unsigned int>(index) > 3)
+		{
+			return {static_cast<ReFit_PNames>(0), DecayStatus::BadIndex};
+		}
+
+		// enum values are the daughter indices
+		return {static_cast<ReFit_PNames>(index), DecayStatus::Ok};
 	}
 
 	ReFit_PNames K3PiStudiesUtils::findReFitKaon(
@@ -1371,6 +1018,7 @@ namespace K3PiStudies
 		int Dst_ReFit_D0_piplus_1_ID,
 		int Dst_ReFit_D0_piplus_ID)
 	{
+		K3PI_PROFILE_FUNCTION();
 		int index = findKaon(
 			Dst_ReFit_D0_Kplus_ID,
 			Dst_ReFit_D0_piplus_0_ID,
@@ -1387,41 +1035,251 @@ namespace K3PiStudies
 		int D0_P2_ID,
 		int D0_P3_ID)
 	{
-		std::vector<int> kaonIndices;
-		kaonIndices.reserve(1);
-
-		if (std::abs(D0_P0_ID) == _KAON_ID)
+		K3PI_PROFILE_FUNCTION();
+		const DecayLookup<int> kaon = tryFindKaon(D0_P0_ID, D0_P1_ID, D0_P2_ID, D0_P3_ID);
+		if (!kaon)
 		{
-			kaonIndices.push_back(0);
-		}
-		if (std::abs(D0_P1_ID) == _KAON_ID)
-		{
-			kaonIndices.push_back(1);
+			throw InvalidDecayError("findKaon: Did not find kaon in daughters.");
 		}
-		if (std::abs(D0_P2_ID) == _KAON_ID)
+
+		return kaon._value;
+	}
+
+	DecayLookup<int> K3PiStudiesUtils::tryFindKaon(
+		int D0_P0_ID,
+		int D0_P1_ID,
+		int D0_P2_ID,
+		int D0_P3_ID) noexcept
+	{
+		const int ids[4] = {D0_P0_ID, D0_P1_ID, D0_P2_ID, D0_P3_ID};
+		int kaonIndex = -1;
+		int numKaons = 0;
+
+		for (int i = 0; i < 4; i++)
 		{
-			kaonIndices.push_back(2);
+			const bool isKaon = std::abs(ids[i]) == _KAON_ID;
+			kaonIndex = isKaon ? i : kaonIndex;
+			numKaons += isKaon;
 		}
-		if (std::abs(D0_P3_ID) == _KAON_ID)
+
+		return {kaonIndex, numKaons == 1 ? DecayStatus::Ok : DecayStatus::WrongNumKaons};
+	}
+
+	/**
+	 * Table-driven replacement for findKaon + isKaonNeg + findSSPion + findOSPionPair; never throws, check isValid() on the result
+	 */
+	DecayPermutation K3PiStudiesUtils::findDecayPermutation(
+		int D0_P0_ID,
+		int D0_P1_ID,
+		int D0_P2_ID,
+		int D0_P3_ID)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return DecayPermutation::fromIDs(D0_P0_ID, D0_P1_ID, D0_P2_ID, D0_P3_ID);
+	}
+
+	std::size_t K3PiStudiesUtils::findDecayPermutations(
+		std::size_t nEvents,
+		const int *D0_P0_ID,
+		const int *D0_P1_ID,
+		const int *D0_P2_ID,
+		const int *D0_P3_ID,
+		DecayPermutation *perms,
+		DecayRejectCounters &counters) noexcept
+	{
+		// local counts so the loop doesn't store through counters every event
+		std::uint64_t counts[static_cast<int>(DecayStatus::NumStatuses)] = {};
+		for (std::size_t i = 0; i < nEvents; i++)
 		{
-			kaonIndices.push_back(3);
+			perms[i] = DecayPermutation::fromIDs(D0_P0_ID[i], D0_P1_ID[i], D0_P2_ID[i], D0_P3_ID[i]);
+			counts[static_cast<int>(perms[i].status())]++;
 		}
 
-		if (kaonIndices.size() != 1)
+		for (int s = 0; s < static_cast<int>(DecayStatus::NumStatuses); s++)
 		{
-			throw InvalidDecayError("findKaon: Did not find kaon in daughters.");
+			counters.push(static_cast<DecayStatus>(s), counts[s]);
 		}
 
-		return kaonIndices[0];
+		return counts[static_cast<int>(DecayStatus::Ok)];
+	}
+
+	double K3PiStudiesUtils::getD0Part_M(
+		const DecayPermutation &perm,
+		K3Pi_Roles role,
+		double D0_P0_M,
+		double D0_P1_M,
+		double D0_P2_M,
+		double D0_P3_M)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, D0_P0_M, D0_P1_M, D0_P2_M, D0_P3_M);
+	}
+
+	double K3PiStudiesUtils::getD0Part_PX(
+		const DecayPermutation &perm,
+		K3Pi_Roles role,
+		double D0_P0_PX,
+		double D0_P1_PX,
+		double D0_P2_PX,
+		double D0_P3_PX)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, D0_P0_PX, D0_P1_PX, D0_P2_PX, D0_P3_PX);
+	}
+
+	double K3PiStudiesUtils::getD0Part_PY(
+		const DecayPermutation &perm,
+		K3Pi_Roles role,
+		double D0_P0_PY,
+		double D0_P1_PY,
+		double D0_P2_PY,
+		double D0_P3_PY)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, D0_P0_PY, D0_P1_PY, D0_P2_PY, D0_P3_PY);
+	}
+
+	double K3PiStudiesUtils::getD0Part_PZ(
+		const DecayPermutation &perm,
+		K3Pi_Roles role,
+		double D0_P0_PZ,
+		double D0_P1_PZ,
+		double D0_P2_PZ,
+		double D0_P3_PZ)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, D0_P0_PZ, D0_P1_PZ, D0_P2_PZ, D0_P3_PZ);
+	}
+
+	double K3PiStudiesUtils::getD0Part_PE(
+		const DecayPermutation &perm,
+		K3Pi_Roles role,
+		double D0_P0_PE,
+		double D0_P1_PE,
+		double D0_P2_PE,
+		double D0_P3_PE)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, D0_P0_PE, D0_P1_PE, D0_P2_PE, D0_P3_PE);
+	}
+
+	double K3PiStudiesUtils::getD0Fit_PE(
+		const DecayPermutation &perm,
+		K3Pi_Roles role,
+		double Dst_D0Fit_D0_Kplus_PE,
+		double Dst_D0Fit_D0_piplus_0_PE,
+		double Dst_D0Fit_D0_piplus_1_PE,
+		double Dst_D0Fit_D0_piplus_PE)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, Dst_D0Fit_D0_Kplus_PE, Dst_D0Fit_D0_piplus_0_PE, Dst_D0Fit_D0_piplus_1_PE, Dst_D0Fit_D0_piplus_PE);
+	}
+
+	double K3PiStudiesUtils::getD0Fit_PX(
+		const DecayPermutation &perm,
+		K3Pi_Roles role,
+		double Dst_D0Fit_D0_Kplus_PX,
+		double Dst_D0Fit_D0_piplus_0_PX,
+		double Dst_D0Fit_D0_piplus_1_PX,
+		double Dst_D0Fit_D0_piplus_PX)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, Dst_D0Fit_D0_Kplus_PX, Dst_D0Fit_D0_piplus_0_PX, Dst_D0Fit_D0_piplus_1_PX, Dst_D0Fit_D0_piplus_PX);
+	}
+
+	double K3PiStudiesUtils::getD0Fit_PY(
+		const DecayPermutation &perm,
+		K3Pi_Roles role,
+		double Dst_D0Fit_D0_Kplus_PY,
+		double Dst_D0Fit_D0_piplus_0_PY,
+		double Dst_D0Fit_D0_piplus_1_PY,
+		double Dst_D0Fit_D0_piplus_PY)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, Dst_D0Fit_D0_Kplus_PY, Dst_D0Fit_D0_piplus_0_PY, Dst_D0Fit_D0_piplus_1_PY, Dst_D0Fit_D0_piplus_PY);
+	}
+
+	double K3PiStudiesUtils::getD0Fit_PZ(
+		const DecayPermutation &perm,
+		K3Pi_Roles role,
+		double Dst_D0Fit_D0_Kplus_PZ,
+		double Dst_D0Fit_D0_piplus_0_PZ,
+		double Dst_D0Fit_D0_piplus_1_PZ,
+		double Dst_D0Fit_D0_piplus_PZ)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, Dst_D0Fit_D0_Kplus_PZ, Dst_D0Fit_D0_piplus_0_PZ, Dst_D0Fit_D0_piplus_1_PZ, Dst_D0Fit_D0_piplus_PZ);
+	}
+
+	double K3PiStudiesUtils::getReFit_PE(
+		const DecayPermutation &perm,
+		K3Pi_Roles role,
+		double Dst_ReFit_D0_Kplus_PE,
+		double Dst_ReFit_D0_piplus_0_PE,
+		double Dst_ReFit_D0_piplus_1_PE,
+		double Dst_ReFit_D0_piplus_PE)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, Dst_ReFit_D0_Kplus_PE, Dst_ReFit_D0_piplus_0_PE, Dst_ReFit_D0_piplus_1_PE, Dst_ReFit_D0_piplus_PE);
+	}
+
+	double K3PiStudiesUtils::getReFit_PX(
+		const DecayPermutation &perm,
+		K3Pi_Roles role,
+		double Dst_ReFit_D0_Kplus_PX,
+		double Dst_ReFit_D0_piplus_0_PX,
+		double Dst_ReFit_D0_piplus_1_PX,
+		double Dst_ReFit_D0_piplus_PX)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, Dst_ReFit_D0_Kplus_PX, Dst_ReFit_D0_piplus_0_PX, Dst_ReFit_D0_piplus_1_PX, Dst_ReFit_D0_piplus_PX);
+	}
+
+	double K3PiStudiesUtils::getReFit_PY(
+		const DecayPermutation &perm,
+		K3Pi_Roles role,
+		double Dst_ReFit_D0_Kplus_PY,
+		double Dst_ReFit_D0_piplus_0_PY,
+		double Dst_ReFit_D0_piplus_1_PY,
+		double Dst_ReFit_D0_piplus_PY)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, Dst_ReFit_D0_Kplus_PY, Dst_ReFit_D0_piplus_0_PY, Dst_ReFit_D0_piplus_1_PY, Dst_ReFit_D0_piplus_PY);
+	}
+
+	double K3PiStudiesUtils::getReFit_PZ(
+		const DecayPermutation &perm,
+		K3Pi_Roles role,
+		double Dst_ReFit_D0_Kplus_PZ,
+		double Dst_ReFit_D0_piplus_0_PZ,
+		double Dst_ReFit_D0_piplus_1_PZ,
+		double Dst_ReFit_D0_piplus_PZ)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, Dst_ReFit_D0_Kplus_PZ, Dst_ReFit_D0_piplus_0_PZ, Dst_ReFit_D0_piplus_1_PZ, Dst_ReFit_D0_piplus_PZ);
+	}
+
+	double K3PiStudiesUtils::getProbNNx(
+		double D0_P0_ProbNNx,
+		double D0_P1_ProbNNx,
+		double D0_P2_ProbNNx,
+		double D0_P3_ProbNNx,
+		const DecayPermutation &perm,
+		K3Pi_Roles role)
+	{
+		K3PI_PROFILE_FUNCTION();
+		return perm.select(role, D0_P0_ProbNNx, D0_P1_ProbNNx, D0_P2_ProbNNx, D0_P3_ProbNNx);
 	}
 
 	bool K3PiStudiesUtils::isD0(int dStarPiID)
 	{
+		K3PI_PROFILE_FUNCTION();
 		return dStarPiID > 0;
 	}
 
 	bool K3PiStudiesUtils::isRS(bool isD0, bool isKaonNeg)
 	{
+		K3PI_PROFILE_FUNCTION();
 		bool isRS;
 		if (isD0)
 		{
@@ -1439,6 +1297,7 @@ namespace K3PiStudies
 	std::vector<std::string> K3PiStudiesUtils::buildListFromCommaSepStr(
 		const std::string &filesString)
 	{
+		K3PI_PROFILE_FUNCTION();
 		// make a copy so we don't modify the input string
 		std::string filesStringCopy = filesString;
 
@@ -1460,10 +1319,35 @@ namespace K3PiStudies
 		return result;
 	}
 
+	// same as above without a stringstream, with everything allocated from scratch
+	std::pmr::vector<std::pmr::string> K3PiStudiesUtils::buildListFromCommaSepStr(
+		const std::string &filesString,
+		std::pmr::memory_resource *scratch)
+	{
+		K3PI_PROFILE_FUNCTION();
+		std::pmr::vector<std::pmr::string> result(scratch);
+		result.reserve(std::count(filesString.begin(), filesString.end(), ',') + 1);
+		result.emplace_back();
+		for (const char c : filesString)
+		{
+			if (c == ',')
+			{
+				result.emplace_back();
+			}
+			else if (!::isspace(static_cast<unsigned char>(c)))
+			{
+				result.back().push_back(c);
+			}
+		}
+
+		return result;
+	}
+
 	std::string K3PiStudiesUtils::d0TimeBinToString(
 		const std::pair<double, double> &decayTimeLimits,
 		const std::string &unit)
 	{
+		K3PI_PROFILE_FUNCTION();
 		double lowerBinEdge = decayTimeLimits.first;
 		double upperBinEdge = decayTimeLimits.second;
 
@@ -1472,6 +1356,7 @@ namespace K3PiStudies
 
 	std::vector<std::pair<double, double>> K3PiStudiesUtils::makeTimeBins(const std::vector<double> &upperBinEdges)
 	{
+		K3PI_PROFILE_FUNCTION();
 		int numBins = upperBinEdges.size();
 		std::vector<std::pair<double, double>> decayTimeLimits;
 		decayTimeLimits.reserve(numBins + 1);
@@ -1493,125 +1378,24 @@ namespace K3PiStudies
 		double D0_P3_ProbNNx,
 		int ind)
 	{
-		double probNNx;
-		switch (ind)
-		{
-		case 0:
-			probNNx = D0_P0_ProbNNx;
-			break;
-		case 1:
-			probNNx = D0_P1_ProbNNx;
-			break;
-		case 2:
-			probNNx = D0_P2_ProbNNx;
-			break;
-		case 3:
-			probNNx = D0_P3_ProbNNx;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		const DecayLookup<double> part = tryGetD0Part(ind, D0_P0_ProbNNx, D0_P1_ProbNNx, D0_P2_ProbNNx, D0_P3_ProbNNx);
+		if (!part)
+		{
 			throw InvalidDecayError("getProbNNx: Cannot find particle with index " + std::to_string(ind) + " in daughters.");
 		}
-		return probNNx;
-	}
-
-	/**
-	 * From John's apply_full_selection.py code
-	 */
-	double K3PiStudiesUtils::compute_delta_angle(
-		double extra_px,
-		double extra_py,
-		double extra_pz,
-		double d_px,
-		double d_py,
-		double d_pz)
-	{
-		TLorentzVector extra, d;
-		extra.SetXYZM(extra_px, extra_py, extra_pz, _PION_MASS);
-		d.SetXYZM(d_px, d_py, d_pz, _PION_MASS);
-		return d.Angle(extra.Vect());
-	}
 
-	/**
-	 * From John's apply_full_selection.py code
-	 */
-	double K3PiStudiesUtils::compute_delta_angle(
-		double extra_px,
-		double extra_py,
-		double extra_pz,
-		double extra_m,
-		double d_px,
-		double d_py,
-		double d_pz,
-		double d_m)
-	{
-		TLorentzVector extra, d;
-		extra.SetXYZM(extra_px, extra_py, extra_pz, extra_m);
-		d.SetXYZM(d_px, d_py, d_pz, d_m);
-		return d.Angle(extra.Vect());
+		return part._value;
 	}
 
-	/**
-	 * function to calculate helicity angle of soft pion
-	 * From John's apply_full_selection.py code
-	 */
-	float K3PiStudiesUtils::helicity_angle_func(
-		float d0_px,
-		float d0_py,
-		float d0_pz,
-		float d0_m,
-		const ROOT::RVec<float> &pis_px,
-		const ROOT::RVec<float> &pis_py,
-		const ROOT::RVec<float> &pis_pz,
-		float pis_m)
-	{
-		// create the D* rest frame vector via a boost from lab to rest frame
-		TLorentzVector d0_vec, pis_vec;
-		d0_vec.SetXYZM(d0_px, d0_py, d0_pz, d0_m);
-		pis_vec.SetXYZM(pis_px[0], pis_py[0], pis_pz[0], pis_m);
-		auto dstar_lab_vec = (d0_vec + pis_vec);
-
-		auto lab_n = dstar_lab_vec.Vect().Unit();
-		auto pis_vec_boost = pis_vec;
-
-		// boost soft pion to D* rest frame
-		pis_vec_boost.Boost(-dstar_lab_vec.BoostVector()); // minus sign for lab -> CM
-		auto pis_vec_boost_n = pis_vec_boost.Vect().Unit();
-		// Helicity angle is angle of pi soft relative to D* lab frame momentum
-		double helicity_angle = pis_vec_boost_n.Angle(lab_n);
-
-		return helicity_angle;
-	}
-
-	/**
-	 * function to calculate helicity angle of soft pion
-	 * From John's apply_full_selection.py code
-	 */
-	float K3PiStudiesUtils::helicity_angle_func(
-		float d0_px,
-		float d0_py,
-		float d0_pz,
-		float d0_m,
-		float pis_px,
-		float pis_py,
-		float pis_pz,
-		float pis_m)
-	{
-		// create the D* rest frame vector via a boost from lab to rest frame
-		TLorentzVector d0_vec, pis_vec;
-		d0_vec.SetXYZM(d0_px, d0_py, d0_pz, d0_m);
-		pis_vec.SetXYZM(pis_px, pis_py, pis_pz, pis_m);
-		auto dstar_lab_vec = (d0_vec + pis_vec);
-
-		auto lab_n = dstar_lab_vec.Vect().Unit();
-		auto pis_vec_boost = pis_vec;
-
-		// boost soft pion to D* rest frame
-		pis_vec_boost.Boost(-dstar_lab_vec.BoostVector()); // minus sign for lab -> CM
-		auto pis_vec_boost_n = pis_vec_boost.Vect().Unit();
-		// Helicity angle is angle of pi soft relative to D* lab frame momentum
-		double helicity_angle = pis_vec_boost_n.Angle(lab_n);
-
-		return helicity_angle;
+	DecayLookup<double> K3PiStudiesUtils::tryGetProbNNx(
+		double D0_P0_ProbNNx,
+		double D0_P1_ProbNNx,
+		double D0_P2_ProbNNx,
+		double D0_P3_ProbNNx,
+		int ind) noexcept
+	{
+		return tryGetD0Part(ind, D0_P0_ProbNNx, D0_P1_ProbNNx, D0_P2_ProbNNx, D0_P3_ProbNNx);
 	}
 
 	double K3PiStudiesUtils::getReFit_PE(
@@ -1621,26 +1405,14 @@ namespace K3PiStudies
 		double Dst_ReFit_D0_piplus_1_PE,
 		double Dst_ReFit_D0_piplus_PE)
 	{
-		double pE;
-		switch (pName)
-		{
-		case ReFit_PNames::ReFit_D0_Kplus:
-			pE = Dst_ReFit_D0_Kplus_PE;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus_0:
-			pE = Dst_ReFit_D0_piplus_0_PE;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus_1:
-			pE = Dst_ReFit_D0_piplus_1_PE;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus:
-			pE = Dst_ReFit_D0_piplus_PE;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		if (static_cast<unsigned int>(pName) > 3)
+		{
 			throw InvalidDecayError("getReFit_PE: Cannot find daughter with name " + std::to_string(pName) + " in daughters.");
 		}
 
-		return pE;
+		const double pE[4] = {Dst_ReFit_D0_Kplus_PE, Dst_ReFit_D0_piplus_0_PE, Dst_ReFit_D0_piplus_1_PE, Dst_ReFit_D0_piplus_PE};
+		return pE[pName];
 	}
 
 	double K3PiStudiesUtils::getReFit_PX(
@@ -1650,26 +1422,14 @@ namespace K3PiStudies
 		double Dst_ReFit_D0_piplus_1_PX,
 		double Dst_ReFit_D0_piplus_PX)
 	{
-		double px;
-		switch (pName)
-		{
-		case ReFit_PNames::ReFit_D0_Kplus:
-			px = Dst_ReFit_D0_Kplus_PX;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus_0:
-			px = Dst_ReFit_D0_piplus_0_PX;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus_1:
-			px = Dst_ReFit_D0_piplus_1_PX;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus:
-			px = Dst_ReFit_D0_piplus_PX;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		if (static_cast<unsigned int>(pName) > 3)
+		{
 			throw InvalidDecayError("getReFit_PX: Cannot find daughter with name " + std::to_string(pName) + " in daughters.");
 		}
 
-		return px;
+		const double px[4] = {Dst_ReFit_D0_Kplus_PX, Dst_ReFit_D0_piplus_0_PX, Dst_ReFit_D0_piplus_1_PX, Dst_ReFit_D0_piplus_PX};
+		return px[pName];
 	}
 
 	double K3PiStudiesUtils::getReFit_PY(
@@ -1679,26 +1439,14 @@ namespace K3PiStudies
 		double Dst_ReFit_D0_piplus_1_PY,
 		double Dst_ReFit_D0_piplus_PY)
 	{
-		double py;
-		switch (pName)
-		{
-		case ReFit_PNames::ReFit_D0_Kplus:
-			py = Dst_ReFit_D0_Kplus_PY;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus_0:
-			py = Dst_ReFit_D0_piplus_0_PY;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus_1:
-			py = Dst_ReFit_D0_piplus_1_PY;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus:
-			py = Dst_ReFit_D0_piplus_PY;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		if (static_cast<unsigned int>(pName) > 3)
+		{
 			throw InvalidDecayError("getReFit_PY: Cannot find daughter with name " + std::to_string(pName) + " in daughters.");
 		}
 
-		return py;
+		const double py[4] = {Dst_ReFit_D0_Kplus_PY, Dst_ReFit_D0_piplus_0_PY, Dst_ReFit_D0_piplus_1_PY, Dst_ReFit_D0_piplus_PY};
+		return py[pName];
 	}
 
 	double K3PiStudiesUtils::getReFit_PZ(
@@ -1708,26 +1456,14 @@ namespace K3PiStudies
 		double Dst_ReFit_D0_piplus_1_PZ,
 		double Dst_ReFit_D0_piplus_PZ)
 	{
-		double pz;
-		switch (pName)
-		{
-		case ReFit_PNames::ReFit_D0_Kplus:
-			pz = Dst_ReFit_D0_Kplus_PZ;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus_0:
-			pz = Dst_ReFit_D0_piplus_0_PZ;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus_1:
-			pz = Dst_ReFit_D0_piplus_1_PZ;
-			break;
-		case ReFit_PNames::ReFit_D0_piplus:
-			pz = Dst_ReFit_D0_piplus_PZ;
-			break;
-		default:
+		K3PI_PROFILE_FUNCTION();
+		if (static_cast<unsigned int>(pName) > 3)
+		{
 			throw InvalidDecayError("getReFit_PZ: Cannot find daughter with name " + std::to_string(pName) + " in daughters.");
 		}
 
-		return pz;
+		const double pz[4] = {Dst_ReFit_D0_Kplus_PZ, Dst_ReFit_D0_piplus_0_PZ, Dst_ReFit_D0_piplus_1_PZ, Dst_ReFit_D0_piplus_PZ};
+		return pz[pName];
 	}
 
 } // end namespace K3PiStudies
\ No newline at end of file
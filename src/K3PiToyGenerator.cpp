@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "K3PiToyGenerator.h"
+#include "K3PiDecayPermutation.h"
+#include "K3PiInstrumentation.h"
+#include "K3PiKinematics.h"
+
+namespace K3PiStudies
+{
+	namespace
+	{
+		constexpr std::uint32_t _PHILOX_M0 = 0xD2511F53;
+		constexpr std::uint32_t _PHILOX_M1 = 0xCD9E8D57;
+		constexpr std::uint32_t _PHILOX_W0 = 0x9E3779B9;
+		constexpr std::uint32_t _PHILOX_W1 = 0xBB67AE85;
+		constexpr int _PHILOX_ROUNDS = 10;
+
+		// bins per m12 for the upper bound of the weight, and per axis for the efficiency estimate
+		constexpr int _NUM_BOUND_BINS = 2000;
+		constexpr int _NUM_EFFICIENCY_BINS = 400;
+
+		// momentum of either daughter of m -> m1 m2 in the m rest frame
+		double breakupMomentum(double m, double m1, double m2)
+		{
+			const double sumSq = (m + m1 + m2) * (m - m1 - m2);
+			const double diffSq = (m + m1 - m2) * (m - m1 + m2);
+			return sumSq > 0.0 && diffSq > 0.0 ? std::sqrt(sumSq * diffSq) / (2.0 * m) : 0.0;
+		}
+
+		// the 4-body phase space density in (m12, m34) (the angles are flat), up to a constant
+		double phspWeight(double mD0, double m12, double m34)
+		{
+			const double mK = K3PiKinematics::_KAON_MASS;
+			const double mPi = K3PiKinematics::_PION_MASS;
+			return breakupMomentum(mD0, m12, m34) * breakupMomentum(m12, mK, mPi) * breakupMomentum(m34, mPi, mPi);
+		}
+
+		// a daughter of a pair of mass m moving along z with momentum pz, given its momentum in the pair frame
+		ROOT::Math::PxPyPzEVector boostAlongZ(double px, double py, double pz, double mass, double pairMass, double pairPz)
+		{
+			const double e = std::sqrt(px * px + py * py + pz * pz + mass * mass);
+			const double pairE = std::sqrt(pairPz * pairPz + pairMass * pairMass);
+			const double gamma = pairE / pairMass;
+			const double gammaBeta = pairPz / pairMass;
+			return {px, py, gamma * pz + gammaBeta * e, gamma * e + gammaBeta * pz};
+		}
+
+		// rotation taking z to (theta, phi), after rolling by psi about z
+		struct Rotation
+		{
+			double _m[3][3];
+
+			Rotation(double cosTheta, double phi, double psi)
+			{
+				const double sinTheta = std::sqrt(std::max(0.0, 1.0 - cosTheta * cosTheta));
+				const double cosPhi = std::cos(phi);
+				const double sinPhi = std::sin(phi);
+				const double cosPsi = std::cos(psi);
+				const double sinPsi = std::sin(psi);
+
+				// Rz(phi) Ry(theta) Rz(psi)
+				_m[0][0] = cosPhi * cosTheta * cosPsi - sinPhi * sinPsi;
+				_m[0][1] = -cosPhi * cosTheta * sinPsi - sinPhi * cosPsi;
+				_m[0][2] = cosPhi * sinTheta;
+				_m[1][0] = sinPhi * cosTheta * cosPsi + cosPhi * sinPsi;
+				_m[1][1] = -sinPhi * cosTheta * sinPsi + cosPhi * cosPsi;
+				_m[1][2] = sinPhi * sinTheta;
+				_m[2][0] = -sinTheta * cosPsi;
+				_m[2][1] = sinTheta * sinPsi;
+				_m[2][2] = cosTheta;
+			}
+
+			ROOT::Math::PxPyPzEVector operator()(const ROOT::Math::PxPyPzEVector &v) const
+			{
+				return {
+					_m[0][0] * v.Px() + _m[0][1] * v.Py() + _m[0][2] * v.Pz(),
+					_m[1][0] * v.Px() + _m[1][1] * v.Py() + _m[1][2] * v.Pz(),
+					_m[2][0] * v.Px() + _m[2][1] * v.Py() + _m[2][2] * v.Pz(),
+					v.E()};
+			}
+		};
+	} // end anonymous namespace
+
+	K3PiCounterRNG::K3PiCounterRNG(std::uint64_t seed, std::uint64_t stream)
+		: _key{std::uint32_t(seed), std::uint32_t(seed >> 32)}, _stream(stream)
+	{
+	}
+
+	void K3PiCounterRNG::nextBlock()
+	{
+		std::array<std::uint32_t, 4> ctr = {std::uint32_t(_stream), std::uint32_t(_stream >> 32), _blockInd++, 0};
+		std::array<std::uint32_t, 2> key = _key;
+		for (int r = 0; r < _PHILOX_ROUNDS; r++)
+		{
+			const std::uint64_t prod0 = std::uint64_t(_PHILOX_M0) * ctr[0];
+			const std::uint64_t prod1 = std::uint64_t(_PHILOX_M1) * ctr[2];
+			ctr = {
+				std::uint32_t(prod1 >> 32) ^ ctr[1] ^ key[0],
+				std::uint32_t(prod1),
+				std::uint32_t(prod0 >> 32) ^ ctr[3] ^ key[1],
+				std::uint32_t(prod0)};
+			key[0] += _PHILOX_W0;
+			key[1] += _PHILOX_W1;
+		}
+		_block = ctr;
+		_numUsed = 0;
+	}
+
+	double K3PiCounterRNG::uniform()
+	{
+		if (_numUsed >= 4)
+		{
+			nextBlock();
+		}
+		const std::uint64_t bits = (std::uint64_t(_block[_numUsed]) << 32) | _block[_numUsed + 1];
+		_numUsed += 2;
+		return double(bits >> 11) * 0x1.0p-53;
+	}
+
+	K3PiToyGenerator::K3PiToyGenerator(const K3PiToyGeneratorConfig &config)
+		: _config(config)
+	{
+		K3PI_PROFILE_FUNCTION();
+		const double mK = K3PiKinematics::_KAON_MASS;
+		const double mPi = K3PiKinematics::_PION_MASS;
+		const double mD0 = _config._d0MassMeV;
+		if (!(mD0 > mK + 3.0 * mPi))
+		{
+			throw std::invalid_argument("K3PiToyGenerator: _d0MassMeV must be above the K 3pi threshold.");
+		}
+
+		_m12Min = mK + mPi;
+		_m34Min = 2.0 * mPi;
+		_massesMax = mD0;
+
+		// a true upper bound, so accept/reject is exact: within an m12 bin [lo, hi], p falls with m12 and m34, q12 rises with
+		// m12, and q34 rises with m34 <= mD0 - lo
+		const double m12Max = mD0 - _m34Min;
+		const double binWidth = (m12Max - _m12Min) / _NUM_BOUND_BINS;
+		_maxWeight = 0.0;
+		for (int b = 0; b < _NUM_BOUND_BINS; b++)
+		{
+			const double lo = _m12Min + b * binWidth;
+			const double hi = lo + binWidth;
+			const double bound = breakupMomentum(mD0, lo, _m34Min) * breakupMomentum(hi, mK, mPi) * breakupMomentum(mD0 - lo, mPi, mPi);
+			_maxWeight = std::max(_maxWeight, bound);
+		}
+
+		// mean acceptance over the (m12, m34) square the proposals are drawn from
+		const double m34Max = mD0 - _m12Min;
+		const double dm12 = (m12Max - _m12Min) / _NUM_EFFICIENCY_BINS;
+		const double dm34 = (m34Max - _m34Min) / _NUM_EFFICIENCY_BINS;
+		double sumWeights = 0.0;
+		for (int i = 0; i < _NUM_EFFICIENCY_BINS; i++)
+		{
+			for (int j = 0; j < _NUM_EFFICIENCY_BINS; j++)
+			{
+				const double m12 = _m12Min + (i + 0.5) * dm12;
+				const double m34 = _m34Min + (j + 0.5) * dm34;
+				if (m12 + m34 < mD0)
+				{
+					sumWeights += phspWeight(mD0, m12, m34);
+				}
+			}
+		}
+		_efficiency = sumWeights / (_maxWeight * _NUM_EFFICIENCY_BINS * _NUM_EFFICIENCY_BINS);
+	}
+
+	Phsp4BodyPoint K3PiToyGenerator::generateOne(std::uint64_t eventInd, ROOT::Math::PxPyPzEVector *p4) const
+	{
+		const double mK = K3PiKinematics::_KAON_MASS;
+		const double mPi = K3PiKinematics::_PION_MASS;
+		const double mD0 = _config._d0MassMeV;
+		const double twoPi = 2.0 * K3PiKinematics::_PI;
+
+		K3PiCounterRNG rng(_config._seed, eventInd);
+
+		Phsp4BodyPoint point;
+		const double m12Range = mD0 - _m34Min - _m12Min;
+		const double m34Range = mD0 - _m12Min - _m34Min;
+		for (;;)
+		{
+			point._m12_MeV = _m12Min + m12Range * rng.uniform();
+			point._m34_MeV = _m34Min + m34Range * rng.uniform();
+			const double u = rng.uniform();
+			if (point._m12_MeV + point._m34_MeV < _massesMax && u * _maxWeight < phspWeight(mD0, point._m12_MeV, point._m34_MeV))
+			{
+				break;
+			}
+		}
+		point._cos12 = 2.0 * rng.uniform() - 1.0;
+		point._cos34 = 2.0 * rng.uniform() - 1.0;
+		point._phi_rad = twoPi * rng.uniform();
+
+		if (!p4)
+		{
+			return point;
+		}
+
+		// K pi pair along +z, with yhat = K x pi along +y; pi pi pair along -z, its plane at phi about z
+		const double p = breakupMomentum(mD0, point._m12_MeV, point._m34_MeV);
+		const double q12 = breakupMomentum(point._m12_MeV, mK, mPi);
+		const double q34 = breakupMomentum(point._m34_MeV, mPi, mPi);
+		const double sin12 = std::sqrt(std::max(0.0, 1.0 - point._cos12 * point._cos12));
+		const double sin34 = std::sqrt(std::max(0.0, 1.0 - point._cos34 * point._cos34));
+
+		const double kx = -q12 * sin12;
+		const double kz = q12 * point._cos12;
+		const double cx = q34 * sin34 * std::cos(point._phi_rad);
+		const double cy = -q34 * sin34 * std::sin(point._phi_rad);
+		const double cz = q34 * point._cos34;
+
+		p4[K3Pi_Kaon] = boostAlongZ(kx, 0.0, kz, mK, point._m12_MeV, p);
+		p4[K3Pi_OSPion1] = boostAlongZ(-kx, 0.0, -kz, mPi, point._m12_MeV, p);
+		p4[K3Pi_SSPion] = boostAlongZ(cx, cy, cz, mPi, point._m34_MeV, -p);
+		p4[K3Pi_OSPion2] = boostAlongZ(-cx, -cy, -cz, mPi, point._m34_MeV, -p);
+
+		if (_config._randomOrientation)
+		{
+			const Rotation rotation(2.0 * rng.uniform() - 1.0, twoPi * rng.uniform(), twoPi * rng.uniform());
+			for (int r = 0; r < 4; r++)
+			{
+				p4[r] = rotation(p4[r]);
+			}
+		}
+
+		return point;
+	}
+
+	K3PiToyEvent K3PiToyGenerator::generateEvent(std::uint64_t eventInd) const
+	{
+		K3PI_PROFILE_FUNCTION();
+		K3PiToyEvent event;
+		event._phsp = generateOne(eventInd, event._p4.data());
+		return event;
+	}
+
+	Phsp4BodyPoint K3PiToyGenerator::generatePoint(std::uint64_t eventInd) const
+	{
+		K3PI_PROFILE_FUNCTION();
+		return generateOne(eventInd, nullptr);
+	}
+
+	void K3PiToyGenerator::generate(
+		std::uint64_t firstEvent,
+		std::size_t nEvents,
+		const Phsp4BodyColumns &phsp,
+		const std::array<P4OutColumns, 4> *p4,
+		unsigned int numThreads) const
+	{
+		K3PI_PROFILE_FUNCTION();
+		auto generateRange = [&](std::size_t begin, std::size_t end)
+		{
+			std::array<ROOT::Math::PxPyPzEVector, 4> vecs;
+			for (std::size_t i = begin; i < end; i++)
+			{
+				const Phsp4BodyPoint point = generateOne(firstEvent + i, p4 ? vecs.data() : nullptr);
+				phsp._m12_MeV[i] = point._m12_MeV;
+				phsp._m34_MeV[i] = point._m34_MeV;
+				phsp._cos12[i] = point._cos12;
+				phsp._cos34[i] = point._cos34;
+				phsp._phi_rad[i] = point._phi_rad;
+
+				if (p4)
+				{
+					for (int r = 0; r < 4; r++)
+					{
+						(*p4)[r]._px[i] = vecs[r].Px();
+						(*p4)[r]._py[i] = vecs[r].Py();
+						(*p4)[r]._pz[i] = vecs[r].Pz();
+						(*p4)[r]._pE[i] = vecs[r].E();
+					}
+				}
+			}
+		};
+
+		// every event has its own stream, so the split only changes who computes what
+		const unsigned int maxThreads = numThreads > 0 ? numThreads : std::max(1u, std::thread::hardware_concurrency());
+		const std::size_t numWorkers = std::max<std::size_t>(1, std::min<std::size_t>(maxThreads, nEvents));
+		const std::size_t perWorker = (nEvents + numWorkers - 1) / numWorkers;
+
+		// the calling thread does the first range
+		std::vector<std::thread> workers;
+		for (std::size_t w = 1; w < numWorkers; w++)
+		{
+			const std::size_t begin = std::min(nEvents, w * perWorker);
+			workers.emplace_back(generateRange, begin, std::min(nEvents, begin + perWorker));
+		}
+		generateRange(0, std::min(nEvents, perWorker));
+		for (std::thread &t : workers)
+		{
+			t.join();
+		}
+	}
+
+	double K3PiToyGenerator::efficiency() const
+	{
+		return _efficiency;
+	}
+
+	const K3PiToyGeneratorConfig &K3PiToyGenerator::config() const
+	{
+		return _config;
+	}
+
+} // end namespace K3PiStudies